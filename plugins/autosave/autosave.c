@@ -168,16 +168,12 @@ typedef struct {
 } RestorePending;
 
 /* Replace `buf`'s rows with the contents of `path`, mark dirty.
- * Mirrors the read loop in buf_reload(). */
+ * Same steps as buf_reload(). */
 static int autosave_load_into(Buffer *buf, const char *path) {
-    FsLines *r = NULL;
-    if (fs_lines_open(&r, path) != ED_OK) return -1;
+    if (!fs_is_file(path)) return -1;
 
     /* Drop existing rows. */
-    for (int i = 0; i < buf->num_rows; i++) row_free(&buf->rows[i]);
-    free(buf->rows);
-    buf->rows     = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
     if (buf->cursor) { buf->cursor->x = 0; buf->cursor->y = 0; }
 
     /* Drop undo so the user can't accidentally undo back into the
@@ -188,11 +184,7 @@ static int autosave_load_into(Buffer *buf, const char *path) {
     /* Drop vtext marks pinned to old line indices. */
     vtext_clear_all(buf);
 
-    const char *line;
-    size_t      len;
-    while (fs_lines_next(r, &line, &len))
-        buf_row_insert_in(buf, buf->num_rows, line, len);
-    fs_lines_close(r);
+    if (buf_rows_load_file(buf, path) != ED_OK) return -1;
 
     buf->dirty = 1;
     return 0;
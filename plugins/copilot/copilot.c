@@ -19,6 +19,7 @@
 #include "copilot_internal.h"
 #include "lsp/cjson/cJSON.h"
 #include "lsp/json_helpers.h"
+#include "lsp/json_lazy.h"
 
 /* ----- module-level config ----- */
 
@@ -42,7 +43,7 @@ static int cp_cursor_at_eol(Buffer *buf) {
     if (!buf || !buf->cursor) return 0;
     int y = buf->cursor->y;
     if (y < 0 || y >= buf->num_rows) return 0;
-    return buf->cursor->x == (int)buf->rows[y].chars.len;
+    return buf->cursor->x == (int)buf_row(buf, y)->chars.len;
 }
 
 /* ----- pane (alternatives buffer) ----- */
@@ -84,10 +85,7 @@ static void cp_pane_refresh(void) {
     Buffer *b = &E.buffers[idx];
 
     /* Clear existing rows. */
-    for (int i = 0; i < b->num_rows; i++) row_free(&b->rows[i]);
-    free(b->rows);
-    b->rows     = NULL;
-    b->num_rows = 0;
+    buf_rows_clear(b);
     if (b->cursor) { b->cursor->x = 0; b->cursor->y = 0; }
 
     if (CP.alts_count == 0) {
@@ -176,61 +174,128 @@ static void cp_dismiss(void) {
 
 /* ----- completion request ----- */
 
-/* Full-text sync: tell the server the current contents of `buf` and
- * bump `CP.doc_version`. The matching getCompletions call below
- * reuses (does not bump) the same version. */
-static void cp_send_did_change(Buffer *buf, const char *uri, const char *text) {
+/* ----- document sync ----- */
+
+static CpDoc *cp_doc_find(const char *uri) {
+    for (ptrdiff_t i = 0; i < arrlen(CP.docs); i++)
+        if (strcmp(CP.docs[i]->uri, uri) == 0) return CP.docs[i];
+    return NULL;
+}
+
+static void cp_doc_drop(CpDoc *doc) {
+    for (ptrdiff_t i = 0; i < arrlen(CP.docs); i++) {
+        if (CP.docs[i] == doc) { arrdel(CP.docs, i); break; }
+    }
+    buf_edit_span_detach(buf_edit_span_owner(&doc->span), &doc->span);
+    free(doc->uri);
+    free(doc);
+}
+
+void cp_docs_reset(void) {
+    while (arrlen(CP.docs) > 0) cp_doc_drop(CP.docs[0]);
+    arrfree(CP.docs);
+}
+
+/* didChange for the rows touched since the last sync, as one
+ * whole-line range replacement (json_line_change). Reloads, and
+ * servers without incremental sync, get the full text. Nothing is
+ * sent when nothing changed, so a completion request right after the
+ * debounce timer's own sync costs no traffic. */
+static void cp_doc_flush(Buffer *buf, CpDoc *doc) {
+    BufEditSpan *e = &doc->span;
+    if (!e->touched && !e->reset) return;
+
+    cJSON *change = json_line_change(buf, e, CP.sync_incremental);
+    if (!change) return;
+
     cJSON *p   = cJSON_CreateObject();
     cJSON *td  = cJSON_CreateObject();
-    cJSON_AddStringToObject(td, "uri",     uri);
-    cJSON_AddNumberToObject(td, "version", ++CP.doc_version);
+    doc->version = ++CP.doc_version;
+    cJSON_AddStringToObject(td, "uri",     doc->uri);
+    cJSON_AddNumberToObject(td, "version", doc->version);
     cJSON_AddItemToObject(p, "textDocument", td);
 
     cJSON *changes = cJSON_CreateArray();
-    cJSON *change  = cJSON_CreateObject();
-    cJSON_AddStringToObject(change, "text", text);   /* full document */
     cJSON_AddItemToArray(changes, change);
     cJSON_AddItemToObject(p, "contentChanges", changes);
 
     cp_proto_notify("textDocument/didChange", p);
-    (void)buf;
+    buf_edit_span_clear(e);
+}
+
+static void cp_send_did_open(Buffer *buf) {
+    if (!buf || !buf->filename || !CP.spawned || !CP.initialized) return;
+    if (cp_is_pane_buf(buf)) return;        /* never sync our own pane */
+    char *uri  = cp_uri_for(buf->filename);
+    char *text = buf_to_text(buf, NULL);
+    if (!uri || !text) { free(uri); free(text); return; }
+
+    cJSON *p   = cJSON_CreateObject();
+    cJSON *td  = cJSON_CreateObject();
+    int version = ++CP.doc_version;
+    cJSON_AddStringToObject(td, "uri",        uri);
+    cJSON_AddStringToObject(td, "languageId", cp_language_id(buf));
+    cJSON_AddNumberToObject(td, "version",    version);
+    cJSON_AddStringToObject(td, "text",       text);
+    cJSON_AddItemToObject(p, "textDocument", td);
+
+    /* From here on only the rows that change need to go out. */
+    CpDoc *doc = cp_doc_find(uri);
+    if (!doc && (doc = calloc(1, sizeof(*doc))) != NULL) {
+        doc->uri = strdup(uri);
+        arrput(CP.docs, doc);
+    }
+    if (doc) {
+        buf_edit_span_attach(buf, &doc->span);
+        doc->version = version;
+    }
+
+    cp_proto_notify("textDocument/didOpen", p);
+    free(uri); free(text);
 }
 
+/* ----- completion request ----- */
+
 static void cp_request_completions_for_cursor(Buffer *buf) {
     if (!CP.spawned || !CP.initialized || !CP.signed_in) return;
     if (!buf || !buf->filename || !buf->cursor) return;
     if (cp_is_pane_buf(buf)) return;        /* never request for our own pane */
 
-    char *uri  = cp_uri_for(buf->filename);
-    char *text = buf_to_text(buf, NULL);
-    if (!uri || !text) { free(uri); free(text); return; }
+    char *uri = cp_uri_for(buf->filename);
+    if (!uri) return;
 
     /* Sync the document FIRST so the server's view matches what we're
-     * about to point at with `position`. The version we set here is
-     * the one we cite in getCompletions immediately below. */
-    cp_send_did_change(buf, uri, text);
+     * about to point at with `position`. getCompletions cites the
+     * version of that sync. */
+    CpDoc *doc = cp_doc_find(uri);
+    if (!doc) {
+        cp_send_did_open(buf);
+        doc = cp_doc_find(uri);
+    }
+    if (!doc) { free(uri); return; }
+    cp_doc_flush(buf, doc);
 
     cJSON *params = cJSON_CreateObject();
-    cJSON *doc    = cJSON_CreateObject();
-    cJSON_AddStringToObject(doc, "uri",          uri);
-    cJSON_AddNumberToObject(doc, "version",      CP.doc_version);
-    cJSON_AddStringToObject(doc, "languageId",   cp_language_id(buf));
-    cJSON_AddStringToObject(doc, "relativePath", buf->filename);
-    cJSON_AddBoolToObject  (doc, "insertSpaces", E.expand_tab ? 1 : 0);
-    cJSON_AddNumberToObject(doc, "tabSize",      E.tab_size > 0 ? E.tab_size : 4);
-    cJSON_AddNumberToObject(doc, "indentSize",   E.tab_size > 0 ? E.tab_size : 4);
+    cJSON *td     = cJSON_CreateObject();
+    cJSON_AddStringToObject(td, "uri",          uri);
+    cJSON_AddNumberToObject(td, "version",      doc->version);
+    cJSON_AddStringToObject(td, "languageId",   cp_language_id(buf));
+    cJSON_AddStringToObject(td, "relativePath", buf->filename);
+    cJSON_AddBoolToObject  (td, "insertSpaces", E.expand_tab ? 1 : 0);
+    cJSON_AddNumberToObject(td, "tabSize",      E.tab_size > 0 ? E.tab_size : 4);
+    cJSON_AddNumberToObject(td, "indentSize",   E.tab_size > 0 ? E.tab_size : 4);
 
     cJSON *pos = cJSON_CreateObject();
     cJSON_AddNumberToObject(pos, "line",      buf->cursor->y);
     /* Byte column. Strict UTF-16 code-unit math is a v2 concern;
      * ASCII files are the common case. */
     cJSON_AddNumberToObject(pos, "character", buf->cursor->x);
-    cJSON_AddItemToObject(doc, "position", pos);
+    cJSON_AddItemToObject(td, "position", pos);
 
-    cJSON_AddItemToObject(params, "doc", doc);
+    cJSON_AddItemToObject(params, "doc", td);
 
     cp_proto_request("getCompletions", params, CP_REQ_GET_COMPLETIONS);
-    free(uri); free(text);
+    free(uri);
 }
 
 /* ----- debounce ----- */
@@ -271,8 +336,22 @@ static void on_cursor_move(const HookCursorEvent *e) {
         cp_dismiss();
 }
 
+/* Send the current buffer's pending edits. Called at mode changes so
+ * one sync never spans edits made far apart (a `dd` at the top, then
+ * typing at the bottom would otherwise go out as the whole file). */
+static void cp_sync_current(void) {
+    Buffer *buf = buf_cur();
+    if (!CP.initialized || !buf || !buf->filename || arrlen(CP.docs) == 0) return;
+    char *uri = cp_uri_for(buf->filename);
+    if (!uri) return;
+    CpDoc *doc = cp_doc_find(uri);
+    if (doc) cp_doc_flush(buf, doc);
+    free(uri);
+}
+
 static void on_mode_change(const HookModeEvent *e) {
     if (!e) return;
+    cp_sync_current();
     if (e->new_mode == MODE_INSERT) {
         /* Trigger a fetch on mode entry so empty rows (and rows the
          * user opened with `o`/`O`/`a`/`i` without typing anything
@@ -284,24 +363,6 @@ static void on_mode_change(const HookModeEvent *e) {
     }
 }
 
-static void cp_send_did_open(Buffer *buf) {
-    if (!buf || !buf->filename || !CP.spawned || !CP.initialized) return;
-    if (cp_is_pane_buf(buf)) return;        /* never sync our own pane */
-    char *uri  = cp_uri_for(buf->filename);
-    char *text = buf_to_text(buf, NULL);
-    if (!uri || !text) { free(uri); free(text); return; }
-
-    cJSON *p   = cJSON_CreateObject();
-    cJSON *td  = cJSON_CreateObject();
-    cJSON_AddStringToObject(td, "uri",        uri);
-    cJSON_AddStringToObject(td, "languageId", cp_language_id(buf));
-    cJSON_AddNumberToObject(td, "version",    ++CP.doc_version);
-    cJSON_AddStringToObject(td, "text",       text);
-    cJSON_AddItemToObject(p, "textDocument", td);
-    cp_proto_notify("textDocument/didOpen", p);
-    free(uri); free(text);
-}
-
 static void cp_notify_existing_buffers(void) {
     for (ptrdiff_t i = 0; i < arrlen(E.buffers); i++) {
         cp_send_did_open(&E.buffers[i]);
@@ -324,6 +385,8 @@ static void on_buffer_close(HookBufferEvent *e) {
     cJSON_AddStringToObject(td, "uri", uri);
     cJSON_AddItemToObject(p, "textDocument", td);
     cp_proto_notify("textDocument/didClose", p);
+    CpDoc *doc = cp_doc_find(uri);
+    if (doc) cp_doc_drop(doc);
     free(uri);
 }
 
@@ -436,41 +499,41 @@ static void cp_show_active(int line, int col) {
     }
 }
 
-static void cp_apply_suggestion(cJSON *result) {
+static void cp_apply_suggestion(JsonVal result) {
     /* Drop prior ghost + alt list (this is a fresh response). */
     cp_clear_suggestion();
-    if (!result) return;
+    if (!jv_ok(result)) return;
 
-    cJSON *arr = cJSON_GetObjectItemCaseSensitive(result, "completions");
-    if (!arr || !cJSON_IsArray(arr)) {
-        cp_pane_refresh();
-        return;
-    }
-    int n = cJSON_GetArraySize(arr);
+    /* Alternatives are read straight off the message, at most
+     * CP_ALTS_MAX of them. */
+    JsonVal arr = jv_get(result, "completions");
+    int     n   = jv_count(arr, CP_ALTS_MAX);
     if (n <= 0) {
-        log_msg("copilot: no completions");
+        if (arr.type == JV_ARRAY) log_msg("copilot: no completions");
         cp_pane_refresh();
         return;
     }
 
-    /* Read anchor from the first completion (server's reference point). */
-    cJSON *first  = cJSON_GetArrayItem(arr, 0);
-    cJSON *posobj = cJSON_GetObjectItemCaseSensitive(first, "position");
-    int line = posobj ? json_get_int(posobj, "line", -1) : -1;
-    int col  = posobj ? json_get_int(posobj, "character", -1) : -1;
-
     CP.alts        = calloc((size_t)n, sizeof(*CP.alts));
     CP.alts_count  = 0;
     CP.alts_active = 0;
     if (!CP.alts) return;
-    for (int i = 0; i < n; i++) {
-        cJSON *item = cJSON_GetArrayItem(arr, i);
-        const char *t = json_get_string(item, "text");
-        const char *d = json_get_string(item, "displayText");
-        const char *u = json_get_string(item, "uuid");
-        CP.alts[CP.alts_count].text    = t ? strdup(t) : NULL;
-        CP.alts[CP.alts_count].display = d ? strdup(d) : (t ? strdup(t) : NULL);
-        CP.alts[CP.alts_count].uuid    = u ? strdup(u) : NULL;
+    int      line = -1, col = -1;
+    JsonIter it;
+    JsonVal  item;
+    jv_iter(arr, &it);
+    while (CP.alts_count < n && jv_iter_next(&it, &item)) {
+        if (CP.alts_count == 0) {
+            /* Read anchor from the first completion (server's reference point). */
+            JsonVal pos = jv_get(item, "position");
+            line = jv_get_int(pos, "line", -1);
+            col  = jv_get_int(pos, "character", -1);
+        }
+        char *t = jv_get_strdup(item, "text");
+        char *d = jv_get_strdup(item, "displayText");
+        CP.alts[CP.alts_count].text    = t;
+        CP.alts[CP.alts_count].display = d ? d : (t ? strdup(t) : NULL);
+        CP.alts[CP.alts_count].uuid    = jv_get_strdup(item, "uuid");
         CP.alts_count++;
     }
 
@@ -478,32 +541,35 @@ static void cp_apply_suggestion(cJSON *result) {
     cp_pane_refresh();
 }
 
-static void cp_handle_check_status(cJSON *result) {
-    const char *status = result ? json_get_string(result, "status") : NULL;
-    const char *user   = result ? json_get_string(result, "user")   : NULL;
-    if (status && strcmp(status, "OK") == 0) {
+static void cp_handle_check_status(JsonVal result) {
+    JsonVal status = jv_get(result, "status");
+    char    user[sizeof(CP.user_login)];
+    bool    has_user = jv_strcpy(jv_get(result, "user"), user, sizeof(user));
+    if (jv_streq(status, "OK")) {
         int was_signed_in = CP.signed_in;
         CP.signed_in = 1;
-        if (user) {
+        if (has_user) {
             safe_strcpy(CP.user_login, user, sizeof(CP.user_login));
         }
         ed_set_status_message("copilot: signed in as %s",
-                              user ? user : "(unknown)");
+                              has_user ? user : "(unknown)");
         /* First time we know the session is usable: catch the server up
          * on every buffer the editor already had open before we
          * connected. */
         if (!was_signed_in) cp_notify_existing_buffers();
     } else {
+        char why[64];
         CP.signed_in = 0;
         ed_set_status_message("copilot: %s - run :copilot login",
-                              status ? status : "not signed in");
+                              jv_strcpy(status, why, sizeof(why)) ? why
+                                                                  : "not signed in");
     }
 }
 
-static void cp_handle_sign_in_initiate(cJSON *result) {
-    const char *code = result ? json_get_string(result, "userCode")        : NULL;
-    const char *uri  = result ? json_get_string(result, "verificationUri") : NULL;
-    if (!code || !uri) {
+static void cp_handle_sign_in_initiate(JsonVal result) {
+    char code[sizeof(CP.user_code)], uri[512];
+    if (!jv_strcpy(jv_get(result, "userCode"), code, sizeof(code)) ||
+        !jv_strcpy(jv_get(result, "verificationUri"), uri, sizeof(uri))) {
         ed_set_status_message("copilot: signInInitiate returned no userCode");
         return;
     }
@@ -514,41 +580,49 @@ static void cp_handle_sign_in_initiate(cJSON *result) {
     log_msg("copilot: device code=%s url=%s", code, uri);
 }
 
-static void cp_handle_sign_in_confirm(cJSON *result) {
-    const char *status = result ? json_get_string(result, "status") : NULL;
-    const char *user   = result ? json_get_string(result, "user")   : NULL;
-    if (status && strcmp(status, "OK") == 0) {
+static void cp_handle_sign_in_confirm(JsonVal result) {
+    JsonVal status = jv_get(result, "status");
+    char    user[sizeof(CP.user_login)];
+    bool    has_user = jv_strcpy(jv_get(result, "user"), user, sizeof(user));
+    if (jv_streq(status, "OK")) {
         int was_signed_in = CP.signed_in;
         CP.signed_in = 1;
-        if (user) {
+        if (has_user) {
             safe_strcpy(CP.user_login, user, sizeof(CP.user_login));
         }
         ed_set_status_message("copilot: signed in as %s",
-                              user ? user : "(unknown)");
+                              has_user ? user : "(unknown)");
         if (!was_signed_in) cp_notify_existing_buffers();
     } else {
+        char why[64];
         ed_set_status_message("copilot: sign-in failed (%s)",
-                              status ? status : "unknown");
+                              jv_strcpy(status, why, sizeof(why)) ? why : "unknown");
     }
 }
 
-static void cp_process_response(cJSON *json) {
-    int id = json_get_int(json, "id", -1);
-    cJSON *err = cJSON_GetObjectItemCaseSensitive(json, "error");
-    if (err) {
-        const char *msg = json_get_string(err, "message");
-        log_msg("copilot: error id=%d: %s", id, msg ? msg : "?");
-        ed_set_status_message("copilot error: %s", msg ? msg : "(unknown)");
+static void cp_process_response(JsonVal json) {
+    int     id  = jv_get_int(json, "id", -1);
+    JsonVal err = jv_get(json, "error");
+    if (jv_ok(err)) {
+        char msg[512];
+        if (!jv_strcpy(jv_get(err, "message"), msg, sizeof(msg))) msg[0] = '\0';
+        log_msg("copilot: error id=%d: %s", id, *msg ? msg : "?");
+        ed_set_status_message("copilot error: %s", *msg ? msg : "(unknown)");
         cp_proto_pending_pop(id);
         return;
     }
-    cJSON    *result = cJSON_GetObjectItemCaseSensitive(json, "result");
+    JsonVal   result = jv_get(json, "result");
     CpReqKind kind   = cp_proto_pending_pop(id);
 
     switch (kind) {
-    case CP_REQ_INITIALIZE:
+    case CP_REQ_INITIALIZE: {
+        /* textDocumentSync is a kind, or an options object with one. */
+        JsonVal sync = jv_path(result, "capabilities.textDocumentSync");
+        if (sync.type == JV_OBJECT) sync = jv_get(sync, "change");
+        CP.sync_incremental = jv_int(sync, 0) == 2;
         cp_send_initialized();
         break;
+    }
     case CP_REQ_CHECK_STATUS:
         cp_handle_check_status(result);
         break;
@@ -572,26 +646,26 @@ static void cp_process_response(cJSON *json) {
     }
 }
 
-static void cp_process_notification(cJSON *json) {
-    const char *method = json_get_string(json, "method");
-    if (!method) return;
+static void cp_process_notification(JsonVal json) {
+    char method[128];
+    if (!jv_strcpy(jv_get(json, "method"), method, sizeof(method))) return;
     log_msg("copilot: <- %s", method);
     if (strcmp(method, "window/logMessage") == 0 ||
         strcmp(method, "window/showMessage") == 0) {
-        cJSON      *params = json_get_object(json, "params");
-        const char *msg    = params ? json_get_string(params, "message") : NULL;
+        char *msg = jv_get_strdup(jv_get(json, "params"), "message");
         if (msg) log_msg("copilot[srv]: %s", msg);
+        free(msg);
     }
 }
 
+/* Fields are read lazily off the raw message; no cJSON tree is built
+ * (see lsp/json_lazy.h). */
 void cp_handle_message(const char *json_str, int len) {
-    (void)len;
-    cJSON *json = json_parse(json_str, (size_t)len);
-    if (!json) { log_msg("copilot: JSON parse error"); return; }
-    cJSON *id = cJSON_GetObjectItemCaseSensitive(json, "id");
-    if (id && !cJSON_IsNull(id)) cp_process_response(json);
-    else                          cp_process_notification(json);
-    cJSON_Delete(json);
+    JsonVal json = jv_root(json_str, (size_t)len);
+    if (json.type != JV_OBJECT) { log_msg("copilot: JSON parse error"); return; }
+    JsonVal id = jv_get(json, "id");
+    if (jv_ok(id) && !jv_is_null(id)) cp_process_response(json);
+    else                              cp_process_notification(json);
 }
 
 /* ----- Tab to accept ----- */
@@ -621,7 +695,7 @@ static void kb_accept(void) {
     int row = buf->cursor->y;
     int strip = 0;
     if (row >= 0 && row < buf->num_rows) {
-        const char *line = buf->rows[row].chars.data;
+        const char *line = buf_row(buf, row)->chars.data;
         int max = already_have;
         int flen = (int)strlen(full);
         if (max > flen) max = flen;
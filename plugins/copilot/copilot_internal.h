@@ -4,11 +4,13 @@
 #ifndef HED_PLUGIN_COPILOT_INTERNAL_H
 #define HED_PLUGIN_COPILOT_INTERNAL_H
 
+#include "buf/buffer.h"
 #include "lsp/cjson/cJSON.h"
 
 #define CP_READ_BUF_SIZE  65536
 #define CP_PENDING_MAX    32
 #define CP_DEBOUNCE_MS    250
+#define CP_ALTS_MAX       10     /* alternatives read off a getCompletions reply */
 
 typedef enum {
     CP_REQ_NONE = 0,
@@ -25,6 +27,13 @@ typedef struct {
     CpReqKind kind;
 } CpPending;
 
+/* A didOpen'd document, synced like the LSP plugin's LspDoc. */
+typedef struct {
+    char       *uri;
+    BufEditSpan span;
+    int         version;  /* last version sent for it */
+} CpDoc;
+
 typedef struct {
     /* Child process */
     int   pid;
@@ -48,6 +57,8 @@ typedef struct {
 
     /* Document sync */
     int   doc_version;        /* monotonically increasing across all docs */
+    int   sync_incremental;   /* server takes ranged didChange */
+    CpDoc **docs;             /* stb_ds; documents the server has open */
 
     /* Auth */
     char  user_code[64];      /* set by signInInitiate response */
@@ -72,12 +83,6 @@ typedef struct {
     } *alts;
     int    alts_count;
     int    alts_active;
-
-    /* Last sent did-change version per buffer (kept simple: just the
-     * buffer pointer + version we last sent for it). v1 only tracks
-     * the most recently changed buffer. */
-    void  *last_buf;
-    int    last_buf_opened;   /* did we send didOpen for last_buf yet? */
 } Copilot;
 
 extern Copilot CP;
@@ -105,4 +110,8 @@ void cp_proto_shutdown(void);
  * incoming message. Implemented in copilot.c. */
 void cp_handle_message(const char *json, int len);
 
+/* Forget every open document (the server that had them is gone).
+ * Implemented in copilot.c; called from cp_proto_shutdown(). */
+void cp_docs_reset(void);
+
 #endif
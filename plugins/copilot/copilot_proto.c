@@ -247,6 +247,7 @@ void cp_proto_shutdown(void) {
     CP.read_buf_len   = 0;
     CP.spawned        = 0;
     CP.initialized    = 0;
+    cp_docs_reset();
 
     for (int i = 0; i < CP_PENDING_MAX; i++) CP.pending[i].kind = CP_REQ_NONE;
 }
@@ -217,6 +217,8 @@ static void register_commands(void) {
     cmd("put", cmd_put, "put reg");
     cmd("undo", cmd_undo, "undo");
     cmd("redo", cmd_redo, "redo");
+    cmd("earlier", cmd_earlier, "undo tree: go back");
+    cmd("later", cmd_later, "undo tree: go forward");
     cmd("repeat", cmd_repeat, "repeat last");
     cmd("record", cmd_macro_record, "record macro");
     cmd("play", cmd_macro_play, "play macro");
@@ -233,6 +235,7 @@ static void register_commands(void) {
     cmd("cd", cmd_cd, "chdir");
     cmd("pwd", cmd_cd, "current dir");
     cmd("logclear", cmd_logclear, "clear .hedlog");
+    cmd("hookprof", cmd_hookprof, "time hook callbacks");
     cmd("wrap", cmd_wrap, "toggle wrap");
     cmd("wrapdefault", cmd_wrapdefault, "toggle default wrap");
     cmd("new_line", cmd_new_line, "open new line below");
@@ -138,7 +138,7 @@ static int search_and_position(Buffer *buf, Window *win, const char *pattern) {
 
     /* Search through buffer rows */
     for (int y = 0; y < buf->num_rows; y++) {
-        Row *row = &buf->rows[y];
+        Row *row = buf_row(buf, y);
         if (!row->chars.data)
             continue;
 
@@ -81,12 +81,7 @@ static void dired_state_remove(Buffer *buf) {
 static void dired_clear_buffer(Buffer *buf) {
     if (!buf)
         return;
-    for (int i = 0; i < buf->num_rows; i++) {
-        row_free(&buf->rows[i]);
-    }
-    free(buf->rows);
-    buf->rows = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
     buf->cursor->x = 0;
     buf->cursor->y = 0;
 }
@@ -347,7 +342,7 @@ static int dired_row_name(Buffer *buf, int row, char *out, size_t out_sz,
         out[0] = '\0';
         return 0;
     }
-    Row *r = &buf->rows[row];
+    Row *r = buf_row(buf, row);
     int has_id = 0;
     uint32_t id = 0;
     int is_dir = 0;
@@ -479,7 +474,7 @@ static int dired_find_snapshot_by_id(DiredState *st, uint32_t id,
 static int dired_collect_current(DiredState *st, DiredCurrentVec *out) {
     Buffer *buf = st->buf;
     for (int row = 0; row < buf->num_rows; row++) {
-        Row *r = &buf->rows[row];
+        Row *r = buf_row(buf, row);
         DiredCurrent c = {.row = row};
         int rc = dired_parse_line(r->chars.data, r->chars.len, &c.has_id, &c.id,
                                   c.name, sizeof(c.name), &c.is_dir);
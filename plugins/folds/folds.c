@@ -90,7 +90,7 @@ static void detect_brackets(Buffer *buf) {
     bstack_init(&stack);
 
     for (int line = 0; line < buf->num_rows; line++) {
-        Row *row = &buf->rows[line];
+        Row *row = buf_row(buf, line);
         for (size_t i = 0; i < row->chars.len; i++) {
             char c = row->chars.data[i];
             if (char_is_inside_string(row->chars.data, i))
@@ -101,8 +101,8 @@ static void detect_brackets(Buffer *buf) {
                 int start_line = bstack_pop(&stack);
                 if (start_line >= 0 && start_line < line) {
                     if (line - start_line > 0) {
-                        buf->rows[start_line].fold_start = true;
-                        buf->rows[line].fold_end = true;
+                        buf_row(buf, start_line)->fold_start = true;
+                        buf_row(buf, line)->fold_end = true;
                         fold_add_region(&buf->folds, start_line, line);
                     }
                 }
@@ -155,7 +155,7 @@ static void detect_indent(Buffer *buf) {
     int sz = 0, cap = 32;
 
     for (int line = 0; line < buf->num_rows; line++) {
-        Row *row = &buf->rows[line];
+        Row *row = buf_row(buf, line);
         if (row_is_blank(row))
             continue;
 
@@ -168,11 +168,11 @@ static void detect_indent(Buffer *buf) {
             IndentFrame *top = &stack[sz - 1];
             if (indent <= top->base_indent) {
                 int end = line - 1;
-                while (end > top->start_line && row_is_blank(&buf->rows[end]))
+                while (end > top->start_line && row_is_blank(buf_row(buf, end)))
                     end--;
                 if (end > top->start_line) {
-                    buf->rows[top->start_line].fold_start = true;
-                    buf->rows[end].fold_end = true;
+                    buf_row(buf, top->start_line)->fold_start = true;
+                    buf_row(buf, end)->fold_end = true;
                     fold_add_region(&buf->folds, top->start_line, end);
                 }
                 sz--;
@@ -183,10 +183,10 @@ static void detect_indent(Buffer *buf) {
 
         /* Open a frame if the next non-blank row indents further. */
         int next = line + 1;
-        while (next < buf->num_rows && row_is_blank(&buf->rows[next]))
+        while (next < buf->num_rows && row_is_blank(buf_row(buf, next)))
             next++;
 
-        if (next < buf->num_rows && indent_width(&buf->rows[next]) > indent) {
+        if (next < buf->num_rows && indent_width(buf_row(buf, next)) > indent) {
             if (sz >= cap) {
                 cap *= 2;
                 IndentFrame *new_stack = realloc(stack, sizeof(IndentFrame) * cap);
@@ -207,11 +207,11 @@ static void detect_indent(Buffer *buf) {
     while (sz > 0) {
         IndentFrame *top = &stack[sz - 1];
         int end = buf->num_rows - 1;
-        while (end > top->start_line && row_is_blank(&buf->rows[end]))
+        while (end > top->start_line && row_is_blank(buf_row(buf, end)))
             end--;
         if (end > top->start_line) {
-            buf->rows[top->start_line].fold_start = true;
-            buf->rows[end].fold_end = true;
+            buf_row(buf, top->start_line)->fold_start = true;
+            buf_row(buf, end)->fold_end = true;
             fold_add_region(&buf->folds, top->start_line, end);
         }
         sz--;
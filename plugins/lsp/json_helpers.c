@@ -1,4 +1,6 @@
 #include "json_helpers.h"
+#include "buf/buf_helpers.h"
+#include <stdlib.h>
 #include <string.h>
 
 char *json_serialize(const cJSON *json) {
@@ -9,9 +11,9 @@ char *json_serialize(const cJSON *json) {
 cJSON *json_parse(const char *data, size_t len) {
     if (!data || len == 0) return NULL;
 
-    /* cJSON_Parse expects null-terminated string */
-    /* If data is already null-terminated within len, this is safe */
-    cJSON *parsed = cJSON_Parse(data);
+    /* Length-bounded: `data` may point into a larger buffer (LSP
+     * bodies are parsed in place) and need not be NUL-terminated. */
+    cJSON *parsed = cJSON_ParseWithLength(data, len);
     if (!parsed) {
         /* Log error if needed */
         return NULL;
@@ -63,3 +65,32 @@ int json_get_bool(const cJSON *obj, const char *key, int default_val) {
 
     return cJSON_IsTrue(item) ? 1 : 0;
 }
+
+static cJSON *json_position(int line, int character) {
+    cJSON *pos = cJSON_CreateObject();
+    cJSON_AddNumberToObject(pos, "line",      line);
+    cJSON_AddNumberToObject(pos, "character", character);
+    return pos;
+}
+
+cJSON *json_line_change(const Buffer *buf, const BufEditSpan *span,
+                        bool ranged) {
+    if (!buf || !span) return NULL;
+    int old_hi = span->hi - span->delta;
+    ranged = ranged && !span->reset && span->lo >= 0 &&
+             span->lo <= old_hi && span->hi <= buf->num_rows;
+    char *text = ranged ? buf_rows_to_text(buf, span->lo, span->hi, NULL)
+                        : buf_to_text(buf, NULL);
+    if (!text) return NULL;
+
+    cJSON *change = cJSON_CreateObject();
+    if (ranged) {
+        cJSON *range = cJSON_CreateObject();
+        cJSON_AddItemToObject(range, "start", json_position(span->lo, 0));
+        cJSON_AddItemToObject(range, "end",   json_position(old_hi, 0));
+        cJSON_AddItemToObject(change, "range", range);
+    }
+    cJSON_AddStringToObject(change, "text", text);
+    free(text);
+    return change;
+}
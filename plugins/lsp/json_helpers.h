@@ -2,14 +2,19 @@
 #define JSON_HELPERS_H
 
 #include "cjson/cJSON.h"
+#include <stdbool.h>
 #include <stddef.h>
 
+struct Buffer;
+struct BufEditSpan;
+
 /* Helper functions for safe JSON operations */
 
 /* Serialize cJSON object to string (caller must free) */
 char *json_serialize(const cJSON *json);
 
-/* Parse JSON string (returns NULL on error, caller must cJSON_Delete) */
+/* Parse `len` bytes of JSON; no terminator needed (returns NULL on
+ * error, caller must cJSON_Delete) */
 cJSON *json_parse(const char *data, size_t len);
 
 /* Safe string extraction (returns NULL if not found or not a string) */
@@ -27,4 +32,13 @@ cJSON *json_get_array(const cJSON *obj, const char *key);
 /* Safe boolean extraction (returns default_val if not found or not a bool) */
 int json_get_bool(const cJSON *obj, const char *key, int default_val);
 
+/* One didChange contentChanges entry for the rows `span` collected in
+ * `buf` (LSP and Copilot share it). With `ranged` and a span that can
+ * be trusted, rows [lo, hi - delta) of the server's copy became rows
+ * [lo, hi): a whole-line range replacement, column 0 at both ends, so
+ * no UTF-16 math. Otherwise, and after a reset, the full text.
+ * NULL on allocation failure. */
+cJSON *json_line_change(const struct Buffer *buf,
+                        const struct BufEditSpan *span, bool ranged);
+
 #endif /* JSON_HELPERS_H */
@@ -0,0 +1,315 @@
+#include "json_lazy.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const JsonVal JV_MISSING = { JV_NONE, NULL, 0 };
+
+static const char *skip_ws(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+    return p;
+}
+
+/* Past the closing quote of the string opening at p, or NULL. A quote
+ * is a terminator unless an odd run of backslashes precedes it. */
+static const char *skip_string(const char *p, const char *end) {
+    const char *q = p + 1;
+    for (;;) {
+        q = memchr(q, '"', (size_t)(end - q));
+        if (!q) return NULL;
+        const char *b = q;
+        while (b > p + 1 && b[-1] == '\\') b--;
+        if (((q - b) & 1) == 0) return q + 1;
+        q++;
+    }
+}
+
+/* Past a container opening at p. Brackets are only counted, not
+ * matched: the scan is for finding the end, not for validation. */
+static const char *skip_container(const char *p, const char *end) {
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            p = skip_string(p, end);
+            if (!p) return NULL;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) return p + 1;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+}
+
+/* Scan the value at p (no leading whitespace). */
+static JsonVal scan_value(const char *p, const char *end) {
+    JsonVal v = JV_MISSING;
+    if (p >= end) return v;
+    const char *q = NULL;
+    switch (*p) {
+    case '"': q = skip_string(p, end);    v.type = JV_STRING; break;
+    case '{': q = skip_container(p, end); v.type = JV_OBJECT; break;
+    case '[': q = skip_container(p, end); v.type = JV_ARRAY;  break;
+    case 't':
+        if (end - p >= 4 && memcmp(p, "true", 4) == 0)  { q = p + 4; v.type = JV_BOOL; }
+        break;
+    case 'f':
+        if (end - p >= 5 && memcmp(p, "false", 5) == 0) { q = p + 5; v.type = JV_BOOL; }
+        break;
+    case 'n':
+        if (end - p >= 4 && memcmp(p, "null", 4) == 0)  { q = p + 4; v.type = JV_NULL; }
+        break;
+    default:
+        if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            q = p;
+            while (q < end && is_number_char(*q)) q++;
+            v.type = JV_NUMBER;
+        }
+        break;
+    }
+    if (!q) return JV_MISSING;
+    v.p   = p;
+    v.len = (size_t)(q - p);
+    return v;
+}
+
+JsonVal jv_root(const char *data, size_t len) {
+    if (!data) return JV_MISSING;
+    const char *end = data + len;
+    return scan_value(skip_ws(data, end), end);
+}
+
+JsonVal jv_get(JsonVal obj, const char *key) {
+    if (obj.type != JV_OBJECT || !key) return JV_MISSING;
+    size_t      klen = strlen(key);
+    const char *p    = obj.p + 1;
+    const char *end  = obj.p + obj.len - 1; /* the closing brace */
+    for (;;) {
+        p = skip_ws(p, end);
+        if (p >= end || *p != '"') return JV_MISSING;
+        const char *kend = skip_string(p, end);
+        if (!kend) return JV_MISSING;
+        /* Keys are compared raw; protocol keys never carry escapes. */
+        bool hit = (size_t)(kend - p - 2) == klen &&
+                   memcmp(p + 1, key, klen) == 0;
+        p = skip_ws(kend, end);
+        if (p >= end || *p != ':') return JV_MISSING;
+        p = skip_ws(p + 1, end);
+        JsonVal v = scan_value(p, end);
+        if (!jv_ok(v)) return JV_MISSING;
+        if (hit) return v;
+        p = skip_ws(v.p + v.len, end);
+        if (p >= end || *p != ',') return JV_MISSING;
+        p++;
+    }
+}
+
+JsonVal jv_path(JsonVal obj, const char *path) {
+    if (!path) return JV_MISSING;
+    char seg[64];
+    while (*path) {
+        const char *dot = strchr(path, '.');
+        size_t      n   = dot ? (size_t)(dot - path) : strlen(path);
+        if (n >= sizeof(seg)) return JV_MISSING;
+        memcpy(seg, path, n);
+        seg[n] = '\0';
+        obj = jv_get(obj, seg);
+        if (!jv_ok(obj)) return obj;
+        if (!dot) break;
+        path = dot + 1;
+    }
+    return obj;
+}
+
+bool jv_iter(JsonVal arr, JsonIter *it) {
+    if (arr.type != JV_ARRAY) {
+        it->p = it->end = NULL;
+        return false;
+    }
+    it->p     = arr.p + 1;
+    it->end   = arr.p + arr.len - 1; /* the closing bracket */
+    it->first = true;
+    return true;
+}
+
+bool jv_iter_next(JsonIter *it, JsonVal *out) {
+    if (!it->p) return false;
+    const char *p = skip_ws(it->p, it->end);
+    if (p >= it->end) return false;
+    if (!it->first) {
+        if (*p != ',') { it->p = NULL; return false; }
+        p = skip_ws(p + 1, it->end);
+    }
+    JsonVal v = scan_value(p, it->end);
+    if (!jv_ok(v)) { it->p = NULL; return false; }
+    it->first = false;
+    it->p     = v.p + v.len;
+    *out      = v;
+    return true;
+}
+
+int jv_count(JsonVal arr, int cap) {
+    JsonIter it;
+    JsonVal  v;
+    int      n = 0;
+    if (!jv_iter(arr, &it)) return 0;
+    while ((cap <= 0 || n < cap) && jv_iter_next(&it, &v)) n++;
+    return n;
+}
+
+double jv_number(JsonVal v, double default_val) {
+    if (v.type != JV_NUMBER) return default_val;
+    /* The slice is not terminated; strtod wants a C string. */
+    char   num[64];
+    size_t n = v.len < sizeof(num) - 1 ? v.len : sizeof(num) - 1;
+    memcpy(num, v.p, n);
+    num[n] = '\0';
+    char  *stop = NULL;
+    double d    = strtod(num, &stop);
+    return stop == num ? default_val : d;
+}
+
+int jv_int(JsonVal v, int default_val) {
+    if (v.type != JV_NUMBER) return default_val;
+    double d = jv_number(v, (double)default_val);
+    /* Saturate like cJSON's valueint. */
+    if (d >= (double)INT_MAX) return INT_MAX;
+    if (d <= (double)INT_MIN) return INT_MIN;
+    return (int)d;
+}
+
+int jv_bool(JsonVal v, int default_val) {
+    if (v.type != JV_BOOL) return default_val;
+    return *v.p == 't';
+}
+
+static int hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9')      v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+static size_t put_utf8(char *o, uint32_t cp) {
+    if (cp < 0x80)    { o[0] = (char)cp; return 1; }
+    if (cp < 0x800)   { o[0] = (char)(0xC0 | (cp >> 6));
+                        o[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) { o[0] = (char)(0xE0 | (cp >> 12));
+                        o[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                        o[2] = (char)(0x80 | (cp & 0x3F)); return 3; }
+    o[0] = (char)(0xF0 | (cp >> 18));
+    o[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    o[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    o[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Decode the string body into dst[0..cap-1], terminated. The decoded
+ * form is never longer than the raw slice, so cap = v.len always fits. */
+static size_t decode(JsonVal v, char *dst, size_t cap) {
+    const char *p   = v.p + 1;
+    const char *end = v.p + v.len - 1;
+    size_t      n   = 0;
+    while (p < end && n + 1 < cap) {
+        const char *bs = memchr(p, '\\', (size_t)(end - p));
+        size_t      run = (size_t)((bs ? bs : end) - p);
+        if (run > cap - 1 - n) run = cap - 1 - n;
+        memcpy(dst + n, p, run);
+        n += run;
+        p += run;
+        if (!bs || p != bs || p + 1 >= end) break;
+
+        char     tmp[4];
+        size_t   tn = 1;
+        char     c  = p[1];
+        p += 2;
+        switch (c) {
+        case 'b': tmp[0] = '\b'; break;
+        case 'f': tmp[0] = '\f'; break;
+        case 'n': tmp[0] = '\n'; break;
+        case 'r': tmp[0] = '\r'; break;
+        case 't': tmp[0] = '\t'; break;
+        case 'u': {
+            int hi = end - p >= 4 ? hex4(p) : -1;
+            if (hi < 0) { tn = 0; break; }
+            p += 4;
+            uint32_t cp = (uint32_t)hi;
+            if (hi >= 0xD800 && hi <= 0xDBFF && end - p >= 6 &&
+                p[0] == '\\' && p[1] == 'u') {
+                int lo = hex4(p + 2);
+                if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                    cp = 0x10000 + (((uint32_t)hi - 0xD800) << 10) +
+                         ((uint32_t)lo - 0xDC00);
+                    p += 6;
+                }
+            }
+            /* NUL would cut the C string short; drop it. */
+            tn = cp ? put_utf8(tmp, cp) : 0;
+            break;
+        }
+        default:  tmp[0] = c; break; /* \" \\ \/ */
+        }
+        if (tn > cap - 1 - n) break;
+        memcpy(dst + n, tmp, tn);
+        n += tn;
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+char *jv_strdup(JsonVal v) {
+    if (v.type != JV_STRING) return NULL;
+    char *s = malloc(v.len);
+    if (!s) return NULL;
+    decode(v, s, v.len);
+    return s;
+}
+
+bool jv_strcpy(JsonVal v, char *dst, size_t cap) {
+    if (!dst || cap == 0) return false;
+    dst[0] = '\0';
+    if (v.type != JV_STRING) return false;
+    decode(v, dst, cap);
+    return true;
+}
+
+bool jv_streq(JsonVal v, const char *s) {
+    if (v.type != JV_STRING || !s) return false;
+    size_t raw = v.len - 2;
+    if (!memchr(v.p + 1, '\\', raw))
+        return strlen(s) == raw && memcmp(v.p + 1, s, raw) == 0;
+    char *d  = jv_strdup(v);
+    bool  eq = d && strcmp(d, s) == 0;
+    free(d);
+    return eq;
+}
+
+char *jv_get_strdup(JsonVal obj, const char *key) {
+    return jv_strdup(jv_get(obj, key));
+}
+
+int jv_get_int(JsonVal obj, const char *key, int default_val) {
+    return jv_int(jv_get(obj, key), default_val);
+}
+
+cJSON *jv_to_cjson(JsonVal v) {
+    if (!jv_ok(v)) return NULL;
+    return cJSON_ParseWithLength(v.p, v.len);
+}
@@ -0,0 +1,89 @@
+#ifndef JSON_LAZY_H
+#define JSON_LAZY_H
+
+/* Lazy JSON access over a message held in place.
+ *
+ * A JsonVal is a typed [p, p+len) slice of the original text; nothing
+ * is decoded or allocated until a leaf is read. Looking up a member
+ * scans the object's keys and skips over the values in between, so
+ * reading "id" and "method" off a 5 MB response costs one byte scan
+ * and no heap. Arrays are walked with JsonIter, which yields one
+ * element at a time and can stop early — the caller's item budget
+ * bounds the work, not the array length.
+ *
+ * Values are checked only as far as they are scanned: a malformed
+ * message fails lookups (false / defaults), it never reads past `len`.
+ * When a handler wants a real tree for a small subvalue, jv_to_cjson()
+ * parses just that slice. */
+
+#include "cjson/cJSON.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    JV_NONE = 0, /* missing or malformed */
+    JV_NULL,
+    JV_BOOL,
+    JV_NUMBER,
+    JV_STRING,
+    JV_ARRAY,
+    JV_OBJECT,
+} JvType;
+
+typedef struct {
+    JvType      type;
+    const char *p;   /* first byte of the value (quote, bracket, digit...) */
+    size_t      len; /* through the closing quote/bracket */
+} JsonVal;
+
+typedef struct {
+    const char *p;   /* next unread byte inside the container */
+    const char *end; /* the closing bracket */
+    bool        first;
+} JsonIter;
+
+/* The top-level value of `len` bytes. type is JV_NONE when the text
+ * does not start with a well-formed value. */
+JsonVal jv_root(const char *data, size_t len);
+
+/* Member `key` of an object; JV_NONE if absent or `obj` is not one. */
+JsonVal jv_get(JsonVal obj, const char *key);
+
+/* Follow a dotted member path, e.g. "params.textDocument.uri". */
+JsonVal jv_path(JsonVal obj, const char *path);
+
+/* Array element walk. jv_iter_next() returns false at the end or on
+ * malformed input. */
+bool jv_iter(JsonVal arr, JsonIter *it);
+bool jv_iter_next(JsonIter *it, JsonVal *out);
+
+/* Element count, scanning at most `cap` elements (cap <= 0: all). */
+int jv_count(JsonVal arr, int cap);
+
+static inline bool jv_ok(JsonVal v) { return v.type != JV_NONE; }
+static inline bool jv_is_null(JsonVal v) { return v.type == JV_NULL; }
+
+/* Leaf readers; defaults when the value has another type. */
+int    jv_int(JsonVal v, int default_val);
+double jv_number(JsonVal v, double default_val);
+int    jv_bool(JsonVal v, int default_val);
+
+/* Decoded string (escapes resolved, UTF-8), malloc'd; NULL when `v`
+ * is not a string. */
+char *jv_strdup(JsonVal v);
+
+/* Decode into `dst` (always terminated, truncated to cap-1 bytes).
+ * Returns false when `v` is not a string. */
+bool jv_strcpy(JsonVal v, char *dst, size_t cap);
+
+/* True when `v` is a string equal to `s`. */
+bool jv_streq(JsonVal v, const char *s);
+
+/* Shorthands for a member of `obj`. */
+char *jv_get_strdup(JsonVal obj, const char *key);
+int   jv_get_int(JsonVal obj, const char *key, int default_val);
+
+/* Parse just this slice into a cJSON tree (caller must cJSON_Delete). */
+cJSON *jv_to_cjson(JsonVal v);
+
+#endif /* JSON_LAZY_H */
@@ -16,7 +16,13 @@ void lsp_shutdown(void);
 void lsp_on_buffer_open(Buffer *buf);
 void lsp_on_buffer_close(Buffer *buf);
 void lsp_on_buffer_save(Buffer *buf);
+
+/* Edits reach servers as didChange carrying just the changed lines
+ * (whole text for servers without incremental sync). They go out
+ * when the debounce timer armed by lsp_schedule_sync() fires, or right
+ * away through lsp_on_buffer_changed(). */
 void lsp_on_buffer_changed(Buffer *buf);
+void lsp_schedule_sync(void);
 
 /* User-facing requests */
 void lsp_request_hover(Buffer *buf, int line, int col);
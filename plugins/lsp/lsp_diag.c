@@ -0,0 +1,220 @@
+#include "hed.h"
+#include "lsp.h"
+#include "lsp_diag.h"
+#include "buf/virtual_text.h"
+#include "utils/quickfix.h"
+
+#define LSP_DIAG_MAX    4000 /* diagnostics kept per file */
+#define LSP_DIAG_VT_MAX 160  /* bytes of message shown as virtual text */
+
+typedef struct {
+    int   line;     /* 0-based, LSP coords */
+    int   col;
+    int   severity; /* 1=Error, 2=Warning, 3=Info, 4=Hint */
+    char *message;
+} LspDiag;
+
+typedef struct {
+    LspDiag *items; /* stb_ds, sorted by (line, col) */
+} LspDiagFile;
+
+/* URI -> file; stb_ds string map. */
+static struct { char *key; LspDiagFile value; } *g_diags = NULL;
+
+static int g_diag_ns = -1;
+
+/* A parsed entry whose message is still in the message body. */
+typedef struct {
+    int     line, col, severity;
+    int     seq; /* publish order, to keep the sort stable */
+    JsonVal message;
+} LspDiagIn;
+
+static int diag_in_cmp(const void *a, const void *b) {
+    const LspDiagIn *x = a, *y = b;
+    if (x->line != y->line) return x->line < y->line ? -1 : 1;
+    if (x->col  != y->col)  return x->col  < y->col  ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+static LspDiagFile *diag_file(const char *uri) {
+    if (!g_diags) sh_new_strdup(g_diags);
+    ptrdiff_t i = shgeti(g_diags, uri);
+    if (i < 0) {
+        LspDiagFile empty = { 0 };
+        shput(g_diags, uri, empty);
+        i = shgeti(g_diags, uri);
+    }
+    return &g_diags[i].value;
+}
+
+/* First index in `items` whose line is >= `line`. */
+static ptrdiff_t diag_lower_bound(const LspDiag *items, int line) {
+    ptrdiff_t lo = 0, hi = arrlen(items);
+    while (lo < hi) {
+        ptrdiff_t mid = lo + (hi - lo) / 2;
+        if (items[mid].line < line) lo = mid + 1;
+        else                        hi = mid;
+    }
+    return lo;
+}
+
+static bool diag_same(const LspDiag *old, const LspDiagIn *in) {
+    return old->line == in->line && old->col == in->col &&
+           old->severity == in->severity && jv_streq(in->message, old->message);
+}
+
+/* The open buffer showing `uri`, or NULL. */
+static Buffer *diag_buffer(const char *uri) {
+    for (ptrdiff_t i = 0; i < arrlen(E.buffers); i++) {
+        Buffer *buf = &E.buffers[i];
+        if (!buf->filename) continue;
+        char *u    = fs_path_to_file_uri(buf->filename, NULL);
+        bool  same = u && strcmp(u, uri) == 0;
+        free(u);
+        if (same) return buf;
+    }
+    return NULL;
+}
+
+/* Lazy fill: one mark per line in [lo, hi) that has diagnostics — the
+ * most severe one, with a count of the rest. */
+static void diag_fill(Buffer *buf, int ns, int lo, int hi) {
+    if (!g_diags || !buf->filename) return;
+    char *uri = fs_path_to_file_uri(buf->filename, NULL);
+    if (!uri) return;
+    ptrdiff_t fi = shgeti(g_diags, uri);
+    free(uri);
+    if (fi < 0) return;
+    const LspDiag *items = g_diags[fi].value.items;
+    ptrdiff_t      n     = arrlen(items);
+
+    for (ptrdiff_t i = diag_lower_bound(items, lo); i < n && items[i].line < hi;) {
+        int       line  = items[i].line;
+        ptrdiff_t worst = i, j = i;
+        for (; j < n && items[j].line == line; j++)
+            if (items[j].severity < items[worst].severity) worst = j;
+        if (line < buf->num_rows && !fold_is_line_hidden(&buf->folds, line)) {
+            const LspDiag *d   = &items[worst];
+            const char    *msg = d->message;
+            size_t         len = strcspn(msg, "\n");
+            if (len > LSP_DIAG_VT_MAX) len = LSP_DIAG_VT_MAX;
+            char text[LSP_DIAG_VT_MAX + 32];
+            int  tn = snprintf(text, sizeof(text), "  ■ %.*s", (int)len, msg);
+            if (j - i > 1 && tn > 0 && tn < (int)sizeof(text))
+                tn += snprintf(text + tn, sizeof(text) - (size_t)tn, " (+%d)",
+                               (int)(j - i - 1));
+            if (tn > (int)sizeof(text) - 1) tn = (int)sizeof(text) - 1;
+            const char *sgr = d->severity == 1 ? COLOR_DIAG_ERROR
+                            : d->severity == 2 ? COLOR_DIAG_WARN
+                                               : COLOR_DIAG_NOTE;
+            vtext_set_eol(buf, ns, line, text, (size_t)tn, sgr);
+        }
+        i = j;
+    }
+}
+
+void lsp_diag_init(void) {
+    g_diag_ns = vtext_ns_create("lsp.diagnostics");
+    if (g_diag_ns >= 0) vtext_ns_set_fill(g_diag_ns, diag_fill);
+}
+
+int lsp_diag_publish(const char *uri, JsonVal diagnostics) {
+    LspDiagIn *in = NULL; /* stb_ds */
+    JsonIter   it;
+    JsonVal    d;
+    if (jv_iter(diagnostics, &it)) {
+        while (arrlen(in) < LSP_DIAG_MAX && jv_iter_next(&it, &d)) {
+            JsonVal   start = jv_path(d, "range.start");
+            LspDiagIn e = {
+                .line     = jv_get_int(start, "line",      0),
+                .col      = jv_get_int(start, "character", 0),
+                .severity = jv_get_int(d, "severity", 1),
+                .seq      = (int)arrlen(in),
+                .message  = jv_get(d, "message"),
+            };
+            arrput(in, e);
+        }
+    }
+    if (arrlen(in) > 1)
+        qsort(in, (size_t)arrlen(in), sizeof(*in), diag_in_cmp);
+
+    /* Merge line by line. A line whose entries all match keeps its old
+     * strings; any other line is rebuilt and reported as changed. */
+    LspDiagFile *file  = diag_file(uri);
+    LspDiag     *old   = file->items;
+    LspDiag     *fresh = NULL;
+    ptrdiff_t    no = arrlen(old), nn = arrlen(in), i = 0, j = 0;
+    int         *changed = NULL; /* stb_ds; ascending lines */
+    arrsetcap(fresh, nn);
+    while (i < no || j < nn) {
+        int line = i >= no ? in[j].line
+                 : j >= nn ? old[i].line
+                 : (old[i].line < in[j].line ? old[i].line : in[j].line);
+        ptrdiff_t oe = i, ne = j;
+        while (oe < no && old[oe].line == line) oe++;
+        while (ne < nn && in[ne].line == line) ne++;
+        bool same = oe - i == ne - j;
+        for (ptrdiff_t k = 0; same && k < oe - i; k++)
+            same = diag_same(&old[i + k], &in[j + k]);
+        for (ptrdiff_t k = j; k < ne; k++) {
+            char   *msg = same ? old[i + (k - j)].message : jv_strdup(in[k].message);
+            LspDiag e   = {
+                .line = in[k].line, .col = in[k].col, .severity = in[k].severity,
+                .message = msg ? msg : strdup(""),
+            };
+            arrput(fresh, e);
+        }
+        if (!same) {
+            for (ptrdiff_t k = i; k < oe; k++) free(old[k].message);
+            arrput(changed, line);
+        }
+        i = oe;
+        j = ne;
+    }
+    arrfree(old);
+    arrfree(in);
+    file->items = fresh;
+
+    /* Redraw just the changed lines, in runs. Called even when nothing
+     * changed: a publish is what brings marks back after an edit. */
+    Buffer *buf = g_diag_ns >= 0 ? diag_buffer(uri) : NULL;
+    if (buf) {
+        ptrdiff_t nc = arrlen(changed);
+        if (nc == 0) vtext_ns_invalidate(buf, g_diag_ns, 0, 0);
+        for (ptrdiff_t k = 0; k < nc;) {
+            ptrdiff_t e = k + 1;
+            while (e < nc && changed[e] == changed[e - 1] + 1) e++;
+            vtext_ns_invalidate(buf, g_diag_ns, changed[k], changed[e - 1] + 1);
+            k = e;
+        }
+    }
+    arrfree(changed);
+    return (int)arrlen(fresh);
+}
+
+/* Dump every stored diagnostic into the global quickfix list and open it. */
+void lsp_cmd_diagnostics(void) {
+    qf_clear(&E.qf);
+    int total = 0;
+    for (ptrdiff_t f = 0; f < shlen(g_diags); f++) {
+        const LspDiagFile *df = &g_diags[f].value;
+        const char        *fp = fs_uri_to_path(g_diags[f].key);
+        for (ptrdiff_t i = 0; i < arrlen(df->items); i++) {
+            const LspDiag *d = &df->items[i];
+            const char *sev = (d->severity == 1) ? "E"
+                            : (d->severity == 2) ? "W"
+                            : (d->severity == 3) ? "I" : "H";
+            char text[1024];
+            snprintf(text, sizeof(text), "[%s] %s", sev, d->message);
+            qf_add(&E.qf, fp, d->line + 1, d->col + 1, text);
+            total++;
+        }
+    }
+    if (total == 0) {
+        ed_set_status_message("LSP: no diagnostics");
+        return;
+    }
+    qf_open(&E.qf, E.qf.height > 0 ? E.qf.height : 8);
+    ed_set_status_message("LSP: %d diagnostic(s)", total);
+}
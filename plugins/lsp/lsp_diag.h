@@ -0,0 +1,28 @@
+#ifndef LSP_DIAG_H
+#define LSP_DIAG_H
+
+/* Diagnostics store.
+ *
+ * The latest publishDiagnostics per URI, kept sorted by line so a
+ * line's entries are found by binary search. A publish is merged into
+ * what is stored line by line: lines whose entries did not change keep
+ * their strings and their virtual text, and only the lines that did
+ * are redrawn. Survives across :lsp_disconnect, so the user can inspect
+ * the last known state.
+ *
+ * Diagnostics show as end-of-line virtual text in a lazy vtext
+ * namespace (see vtext_ns_set_fill): marks exist only for the lines
+ * on screen, so a file with thousands of warnings costs a screenful of
+ * marks per frame. Like other diagnostic marks they vanish on an edit
+ * and come back with the server's next publish. */
+
+#include "json_lazy.h"
+
+/* Register the virtual-text namespace. Called from lsp_init(). */
+void lsp_diag_init(void);
+
+/* Merge a publishDiagnostics `diagnostics` array for `uri`. At most
+ * LSP_DIAG_MAX entries are kept; returns the number stored. */
+int lsp_diag_publish(const char *uri, JsonVal diagnostics);
+
+#endif /* LSP_DIAG_H */
@@ -20,7 +20,25 @@ static void lsp_hook_buffer_save(HookBufferEvent *event) {
     if (event) lsp_on_buffer_save(event->buf);
 }
 
-/* Send didChange when leaving INSERT mode — batches all edits into one sync. */
+/* Edits arm the didChange debounce. Cursor moves cover the edits that
+ * fire no char/line hook (undo, put, …); nothing is sent unless an
+ * open document actually changed. */
+static void lsp_hook_char(const HookCharEvent *event) {
+    (void)event;
+    lsp_schedule_sync();
+}
+
+static void lsp_hook_line(const HookLineEvent *event) {
+    (void)event;
+    lsp_schedule_sync();
+}
+
+static void lsp_hook_cursor(const HookCursorEvent *event) {
+    (void)event;
+    lsp_schedule_sync();
+}
+
+/* Flush pending edits right away when leaving INSERT mode. */
 static void lsp_hook_mode_change(const HookModeEvent *event) {
     if (!event) return;
     if (event->old_mode == MODE_INSERT && event->new_mode == MODE_NORMAL) {
@@ -59,6 +77,11 @@ void lsp_hooks_init(void) {
     hook_register_buffer(HOOK_BUFFER_OPEN,  MODE_NORMAL, "*", lsp_hook_buffer_open);
     hook_register_buffer(HOOK_BUFFER_CLOSE, MODE_NORMAL, "*", lsp_hook_buffer_close);
     hook_register_buffer(HOOK_BUFFER_SAVE,  MODE_NORMAL, "*", lsp_hook_buffer_save);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", lsp_hook_char);
+    hook_register_char(HOOK_CHAR_DELETE, -1, "*", lsp_hook_char);
+    hook_register_line(HOOK_LINE_INSERT, -1, "*", lsp_hook_line);
+    hook_register_line(HOOK_LINE_DELETE, -1, "*", lsp_hook_line);
+    hook_register_cursor(HOOK_CURSOR_MOVE, -1, "*", lsp_hook_cursor);
     hook_register_mode(HOOK_MODE_CHANGE, lsp_hook_mode_change);
     hook_register_key(HOOK_KEYPRESS, lsp_hook_keypress);
 }
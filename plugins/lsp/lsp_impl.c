@@ -1,11 +1,13 @@
 #include "hed.h"
 #include "lsp.h"
+#include "lsp_diag.h"
 #include "json_helpers.h"
+#include "json_lazy.h"
 #include "lsp_hooks.h"
 #include "lsp_servers.h"
+#include "lsp_transport.h"
 #include "select_loop.h"
 #include "selectlist/selectlist.h"
-#include "utils/quickfix.h"
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <signal.h>
@@ -17,27 +19,64 @@
 
 
 #define LSP_MAX_SERVERS   8
-#define LSP_READ_BUF_SIZE 65536
-#define LSP_PENDING_MAX   32
+#define LSP_SYNC_DEBOUNCE_MS 200
+#define LSP_COMPLETION_MAX 200  /* items read off a completion response */
+
+/* ResponseError codes the server uses to give up on a request. */
+#define LSP_ERR_REQUEST_CANCELLED (-32800)
+#define LSP_ERR_CONTENT_MODIFIED  (-32801)
+
+/* TextDocumentSyncKind */
+enum {
+    LSP_SYNC_NONE        = 0,
+    LSP_SYNC_FULL        = 1,
+    LSP_SYNC_INCREMENTAL = 2,
+};
 
 typedef enum {
     LSP_REQ_NONE = 0,
+    LSP_REQ_INITIALIZE,
     LSP_REQ_HOVER,
     LSP_REQ_DEFINITION,
     LSP_REQ_COMPLETION,
+    LSP_REQ_COUNT
 } LspReqKind;
 
+/* A didOpen'd document. `span` is attached to the buffer, so it
+ * collects every row change since the last didChange, whichever path
+ * made it (typing, normal-mode commands, undo, paste). */
+typedef struct {
+    char       *uri;
+    BufEditSpan span;
+    int         version; /* last version sent to the server */
+} LspDoc;
+
+/* A request in flight. */
 typedef struct {
     int        id;
     LspReqKind kind;
-    /* For LSP_REQ_COMPLETION: the buffer + cursor position at request
-     * time, so the response handler can compute the replacement range
-     * even if the user kept typing while waiting. */
+    LspDoc    *doc;       /* document it is about; NULL once closed */
+    bool       had_doc;   /* doc was set when sent */
+    int        version;   /* doc->version when sent */
+    long long  sent_ms;
+    /* The buffer + cursor position at request time, so the completion
+     * handler can compute the replacement range even if the user kept
+     * typing while waiting. */
     int        buf_idx;
     int        req_line;
-    int        req_col;
+    int        req_col;   /* byte column */
 } LspPending;
 
+/* Round trips per request kind, for :lsp_status. */
+typedef struct {
+    int    done;      /* responses handled */
+    int    cancelled; /* superseded before the server answered */
+    int    dropped;   /* answered too late for the document */
+    int    last_ms;
+    int    max_ms;
+    double avg_ms;    /* moving average */
+} LspLatency;
+
 struct LspServer {
     char *lang;
     char *root_uri;
@@ -49,15 +88,13 @@ struct LspServer {
 
     int initialized;
     int next_id;
+    int sync_kind;   /* LSP_SYNC_*, from the initialize result */
+    LspDoc **docs;   /* stb_ds; open documents */
 
-    /* Incoming message framing */
-    char read_buf[LSP_READ_BUF_SIZE];
-    int  read_buf_len;
-    int  content_length; /* -1 = waiting for header */
-    char *msg_body;
-    int   msg_body_len;
+    LspTransport io; /* framing, both directions */
 
-    LspPending pending[LSP_PENDING_MAX];
+    LspPending *pending;              /* stb_ds; requests in flight */
+    LspLatency  latency[LSP_REQ_COUNT];
 };
 
 static LspServer *g_servers[LSP_MAX_SERVERS];
@@ -68,25 +105,6 @@ static int        g_servers_count = 0;
  * a global counter that only ever grows satisfies that requirement. */
 static int g_doc_version = 1;
 
-/* ----- diagnostics store -------------------------------------------
- * Latest publishDiagnostics per-URI. Replaced wholesale every time the
- * server re-publishes for a file. Survives across :lsp_disconnect, so
- * the user can inspect the last known state. */
-
-typedef struct {
-    int   line;     /* 0-based, LSP coords */
-    int   col;
-    int   severity; /* 1=Error, 2=Warning, 3=Info, 4=Hint */
-    char *message;
-} LspDiag;
-
-typedef struct {
-    char    *uri;
-    LspDiag *items; /* stb_ds */
-} LspDiagFile;
-
-static LspDiagFile *g_diags = NULL; /* stb_ds */
-
 /* ------------------------------------------------------------------ helpers */
 
 static LspServer *lsp_server_for_lang(const char *lang) {
@@ -108,53 +126,188 @@ static char *lsp_get_file_uri(const char *filepath) {
     return fs_path_to_file_uri(filepath, NULL);
 }
 
-/* -------------------------------------------------- pending request table */
+/* LSP columns count UTF-16 code units; rows hold UTF-8. A 4-byte
+ * sequence (above U+FFFF) is two units, any other code point one. */
+static int lsp_utf16_col(const Buffer *buf, int line, int byte_col) {
+    const Row *row = buf_row(buf, line);
+    if (!row) return byte_col;
+    const unsigned char *s = (const unsigned char *)row->chars.data;
+    int len = (int)row->chars.len;
+    if (byte_col > len) byte_col = len;
+    int units = 0;
+    for (int i = 0; i < byte_col; i++) {
+        if ((s[i] & 0xC0) == 0x80) continue;
+        units += s[i] >= 0xF0 ? 2 : 1;
+    }
+    return units;
+}
 
-static void lsp_pending_add(LspServer *srv, int id, LspReqKind kind) {
-    for (int i = 0; i < LSP_PENDING_MAX; i++) {
-        if (srv->pending[i].kind == LSP_REQ_NONE) {
-            srv->pending[i] = (LspPending){ .id = id, .kind = kind };
-            return;
-        }
+static int lsp_byte_col(const Buffer *buf, int line, int utf16_col) {
+    const Row *row = buf_row(buf, line);
+    if (!row) return utf16_col;
+    const unsigned char *s = (const unsigned char *)row->chars.data;
+    int len = (int)row->chars.len;
+    int i = 0, units = 0;
+    while (i < len && units < utf16_col) {
+        units += s[i] >= 0xF0 ? 2 : 1;
+        i++;
+        while (i < len && (s[i] & 0xC0) == 0x80) i++;
     }
-    log_msg("LSP: pending table full, dropping request id=%d", id);
+    return i;
+}
+
+static cJSON *lsp_position(const Buffer *buf, int line, int byte_col) {
+    cJSON *pos = cJSON_CreateObject();
+    cJSON_AddNumberToObject(pos, "line",      line);
+    cJSON_AddNumberToObject(pos, "character", lsp_utf16_col(buf, line, byte_col));
+    return pos;
 }
 
-static void lsp_pending_add_completion(LspServer *srv, int id,
-                                       int buf_idx, int line, int col) {
-    for (int i = 0; i < LSP_PENDING_MAX; i++) {
-        if (srv->pending[i].kind == LSP_REQ_NONE) {
-            srv->pending[i] = (LspPending){
-                .id = id, .kind = LSP_REQ_COMPLETION,
-                .buf_idx = buf_idx, .req_line = line, .req_col = col,
-            };
-            return;
+/* -------------------------------------------------- pending request table */
+
+/* Scheduling policy per kind. Every user-facing request is
+ * latest-wins: a new one for the same document cancels the one still
+ * in flight. `exact` kinds answer about a position, so their result is
+ * dropped once the document has changed; completion re-anchors on the
+ * request row itself and only needs the cursor to still be there. */
+static const struct {
+    const char *name;
+    bool        exact;
+} k_req_policy[LSP_REQ_COUNT] = {
+    [LSP_REQ_INITIALIZE] = { "initialize", false },
+    [LSP_REQ_HOVER]      = { "hover",      true  },
+    [LSP_REQ_DEFINITION] = { "definition", true  },
+    [LSP_REQ_COMPLETION] = { "completion", false },
+};
+
+static long long lsp_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000LL;
+}
+
+static void lsp_send_notification(LspServer *srv, const char *method,
+                                  cJSON *params);
+
+static void lsp_cancel(LspServer *srv, ptrdiff_t i) {
+    LspPending *p = &srv->pending[i];
+    cJSON *params = cJSON_CreateObject();
+    cJSON_AddNumberToObject(params, "id", p->id);
+    lsp_send_notification(srv, "$/cancelRequest", params);
+    srv->latency[p->kind].cancelled++;
+    arrdel(srv->pending, i);
+}
+
+/* Register request `kind` about `doc` (may be NULL) and return its id.
+ * Superseded requests of the same kind for the same document are
+ * cancelled first, so the server stops working on them. */
+static int lsp_request_begin(LspServer *srv, LspReqKind kind, LspDoc *doc,
+                             int buf_idx, int line, int col) {
+    if (kind != LSP_REQ_INITIALIZE) {
+        for (ptrdiff_t i = arrlen(srv->pending) - 1; i >= 0; i--) {
+            if (srv->pending[i].kind == kind && srv->pending[i].doc == doc)
+                lsp_cancel(srv, i);
         }
     }
-    log_msg("LSP: pending table full, dropping request id=%d", id);
+    LspPending p = {
+        .id = srv->next_id++, .kind = kind,
+        .doc = doc, .had_doc = doc != NULL, .version = doc ? doc->version : 0,
+        .sent_ms = lsp_now_ms(),
+        .buf_idx = buf_idx, .req_line = line, .req_col = col,
+    };
+    arrput(srv->pending, p);
+    return p.id;
 }
 
+/* Remove and return the request `id`; kind LSP_REQ_NONE if it is not
+ * in flight (cancelled, or never ours). Records its latency. */
 static LspPending lsp_pending_pop(LspServer *srv, int id) {
     LspPending empty = { .kind = LSP_REQ_NONE };
-    for (int i = 0; i < LSP_PENDING_MAX; i++) {
-        if (srv->pending[i].kind != LSP_REQ_NONE && srv->pending[i].id == id) {
-            LspPending p = srv->pending[i];
-            srv->pending[i] = empty;
-            return p;
-        }
+    for (ptrdiff_t i = 0; i < arrlen(srv->pending); i++) {
+        if (srv->pending[i].id != id) continue;
+        LspPending  p  = srv->pending[i];
+        LspLatency *l  = &srv->latency[p.kind];
+        int         ms = (int)(lsp_now_ms() - p.sent_ms);
+        arrdel(srv->pending, i);
+        l->last_ms = ms;
+        if (ms > l->max_ms) l->max_ms = ms;
+        l->avg_ms = l->done ? l->avg_ms * 0.8 + ms * 0.2 : ms;
+        l->done++;
+        log_msg("LSP[%s]: %s id=%d answered in %d ms", srv->lang,
+                k_req_policy[p.kind].name, id, ms);
+        return p;
     }
     return empty;
 }
 
+/* Whether the answer to `p` no longer fits what the user is looking at. */
+static bool lsp_pending_stale(const LspPending *p) {
+    if (p->kind == LSP_REQ_INITIALIZE) return false;
+    const LspDoc *doc = p->doc;
+    if (!doc && p->had_doc) return true; /* closed meanwhile */
+    if (doc && k_req_policy[p->kind].exact)
+        return doc->version != p->version || doc->span.touched || doc->span.reset;
+    /* Motions move the window cursor; the buffer's copy lags a key. */
+    const Window *win = window_cur();
+    return !win || win->buffer_index != p->buf_idx ||
+           win->cursor.y != p->req_line;
+}
+
+/* ------------------------------------------------------- open documents */
+
+static LspDoc *lsp_doc_find(LspServer *srv, const char *uri) {
+    for (ptrdiff_t i = 0; i < arrlen(srv->docs); i++)
+        if (strcmp(srv->docs[i]->uri, uri) == 0) return srv->docs[i];
+    return NULL;
+}
+
+static void lsp_doc_drop(LspServer *srv, LspDoc *doc) {
+    buf_edit_span_detach(buf_edit_span_owner(&doc->span), &doc->span);
+    for (ptrdiff_t i = 0; i < arrlen(srv->pending); i++)
+        if (srv->pending[i].doc == doc) srv->pending[i].doc = NULL;
+    for (ptrdiff_t i = 0; i < arrlen(srv->docs); i++) {
+        if (srv->docs[i] == doc) { arrdel(srv->docs, i); break; }
+    }
+    free(doc->uri);
+    free(doc);
+}
+
+static void lsp_docs_free(LspServer *srv) {
+    while (arrlen(srv->docs) > 0)
+        lsp_doc_drop(srv, srv->docs[0]);
+    arrfree(srv->docs);
+    srv->docs = NULL;
+}
+
 /* ------------------------------------------------------- send primitives */
 
+static void lsp_flush_out(LspServer *srv);
+
+static void lsp_on_writable(int fd, void *ud) {
+    LspServer *srv = ud;
+    if (srv && srv->to_fd == fd) lsp_flush_out(srv);
+}
+
+/* Write what the server will take now; the select loop calls back for
+ * the rest, so a server that stops reading never blocks the editor. */
+static void lsp_flush_out(LspServer *srv) {
+    int rc = lsp_transport_flush(&srv->io, srv->to_fd);
+    if (rc > 0) {
+        ed_loop_register_write(srv->lang, srv->to_fd, lsp_on_writable, srv);
+        return;
+    }
+    ed_loop_unregister_write(srv->to_fd);
+    if (rc < 0) {
+        /* The read side sees the hangup and tears the server down. */
+        log_msg("LSP[%s]: write failed: %s", srv->lang, strerror(errno));
+        lsp_transport_discard(&srv->io);
+    }
+}
+
 static void lsp_send_raw(LspServer *srv, const char *json_str) {
     if (!srv || srv->to_fd < 0) return;
-    char header[64];
-    int  clen = (int)strlen(json_str);
-    int  hlen = snprintf(header, sizeof(header), "Content-Length: %d\r\n\r\n", clen);
-    write(srv->to_fd, header, hlen);
-    write(srv->to_fd, json_str, clen);
+    lsp_transport_queue(&srv->io, json_str, strlen(json_str));
+    lsp_flush_out(srv);
 }
 
 static void lsp_send_request(LspServer *srv, const char *method,
@@ -225,13 +378,34 @@ static void lsp_send_initialize(LspServer *srv) {
     cJSON_AddItemToObject(tdoc, "completion", comp);
 
     cJSON_AddItemToObject(caps, "textDocument", tdoc);
+
+    /* Columns we send and expect are UTF-16 code units. */
+    cJSON *general = cJSON_CreateObject();
+    cJSON *encs    = cJSON_CreateArray();
+    cJSON_AddItemToArray(encs, cJSON_CreateString("utf-16"));
+    cJSON_AddItemToObject(general, "positionEncodings", encs);
+    cJSON_AddItemToObject(caps, "general", general);
     cJSON_AddItemToObject(params, "capabilities", caps);
 
-    int id = srv->next_id++;
-    lsp_pending_add(srv, id, LSP_REQ_NONE); /* initialize has no user action */
+    int id = lsp_request_begin(srv, LSP_REQ_INITIALIZE, NULL, -1, 0, 0);
     lsp_send_request(srv, "initialize", params, id);
 }
 
+/* capabilities.textDocumentSync is a TextDocumentSyncKind or an
+ * options object carrying one in `change`. Servers that leave it out
+ * keep getting full-text syncs, as before negotiation existed. */
+static int lsp_parse_sync_kind(JsonVal result) {
+    JsonVal sync = jv_path(result, "capabilities.textDocumentSync");
+    int kind = LSP_SYNC_FULL;
+    if (sync.type == JV_NUMBER)
+        kind = jv_int(sync, LSP_SYNC_FULL);
+    else if (sync.type == JV_OBJECT)
+        kind = jv_get_int(sync, "change", LSP_SYNC_NONE);
+    if (kind < LSP_SYNC_NONE || kind > LSP_SYNC_INCREMENTAL)
+        kind = LSP_SYNC_FULL;
+    return kind;
+}
+
 static void lsp_send_initialized(LspServer *srv) {
     lsp_send_notification(srv, "initialized", cJSON_CreateObject());
     srv->initialized = 1;
@@ -370,8 +544,8 @@ static void lsp_show_popup(const char *title, const char *text) {
  * everything it needs on the heap and free it inside the callback. */
 typedef struct {
     int   buf_idx;
-    int   req_line;   /* 0-based, LSP coords */
-    int   req_col;    /* 0-based, LSP coords */
+    int   req_line;   /* 0-based */
+    int   req_col;    /* 0-based byte column */
     int   n;
     char *insert[];   /* `insertText` (or label) per item, deep-copied */
 } LspComplCtx;
@@ -381,7 +555,7 @@ typedef struct {
  * first identifier char. cx is a 0-based byte index into the row. */
 static int lsp_word_start_col(Buffer *buf, int line, int cx) {
     if (!buf || line < 0 || line >= buf->num_rows) return cx;
-    const char *s = buf->rows[line].chars.data;
+    const char *s = buf_row(buf, line)->chars.data;
     int i = cx;
     while (i > 0) {
         unsigned char c = (unsigned char)s[i - 1];
@@ -408,7 +582,7 @@ static void lsp_completion_pick(int idx, const char *item, void *user) {
     int word_cx  = lsp_word_start_col(buf, line, ctx->req_col);
     if (cur_cx < word_cx) cur_cx = word_cx;
 
-    Row *row = &buf->rows[line];
+    Row *row = buf_row(buf, line);
     if (cur_cx > (int)row->chars.len) cur_cx = (int)row->chars.len;
 
     /* Splice: chars[0..word_cx) + insert + chars[cur_cx..len). Done via
@@ -421,6 +595,7 @@ static void lsp_completion_pick(int idx, const char *item, void *user) {
     strbuf_append(&fresh, row->chars.data, (size_t)word_cx);
     strbuf_append(&fresh, ins, ilen);
     strbuf_append(&fresh, row->chars.data + cur_cx, tail);
+    undo_record_replace(buf, line);
     strbuf_free(&row->chars);
     row->chars = fresh;
     buf_row_update(row);
@@ -435,48 +610,46 @@ done:
 
 static void lsp_handle_completion_result(LspServer *srv,
                                          const LspPending *pop,
-                                         cJSON *result) {
-    if (!result || cJSON_IsNull(result)) {
+                                         JsonVal result) {
+    /* result is either CompletionItem[] or { items: CompletionItem[] }.
+     * Items are read off the message one at a time and the walk stops
+     * at the picker's budget, so a huge list costs no more than a
+     * short one. */
+    JsonVal  items = result.type == JV_ARRAY ? result : jv_get(result, "items");
+    JsonIter it;
+    if (!jv_iter(items, &it)) {
         ed_set_status_message("LSP[%s]: no completions", srv->lang);
         return;
     }
-    /* result is either CompletionItem[] or { items: CompletionItem[] }. */
-    cJSON *items = cJSON_IsArray(result)
-                       ? result
-                       : json_get_array(result, "items");
-    int n = items ? cJSON_GetArraySize(items) : 0;
-    if (n <= 0) {
-        ed_set_status_message("LSP[%s]: no completions", srv->lang);
-        return;
-    }
-    if (n > 200) n = 200;
 
     /* Build display labels + the strings to insert. Display = label;
      * if `detail` is set we append " : detail" so the user sees types. */
-    char       **labels  = malloc(sizeof(char *) * (size_t)n);
-    LspComplCtx *ctx     = malloc(sizeof(LspComplCtx) + sizeof(char *) * (size_t)n);
+    const int    max     = LSP_COMPLETION_MAX;
+    char       **labels  = malloc(sizeof(char *) * (size_t)max);
+    LspComplCtx *ctx     = malloc(sizeof(LspComplCtx) + sizeof(char *) * (size_t)max);
     if (!labels || !ctx) { free(labels); free(ctx); return; }
     ctx->buf_idx  = pop->buf_idx;
     ctx->req_line = pop->req_line;
     ctx->req_col  = pop->req_col;
-    ctx->n        = n;
 
-    int kept = 0;
-    for (int i = 0; i < n; i++) {
-        cJSON      *it     = cJSON_GetArrayItem(items, i);
-        const char *label  = json_get_string(it, "label");
-        const char *insert = json_get_string(it, "insertText");
-        const char *detail = json_get_string(it, "detail");
-        if (!insert || !*insert) insert = label;
-        if (!label  || !*label)  continue;
+    int     kept = 0;
+    JsonVal item;
+    while (kept < max && jv_iter_next(&it, &item)) {
+        char *label = jv_get_strdup(item, "label");
+        if (!label || !*label) { free(label); continue; }
+        char *insert = jv_get_strdup(item, "insertText");
+        if (!insert || !*insert) { free(insert); insert = strdup(label); }
+        char detail[256];
+        jv_strcpy(jv_get(item, "detail"), detail, sizeof(detail));
 
         char buf[512];
-        if (detail && *detail)
+        if (*detail)
             snprintf(buf, sizeof(buf), "%s : %s", label, detail);
         else
             snprintf(buf, sizeof(buf), "%s", label);
+        free(label);
         labels[kept]      = strdup(buf);
-        ctx->insert[kept] = strdup(insert);
+        ctx->insert[kept] = insert;
         kept++;
     }
     if (kept == 0) {
@@ -496,7 +669,7 @@ static void lsp_handle_completion_result(LspServer *srv,
                       cur->buffer_index < (int)arrlen(E.buffers))
                          ? &E.buffers[cur->buffer_index] : NULL;
         if (cb && cur->cursor.y < cb->num_rows) {
-            int rx   = buf_row_cx_to_rx(&cb->rows[cur->cursor.y], cur->cursor.x);
+            int rx   = buf_row_cx_to_rx(buf_row(cb, cur->cursor.y), cur->cursor.x);
             anchor_x = (rx - cur->col_offset) + cur->left;
         }
     }
@@ -564,36 +737,30 @@ static void lsp_handle_hover_result(cJSON *result) {
     lsp_show_popup("Hover", text);
 }
 
-static void lsp_handle_definition_result(cJSON *result) {
-    if (!result || cJSON_IsNull(result)) {
-        ed_set_status_message("LSP: definition not found");
-        return;
-    }
-
+static void lsp_handle_definition_result(JsonVal result) {
     /* result can be Location | Location[] | LocationLink[] */
-    cJSON *loc = cJSON_IsArray(result) ? cJSON_GetArrayItem(result, 0) : result;
-    if (!loc) {
+    JsonVal loc = result;
+    if (result.type == JV_ARRAY) {
+        JsonIter it;
+        if (!jv_iter(result, &it) || !jv_iter_next(&it, &loc))
+            loc.type = JV_NONE;
+    }
+    if (loc.type != JV_OBJECT) {
         ed_set_status_message("LSP: definition not found");
         return;
     }
 
-    const char *uri = json_get_string(loc, "uri");
-    if (!uri) uri = json_get_string(loc, "targetUri"); /* LocationLink */
-    if (!uri) {
+    char uri[PATH_MAX + 16];
+    if (!jv_strcpy(jv_get(loc, "uri"), uri, sizeof(uri)) &&
+        !jv_strcpy(jv_get(loc, "targetUri"), uri, sizeof(uri))) { /* LocationLink */
         ed_set_status_message("LSP: definition missing uri");
         return;
     }
 
-    cJSON *range = json_get_object(loc, "range");
-    if (!range) range = json_get_object(loc, "targetSelectionRange");
-    int line = 0, col = 0;
-    if (range) {
-        cJSON *start = json_get_object(range, "start");
-        if (start) {
-            line = json_get_int(start, "line",      0);
-            col  = json_get_int(start, "character", 0);
-        }
-    }
+    JsonVal start = jv_path(loc, "range.start");
+    if (!jv_ok(start)) start = jv_path(loc, "targetSelectionRange.start");
+    int line = jv_get_int(start, "line",      0);
+    int col  = jv_get_int(start, "character", 0);
 
     const char *path = fs_uri_to_path(uri);
     log_msg("LSP definition: %s:%d:%d", path, line + 1, col + 1);
@@ -602,40 +769,62 @@ static void lsp_handle_definition_result(cJSON *result) {
     Buffer *buf = buf_cur();
     if (buf) {
         buf->cursor->y = line < buf->num_rows ? line : buf->num_rows - 1;
-        buf->cursor->x = col;
+        buf->cursor->x = lsp_byte_col(buf, buf->cursor->y, col);
     }
     ed_set_status_message("LSP: jumped to %s:%d", path, line + 1);
 }
 
-static void lsp_process_response(LspServer *srv, cJSON *json) {
-    cJSON *id_node = cJSON_GetObjectItemCaseSensitive(json, "id");
-    int    id      = id_node ? (int)id_node->valuedouble : -1;
+static void lsp_process_response(LspServer *srv, JsonVal json) {
+    int        id  = jv_get_int(json, "id", -1);
+    LspPending pop = lsp_pending_pop(srv, id);
+    if (pop.kind == LSP_REQ_NONE) {
+        /* Cancelled in favour of a newer request; servers still answer
+         * those, with a result or a RequestCancelled error. */
+        log_msg("LSP[%s]: dropping answer to superseded id=%d", srv->lang, id);
+        return;
+    }
 
-    cJSON *error = cJSON_GetObjectItemCaseSensitive(json, "error");
-    if (error) {
-        const char *msg = json_get_string(error, "message");
-        log_msg("LSP[%s]: error id=%d: %s", srv->lang, id, msg ? msg : "?");
-        ed_set_status_message("LSP error: %s", msg ? msg : "unknown");
-        lsp_pending_pop(srv, id);
+    JsonVal error = jv_get(json, "error");
+    if (jv_ok(error)) {
+        char msg[512];
+        int  code = jv_get_int(error, "code", 0);
+        if (!jv_strcpy(jv_get(error, "message"), msg, sizeof(msg)))
+            msg[0] = '\0';
+        log_msg("LSP[%s]: error id=%d code=%d: %s", srv->lang, id, code,
+                *msg ? msg : "?");
+        /* The server gave up on it itself (e.g. clangd while indexing);
+         * the next request will be answered. Not worth a status line. */
+        if (code != LSP_ERR_REQUEST_CANCELLED && code != LSP_ERR_CONTENT_MODIFIED)
+            ed_set_status_message("LSP error: %s", *msg ? msg : "unknown");
         return;
     }
 
-    cJSON *result = cJSON_GetObjectItemCaseSensitive(json, "result");
+    JsonVal result = jv_get(json, "result");
 
     /* initialize response */
-    if (!srv->initialized) {
-        lsp_pending_pop(srv, id);
+    if (pop.kind == LSP_REQ_INITIALIZE) {
+        srv->sync_kind = lsp_parse_sync_kind(result);
+        log_msg("LSP[%s]: textDocumentSync=%d", srv->lang, srv->sync_kind);
         lsp_send_initialized(srv);
         lsp_notify_existing_buffers(srv);
         return;
     }
 
-    LspPending pop  = lsp_pending_pop(srv, id);
-    LspReqKind kind = pop.kind;
-    switch (kind) {
-    case LSP_REQ_HOVER:
-        lsp_handle_hover_result(result);
+    if (lsp_pending_stale(&pop)) {
+        srv->latency[pop.kind].dropped++;
+        log_msg("LSP[%s]: %s id=%d is stale, dropped", srv->lang,
+                k_req_policy[pop.kind].name, id);
+        return;
+    }
+
+    switch (pop.kind) {
+    case LSP_REQ_HOVER: {
+        /* Hover text is small; a tree of just the result is fine. */
+        cJSON *tree = jv_to_cjson(result);
+        lsp_handle_hover_result(tree);
+        cJSON_Delete(tree);
         break;
+    }
     case LSP_REQ_DEFINITION:
         lsp_handle_definition_result(result);
         break;
@@ -648,106 +837,46 @@ static void lsp_process_response(LspServer *srv, cJSON *json) {
     }
 }
 
-/* Find or create the diagnostics slot for a URI. Returns a pointer
- * into the g_diags array; valid until the next push/erase. */
-static LspDiagFile *lsp_diag_slot(const char *uri) {
-    for (ptrdiff_t i = 0; i < arrlen(g_diags); i++) {
-        if (strcmp(g_diags[i].uri, uri) == 0) return &g_diags[i];
-    }
-    LspDiagFile slot = { .uri = strdup(uri), .items = NULL };
-    arrput(g_diags, slot);
-    return &g_diags[arrlen(g_diags) - 1];
-}
-
-static void lsp_diag_clear_slot(LspDiagFile *slot) {
-    for (ptrdiff_t i = 0; i < arrlen(slot->items); i++)
-        free(slot->items[i].message);
-    arrsetlen(slot->items, 0);
-}
-
-/* Replace the diagnostics for `uri` with the LSP `diag` array. */
-static void lsp_diag_replace(const char *uri, cJSON *diag, int n) {
-    LspDiagFile *slot = lsp_diag_slot(uri);
-    lsp_diag_clear_slot(slot);
-    for (int i = 0; i < n; i++) {
-        cJSON *d     = cJSON_GetArrayItem(diag, i);
-        cJSON *range = json_get_object(d, "range");
-        cJSON *start = range ? json_get_object(range, "start") : NULL;
-        int    line  = start ? json_get_int(start, "line",      0) : 0;
-        int    col   = start ? json_get_int(start, "character", 0) : 0;
-        int    sev   = json_get_int(d, "severity", 1);
-        const char *msg = json_get_string(d, "message");
-        LspDiag e = {
-            .line = line, .col = col, .severity = sev,
-            .message = strdup(msg ? msg : ""),
-        };
-        arrput(slot->items, e);
-    }
-}
-
-/* Dump every stored diagnostic into the global quickfix list and open it. */
-void lsp_cmd_diagnostics(void) {
-    qf_clear(&E.qf);
-    int total = 0;
-    for (ptrdiff_t f = 0; f < arrlen(g_diags); f++) {
-        LspDiagFile *df = &g_diags[f];
-        const char  *fp = fs_uri_to_path(df->uri);
-        for (ptrdiff_t i = 0; i < arrlen(df->items); i++) {
-            LspDiag *d = &df->items[i];
-            const char *sev = (d->severity == 1) ? "E"
-                            : (d->severity == 2) ? "W"
-                            : (d->severity == 3) ? "I" : "H";
-            char text[1024];
-            snprintf(text, sizeof(text), "[%s] %s", sev, d->message);
-            qf_add(&E.qf, fp, d->line + 1, d->col + 1, text);
-            total++;
-        }
-    }
-    if (total == 0) {
-        ed_set_status_message("LSP: no diagnostics");
-        return;
-    }
-    qf_open(&E.qf, E.qf.height > 0 ? E.qf.height : 8);
-    ed_set_status_message("LSP: %d diagnostic(s)", total);
-}
-
-static void lsp_process_notification(LspServer *srv, cJSON *json) {
-    const char *method = json_get_string(json, "method");
-    if (!method) return;
+static void lsp_process_notification(LspServer *srv, JsonVal json) {
+    char method[128];
+    if (!jv_strcpy(jv_get(json, "method"), method, sizeof(method))) return;
     log_msg("LSP[%s]: ← %s", srv->lang, method);
 
+    JsonVal params = jv_get(json, "params");
     if (strcmp(method, "textDocument/publishDiagnostics") == 0) {
-        cJSON *params = json_get_object(json, "params");
-        if (!params) return;
-        const char *uri  = json_get_string(params, "uri");
-        cJSON      *diag = json_get_array(params, "diagnostics");
-        int         cnt  = diag ? cJSON_GetArraySize(diag) : 0;
-        log_msg("LSP[%s]: diagnostics for %s: %d items", srv->lang,
-                uri ? uri : "?", cnt);
-        if (uri) lsp_diag_replace(uri, diag, cnt);
+        char *uri = jv_get_strdup(params, "uri");
+        if (!uri) return;
+        int kept = lsp_diag_publish(uri, jv_get(params, "diagnostics"));
+        log_msg("LSP[%s]: diagnostics for %s: %d items", srv->lang, uri, kept);
+        free(uri);
     } else if (strcmp(method, "window/showMessage") == 0) {
-        cJSON      *params = json_get_object(json, "params");
-        const char *msg    = params ? json_get_string(params, "message") : NULL;
+        char *msg = jv_get_strdup(params, "message");
         if (msg) ed_set_status_message("LSP: %s", msg);
+        free(msg);
     } else if (strcmp(method, "window/logMessage") == 0) {
-        cJSON      *params = json_get_object(json, "params");
-        const char *msg    = params ? json_get_string(params, "message") : NULL;
+        char *msg = jv_get_strdup(params, "message");
         if (msg) log_msg("LSP[%s] server log: %s", srv->lang, msg);
+        free(msg);
     }
 }
 
+/* Messages are never turned into a full tree: handlers pull the fields
+ * they need from the raw body (see json_lazy.h), so a multi-megabyte
+ * completion list or diagnostics dump costs a scan, not an allocation
+ * per node. */
 static void lsp_handle_message(LspServer *srv, const char *msg, int len) {
-    log_msg("LSP[%s]: message len=%d: %.120s", srv->lang, len, msg);
-    cJSON *json = json_parse(msg, (size_t)len);
-    if (!json) { log_msg("LSP: JSON parse error"); return; }
-
-    cJSON *id = cJSON_GetObjectItemCaseSensitive(json, "id");
-    if (id && !cJSON_IsNull(id))
+    log_msg("LSP[%s]: message len=%d: %.*s", srv->lang, len,
+            len < 120 ? len : 120, msg);
+    JsonVal json = jv_root(msg, (size_t)len);
+    if (json.type != JV_OBJECT) { log_msg("LSP: JSON parse error"); return; }
+
+    /* Requests from the server carry a method as well as an id; only
+     * answers to ours go through the pending table. */
+    JsonVal id = jv_get(json, "id");
+    if (jv_ok(id) && !jv_is_null(id) && !jv_ok(jv_get(json, "method")))
         lsp_process_response(srv, json);
     else
         lsp_process_notification(srv, json);
-
-    cJSON_Delete(json);
 }
 
 /* -------------------------------------------------------- public API: lifecycle */
@@ -755,6 +884,10 @@ static void lsp_handle_message(LspServer *srv, const char *msg, int len) {
 void lsp_init(void) {
     for (int i = 0; i < LSP_MAX_SERVERS; i++) g_servers[i] = NULL;
     g_servers_count = 0;
+    /* A server that exits with writes queued must surface as EPIPE on
+     * the write, not kill the editor. */
+    signal(SIGPIPE, SIG_IGN);
+    lsp_diag_init();
     log_msg("LSP: init");
 }
 
@@ -777,7 +910,12 @@ static void lsp_reap_child(LspServer *srv) {
 }
 
 static void lsp_close_fds(LspServer *srv) {
+    lsp_docs_free(srv); /* open documents die with the connection */
     if (srv->from_fd >= 0) ed_loop_unregister(srv->from_fd);
+    if (srv->to_fd >= 0) ed_loop_unregister_write(srv->to_fd);
+    lsp_transport_discard(&srv->io);
+    arrfree(srv->pending); /* nothing will answer them now */
+    srv->pending = NULL;
     if (srv->to_fd >= 0) close(srv->to_fd);
     if (srv->from_fd >= 0 && srv->from_fd != srv->to_fd) close(srv->from_fd);
     srv->to_fd = srv->from_fd = -1;
@@ -791,7 +929,7 @@ void lsp_shutdown(void) {
         lsp_close_fds(srv);
         free(srv->lang);
         free(srv->root_uri);
-        free(srv->msg_body);
+        lsp_transport_free(&srv->io);
         free(srv);
         g_servers[i] = NULL;
     }
@@ -802,12 +940,9 @@ static void lsp_on_readable(int fd, void *ud) {
     LspServer *srv = ud;
     if (!srv || srv->from_fd != fd) return;
 
-    int space = LSP_READ_BUF_SIZE - srv->read_buf_len;
-    if (space <= 0) { srv->read_buf_len = 0; return; }
-
-    ssize_t n = read(srv->from_fd, srv->read_buf + srv->read_buf_len, (size_t)space);
+    ssize_t n = lsp_transport_fill(&srv->io, fd);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
     if (n <= 0) {
-        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
         log_msg("LSP[%s]: disconnected", srv->lang);
         char lang_copy[64];
         snprintf(lang_copy, sizeof(lang_copy), "%s", srv->lang);
@@ -823,57 +958,55 @@ static void lsp_on_readable(int fd, void *ud) {
                     g_servers[i] = NULL; g_servers_count--; break;
                 }
             }
-            free(srv->lang); free(srv->root_uri); free(srv->msg_body); free(srv);
+            free(srv->lang); free(srv->root_uri); lsp_transport_free(&srv->io); free(srv);
         }
         ed_set_status_message("LSP[%s]: disconnected", lang_copy);
         return;
     }
-    srv->read_buf_len += (int)n;
-
-    /* Parse and dispatch complete messages */
-    while (srv->read_buf_len > 0) {
-        if (srv->content_length < 0) {
-            char *hend = strstr(srv->read_buf, "\r\n\r\n");
-            if (!hend) break;
-            char *cl = strstr(srv->read_buf, "Content-Length:");
-            if (!cl || cl > hend) { srv->read_buf_len = 0; break; }
-            srv->content_length = atoi(cl + 15);
-            int hlen = (int)(hend - srv->read_buf) + 4;
-            memmove(srv->read_buf, hend + 4, (size_t)(srv->read_buf_len - hlen));
-            srv->read_buf_len -= hlen;
-            free(srv->msg_body);
-            srv->msg_body     = malloc((size_t)srv->content_length + 1);
-            srv->msg_body_len = 0;
-        }
 
-        if (srv->content_length >= 0 && srv->msg_body) {
-            int need   = srv->content_length - srv->msg_body_len;
-            int avail  = srv->read_buf_len;
-            int copy   = need < avail ? need : avail;
-            memcpy(srv->msg_body + srv->msg_body_len, srv->read_buf, (size_t)copy);
-            srv->msg_body_len += copy;
-            memmove(srv->read_buf, srv->read_buf + copy,
-                    (size_t)(srv->read_buf_len - copy));
-            srv->read_buf_len -= copy;
-
-            if (srv->msg_body_len >= srv->content_length) {
-                srv->msg_body[srv->content_length] = '\0';
-                lsp_handle_message(srv, srv->msg_body, srv->content_length);
-                free(srv->msg_body);
-                srv->msg_body     = NULL;
-                srv->msg_body_len = 0;
-                srv->content_length = -1;
-            }
-        }
-
-        if (srv->content_length < 0 && srv->read_buf_len == 0) break;
-        /* If we didn't make progress, stop to avoid infinite loop */
-        if (srv->content_length >= 0 && srv->read_buf_len == 0) break;
-    }
+    /* Dispatch every complete message; bodies are parsed where they
+     * sit in the read buffer. */
+    const char *body;
+    size_t      len;
+    while (lsp_transport_next(&srv->io, &body, &len))
+        lsp_handle_message(srv, body, (int)len);
 }
 
 /* ---------------------------------------------------- buffer notifications */
 
+/* didChange for the rows touched since the last one. Every edit in
+ * between is already coalesced into the span, so one whole-line range
+ * replacement covers them (json_line_change). Servers without
+ * incremental sync, and wholesale reloads, get the full text instead. */
+static void lsp_doc_flush(LspServer *srv, Buffer *buf, LspDoc *doc) {
+    if (!doc) return;
+    BufEditSpan *e = &doc->span;
+    if (!e->touched && !e->reset) return;
+    if (srv->sync_kind == LSP_SYNC_NONE) {
+        doc->version = g_doc_version++; /* still tells stale answers apart */
+        buf_edit_span_clear(e);
+        return;
+    }
+
+    cJSON *change =
+        json_line_change(buf, e, srv->sync_kind == LSP_SYNC_INCREMENTAL);
+    if (!change) return;
+
+    cJSON *params  = cJSON_CreateObject();
+    cJSON *textdoc = cJSON_CreateObject();
+    doc->version = g_doc_version++;
+    cJSON_AddStringToObject(textdoc, "uri",     doc->uri);
+    cJSON_AddNumberToObject(textdoc, "version", doc->version);
+    cJSON_AddItemToObject(params, "textDocument", textdoc);
+
+    cJSON *changes = cJSON_CreateArray();
+    cJSON_AddItemToArray(changes, change);
+    cJSON_AddItemToObject(params, "contentChanges", changes);
+
+    lsp_send_notification(srv, "textDocument/didChange", params);
+    buf_edit_span_clear(e);
+}
+
 void lsp_on_buffer_open(Buffer *buf) {
     if (!buf || !buf->filename || !buf->filetype) return;
     LspServer *srv = lsp_server_for_buffer(buf);
@@ -898,10 +1031,22 @@ void lsp_on_buffer_open(Buffer *buf) {
     cJSON *textdoc  = cJSON_CreateObject();
     cJSON_AddStringToObject(textdoc, "uri",        uri);
     cJSON_AddStringToObject(textdoc, "languageId", buf->filetype);
-    cJSON_AddNumberToObject(textdoc, "version",    g_doc_version++);
+    int version = g_doc_version++;
+    cJSON_AddNumberToObject(textdoc, "version",    version);
     cJSON_AddStringToObject(textdoc, "text",       content);
     cJSON_AddItemToObject(params, "textDocument", textdoc);
 
+    /* From here on only the rows that change need to go out. */
+    LspDoc *doc = lsp_doc_find(srv, uri);
+    if (!doc && (doc = calloc(1, sizeof(*doc))) != NULL) {
+        doc->uri = strdup(uri);
+        arrput(srv->docs, doc);
+    }
+    if (doc) {
+        buf_edit_span_attach(buf, &doc->span);
+        doc->version = version;
+    }
+
     lsp_send_notification(srv, "textDocument/didOpen", params);
     free(uri); free(content);
 }
@@ -919,6 +1064,8 @@ void lsp_on_buffer_close(Buffer *buf) {
     cJSON_AddStringToObject(textdoc, "uri", uri);
     cJSON_AddItemToObject(params, "textDocument", textdoc);
     lsp_send_notification(srv, "textDocument/didClose", params);
+    LspDoc *doc = lsp_doc_find(srv, uri);
+    if (doc) lsp_doc_drop(srv, doc);
     free(uri);
 }
 
@@ -929,6 +1076,7 @@ void lsp_on_buffer_save(Buffer *buf) {
 
     char *uri = lsp_get_file_uri(buf->filename);
     if (!uri) return;
+    lsp_doc_flush(srv, buf, lsp_doc_find(srv, uri));
 
     cJSON *params  = cJSON_CreateObject();
     cJSON *textdoc = cJSON_CreateObject();
@@ -938,31 +1086,43 @@ void lsp_on_buffer_save(Buffer *buf) {
     free(uri);
 }
 
-/* Full-document sync — called when leaving INSERT mode. */
+/* Send pending edits of `buf` now — on leaving INSERT mode, and
+ * before anything that cites a position in it. */
 void lsp_on_buffer_changed(Buffer *buf) {
     if (!buf || !buf->filename || !buf->filetype) return;
     LspServer *srv = lsp_server_for_buffer(buf);
     if (!srv || !srv->initialized) return;
 
-    char *uri     = lsp_get_file_uri(buf->filename);
-    char *content = buf_to_text(buf, NULL);
-    if (!uri || !content) { free(uri); free(content); return; }
-
-    cJSON *params   = cJSON_CreateObject();
-    cJSON *textdoc  = cJSON_CreateObject();
-    cJSON_AddStringToObject(textdoc, "uri",     uri);
-    cJSON_AddNumberToObject(textdoc, "version", g_doc_version++);
-    cJSON_AddItemToObject(params, "textDocument", textdoc);
+    char *uri = lsp_get_file_uri(buf->filename);
+    if (!uri) return;
+    lsp_doc_flush(srv, buf, lsp_doc_find(srv, uri));
+    free(uri);
+}
 
-    /* Full-document sync: contentChanges is a single entry with the whole text */
-    cJSON *changes = cJSON_CreateArray();
-    cJSON *change  = cJSON_CreateObject();
-    cJSON_AddStringToObject(change, "text", content);
-    cJSON_AddItemToArray(changes, change);
-    cJSON_AddItemToObject(params, "contentChanges", changes);
+static void lsp_sync_fire(void *ud) {
+    (void)ud;
+    for (int i = 0; i < LSP_MAX_SERVERS; i++) {
+        LspServer *srv = g_servers[i];
+        if (!srv || !srv->initialized) continue;
+        for (ptrdiff_t d = 0; d < arrlen(srv->docs); d++) {
+            Buffer *buf = buf_edit_span_owner(&srv->docs[d]->span);
+            if (buf) lsp_doc_flush(srv, buf, srv->docs[d]);
+        }
+    }
+}
 
-    lsp_send_notification(srv, "textDocument/didChange", params);
-    free(uri); free(content);
+void lsp_schedule_sync(void) {
+    for (int i = 0; i < LSP_MAX_SERVERS; i++) {
+        LspServer *srv = g_servers[i];
+        if (!srv || !srv->initialized) continue;
+        for (ptrdiff_t d = 0; d < arrlen(srv->docs); d++) {
+            if (srv->docs[d]->span.touched) {
+                ed_loop_timer_after("lsp:sync", LSP_SYNC_DEBOUNCE_MS,
+                                    lsp_sync_fire, NULL);
+                return;
+            }
+        }
+    }
 }
 
 /* ---------------------------------------------------- user-facing requests */
@@ -981,18 +1141,17 @@ void lsp_request_hover(Buffer *buf, int line, int col) {
     }
     char *uri = lsp_get_file_uri(buf->filename);
     if (!uri) return;
+    LspDoc *doc = lsp_doc_find(srv, uri);
+    lsp_doc_flush(srv, buf, doc);
 
     cJSON *params  = cJSON_CreateObject();
     cJSON *textdoc = cJSON_CreateObject();
     cJSON_AddStringToObject(textdoc, "uri", uri);
     cJSON_AddItemToObject(params, "textDocument", textdoc);
-    cJSON *pos = cJSON_CreateObject();
-    cJSON_AddNumberToObject(pos, "line",      line);
-    cJSON_AddNumberToObject(pos, "character", col);
-    cJSON_AddItemToObject(params, "position", pos);
+    cJSON_AddItemToObject(params, "position", lsp_position(buf, line, col));
 
-    int id = srv->next_id++;
-    lsp_pending_add(srv, id, LSP_REQ_HOVER);
+    int id = lsp_request_begin(srv, LSP_REQ_HOVER, doc,
+                               (int)(buf - E.buffers), line, col);
     lsp_send_request(srv, "textDocument/hover", params, id);
     free(uri);
 }
@@ -1011,18 +1170,17 @@ void lsp_request_definition(Buffer *buf, int line, int col) {
     }
     char *uri = lsp_get_file_uri(buf->filename);
     if (!uri) return;
+    LspDoc *doc = lsp_doc_find(srv, uri);
+    lsp_doc_flush(srv, buf, doc);
 
     cJSON *params  = cJSON_CreateObject();
     cJSON *textdoc = cJSON_CreateObject();
     cJSON_AddStringToObject(textdoc, "uri", uri);
     cJSON_AddItemToObject(params, "textDocument", textdoc);
-    cJSON *pos = cJSON_CreateObject();
-    cJSON_AddNumberToObject(pos, "line",      line);
-    cJSON_AddNumberToObject(pos, "character", col);
-    cJSON_AddItemToObject(params, "position", pos);
+    cJSON_AddItemToObject(params, "position", lsp_position(buf, line, col));
 
-    int id = srv->next_id++;
-    lsp_pending_add(srv, id, LSP_REQ_DEFINITION);
+    int id = lsp_request_begin(srv, LSP_REQ_DEFINITION, doc,
+                               (int)(buf - E.buffers), line, col);
     lsp_send_request(srv, "textDocument/definition", params, id);
     free(uri);
 }
@@ -1041,19 +1199,17 @@ void lsp_request_completion(Buffer *buf, int line, int col) {
     }
     char *uri = lsp_get_file_uri(buf->filename);
     if (!uri) return;
+    LspDoc *doc = lsp_doc_find(srv, uri);
+    lsp_doc_flush(srv, buf, doc);
 
     cJSON *params   = cJSON_CreateObject();
     cJSON *textdoc  = cJSON_CreateObject();
     cJSON_AddStringToObject(textdoc, "uri", uri);
     cJSON_AddItemToObject(params, "textDocument", textdoc);
-    cJSON *pos = cJSON_CreateObject();
-    cJSON_AddNumberToObject(pos, "line",      line);
-    cJSON_AddNumberToObject(pos, "character", col);
-    cJSON_AddItemToObject(params, "position", pos);
+    cJSON_AddItemToObject(params, "position", lsp_position(buf, line, col));
 
-    int buf_idx = (int)(buf - E.buffers);
-    int id      = srv->next_id++;
-    lsp_pending_add_completion(srv, id, buf_idx, line, col);
+    int id = lsp_request_begin(srv, LSP_REQ_COMPLETION, doc,
+                               (int)(buf - E.buffers), line, col);
     lsp_send_request(srv, "textDocument/completion", params, id);
     free(uri);
 }
@@ -1070,7 +1226,7 @@ static LspServer *lsp_server_alloc(const char *lang, const char *root_uri) {
     srv->from_fd        = -1;
     srv->initialized    = 0;
     srv->next_id        = 1;
-    srv->content_length = -1;
+    lsp_transport_init(&srv->io);
     for (int i = 0; i < LSP_MAX_SERVERS; i++) {
         if (!g_servers[i]) { g_servers[i] = srv; g_servers_count++; break; }
     }
@@ -1099,6 +1255,8 @@ static int lsp_connect_pipe(LspServer *srv,
     }
     int fl = fcntl(srv->from_fd, F_GETFL, 0);
     fcntl(srv->from_fd, F_SETFL, fl | O_NONBLOCK);
+    fl = fcntl(srv->to_fd, F_GETFL, 0);
+    fcntl(srv->to_fd, F_SETFL, fl | O_NONBLOCK);
     log_msg("LSP[%s]: connected via pipes %s / %s", srv->lang, to_path, from_path);
     return 0;
 }
@@ -1196,6 +1354,8 @@ static int lsp_spawn_process(LspServer *srv, const char *const *argv) {
 
     int fl = fcntl(srv->from_fd, F_GETFL, 0);
     fcntl(srv->from_fd, F_SETFL, fl | O_NONBLOCK);
+    fl = fcntl(srv->to_fd, F_GETFL, 0);
+    fcntl(srv->to_fd, F_SETFL, fl | O_NONBLOCK);
 
     log_msg("LSP[%s]: spawned %s (pid %d)", srv->lang, argv[0], (int)pid);
     return 0;
@@ -1337,7 +1497,7 @@ fail:
         if (g_servers[i] == srv) { g_servers[i] = NULL; g_servers_count--; break; }
     }
     lsp_close_fds(srv);
-    free(srv->lang); free(srv->root_uri); free(srv);
+    free(srv->lang); free(srv->root_uri); lsp_transport_free(&srv->io); free(srv);
     return -1;
 }
 
@@ -1349,7 +1509,7 @@ int lsp_cmd_disconnect(const char *lang) {
     char lang_copy[64];
     snprintf(lang_copy, sizeof(lang_copy), "%s", srv->lang);
     lsp_close_fds(srv);
-    free(srv->lang); free(srv->root_uri); free(srv->msg_body); free(srv);
+    free(srv->lang); free(srv->root_uri); lsp_transport_free(&srv->io); free(srv);
     for (int i = 0; i < LSP_MAX_SERVERS; i++) {
         if (g_servers[i] == srv) { g_servers[i] = NULL; g_servers_count--; break; }
     }
@@ -1368,11 +1528,26 @@ void lsp_cmd_status(void) {
     for (int i = 0; i < LSP_MAX_SERVERS; i++) {
         LspServer *srv = g_servers[i];
         if (!srv) continue;
+        if (off >= (int)sizeof(buf)) break;
         off += snprintf(buf + off, sizeof(buf) - (size_t)off,
-                        " [%s %s fd=%d/%d]",
+                        " [%s %s fd=%d/%d",
                         srv->lang,
                         srv->initialized ? "ready" : "init",
                         srv->to_fd, srv->from_fd);
+        /* Round trips: average (max) ms, and how many were cancelled
+         * or came back too late. */
+        for (int k = LSP_REQ_HOVER; k < LSP_REQ_COUNT; k++) {
+            const LspLatency *l = &srv->latency[k];
+            if (off >= (int)sizeof(buf) || (!l->done && !l->cancelled)) continue;
+            off += snprintf(buf + off, sizeof(buf) - (size_t)off,
+                            " %s %.0f(%d)ms", k_req_policy[k].name,
+                            l->avg_ms, l->max_ms);
+            if (off < (int)sizeof(buf) && (l->cancelled || l->dropped))
+                off += snprintf(buf + off, sizeof(buf) - (size_t)off,
+                                " -%d/%d", l->cancelled, l->dropped);
+        }
+        if (off < (int)sizeof(buf))
+            off += snprintf(buf + off, sizeof(buf) - (size_t)off, "]");
     }
     ed_set_status_message("%s", buf);
 }
@@ -0,0 +1,182 @@
+#include "lsp_transport.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define LSP_READ_MIN (16 * 1024) /* free space asked of each read */
+
+void lsp_transport_init(LspTransport *t) {
+    memset(t, 0, sizeof(*t));
+    t->body_len = -1;
+}
+
+void lsp_transport_free(LspTransport *t) {
+    free(t->in);
+    free(t->out);
+    lsp_transport_init(t);
+}
+
+/* Make room for `need` more bytes after in_len: first by dropping the
+ * consumed prefix, then by growing. */
+static bool in_reserve(LspTransport *t, size_t need) {
+    if (t->in_cap - t->in_len >= need)
+        return true;
+    if (t->in_off > 0) {
+        size_t keep = t->in_len - t->in_off;
+        memmove(t->in, t->in + t->in_off, keep);
+        t->in_len = keep;
+        t->scan -= t->in_off;
+        if (t->body_len >= 0)
+            t->body_off -= t->in_off;
+        t->in_off = 0;
+        if (t->in_cap - t->in_len >= need)
+            return true;
+    }
+    size_t cap = t->in_cap ? t->in_cap : 4 * LSP_READ_MIN;
+    while (cap - t->in_len < need)
+        cap *= 2;
+    char *in = realloc(t->in, cap);
+    if (!in)
+        return false;
+    t->in = in;
+    t->in_cap = cap;
+    return true;
+}
+
+ssize_t lsp_transport_fill(LspTransport *t, int fd) {
+    if (t->in_off == t->in_len && t->body_len < 0) {
+        t->in_off = t->in_len = t->scan = 0;
+    }
+    /* A body being assembled is read in as few calls as it takes. */
+    size_t need = LSP_READ_MIN;
+    if (t->body_len >= 0) {
+        /* The body may already be complete, with more read past it. */
+        size_t end = t->body_off + (size_t)t->body_len;
+        if (end > t->in_len && end - t->in_len > need)
+            need = end - t->in_len;
+    }
+    if (!in_reserve(t, need)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t n;
+    do {
+        n = read(fd, t->in + t->in_len, t->in_cap - t->in_len);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0)
+        t->in_len += (size_t)n;
+    return n;
+}
+
+/* Content-Length from the header block [p, end), or -1. */
+static long header_content_length(const char *p, const char *end) {
+    static const char key[] = "Content-Length:";
+    const size_t klen = sizeof(key) - 1;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol)
+            eol = end;
+        if ((size_t)(eol - p) > klen && strncasecmp(p, key, klen) == 0) {
+            char num[24];
+            size_t n = (size_t)(eol - p) - klen;
+            if (n >= sizeof(num))
+                n = sizeof(num) - 1;
+            memcpy(num, p + klen, n);
+            num[n] = '\0';
+            char *stop = NULL;
+            long v = strtol(num, &stop, 10);
+            return stop != num && v >= 0 ? v : -1;
+        }
+        p = eol + 1;
+    }
+    return -1;
+}
+
+bool lsp_transport_next(LspTransport *t, const char **body, size_t *len) {
+    while (t->body_len < 0) {
+        /* Resume the search a few bytes back: the terminator may
+         * straddle the previous read. */
+        size_t from = t->scan > t->in_off + 3 ? t->scan - 3 : t->in_off;
+        const char *hend = memmem(t->in + from, t->in_len - from, "\r\n\r\n", 4);
+        if (!hend) {
+            t->scan = t->in_len;
+            return false;
+        }
+        size_t hdr_end = (size_t)(hend - t->in) + 4;
+        long clen = header_content_length(t->in + t->in_off, hend);
+        t->scan = hdr_end;
+        if (clen < 0 || (unsigned long)clen > LSP_BODY_MAX) {
+            /* Unusable header block, or a length no server sends that
+             * would drive the buffer size: skip it and look again. */
+            t->in_off = hdr_end;
+            continue;
+        }
+        t->body_off = hdr_end;
+        t->body_len = clen;
+    }
+    if (t->in_len - t->body_off < (size_t)t->body_len)
+        return false;
+    *body = t->in + t->body_off;
+    *len = (size_t)t->body_len;
+    t->in_off = t->scan = t->body_off + (size_t)t->body_len;
+    t->body_len = -1;
+    return true;
+}
+
+void lsp_transport_queue(LspTransport *t, const char *body, size_t len) {
+    if (len > LSP_BODY_MAX)
+        return;
+    char header[64];
+    int hlen = snprintf(header, sizeof(header), "Content-Length: %zu\r\n\r\n", len);
+    size_t need = (size_t)hlen + len;
+
+    if (t->out_off == t->out_len)
+        t->out_off = t->out_len = 0;
+    if (t->out_cap - t->out_len < need && t->out_off > 0) {
+        memmove(t->out, t->out + t->out_off, t->out_len - t->out_off);
+        t->out_len -= t->out_off;
+        t->out_off = 0;
+    }
+    if (t->out_cap - t->out_len < need) {
+        size_t cap = t->out_cap ? t->out_cap : 4 * LSP_READ_MIN;
+        while (cap - t->out_len < need)
+            cap *= 2;
+        char *out = realloc(t->out, cap);
+        if (!out)
+            return;
+        t->out = out;
+        t->out_cap = cap;
+    }
+    memcpy(t->out + t->out_len, header, (size_t)hlen);
+    memcpy(t->out + t->out_len + hlen, body, len);
+    t->out_len += need;
+}
+
+int lsp_transport_flush(LspTransport *t, int fd) {
+    while (t->out_off < t->out_len) {
+        ssize_t n = write(fd, t->out + t->out_off, t->out_len - t->out_off);
+        if (n > 0) {
+            t->out_off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+        return -1;
+    }
+    t->out_off = t->out_len = 0;
+    return 0;
+}
+
+void lsp_transport_discard(LspTransport *t) {
+    t->out_off = t->out_len = 0;
+}
+
+size_t lsp_transport_pending(const LspTransport *t) {
+    return t->out_len - t->out_off;
+}
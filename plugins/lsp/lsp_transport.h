@@ -0,0 +1,69 @@
+#ifndef LSP_TRANSPORT_H
+#define LSP_TRANSPORT_H
+
+/* JSON-RPC framing over a byte stream (Content-Length headers).
+ *
+ * Incoming bytes land in one growable buffer with a read offset; a
+ * complete message body is handed out in place, as a pointer into that
+ * buffer, so nothing is copied or allocated per message. The consumed
+ * prefix is only moved out when a read needs room the buffer lacks,
+ * instead of a memmove after every header and body, and the buffer
+ * starts over once everything read was consumed. Header scanning
+ * resumes where the last scan stopped, so a header that arrives a byte
+ * at a time is still scanned once.
+ *
+ * Outgoing messages are framed into a queue and written with
+ * non-blocking writes. Whatever the peer does not take right away stays
+ * queued until lsp_transport_flush() is called again, normally from a
+ * writable-fd callback on the select loop. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define LSP_BODY_MAX ((size_t)256 << 20) /* largest body sent or accepted */
+
+typedef struct LspTransport {
+    char  *in;
+    size_t in_cap;
+    size_t in_len;    /* bytes held */
+    size_t in_off;    /* start of the unconsumed data */
+    size_t scan;      /* header search resumes here */
+    size_t body_off;  /* body start of the message being assembled */
+    long   body_len;  /* -1 while waiting for a header */
+
+    char  *out;
+    size_t out_cap;
+    size_t out_len;
+    size_t out_off;   /* first byte not yet written */
+} LspTransport;
+
+void lsp_transport_init(LspTransport *t);
+void lsp_transport_free(LspTransport *t);
+
+/* Read what `fd` has ready. Returns the byte count, 0 at end of stream,
+ * -1 on error (errno set; EAGAIN when nothing was ready). Bodies
+ * returned by lsp_transport_next() are invalidated. */
+ssize_t lsp_transport_fill(LspTransport *t, int fd);
+
+/* The next complete message body, in place and not NUL-terminated.
+ * Valid until the next lsp_transport_fill(). false when none is
+ * complete yet. A header without a usable Content-Length, or one over
+ * LSP_BODY_MAX, is skipped. */
+bool lsp_transport_next(LspTransport *t, const char **body, size_t *len);
+
+/* Frame `body` and append it to the write queue. Bodies over
+ * LSP_BODY_MAX are dropped. */
+void lsp_transport_queue(LspTransport *t, const char *body, size_t len);
+
+/* Write queued bytes until `fd` would block. Returns 1 if bytes remain
+ * queued, 0 when the queue is empty, -1 on a write error. */
+int lsp_transport_flush(LspTransport *t, int fd);
+
+/* Drop everything still queued. */
+void lsp_transport_discard(LspTransport *t);
+
+/* Bytes queued and not yet written. */
+size_t lsp_transport_pending(const LspTransport *t);
+
+#endif /* LSP_TRANSPORT_H */
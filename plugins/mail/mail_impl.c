@@ -113,8 +113,17 @@ void mail_add_view(const char *name, const char *query) {
 /* Query helpers                                                       */
 /* ------------------------------------------------------------------ */
 
+/* The sidebar bolds the active view/mailbox, which its rows' text
+ * doesn't show, so its cached highlight goes stale on every switch. */
+static void mailboxes_invalidate(void) {
+    int idx = buf_find_by_filename(MAIL_MBOX_BUF);
+    if (idx >= 0)
+        buf_render_invalidate(&E.buffers[idx], 0, E.buffers[idx].num_rows);
+}
+
 void mail_set_query(const char *q) {
     snprintf(base_query, sizeof(base_query), "%s", q && *q ? q : "*");
+    mailboxes_invalidate();
 }
 
 const char *mail_get_query(void) { return base_query; }
@@ -145,6 +154,7 @@ static void build_full_query(char *out, size_t sz) {
 
 void mail_set_mailbox(const char *q) {
     snprintf(mailbox_query, sizeof(mailbox_query), "%s", q ? q : "");
+    mailboxes_invalidate();
 }
 
 const char *mail_get_mailbox(void) { return mailbox_query; }
@@ -311,11 +321,7 @@ void mail_sync(void) {
 /* ------------------------------------------------------------------ */
 
 static void clear_buffer(Buffer *buf) {
-    for (int i = 0; i < buf->num_rows; i++)
-        row_free(&buf->rows[i]);
-    free(buf->rows);
-    buf->rows     = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
 }
 
 /* ------------------------------------------------------------------ */
@@ -399,8 +405,8 @@ static void mail_list_render_hook(const HookRenderEvent *e) {
     Buffer *buf = e->buf;
     for (int row = e->row_start; row < e->row_end; row++) {
         if (row < 0 || row >= buf->num_rows) continue;
-        const char *raw = buf->rows[row].chars.data;
-        int         len = (int)buf->rows[row].chars.len;
+        const char *raw = buf_row(buf, row)->chars.data;
+        int         len = (int)buf_row(buf, row)->chars.len;
         if (!raw || len <= 0) continue;
         MailSpan ms[16];
         int n = parse_list_spans(raw, len, ms, 16);
@@ -464,8 +470,8 @@ static void mail_msg_render_hook(const HookRenderEvent *e) {
     Buffer *buf = e->buf;
     for (int row = e->row_start; row < e->row_end; row++) {
         if (row < 0 || row >= buf->num_rows) continue;
-        const char *raw = buf->rows[row].chars.data;
-        int         len = (int)buf->rows[row].chars.len;
+        const char *raw = buf_row(buf, row)->chars.data;
+        int         len = (int)buf_row(buf, row)->chars.len;
         if (!raw || len <= 0) continue;
         MailSpan ms[8];
         int n = parse_msg_spans(raw, len, ms, 8);
@@ -612,10 +618,11 @@ static void mark_thread_read(int row) {
     int lidx = buf_find_by_filename(MAIL_LIST_BUF);
     if (lidx >= 0) {
         Buffer *lb = &E.buffers[lidx];
-        if (row < lb->num_rows && lb->rows[row].chars.len >= 1 &&
-            lb->rows[row].chars.data[0] == 'U') {
-            lb->rows[row].chars.data[0] = ' ';
-            buf_row_update(&lb->rows[row]);
+        if (row < lb->num_rows && buf_row(lb, row)->chars.len >= 1 &&
+            buf_row(lb, row)->chars.data[0] == 'U') {
+            buf_row(lb, row)->chars.data[0] = ' ';
+            buf_row_update(buf_row(lb, row));
+            buf_render_invalidate(lb, row, row + 1);
         }
     }
 }
@@ -995,8 +1002,8 @@ static void mailbox_render_hook(const HookRenderEvent *ev) {
     Buffer *buf = ev->buf;
     for (int row = ev->row_start; row < ev->row_end; row++) {
         if (row < 0 || row >= buf->num_rows) continue;
-        const char *raw = buf->rows[row].chars.data;
-        int         len = (int)buf->rows[row].chars.len;
+        const char *raw = buf_row(buf, row)->chars.data;
+        int         len = (int)buf_row(buf, row)->chars.len;
         if (!raw || len <= 0) continue;
 
         int indented = (len >= 2 && raw[0] == ' ' && raw[1] == ' ');
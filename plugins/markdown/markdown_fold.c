@@ -104,7 +104,7 @@ static void md_detect_folds(Buffer *buf) {
     bool in_fence = false;
 
     for (int line = 0; line < buf->num_rows; line++) {
-        Row *row = &buf->rows[line];
+        Row *row = buf_row(buf, line);
 
         if (is_code_fence(row)) {
             in_fence = !in_fence;
@@ -123,8 +123,8 @@ static void md_detect_folds(Buffer *buf) {
             int start = start_lines[depth - 1];
             int end   = line - 1;
             if (end > start) {
-                buf->rows[start].fold_start = true;
-                buf->rows[end].fold_end     = true;
+                buf_row(buf, start)->fold_start = true;
+                buf_row(buf, end)->fold_end     = true;
                 fold_add_region(&buf->folds, start, end);
             }
             depth--;
@@ -152,11 +152,11 @@ static void md_detect_folds(Buffer *buf) {
          * so fold_find_at_line picks it as the innermost). */
         int fs = line + 1;
         int fe = fs;
-        while (fe < buf->num_rows && md_is_field_line(&buf->rows[fe]))
+        while (fe < buf->num_rows && md_is_field_line(buf_row(buf, fe)))
             fe++;
         if (fe - 1 > fs) {
-            buf->rows[fs].fold_start    = true;
-            buf->rows[fe - 1].fold_end  = true;
+            buf_row(buf, fs)->fold_start    = true;
+            buf_row(buf, fe - 1)->fold_end  = true;
             fold_add_region(&buf->folds, fs, fe - 1);
         }
     }
@@ -166,8 +166,8 @@ static void md_detect_folds(Buffer *buf) {
         int start = start_lines[depth - 1];
         int end   = buf->num_rows - 1;
         if (end > start) {
-            buf->rows[start].fold_start = true;
-            buf->rows[end].fold_end     = true;
+            buf_row(buf, start)->fold_start = true;
+            buf_row(buf, end)->fold_end     = true;
             fold_add_region(&buf->folds, start, end);
         }
         depth--;
@@ -12,10 +12,22 @@
  *   :mcp_stop     close listener + drop clients
  *   :mcp_status   print socket path + connected-client count
  *
- * Tools exposed (first slice):
+ * Clients are served concurrently. Sockets are non-blocking and every
+ * client has its own outgoing queue, drained when the socket is
+ * writable, so an agent that stops reading never stalls the editor; one
+ * whose queue outgrows the budget (mcp_set_limits) is disconnected.
+ *
+ * A client that calls watch_changes gets pushed
+ * notifications/hed/buffer_changed messages — the rows each buffer
+ * edit touched — instead of re-reading buffers to find out.
+ *
+ * Tools exposed:
  *   read_current_buffer()
+ *   read_range(start_line:int, end_line:int)
+ *   read_buffer_chunked(start_line?:int, max_bytes?:int)
  *   apply_edit(start_line:int, end_line:int, text:string)
  *   run_command(cmdline:string)
+ *   watch_changes(enabled?:bool)
  *
  * Method support: initialize, notifications/initialized, tools/list,
  * tools/call. Everything else returns method-not-found. */
@@ -35,45 +47,149 @@
 #include <sys/un.h>
 #include <unistd.h>
 
-/* Global helper from buf/buffer.c. */
-
-#define MCP_MAX_CLIENTS 8
+#define MCP_MAX_CLIENTS 8                  /* default client budget */
+#define MCP_TX_LIMIT    (16 * 1024 * 1024) /* default per-client queue budget */
 #define MCP_RX_LIMIT    (4 * 1024 * 1024)  /* per-client cap on accumulator */
+#define MCP_CHUNK_BYTES (64 * 1024)        /* read_buffer_chunked default */
+#define MCP_NOTIFY_MS   50                 /* change-notification poll period */
 
 typedef struct McpClient {
-    int    fd;          /* 0 = slot free, otherwise an open fd */
+    int    id;          /* never reused; survives the client being freed */
+    int    fd;
     char  *rx;
     size_t rx_len, rx_cap;
+    char  *tx;          /* outgoing queue: [tx_off, tx_len) unsent */
+    size_t tx_len, tx_off, tx_cap;
+    bool   write_armed; /* on the loop's write set */
+    bool   broken;      /* write failed or over budget; closed at next reap */
+    bool   watching;    /* wants buffer_changed notifications */
 } McpClient;
 
-static int      g_listen_fd = -1;
-static char     g_socket_path[108] = {0};
-static McpClient g_clients[MCP_MAX_CLIENTS];
+/* Edit span watched on one buffer while any client is watching. */
+typedef struct {
+    BufEditSpan span;
+} McpWatch;
+
+static int        g_listen_fd = -1;
+static char       g_socket_path[108] = {0};
+static McpClient **g_clients = NULL;  /* stb_ds */
+static McpWatch  **g_watches = NULL;  /* stb_ds */
+static int        g_next_client_id = 1;
+static int        g_max_clients = MCP_MAX_CLIENTS;
+static size_t     g_max_queue   = MCP_TX_LIMIT;
+
+void mcp_set_limits(int max_clients, size_t max_queue_bytes) {
+    if (max_clients > 0)     g_max_clients = max_clients;
+    if (max_queue_bytes > 0) g_max_queue   = max_queue_bytes;
+}
 
 /* ---- transport ---- */
 
+static void   watches_update(void);
+static cJSON *tool_watch_changes(int client_id, cJSON *args);
+
 static void client_close(McpClient *c) {
-    if (!c || c->fd <= 0) return;
+    for (ptrdiff_t i = 0; i < arrlen(g_clients); i++) {
+        if (g_clients[i] == c) { arrdel(g_clients, i); break; }
+    }
+    if (c->write_armed) ed_loop_unregister_write(c->fd);
     ed_loop_unregister(c->fd);
     close(c->fd);
     free(c->rx);
-    memset(c, 0, sizeof(*c));
+    free(c->tx);
+    bool watched = c->watching;
+    free(c);
+    if (watched) watches_update();
 }
 
 static McpClient *client_for_fd(int fd) {
-    for (int i = 0; i < MCP_MAX_CLIENTS; i++)
-        if (g_clients[i].fd == fd) return &g_clients[i];
+    for (ptrdiff_t i = 0; i < arrlen(g_clients); i++)
+        if (g_clients[i]->fd == fd) return g_clients[i];
+    return NULL;
+}
+
+static McpClient *client_by_id(int id) {
+    for (ptrdiff_t i = 0; i < arrlen(g_clients); i++)
+        if (g_clients[i]->id == id) return g_clients[i];
     return NULL;
 }
 
-static void send_message(int fd, cJSON *msg) {
+/* Close the clients whose socket failed. Only called where no caller
+ * up the stack still holds a client pointer. */
+static void clients_reap(void) {
+    for (ptrdiff_t i = arrlen(g_clients) - 1; i >= 0; i--) {
+        if (g_clients[i]->broken) {
+            log_msg("mcp: dropping client %d", g_clients[i]->id);
+            client_close(g_clients[i]);
+        }
+    }
+}
+
+static void on_writable(int fd, void *ud);
+
+/* Write queued bytes until the socket would block. Arms the write
+ * watch while anything is left over and disarms it once drained. */
+static void client_flush(McpClient *c) {
+    while (!c->broken && c->tx_off < c->tx_len) {
+        ssize_t n = send(c->fd, c->tx + c->tx_off, c->tx_len - c->tx_off,
+                         MSG_NOSIGNAL);
+        if (n > 0) { c->tx_off += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        c->broken = true;
+    }
+    if (c->tx_off == c->tx_len) c->tx_off = c->tx_len = 0;
+    bool want = !c->broken && c->tx_len > 0;
+    if (want && !c->write_armed)
+        ed_loop_register_write("mcp.client", c->fd, on_writable, NULL);
+    else if (!want && c->write_armed)
+        ed_loop_unregister_write(c->fd);
+    c->write_armed = want;
+}
+
+static void on_writable(int fd, void *ud) {
+    (void)ud;
+    McpClient *c = client_for_fd(fd);
+    if (!c) return;
+    client_flush(c);
+    clients_reap();
+}
+
+/* Queue one message line for `c` and write what the socket takes now. */
+static void send_message(McpClient *c, cJSON *msg) {
+    if (!c || c->broken) return;
     char *s = cJSON_PrintUnformatted(msg);
     if (!s) return;
     size_t n = strlen(s);
-    /* Best-effort write; if the client is gone we'll notice on next read. */
-    (void)!write(fd, s, n);
-    (void)!write(fd, "\n", 1);
+
+    size_t pending = c->tx_len - c->tx_off;
+    /* Only what is still queued counts: a reply larger than the budget
+     * still goes to a client that keeps up. */
+    if (pending > g_max_queue) {
+        /* It has stopped reading; holding more only grows the editor. */
+        ed_set_status_message("mcp: client %d too slow, disconnecting", c->id);
+        c->broken = true;
+        free(s);
+        return;
+    }
+    if (c->tx_off > 0 && c->tx_cap - c->tx_len < n + 1) {
+        memmove(c->tx, c->tx + c->tx_off, pending);
+        c->tx_len = pending;
+        c->tx_off = 0;
+    }
+    if (c->tx_cap - c->tx_len < n + 1) {
+        size_t cap = c->tx_cap ? c->tx_cap : 4096;
+        while (cap - c->tx_len < n + 1) cap *= 2;
+        char *t = realloc(c->tx, cap);
+        if (!t) { c->broken = true; free(s); return; }
+        c->tx = t;
+        c->tx_cap = cap;
+    }
+    memcpy(c->tx + c->tx_len, s, n);
+    c->tx[c->tx_len + n] = '\n';
+    c->tx_len += n + 1;
     free(s);
+    client_flush(c);
 }
 
 static cJSON *make_response(cJSON *id, cJSON *result) {
@@ -106,6 +222,13 @@ static cJSON *empty_object_schema(void) {
     return s;
 }
 
+/* Add an {"type": type} property to a schema's properties object. */
+static void schema_prop(cJSON *props, const char *name, const char *type) {
+    cJSON *p = cJSON_CreateObject();
+    cJSON_AddStringToObject(p, "type", type);
+    cJSON_AddItemToObject(props, name, p);
+}
+
 static cJSON *tool_descriptors(void) {
     cJSON *arr = cJSON_CreateArray();
 
@@ -119,6 +242,48 @@ static cJSON *tool_descriptors(void) {
         cJSON_AddItemToArray(arr, t);
     }
 
+    /* read_range */
+    {
+        cJSON *t = cJSON_CreateObject();
+        cJSON_AddStringToObject(t, "name", "read_range");
+        cJSON_AddStringToObject(t, "description",
+            "Return lines [start_line, end_line) of the current buffer. "
+            "0-indexed, half-open, clamped to the buffer. The first "
+            "content block is JSON with the range returned and "
+            "total_lines.");
+        cJSON *s = cJSON_CreateObject();
+        cJSON_AddStringToObject(s, "type", "object");
+        cJSON *props = cJSON_CreateObject();
+        schema_prop(props, "start_line", "integer");
+        schema_prop(props, "end_line",   "integer");
+        cJSON_AddItemToObject(s, "properties", props);
+        cJSON *req = cJSON_CreateArray();
+        cJSON_AddItemToArray(req, cJSON_CreateString("start_line"));
+        cJSON_AddItemToArray(req, cJSON_CreateString("end_line"));
+        cJSON_AddItemToObject(s, "required", req);
+        cJSON_AddItemToObject(t, "inputSchema", s);
+        cJSON_AddItemToArray(arr, t);
+    }
+
+    /* read_buffer_chunked */
+    {
+        cJSON *t = cJSON_CreateObject();
+        cJSON_AddStringToObject(t, "name", "read_buffer_chunked");
+        cJSON_AddStringToObject(t, "description",
+            "Page through the current buffer: whole lines from start_line "
+            "(default 0) up to about max_bytes (default 65536; at least "
+            "one line). The first content block is JSON with next_line "
+            "and done; call again with start_line = next_line until done.");
+        cJSON *s = cJSON_CreateObject();
+        cJSON_AddStringToObject(s, "type", "object");
+        cJSON *props = cJSON_CreateObject();
+        schema_prop(props, "start_line", "integer");
+        schema_prop(props, "max_bytes",  "integer");
+        cJSON_AddItemToObject(s, "properties", props);
+        cJSON_AddItemToObject(t, "inputSchema", s);
+        cJSON_AddItemToArray(arr, t);
+    }
+
     /* apply_edit */
     {
         cJSON *t = cJSON_CreateObject();
@@ -126,20 +291,14 @@ static cJSON *tool_descriptors(void) {
         cJSON_AddStringToObject(t, "description",
             "Replace lines [start_line, end_line) of the current buffer "
             "with `text` (LF-separated). 0-indexed, half-open. "
-            "Goes through hed's normal edit + undo path; hooks fire.");
+            "Applied as one undo step; unchanged lines at either end "
+            "of the range are left as they are.");
         cJSON *s = cJSON_CreateObject();
         cJSON_AddStringToObject(s, "type", "object");
         cJSON *props = cJSON_CreateObject();
-        cJSON *p;
-        p = cJSON_CreateObject();
-        cJSON_AddStringToObject(p, "type", "integer");
-        cJSON_AddItemToObject(props, "start_line", p);
-        p = cJSON_CreateObject();
-        cJSON_AddStringToObject(p, "type", "integer");
-        cJSON_AddItemToObject(props, "end_line", p);
-        p = cJSON_CreateObject();
-        cJSON_AddStringToObject(p, "type", "string");
-        cJSON_AddItemToObject(props, "text", p);
+        schema_prop(props, "start_line", "integer");
+        schema_prop(props, "end_line",   "integer");
+        schema_prop(props, "text",       "string");
         cJSON_AddItemToObject(s, "properties", props);
         cJSON *req = cJSON_CreateArray();
         cJSON_AddItemToArray(req, cJSON_CreateString("start_line"));
@@ -160,9 +319,7 @@ static cJSON *tool_descriptors(void) {
         cJSON *s = cJSON_CreateObject();
         cJSON_AddStringToObject(s, "type", "object");
         cJSON *props = cJSON_CreateObject();
-        cJSON *p = cJSON_CreateObject();
-        cJSON_AddStringToObject(p, "type", "string");
-        cJSON_AddItemToObject(props, "cmdline", p);
+        schema_prop(props, "cmdline", "string");
         cJSON_AddItemToObject(s, "properties", props);
         cJSON *req = cJSON_CreateArray();
         cJSON_AddItemToArray(req, cJSON_CreateString("cmdline"));
@@ -171,6 +328,24 @@ static cJSON *tool_descriptors(void) {
         cJSON_AddItemToArray(arr, t);
     }
 
+    /* watch_changes */
+    {
+        cJSON *t = cJSON_CreateObject();
+        cJSON_AddStringToObject(t, "name", "watch_changes");
+        cJSON_AddStringToObject(t, "description",
+            "Subscribe this connection (enabled=true, the default) to "
+            "notifications/hed/buffer_changed messages, sent shortly after "
+            "buffers are edited. Each names the buffer and the changed line "
+            "range so the client can re-read only that range.");
+        cJSON *s = cJSON_CreateObject();
+        cJSON_AddStringToObject(s, "type", "object");
+        cJSON *props = cJSON_CreateObject();
+        schema_prop(props, "enabled", "boolean");
+        cJSON_AddItemToObject(s, "properties", props);
+        cJSON_AddItemToObject(t, "inputSchema", s);
+        cJSON_AddItemToArray(arr, t);
+    }
+
     return arr;
 }
 
@@ -200,6 +375,94 @@ static cJSON *tool_read_current_buffer(void) {
     return r;
 }
 
+/* A result whose first block is `meta` (JSON) and second `text`. */
+static cJSON *tool_result_paged(cJSON *meta, const char *text) {
+    char  *m = cJSON_PrintUnformatted(meta);
+    cJSON_Delete(meta);
+    cJSON *r = tool_result_text(m, 0);
+    free(m);
+    cJSON *block = cJSON_CreateObject();
+    cJSON_AddStringToObject(block, "type", "text");
+    cJSON_AddStringToObject(block, "text", text ? text : "");
+    cJSON_AddItemToArray(cJSON_GetObjectItem(r, "content"), block);
+    return r;
+}
+
+static int arg_int(cJSON *args, const char *name, int dflt) {
+    cJSON *j = cJSON_GetObjectItem(args, name);
+    return cJSON_IsNumber(j) ? j->valueint : dflt;
+}
+
+static cJSON *tool_read_range(cJSON *args) {
+    Buffer *b = buf_cur();
+    if (!b) return tool_result_text("error: no current buffer", 1);
+    if (!cJSON_IsNumber(cJSON_GetObjectItem(args, "start_line")) ||
+        !cJSON_IsNumber(cJSON_GetObjectItem(args, "end_line")))
+        return tool_result_text("error: expected start_line:int, end_line:int", 1);
+
+    int start = arg_int(args, "start_line", 0);
+    int end   = arg_int(args, "end_line", 0);
+    if (start < 0) start = 0;
+    if (start > b->num_rows) start = b->num_rows;
+    if (end > b->num_rows) end = b->num_rows;
+    if (end < start) end = start;
+
+    char *out = buf_rows_to_text(b, start, end, NULL);
+    if (!out) return tool_result_text("error: out of memory", 1);
+    cJSON *meta = cJSON_CreateObject();
+    cJSON_AddNumberToObject(meta, "start_line",  start);
+    cJSON_AddNumberToObject(meta, "end_line",    end);
+    cJSON_AddNumberToObject(meta, "total_lines", b->num_rows);
+    cJSON *r = tool_result_paged(meta, out);
+    free(out);
+    return r;
+}
+
+static cJSON *tool_read_buffer_chunked(cJSON *args) {
+    Buffer *b = buf_cur();
+    if (!b) return tool_result_text("error: no current buffer", 1);
+
+    int start = arg_int(args, "start_line", 0);
+    int max   = arg_int(args, "max_bytes", MCP_CHUNK_BYTES);
+    if (start < 0) start = 0;
+    if (start > b->num_rows) start = b->num_rows;
+    if (max <= 0) max = MCP_CHUNK_BYTES;
+
+    /* Whole lines only; the first one goes out even if it is larger
+     * than the budget, so every call makes progress. */
+    int    end   = start;
+    size_t bytes = 0;
+    while (end < b->num_rows) {
+        size_t n = buf_row(b, end)->chars.len + 1;
+        if (end > start && bytes + n > (size_t)max) break;
+        bytes += n;
+        end++;
+    }
+
+    char *out = buf_rows_to_text(b, start, end, NULL);
+    if (!out) return tool_result_text("error: out of memory", 1);
+    cJSON *meta = cJSON_CreateObject();
+    cJSON_AddNumberToObject(meta, "start_line",  start);
+    cJSON_AddNumberToObject(meta, "next_line",   end);
+    cJSON_AddNumberToObject(meta, "total_lines", b->num_rows);
+    cJSON_AddBoolToObject  (meta, "done",        end >= b->num_rows);
+    cJSON *r = tool_result_paged(meta, out);
+    free(out);
+    return r;
+}
+
+/* Pull cursors of windows showing `b` back inside it after rows went
+ * away under them. */
+static void clamp_cursors(Buffer *b) {
+    int last = b->num_rows > 0 ? b->num_rows - 1 : 0;
+    for (ptrdiff_t i = 0; i < arrlen(E.windows); i++) {
+        Window *w = &E.windows[i];
+        if (w->buffer_index < 0 || &E.buffers[w->buffer_index] != b) continue;
+        if (w->cursor.y > last) { w->cursor.y = last; w->cursor.x = 0; }
+    }
+    if (b->cursor && b->cursor->y > last) { b->cursor->y = last; b->cursor->x = 0; }
+}
+
 static cJSON *tool_apply_edit(cJSON *args) {
     Buffer *b = buf_cur();
     if (!b)
@@ -217,34 +480,24 @@ static cJSON *tool_apply_edit(cJSON *args) {
     int start = js->valueint;
     int end   = je->valueint;
     if (start < 0) start = 0;
+    if (start > b->num_rows) start = b->num_rows;
     if (end < start) end = start;
     if (end > b->num_rows) end = b->num_rows;
 
-    /* Delete [start, end) — buf_row_del_in takes one index at a time and
-     * shifts the tail, so repeatedly delete at `start`. */
-    for (int i = start; i < end; i++)
-        buf_row_del_in(b, start);
-
-    /* Insert lines from `text` at `start`. */
+    /* One splice, one undo step. A trailing newline in `text` yields a
+     * final empty line; omit it to replace the range line for line. */
     const char *text = jt->valuestring;
-    size_t len = text ? strlen(text) : 0;
-    int    at  = start;
-    int    inserted = 0;
-    size_t lstart = 0;
-    for (size_t i = 0; i <= len; i++) {
-        if (i == len || text[i] == '\n') {
-            size_t llen = i - lstart;
-            if (llen && text[lstart + llen - 1] == '\r') llen--;
-            buf_row_insert_in(b, at++, text + lstart, llen);
-            inserted++;
-            lstart = i + 1;
-            /* If `text` is empty, don't insert anything. */
-            if (i == len && len == 0) inserted = 0;
-        }
+    int inserted = 0;
+    undo_begin(b, "mcp edit");
+    EdError err = buf_rows_splice(b, start, end, text, text ? strlen(text) : 0,
+                                  &inserted);
+    undo_end(b);
+    if (err != ED_OK) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "error: %s", ed_error_string(err));
+        return tool_result_text(msg, 1);
     }
-    /* A trailing newline in `text` would have inserted a final empty line;
-     * that matches the convention that `text` is the LF-terminated content
-     * of the range. If you didn't want that, omit the trailing \n. */
+    clamp_cursors(b);
 
     char msg[128];
     snprintf(msg, sizeof(msg),
@@ -296,7 +549,7 @@ static cJSON *handle_tools_list(cJSON *id) {
     return make_response(id, result);
 }
 
-static cJSON *handle_tools_call(cJSON *id, cJSON *params) {
+static cJSON *handle_tools_call(int client_id, cJSON *id, cJSON *params) {
     cJSON *jname = cJSON_GetObjectItem(params, "name");
     cJSON *jargs = cJSON_GetObjectItem(params, "arguments");
     if (!cJSON_IsString(jname))
@@ -305,10 +558,16 @@ static cJSON *handle_tools_call(cJSON *id, cJSON *params) {
     cJSON *result;
     if (strcmp(name, "read_current_buffer") == 0)
         result = tool_read_current_buffer();
+    else if (strcmp(name, "read_range") == 0)
+        result = tool_read_range(jargs);
+    else if (strcmp(name, "read_buffer_chunked") == 0)
+        result = tool_read_buffer_chunked(jargs);
     else if (strcmp(name, "apply_edit") == 0)
         result = tool_apply_edit(jargs);
     else if (strcmp(name, "run_command") == 0)
         result = tool_run_command(jargs);
+    else if (strcmp(name, "watch_changes") == 0)
+        result = tool_watch_changes(client_id, jargs);
     else {
         char err[128];
         snprintf(err, sizeof(err), "unknown tool: %s", name);
@@ -317,11 +576,15 @@ static cJSON *handle_tools_call(cJSON *id, cJSON *params) {
     return make_response(id, result);
 }
 
-static void dispatch_message(int fd, const char *json, size_t len) {
+/* `c` may be closed by the time a tool returns (run_command can run
+ * :mcp_stop), so the reply is sent to whichever client still has its
+ * id. */
+static void dispatch_message(McpClient *c, const char *json, size_t len) {
+    int    client_id = c->id;
     cJSON *msg = cJSON_ParseWithLength(json, len);
     if (!msg) {
         cJSON *err = make_error(NULL, -32700, "parse error");
-        send_message(fd, err);
+        send_message(c, err);
         cJSON_Delete(err);
         return;
     }
@@ -334,7 +597,7 @@ static void dispatch_message(int fd, const char *json, size_t len) {
     if (!cJSON_IsString(jmethod)) {
         if (!is_notification) {
             cJSON *err = make_error(jid, -32600, "method must be string");
-            send_message(fd, err);
+            send_message(c, err);
             cJSON_Delete(err);
         }
         cJSON_Delete(msg);
@@ -351,7 +614,7 @@ static void dispatch_message(int fd, const char *json, size_t len) {
     } else if (strcmp(method, "tools/list") == 0) {
         resp = handle_tools_list(jid);
     } else if (strcmp(method, "tools/call") == 0) {
-        resp = handle_tools_call(jid, jparams);
+        resp = handle_tools_call(client_id, jid, jparams);
     } else if (strcmp(method, "ping") == 0) {
         resp = make_response(jid, cJSON_CreateObject());
     } else if (!is_notification) {
@@ -361,7 +624,7 @@ static void dispatch_message(int fd, const char *json, size_t len) {
     }
 
     if (resp) {
-        send_message(fd, resp);
+        send_message(client_by_id(client_id), resp);
         cJSON_Delete(resp);
     }
     cJSON_Delete(msg);
@@ -374,43 +637,46 @@ static void drain_client(int fd, void *ud) {
     McpClient *c = client_for_fd(fd);
     if (!c) return;
 
-    char chunk[4096];
-    ssize_t n = read(fd, chunk, sizeof(chunk));
-    if (n <= 0) {
-        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
-        client_close(c);
-        return;
-    }
-
-    if (c->rx_len + (size_t)n + 1 > c->rx_cap) {
-        size_t ncap = c->rx_cap ? c->rx_cap * 2 : 4096;
-        while (ncap < c->rx_len + (size_t)n + 1) ncap *= 2;
+    if (c->rx_cap - c->rx_len < 4096 + 1) {
+        size_t ncap = c->rx_cap ? c->rx_cap * 2 : 16384;
         if (ncap > MCP_RX_LIMIT) { client_close(c); return; }
         char *r = realloc(c->rx, ncap);
         if (!r) { client_close(c); return; }
         c->rx = r;
         c->rx_cap = ncap;
     }
-    memcpy(c->rx + c->rx_len, chunk, (size_t)n);
+    ssize_t n = read(fd, c->rx + c->rx_len, c->rx_cap - c->rx_len - 1);
+    if (n <= 0) {
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        client_close(c);
+        return;
+    }
+    /* Only the new bytes can hold a newline that ends the pending
+     * line, so a large message is scanned once, not once per read. */
+    size_t scan = c->rx_len;
     c->rx_len += (size_t)n;
     c->rx[c->rx_len] = '\0';
 
     /* Split on '\n'; dispatch each complete line. */
+    int    id  = c->id;
     size_t off = 0;
-    for (size_t i = 0; i < c->rx_len; i++) {
-        if (c->rx[i] == '\n') {
-            size_t lend = i;
-            /* Strip trailing \r. */
-            if (lend > off && c->rx[lend - 1] == '\r') lend--;
-            if (lend > off)
-                dispatch_message(fd, c->rx + off, lend - off);
-            off = i + 1;
+    char  *nl;
+    while ((nl = memchr(c->rx + scan, '\n', c->rx_len - scan)) != NULL) {
+        size_t lend = (size_t)(nl - c->rx);
+        size_t next = lend + 1;
+        /* Strip trailing \r. */
+        if (lend > off && c->rx[lend - 1] == '\r') lend--;
+        if (lend > off) {
+            dispatch_message(c, c->rx + off, lend - off);
+            if (client_by_id(id) != c) return; /* closed under us */
         }
+        off = scan = next;
     }
     if (off > 0) {
         memmove(c->rx, c->rx + off, c->rx_len - off);
         c->rx_len -= off;
     }
+    clients_reap();
 }
 
 static void on_accept(int listen_fd, void *ud) {
@@ -418,25 +684,132 @@ static void on_accept(int listen_fd, void *ud) {
     int fd = accept(listen_fd, NULL, NULL);
     if (fd < 0) return;
 
-    /* Find a free slot. */
-    McpClient *slot = NULL;
-    for (int i = 0; i < MCP_MAX_CLIENTS; i++)
-        if (g_clients[i].fd == 0) { slot = &g_clients[i]; break; }
-    if (!slot) {
+    if (arrlen(g_clients) >= g_max_clients) {
         close(fd);
-        ed_set_status_message("mcp: client limit reached");
+        ed_set_status_message("mcp: client limit (%d) reached", g_max_clients);
         return;
     }
+    McpClient *c = calloc(1, sizeof(*c));
+    if (!c) { close(fd); return; }
 
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 
-    slot->fd = fd;
-    slot->rx = NULL;
-    slot->rx_len = slot->rx_cap = 0;
+    c->id = g_next_client_id++;
+    c->fd = fd;
+    arrput(g_clients, c);
     ed_loop_register("mcp.client", fd, drain_client, NULL);
 }
 
+/* ---- change notifications ---- */
+
+static bool any_watching(void) {
+    for (ptrdiff_t i = 0; i < arrlen(g_clients); i++)
+        if (g_clients[i]->watching && !g_clients[i]->broken) return true;
+    return false;
+}
+
+static void watch_add(Buffer *buf) {
+    McpWatch *w = calloc(1, sizeof(*w));
+    if (!w) return;
+    buf_edit_span_attach(buf, &w->span);
+    arrput(g_watches, w);
+}
+
+static void watch_drop(ptrdiff_t i) {
+    McpWatch *w = g_watches[i];
+    buf_edit_span_detach(buf_edit_span_owner(&w->span), &w->span);
+    arrdel(g_watches, i);
+    free(w);
+}
+
+static void notify_fire(void *ud);
+
+/* Spans and the poll timer exist only while someone is watching, so
+ * unwatched buffers pay nothing for edits. */
+static void watches_update(void) {
+    bool want = any_watching();
+    if (want && arrlen(g_watches) == 0) {
+        for (ptrdiff_t i = 0; i < arrlen(E.buffers); i++)
+            watch_add(&E.buffers[i]);
+        ed_loop_timer_after("mcp:notify", MCP_NOTIFY_MS, notify_fire, NULL);
+    } else if (!want) {
+        while (arrlen(g_watches) > 0) watch_drop(arrlen(g_watches) - 1);
+        arrfree(g_watches);
+        ed_loop_timer_cancel("mcp:notify");
+    }
+}
+
+/* Polled rather than driven by edit hooks: undo, puts and tool edits
+ * change rows without firing any, but every change widens the spans.
+ * Edits within one period go out as a single notification. */
+static void notify_fire(void *ud) {
+    (void)ud;
+
+    for (ptrdiff_t i = 0; i < arrlen(g_watches); i++) {
+        McpWatch *w = g_watches[i];
+        if (!w->span.touched && !w->span.reset) continue;
+        Buffer *buf = buf_edit_span_owner(&w->span);
+        if (!buf) continue;
+
+        cJSON *params = cJSON_CreateObject();
+        const char *name = buf->filename ? buf->filename
+                         : buf->title    ? buf->title : "";
+        cJSON_AddStringToObject(params, "buffer", name);
+        cJSON_AddNumberToObject(params, "total_lines", buf->num_rows);
+        if (w->span.reset) {
+            cJSON_AddBoolToObject(params, "reset", 1);
+        } else {
+            /* Rows [start_line, old_end_line) before the edits are now
+             * rows [start_line, end_line). */
+            cJSON_AddNumberToObject(params, "start_line",   w->span.lo);
+            cJSON_AddNumberToObject(params, "end_line",     w->span.hi);
+            cJSON_AddNumberToObject(params, "old_end_line",
+                                    w->span.hi - w->span.delta);
+        }
+        buf_edit_span_clear(&w->span);
+
+        cJSON *msg = cJSON_CreateObject();
+        cJSON_AddStringToObject(msg, "jsonrpc", "2.0");
+        cJSON_AddStringToObject(msg, "method", "notifications/hed/buffer_changed");
+        cJSON_AddItemToObject(msg, "params", params);
+        for (ptrdiff_t k = 0; k < arrlen(g_clients); k++)
+            if (g_clients[k]->watching) send_message(g_clients[k], msg);
+        cJSON_Delete(msg);
+    }
+    clients_reap();
+    /* With every watched buffer closed the timer stops; on_buffer_open
+     * re-arms it for the next one. */
+    if (any_watching() && arrlen(g_watches) > 0)
+        ed_loop_timer_after("mcp:notify", MCP_NOTIFY_MS, notify_fire, NULL);
+}
+
+static void on_buffer_open(HookBufferEvent *e) {
+    if (!e || !e->buf || !any_watching()) return;
+    if (arrlen(g_watches) == 0)
+        ed_loop_timer_after("mcp:notify", MCP_NOTIFY_MS, notify_fire, NULL);
+    watch_add(e->buf);
+}
+
+static void on_buffer_close(HookBufferEvent *e) {
+    if (!e || !e->buf) return;
+    for (ptrdiff_t i = 0; i < arrlen(g_watches); i++) {
+        if (buf_edit_span_owner(&g_watches[i]->span) == e->buf) {
+            watch_drop(i);
+            return;
+        }
+    }
+}
+
+static cJSON *tool_watch_changes(int client_id, cJSON *args) {
+    McpClient *c = client_by_id(client_id);
+    if (!c) return tool_result_text("error: client gone", 1);
+    cJSON *je = cJSON_GetObjectItem(args, "enabled");
+    c->watching = je ? cJSON_IsTrue(je) : true;
+    watches_update();
+    return tool_result_text(c->watching ? "ok: watching" : "ok: not watching", 0);
+}
+
 /* ---- listener lifecycle ---- */
 
 static int mcp_start(void) {
@@ -469,8 +842,9 @@ static int mcp_start(void) {
 }
 
 static void mcp_stop(void) {
-    for (int i = 0; i < MCP_MAX_CLIENTS; i++)
-        client_close(&g_clients[i]);
+    while (arrlen(g_clients) > 0)
+        client_close(g_clients[arrlen(g_clients) - 1]);
+    arrfree(g_clients);
     if (g_listen_fd >= 0) {
         ed_loop_unregister(g_listen_fd);
         close(g_listen_fd);
@@ -513,11 +887,15 @@ static void cmd_mcp_status(const char *args) {
         ed_set_status_message("mcp: not running");
         return;
     }
-    int n = 0;
-    for (int i = 0; i < MCP_MAX_CLIENTS; i++)
-        if (g_clients[i].fd > 0) n++;
-    ed_set_status_message("mcp: %s (%d client%s)",
-                          g_socket_path, n, n == 1 ? "" : "s");
+    int    n = (int)arrlen(g_clients), watching = 0;
+    size_t queued = 0;
+    for (int i = 0; i < n; i++) {
+        watching += g_clients[i]->watching;
+        queued   += g_clients[i]->tx_len - g_clients[i]->tx_off;
+    }
+    ed_set_status_message("mcp: %s (%d/%d client%s, %d watching, %zu bytes queued)",
+                          g_socket_path, n, g_max_clients, n == 1 ? "" : "s",
+                          watching, queued);
 }
 
 /* ---- plugin lifecycle ---- */
@@ -526,6 +904,9 @@ static int mcp_init(void) {
     cmd("mcp_start",  cmd_mcp_start,  "start the MCP server");
     cmd("mcp_stop",   cmd_mcp_stop,   "stop the MCP server");
     cmd("mcp_status", cmd_mcp_status, "show MCP server status");
+
+    hook_register_buffer(HOOK_BUFFER_OPEN, -1, "*", on_buffer_open);
+    hook_register_buffer(HOOK_BUFFER_CLOSE, -1, "*", on_buffer_close);
     return 0;
 }
 
@@ -1,5 +1,12 @@
 #ifndef HED_PLUGIN_MCP_SERVER_H
 #define HED_PLUGIN_MCP_SERVER_H
 #include "plugin.h"
+#include <stddef.h>
 extern const Plugin plugin_mcp_server;
+
+/* Most clients served at once, and the most bytes left queued for one
+ * client that is not reading before its next message drops it. A
+ * single message may exceed it. Values <= 0 keep the current limit.
+ * Call from config. */
+void mcp_set_limits(int max_clients, size_t max_queue_bytes);
 #endif
@@ -61,7 +61,7 @@ static void clamp_cursor_x(Window *win, Buffer *buf) {
         win->cursor.y = 0;
     if (win->cursor.y >= buf->num_rows)
         win->cursor.y = buf->num_rows - 1;
-    int len = (int)buf->rows[win->cursor.y].chars.len;
+    int len = (int)buf_row(buf, win->cursor.y)->chars.len;
     if (win->cursor.x > len)
         win->cursor.x = len;
     if (win->cursor.x < 0)
@@ -132,7 +132,7 @@ static void on_drag(const MouseEvent *ev) {
         win->sel.anchor_y = g_press.y;
         win->sel.anchor_x = g_press.x;
         win->sel.anchor_rx =
-            buf_row_cx_to_rx(&buf->rows[g_press.y], g_press.x);
+            buf_row_cx_to_rx(buf_row(buf, g_press.y), g_press.x);
         ed_set_mode(MODE_VISUAL);
         ed_set_status_message("-- VISUAL --");
         g_press.dragging = 1;
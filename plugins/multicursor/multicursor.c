@@ -234,59 +234,37 @@ static void on_keypress(HookKeyEvent *event) {
 
 /* --- next-match search --- */
 
-typedef struct { int y, x; } McPos;
-
 /* Case-sensitive substring search starting at (start_y, start_x),
  * wrapping past the last row. Fills *out_y / *out_x and returns 1 on
  * match; returns 0 if the query isn't found anywhere. */
 static int mc_find_next(Buffer *buf, const char *q, size_t qlen,
                         int start_y, int start_x,
                         int *out_y, int *out_x) {
-    if (!buf || !q || qlen == 0 || buf->num_rows == 0) return 0;
-    int rows = buf->num_rows;
-
-    for (int i = 0; i <= rows; i++) {
-        int y = (start_y + i) % rows;
-        Row *row = &buf->rows[y];
-        int len = (int)row->chars.len;
-        int from = (i == 0) ? start_x : 0;
-        if (from < 0) from = 0;
-        for (int x = from; x + (int)qlen <= len; x++) {
-            if (memcmp(row->chars.data + x, q, qlen) == 0) {
-                *out_y = y;
-                *out_x = x;
-                return 1;
-            }
-        }
-    }
-    return 0;
+    if (!buf || !q || qlen == 0) return 0;
+    StrSearch ss;
+    TextPos   hit;
+    strsearch_init(&ss, q, qlen, false);
+    if (!buf_search_next(buf, &ss, start_y, start_x, 1, &hit)) return 0;
+    *out_y = hit.line;
+    *out_x = hit.col;
+    return 1;
 }
 
 /* Mirror of mc_find_next walking backward. On the start row the match
  * must end at or before start_x (i.e. match-start <= start_x - qlen);
- * wrapped rows are scanned from the rightmost candidate position. */
+ * wrapped rows are searched from their rightmost candidate. */
 static int mc_find_prev(Buffer *buf, const char *q, size_t qlen,
                         int start_y, int start_x,
                         int *out_y, int *out_x) {
-    if (!buf || !q || qlen == 0 || buf->num_rows == 0) return 0;
-    int rows = buf->num_rows;
-
-    for (int i = 0; i <= rows; i++) {
-        int y = ((start_y - i) % rows + rows) % rows;
-        Row *row = &buf->rows[y];
-        int len = (int)row->chars.len;
-        int upper = (i == 0) ? (start_x - (int)qlen)
-                             : (len - (int)qlen);
-        if (upper > len - (int)qlen) upper = len - (int)qlen;
-        for (int x = upper; x >= 0; x--) {
-            if (memcmp(row->chars.data + x, q, qlen) == 0) {
-                *out_y = y;
-                *out_x = x;
-                return 1;
-            }
-        }
-    }
-    return 0;
+    if (!buf || !q || qlen == 0) return 0;
+    StrSearch ss;
+    TextPos   hit;
+    strsearch_init(&ss, q, qlen, false);
+    if (!buf_search_next(buf, &ss, start_y, start_x - (int)qlen, -1, &hit))
+        return 0;
+    *out_y = hit.line;
+    *out_x = hit.col;
+    return 1;
 }
 
 /* Extract the search query at the active cursor: the single-line
@@ -308,7 +286,7 @@ static int mc_query_at_cursor(Buffer *buf, Window *win, StrBuf *q,
             ed_set_status_message("multicursor: multi-line selection not supported");
             return 0;
         }
-        Row *row = &buf->rows[ay];
+        Row *row = buf_row(buf, ay);
         if (ax < 0) ax = 0;
         if (cx > (int)row->chars.len - 1) cx = (int)row->chars.len - 1;
         int sel_end = cx + 1; /* visual selection is inclusive on the cursor side */
@@ -329,7 +307,7 @@ static int mc_query_at_cursor(Buffer *buf, Window *win, StrBuf *q,
         strbuf_free(q);
         return 0;
     }
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     int b = win->cursor.x, e = win->cursor.x;
     while (b > 0 &&
            (isalnum((unsigned char)row->chars.data[b-1]) ||
@@ -461,21 +439,10 @@ static void kb_mc_match_all(void) {
     if (!mc_query_at_cursor(buf, win, &q, &sy, &sx, &ex)) return;
     (void)ex;
 
-    McPos *matches = NULL;
-    for (int y = 0; y < buf->num_rows; y++) {
-        Row *row = &buf->rows[y];
-        int len = (int)row->chars.len;
-        int x = 0;
-        while (x + (int)q.len <= len) {
-            if (memcmp(row->chars.data + x, q.data, q.len) == 0) {
-                McPos p = { y, x };
-                arrput(matches, p);
-                x += (int)q.len;
-            } else {
-                x++;
-            }
-        }
-    }
+    TextPos  *matches = NULL;
+    StrSearch ss;
+    strsearch_init(&ss, q.data, q.len, false);
+    buf_search_all(buf, &ss, &matches);
 
     int n = (int)arrlen(matches);
     if (n == 0) { /* can't happen — the query was read out of the buffer */
@@ -493,12 +460,12 @@ static void kb_mc_match_all(void) {
      * match at or after it, then to the first match overall. */
     int active = -1;
     for (int i = 0; i < n; i++) {
-        if (matches[i].y == sy && matches[i].x == sx) { active = i; break; }
+        if (matches[i].line == sy && matches[i].col == sx) { active = i; break; }
     }
     if (active < 0) {
         for (int i = 0; i < n; i++) {
-            if (matches[i].y > sy ||
-                (matches[i].y == sy && matches[i].x >= sx)) {
+            if (matches[i].line > sy ||
+                (matches[i].line == sy && matches[i].col >= sx)) {
                 active = i;
                 break;
             }
@@ -508,18 +475,18 @@ static void kb_mc_match_all(void) {
 
     /* Rebuild the cursor set: one cursor per match, nothing else. */
     buf_cursor_clear_extras(buf);
-    buf->cursor->y = matches[active].y;
-    buf->cursor->x = matches[active].x;
+    buf->cursor->y = matches[active].line;
+    buf->cursor->x = matches[active].col;
     int oom = 0;
     for (int i = 0; i < n; i++) {
         if (i == active) continue;
-        if (!buf_cursor_add(buf, matches[i].y, matches[i].x)) {
+        if (!buf_cursor_add(buf, matches[i].line, matches[i].col)) {
             oom = 1;
             break;
         }
     }
-    win->cursor.y = matches[active].y;
-    win->cursor.x = matches[active].x;
+    win->cursor.y = matches[active].line;
+    win->cursor.x = matches[active].col;
     arrfree(matches);
 
     if (E.mode == MODE_VISUAL) {
@@ -628,7 +595,7 @@ static void mc_add_and_advance(int dy) {
         return;
     }
     int x = buf->cursor->x;
-    int len = (int)buf->rows[new_y].chars.len;
+    int len = (int)buf_row(buf, new_y)->chars.len;
     if (x > len) x = len;
     Cursor *nc = buf_cursor_add(buf, new_y, x);
     if (!nc) {
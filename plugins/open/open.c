@@ -45,7 +45,7 @@ static int extract_target_under_cursor(StrBuf *out) {
     BUF(buf);
     WIN(win);
     if (!BOUNDS_CHECK(win->cursor.y, buf->num_rows)) return 0;
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     if (row->chars.len == 0) return 0;
 
     const char *s = row->chars.data;
@@ -60,12 +60,7 @@ EdError sed_apply_to_buffer(Buffer *buf, const char *sed_expr) {
     }
 
     /* 6. Clear old buffer content */
-    for (int i = 0; i < buf->num_rows; i++) {
-        row_free(&buf->rows[i]);
-    }
-    free(buf->rows);
-    buf->rows = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
 
     /* 7. Insert new content from sed output */
     if (output_count == 0) {
@@ -96,7 +91,7 @@ EdError sed_apply_to_buffer(Buffer *buf, const char *sed_expr) {
 
         /* Clamp X to valid range for current line */
         if (saved_cy < buf->num_rows) {
-            int max_x = (int)buf->rows[saved_cy].chars.len;
+            int max_x = (int)buf_row(buf, saved_cy)->chars.len;
             if (saved_cx > max_x) {
                 saved_cx = max_x;
             }
@@ -213,7 +213,7 @@ static void cmd_selectlist_demo(const char *args) {
                        ? &E.buffers[cur->buffer_index]
                        : NULL;
     if (buf && cur->cursor.y < buf->num_rows) {
-        int rx   = buf_row_cx_to_rx(&buf->rows[cur->cursor.y], cur->cursor.x);
+        int rx   = buf_row_cx_to_rx(buf_row(buf, cur->cursor.y), cur->cursor.x);
         anchor_x = (rx - cur->col_offset) + cur->left;
     }
 
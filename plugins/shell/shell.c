@@ -158,18 +158,18 @@ static void splice_lines_at_range(Buffer *buf, int sy, int sx,
     if (ey < sy) ey = sy;
     if (ey >= buf->num_rows) ey = buf->num_rows - 1;
     if (sx < 0) sx = 0;
-    if (sx > (int)buf->rows[sy].chars.len) sx = (int)buf->rows[sy].chars.len;
+    if (sx > (int)buf_row(buf, sy)->chars.len) sx = (int)buf_row(buf, sy)->chars.len;
     if (ex < 0) ex = 0;
-    if (ex > (int)buf->rows[ey].chars.len) ex = (int)buf->rows[ey].chars.len;
+    if (ex > (int)buf_row(buf, ey)->chars.len) ex = (int)buf_row(buf, ey)->chars.len;
     if (sy == ey && ex < sx) ex = sx;
 
     undo_begin(buf, desc);
 
-    StrBuf tail = strbuf_from(buf->rows[ey].chars.data + ex,
-                              buf->rows[ey].chars.len - ex);
+    StrBuf tail = strbuf_from(buf_row(buf, ey)->chars.data + ex,
+                              buf_row(buf, ey)->chars.len - ex);
 
     {
-        Row *first = &buf->rows[sy];
+        Row *first = buf_row(buf, sy);
         undo_record_replace(buf, sy);
         first->chars.len = sx;
         if (first->chars.data)
@@ -185,7 +185,7 @@ static void splice_lines_at_range(Buffer *buf, int sy, int sx,
         size_t s0len = strlen(s0);
         if (s0len > 0) {
             StrBuf s = strbuf_from(s0, s0len);
-            buf_row_append_in(buf, &buf->rows[sy], &s);
+            buf_row_append_in(buf, buf_row(buf, sy), &s);
             strbuf_free(&s);
         }
         for (int i = 1; i < count; i++) {
@@ -198,7 +198,7 @@ static void splice_lines_at_range(Buffer *buf, int sy, int sx,
     }
 
     if (tail.len > 0)
-        buf_row_append_in(buf, &buf->rows[end_y], &tail);
+        buf_row_append_in(buf, buf_row(buf, end_y), &tail);
     strbuf_free(&tail);
 
     if (buf->num_rows == 0)
@@ -208,7 +208,7 @@ static void splice_lines_at_range(Buffer *buf, int sy, int sx,
 
     if (end_y >= buf->num_rows) end_y = buf->num_rows - 1;
     if (end_y < 0) end_y = 0;
-    int row_len = (int)buf->rows[end_y].chars.len;
+    int row_len = (int)buf_row(buf, end_y)->chars.len;
     if (end_x > row_len) end_x = row_len;
     if (end_x < 0) end_x = 0;
     buf->cursor->y = end_y;
@@ -249,7 +249,7 @@ static int sel_to_byte_range(Window *win, Buffer *buf,
             *out_ex = 0;
         } else {
             *out_ey = ey;
-            *out_ex = (int)buf->rows[ey].chars.len;
+            *out_ex = (int)buf_row(buf, ey)->chars.len;
         }
         return 1;
     }
@@ -260,7 +260,7 @@ static int sel_to_byte_range(Window *win, Buffer *buf,
     } else {
         sy = cy; sx = cx; ey = ay; ex = ax;
     }
-    int row_len = (int)buf->rows[ey].chars.len;
+    int row_len = (int)buf_row(buf, ey)->chars.len;
     if (ex < row_len) {
         ex++;
     } else if (ey + 1 < buf->num_rows) {
@@ -362,7 +362,7 @@ static void shell_execute(const char *args) {
         case CAP_REPLACE_BUF: {
             int last = buf->num_rows > 0 ? buf->num_rows - 1 : 0;
             int last_x = (buf->num_rows > 0)
-                       ? (int)buf->rows[last].chars.len : 0;
+                       ? (int)buf_row(buf, last)->chars.len : 0;
             splice_lines_at_range(buf, 0, 0, last, last_x,
                                   lines, count, "shell-capture");
             if (win) { win->row_offset = 0; win->col_offset = 0; }
@@ -12,7 +12,7 @@ static void hook_smart_indent(const HookCharEvent *event) {
 
     /* Copy the previous line's leading whitespace verbatim so a tab-
      * indented line yields a tab-indented continuation, not 4 spaces. */
-    Row *prev_row = &buf->rows[win->cursor.y - 1];
+    Row *prev_row = buf_row(buf, win->cursor.y - 1);
     for (size_t i = 0; i < prev_row->chars.len; i++) {
         char c = prev_row->chars.data[i];
         if (c != ' ' && c != '\t') break;
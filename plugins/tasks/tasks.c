@@ -275,7 +275,7 @@ static int parse_heading(const Row *row, Heading *h) {
 static int heading_at_or_above(Buffer *buf, int y) {
     Heading h;
     for (int r = y; r >= 0; r--)
-        if (r < buf->num_rows && parse_heading(&buf->rows[r], &h))
+        if (r < buf->num_rows && parse_heading(buf_row(buf, r), &h))
             return r;
     return -1;
 }
@@ -287,7 +287,7 @@ static int heading_at_or_above(Buffer *buf, int y) {
 /* End of the contiguous field block under heading `hy` (exclusive). */
 static int field_block_end(Buffer *buf, int hy) {
     int e = hy + 1;
-    while (e < buf->num_rows && md_is_field_line(&buf->rows[e])) e++;
+    while (e < buf->num_rows && md_is_field_line(buf_row(buf, e))) e++;
     return e;
 }
 
@@ -298,7 +298,7 @@ static void task_field_set(Buffer *buf, int hy, const char *key,
     int e = field_block_end(buf, hy);
     int at = -1;
     for (int r = hy + 1; r < e; r++)
-        if (md_field_is_key(&buf->rows[r], key)) { at = r; break; }
+        if (md_field_is_key(buf_row(buf, r), key)) { at = r; break; }
 
     int clear = !value || !*value;
     if (clear) {
@@ -319,7 +319,7 @@ static void task_field_set(Buffer *buf, int hy, const char *key,
 
 static void task_set(Buffer *buf, int hy, int next) {
     Heading h;
-    Row *row = &buf->rows[hy];
+    Row *row = buf_row(buf, hy);
     if (!parse_heading(row, &h)) return;
     int old = h.status;
 
@@ -380,7 +380,7 @@ static void cmd_task_cycle(const char *args) {
     int hy = cursor_heading(&buf);
     if (hy < 0) return;
     Heading h;
-    parse_heading(&buf->rows[hy], &h);
+    parse_heading(buf_row(buf, hy), &h);
     int next;
     if (h.status < 0) next = IDX_TODO;
     else {
@@ -486,12 +486,12 @@ static void cmd_task_field(const char *args) {
  * line in the section (before the next same-or-shallower heading). */
 static int section_log_pos(Buffer *buf, int hy) {
     Heading h;
-    parse_heading(&buf->rows[hy], &h);
+    parse_heading(buf_row(buf, hy), &h);
     int last = hy;
     for (int r = hy + 1; r < buf->num_rows; r++) {
         Heading hh;
-        if (parse_heading(&buf->rows[r], &hh) && hh.level <= h.level) break;
-        if (buf->rows[r].chars.len > 0) last = r;
+        if (parse_heading(buf_row(buf, r), &hh) && hh.level <= h.level) break;
+        if (buf_row(buf, r)->chars.len > 0) last = r;
     }
     return last + 1;
 }
@@ -657,11 +657,11 @@ static void cmd_task_agenda(const char *args) {
  * is <= this heading's, or end-of-buffer. Includes nested sub-headings. */
 static int section_extent(Buffer *buf, int hy) {
     Heading h;
-    parse_heading(&buf->rows[hy], &h);
+    parse_heading(buf_row(buf, hy), &h);
     int r = hy + 1;
     for (; r < buf->num_rows; r++) {
         Heading hh;
-        if (parse_heading(&buf->rows[r], &hh) && hh.level <= h.level) break;
+        if (parse_heading(buf_row(buf, r), &hh) && hh.level <= h.level) break;
     }
     return r;
 }
@@ -693,7 +693,7 @@ static int append_section(const char *path, Buffer *buf, int hy, int end) {
     FILE *f = fopen(path, "a");
     if (!f) return 0;
     for (int r = hy; r < end; r++) {
-        Row *row = &buf->rows[r];
+        Row *row = buf_row(buf, r);
         if (row->chars.len) fwrite(row->chars.data, 1, row->chars.len, f);
         fputc('\n', f);
     }
@@ -714,7 +714,7 @@ static int archive_section(Buffer *buf, int hy, const char *ap) {
 
     for (int r = end - 1; r >= hy; r--) buf_row_del_in(buf, r);
     /* swallow one leftover blank line so sections don't pile up gaps */
-    if (hy < buf->num_rows && buf->rows[hy].chars.len == 0)
+    if (hy < buf->num_rows && buf_row(buf, hy)->chars.len == 0)
         buf_row_del_in(buf, hy);
     return 1;
 }
@@ -753,7 +753,7 @@ static void cmd_task_archive_done(const char *args) {
         int hy = -1;
         for (int r = 0; r < buf->num_rows; r++) {
             Heading h;
-            if (parse_heading(&buf->rows[r], &h) && h.status >= 0 &&
+            if (parse_heading(buf_row(buf, r), &h) && h.status >= 0 &&
                 STATUS[h.status].closed) { hy = r; break; }
         }
         if (hy < 0) break;
@@ -810,8 +810,8 @@ static void on_render_pre(const HookRenderEvent *e) {
     Buffer *buf = e->buf;
     int hi = e->row_end < buf->num_rows ? e->row_end : buf->num_rows;
     for (int y = e->row_start; y < hi; y++) {
-        const char *s = buf->rows[y].chars.data;
-        int len = (int)buf->rows[y].chars.len;
+        const char *s = buf_row(buf, y)->chars.data;
+        int len = (int)buf_row(buf, y)->chars.len;
 
         Heading h;
         if (parse_heading_buf(s, len, &h)) {
@@ -1,5 +1,6 @@
 #include "highlight.h"
 #include "theme.h"
+#include "buf/attrspan.h"
 #include "stb_ds.h"
 #include <string.h>
 
@@ -23,6 +24,7 @@ int highlight_set(const char *role, const char *value) {
         return -1;
     ensure_inited();
     shput(g_table, role, value);
+    attrspan_invalidate_global();
     return 0;
 }
 
@@ -1,4 +1,5 @@
 #include "theme.h"
+#include "buf/attrspan.h"
 #include "stb_ds.h"
 
 typedef struct {
@@ -39,6 +40,7 @@ int theme_palette_set(const char *name, const char *sgr) {
         return -1;
     ensure_palette();
     shput(g_palette, name, sgr);
+    attrspan_invalidate_global(); /* cached spans hold the old SGR */
     return 0;
 }
 
@@ -47,14 +47,15 @@ int ts_buffer_load_language(Buffer *buf, const char *lang_name);
 /* Attempt autoload by filename/filetype */
 int ts_buffer_autoload(Buffer *buf);
 
-/* HOOK_RENDER_PRE handler: walks the whole-buffer tree-sitter parse,
- * splits each query capture by line, and pushes one AttrSpan per
- * (capture, row) into event->spans. Tree-sitter sees the full
- * document anyway, so collecting for the whole buffer once per frame
- * is no more parse-work than per-row and gives correct highlighting
- * for tokens that straddle the visible viewport. Forward-declared so
- * the treesitter init code can register it without exposing
- * HookRenderEvent's full layout here. */
+/* HOOK_RENDER_PRE handler: runs the highlight query over the bytes of
+ * event->row_start..row_end only (the stale rows the renderer asks
+ * for), splits each capture by line, and pushes one AttrSpan per
+ * (capture, row) into event->spans. The parse still covers the whole
+ * document, so tokens straddling the range edge highlight correctly;
+ * rows whose highlighting a reparse changed are handed back to the
+ * renderer with buf_render_invalidate(). Forward-declared so the treesitter init
+ * code can register it without exposing HookRenderEvent's full layout
+ * here. */
 struct HookRenderEvent;
 void ts_render_pre_hook(const struct HookRenderEvent *event);
 
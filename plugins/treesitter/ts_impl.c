@@ -2,8 +2,10 @@
 #include "highlight.h"
 #include "theme.h"
 #include "hed.h"
+#include "select_loop.h"
 #include <dlfcn.h>
 #include <limits.h>
+#include <pthread.h>
 #include <tree_sitter/api.h>
 
 /*
@@ -23,6 +25,8 @@ typedef struct {
     char     lang_name[32];
     uint32_t start_byte;
     uint32_t end_byte;
+    TSPoint  start_point;
+    TSPoint  end_point;
 } TSInjectionRange;
 
 typedef struct {
@@ -35,7 +39,45 @@ typedef struct {
     int         load_failed; /* 1 once we know this lang can't be loaded */
 } TSSubLang;
 
+/* Byte length of every row in the text tree-sitter sees, kept across
+ * frames. lens[r] counts the row plus the '\n' after it (a final row
+ * included, so the text is one byte shorter than the sum), and a
+ * Fenwick tree over lens maps a row to its start offset and back in
+ * O(log n). Patched from the edit span on each reparse: rows edited in
+ * place update the tree in O(log n); inserts and deletes shift lens
+ * and rebuild the tree in one linear pass. */
 typedef struct {
+    uint32_t *lens;
+    uint32_t *tree;  /* Fenwick tree over lens, 1-based */
+    uint32_t  total; /* sum of lens, kept so the text length is O(1) */
+    int       rows;
+    int       cap;
+    int       valid;
+} TSLineIndex;
+
+/* Buffers whose text is at least this long parse on a worker thread;
+ * smaller ones parse inline, where the tree is ready for the very frame
+ * that asked for it. */
+#define TS_ASYNC_MIN_BYTES (256u * 1024u)
+
+struct TSState;
+
+/* One background parse. The worker owns everything here until it
+ * writes the job back through g_job_pipe; from then on the main thread
+ * does. */
+typedef struct {
+    struct TSState *st;       /* NULL once the buffer's state went away */
+    TSParser       *parser;   /* job-private */
+    TSTree         *old;      /* copy of the tree to reuse, or NULL */
+    char           *text;     /* immutable snapshot of the rows */
+    uint32_t        len;
+    TSTree         *result;
+    int             dirty;    /* buf->dirty at snapshot time */
+    int             discard;  /* text was replaced wholesale meanwhile */
+    void           *dl_handle; /* orphaned jobs keep the grammar loaded */
+} TSParseJob;
+
+typedef struct TSState {
     TSParser   *parser;
     TSTree     *tree;
     TSLanguage *lang;
@@ -45,6 +87,18 @@ typedef struct {
     char        lang_name[32];
     int         parsed_dirty; /* last buf->dirty value parsed; -1 = needs parse */
 
+    /* Rows edited since the last parse, and the row offsets that parse
+     * saw, so the next one can ts_tree_edit() the old tree instead of
+     * starting over and frames can find their rows' bytes directly. */
+    BufEditSpan span;
+    TSLineIndex lines;
+
+    /* Background parse in flight, and the edits applied to `tree` since
+     * its snapshot, replayed onto the result so it lines up with the
+     * rows by the time it is installed. */
+    TSParseJob  *job;
+    TSInputEdit *job_edits; /* stb_ds array */
+
     TSInjectionRange *injections;
     int               num_injections;
     int               cap_injections;
@@ -54,7 +108,11 @@ typedef struct {
     int               cap_sub_langs;
 } TSState;
 
-void ts_set_enabled(int on) { g_ts_enabled = on ? 1 : 0; }
+void ts_set_enabled(int on) {
+    if (g_ts_enabled != (on ? 1 : 0))
+        attrspan_invalidate_global();
+    g_ts_enabled = on ? 1 : 0;
+}
 int ts_is_enabled(void) { return g_ts_enabled; }
 
 /* ===================================================================
@@ -93,6 +151,7 @@ static TSState *ts_state_create(Buffer *buf) {
     st->parsed_dirty = -1;
     TSStateEntry e = { .key = buf, .value = st };
     arrput(g_states, e);
+    buf_edit_span_attach(buf, &st->span);
     return st;
 }
 
@@ -110,18 +169,35 @@ static void free_sub_lang(TSSubLang *s) {
     memset(s, 0, sizeof(*s));
 }
 
+/* Let go of an in-flight parse: it finishes on its own and is freed
+ * when it comes back, holding the grammar open until then. */
+static void ts_job_orphan(TSState *st) {
+    if (!st->job)
+        return;
+    st->job->st = NULL;
+    st->job->dl_handle = st->dl_handle;
+    st->dl_handle = NULL;
+    st->job = NULL;
+    arrsetlen(st->job_edits, 0);
+}
+
 static void ts_state_destroy(Buffer *buf) {
     if (!buf) return;
     int i = ts_state_index(buf);
     if (i < 0) return;
     TSState *st = g_states[i].value;
     if (st) {
+        ts_job_orphan(st);
+        arrfree(st->job_edits);
+        buf_edit_span_detach(buf, &st->span);
         if (st->tree)         ts_tree_delete(st->tree);
         if (st->parser)       ts_parser_delete(st->parser);
         if (st->query)        ts_query_delete(st->query);
         if (st->inject_query) ts_query_delete(st->inject_query);
         if (st->dl_handle)    dlclose(st->dl_handle);
         if (st->injections)   free(st->injections);
+        free(st->lines.lens);
+        free(st->lines.tree);
         if (st->sub_langs) {
             for (int j = 0; j < st->num_sub_langs; j++)
                 free_sub_lang(&st->sub_langs[j]);
@@ -362,6 +438,8 @@ int ts_buffer_load_language(Buffer *buf, const char *lang_name) {
     log_msg("Loading tree-sitter language: %s for buf: %s", lang_name,
             buf->title);
 
+    ts_job_orphan(st);
+
     if (st->parser) {
         ts_parser_delete(st->parser);
         st->parser = NULL;
@@ -526,17 +604,214 @@ static int find_set_string_value(const TSQuery *q, uint32_t pattern_idx,
     return 0;
 }
 
-static TSPoint byte_to_point(const char *src, uint32_t byte) {
-    TSPoint p = {0, 0};
-    for (uint32_t i = 0; i < byte; i++) {
-        if (src[i] == '\n') {
-            p.row++;
-            p.column = 0;
-        } else {
-            p.column++;
+/* ===================================================================
+ * Reading the buffer. The text tree-sitter sees is the rows joined with
+ * '\n' (what buf_to_text() would produce), but it is read straight out
+ * of the row storage: parses never copy the document.
+ * =================================================================== */
+
+/* TSInput.read: tree-sitter passes the point it wants next, so each
+ * call is one row lookup — O(1) while it scans forward. Hands out the
+ * rest of the row, then the '\n' after it as its own chunk. */
+static const char *ts_read_rows(void *payload, uint32_t byte_index,
+                                TSPoint pos, uint32_t *bytes_read) {
+    (void)byte_index;
+    Buffer *buf = payload;
+    *bytes_read = 0;
+    if ((int)pos.row >= buf->num_rows)
+        return "";
+    Row *row = buf_row(buf, (int)pos.row);
+    if (pos.column < row->chars.len) {
+        *bytes_read = (uint32_t)(row->chars.len - pos.column);
+        return row->chars.data + pos.column;
+    }
+    if ((int)pos.row + 1 < buf->num_rows) {
+        *bytes_read = 1;
+        return "\n";
+    }
+    return "";
+}
+
+static TSInput ts_buffer_input(Buffer *buf) {
+    TSInput in = {
+        .payload  = buf,
+        .read     = ts_read_rows,
+        .encoding = TSInputEncodingUTF8,
+    };
+    return in;
+}
+
+/* Line index maintenance. */
+static int line_index_reserve(TSLineIndex *li, int rows) {
+    if (rows + 1 <= li->cap)
+        return 1;
+    int cap = li->cap ? li->cap : 256;
+    while (cap < rows + 1)
+        cap *= 2;
+    uint32_t *lens = realloc(li->lens, (size_t)cap * sizeof(uint32_t));
+    if (!lens)
+        return 0;
+    li->lens = lens;
+    uint32_t *tree = realloc(li->tree, (size_t)cap * sizeof(uint32_t));
+    if (!tree)
+        return 0;
+    li->tree = tree;
+    li->cap = cap;
+    return 1;
+}
+
+/* Fill the tree from lens in one linear pass. */
+static void line_index_build(TSLineIndex *li) {
+    int n = li->rows;
+    li->tree[0] = 0;
+    li->total = 0;
+    for (int i = 0; i < n; i++) {
+        li->tree[i + 1] = li->lens[i];
+        li->total += li->lens[i];
+    }
+    for (int i = 1; i <= n; i++) {
+        int j = i + (i & -i);
+        if (j <= n)
+            li->tree[j] += li->tree[i];
+    }
+}
+
+/* lens[r] += d; d wraps like the sums do, so shrinking works too. */
+static void line_index_add(TSLineIndex *li, int r, uint32_t d) {
+    li->total += d;
+    for (int j = r + 1; j <= li->rows; j += j & -j)
+        li->tree[j] += d;
+}
+
+static void line_index_rebuild(TSLineIndex *li, Buffer *buf) {
+    li->valid = 0;
+    if (!line_index_reserve(li, buf->num_rows))
+        return;
+    for (int r = 0; r < buf->num_rows; r++)
+        li->lens[r] = (uint32_t)buf_row(buf, r)->chars.len + 1;
+    li->rows = buf->num_rows;
+    line_index_build(li);
+    li->valid = 1;
+}
+
+/* Byte offset of row r's first byte; r == rows gives the sum of lens. */
+static uint32_t line_index_start(const TSLineIndex *li, int r) {
+    uint32_t off = 0;
+    for (int j = r; j > 0; j -= j & -j)
+        off += li->tree[j];
+    return off;
+}
+
+/* The row holding byte `b`, or the last row when b is past the end. */
+static int line_index_row_at(const TSLineIndex *li, uint32_t b) {
+    /* Fenwick descent: the longest prefix of rows ending at or before
+     * b stops just before the row that holds it. */
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= li->rows)
+        step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= li->rows && li->tree[pos + step] <= b) {
+            pos += step;
+            b -= li->tree[pos];
+        }
+    }
+    return pos < li->rows ? pos : li->rows - 1;
+}
+
+static uint32_t line_index_row_len(const TSLineIndex *li, int r) {
+    return li->lens[r] - 1;
+}
+
+static uint32_t line_index_text_len(const TSLineIndex *li) {
+    return li->rows > 0 ? li->total - 1 : 0;
+}
+
+/* Point just past the last byte of the text. */
+static TSPoint line_index_end_point(const TSLineIndex *li) {
+    if (li->rows <= 0)
+        return (TSPoint){0, 0};
+    return (TSPoint){(uint32_t)(li->rows - 1),
+                     line_index_row_len(li, li->rows - 1)};
+}
+
+/* Fold the rows touched since the last parse (st->span) into a single
+ * TSInputEdit and patch st->lines to match the current rows. Edits are
+ * taken at row granularity: the region starts at column 0 of its first
+ * row and ends at column 0 of the first untouched row after it, so
+ * only the touched rows are measured; the rows behind them keep their
+ * lengths. Returns 0 (index untouched) when the span can't be
+ * trusted — nothing recorded although the buffer changed, a wholesale
+ * reset, row counts that don't add up — and the caller rebuilds. */
+static int ts_edit_from_span(TSState *st, Buffer *buf, TSInputEdit *out) {
+    const BufEditSpan *sp = &st->span;
+    TSLineIndex *li = &st->lines;
+    if (!li->valid || !sp->touched || sp->reset)
+        return 0;
+    int old_rows = li->rows, new_rows = buf->num_rows;
+    int lo = sp->lo, hi = sp->hi, old_hi = sp->hi - sp->delta;
+    if (new_rows - old_rows != sp->delta || lo < 0 || lo > hi ||
+        hi > new_rows || lo > old_hi || old_hi > old_rows)
+        return 0;
+    if (!line_index_reserve(li, new_rows))
+        return 0;
+
+    uint32_t old_len = line_index_text_len(li);
+    TSPoint  old_tail = line_index_end_point(li);
+    uint32_t start = line_index_start(li, lo);
+    uint32_t old_end = line_index_start(li, old_hi);
+
+    if (sp->delta == 0) {
+        /* Rows edited in place: adjust the tree for each length. */
+        for (int r = lo; r < hi; r++) {
+            uint32_t len = (uint32_t)buf_row(buf, r)->chars.len + 1;
+            if (len != li->lens[r])
+                line_index_add(li, r, len - li->lens[r]);
+            li->lens[r] = len;
         }
+    } else {
+        /* Slide the untouched suffix into place, fill the region, then
+         * rebuild the tree over the new rows. */
+        memmove(&li->lens[hi], &li->lens[old_hi],
+                (size_t)(old_rows - old_hi) * sizeof(uint32_t));
+        for (int r = lo; r < hi; r++)
+            li->lens[r] = (uint32_t)buf_row(buf, r)->chars.len + 1;
+        li->rows = new_rows;
+        line_index_build(li);
+    }
+    uint32_t new_end = line_index_start(li, hi);
+
+    TSPoint start_pt = {(uint32_t)lo, 0};
+    TSPoint old_end_pt = {(uint32_t)old_hi, 0};
+    TSPoint new_end_pt = {(uint32_t)hi, 0};
+    if (hi >= new_rows) {
+        /* Region runs to the end: no '\n' after it in the real text. */
+        new_end = line_index_text_len(li);
+        new_end_pt = line_index_end_point(li);
+        old_end = old_len;
+        old_end_pt = old_tail;
     }
-    return p;
+    /* A region starting past the last row of either text (rows appended
+     * or dropped at the end) begins at the '\n' that joins it on. */
+    if (lo > 0 && (lo >= new_rows || lo >= old_rows)) {
+        start -= 1;
+        start_pt = (TSPoint){(uint32_t)(lo - 1), line_index_row_len(li, lo - 1)};
+    }
+
+    out->start_byte    = start;
+    out->old_end_byte  = old_end;
+    out->new_end_byte  = new_end;
+    out->start_point   = start_pt;
+    out->old_end_point = old_end_pt;
+    out->new_end_point = new_end_pt;
+    return 1;
+}
+
+/* Whether the tree is behind the buffer. Edits are seen through the
+ * span; the dirty counter still covers changes made without it. */
+static int ts_needs_parse(const TSState *st, const Buffer *buf) {
+    return !st->tree || st->span.touched || st->span.reset ||
+           st->parsed_dirty != buf->dirty;
 }
 
 /* ===================================================================
@@ -598,8 +873,9 @@ static TSSubLang *get_or_create_sub_lang(TSState *st, const char *lang_name) {
 /* ===================================================================
  * Injection collection.
  * =================================================================== */
-static void add_injection(TSState *st, const char *lang_name, uint32_t s,
-                          uint32_t e) {
+static void add_injection(TSState *st, const char *lang_name, TSNode node) {
+    uint32_t s = ts_node_start_byte(node);
+    uint32_t e = ts_node_end_byte(node);
     if (s >= e || !lang_name || !*lang_name)
         return;
     if (st->num_injections == st->cap_injections) {
@@ -616,9 +892,11 @@ static void add_injection(TSState *st, const char *lang_name, uint32_t s,
     safe_strcpy(ir->lang_name, lang_name, sizeof(ir->lang_name));
     ir->start_byte = s;
     ir->end_byte = e;
+    ir->start_point = ts_node_start_point(node);
+    ir->end_point = ts_node_end_point(node);
 }
 
-static void collect_injections(TSState *st, const char *src, size_t src_len) {
+static void collect_injections(TSState *st, Buffer *buf) {
     st->num_injections = 0;
     if (!st->inject_query || !st->tree)
         return;
@@ -646,11 +924,14 @@ static void collect_injections(TSState *st, const char *src, size_t src_len) {
                 has_content = 1;
             } else if (clen == 18 &&
                        memcmp(cname, "injection.language", 18) == 0) {
-                uint32_t s = ts_node_start_byte(c.node);
-                uint32_t e = ts_node_end_byte(c.node);
-                if (e > s && (size_t)e <= src_len) {
-                    dyn_lang_ptr = src + s;
-                    dyn_lang_len = e - s;
+                /* Language names sit on one row; read them in place. */
+                TSPoint s = ts_node_start_point(c.node);
+                TSPoint e = ts_node_end_point(c.node);
+                Row *row = buf_row(buf, (int)s.row);
+                if (row && e.row == s.row && e.column > s.column &&
+                    e.column <= row->chars.len) {
+                    dyn_lang_ptr = row->chars.data + s.column;
+                    dyn_lang_len = e.column - s.column;
                 }
             }
         }
@@ -671,17 +952,34 @@ static void collect_injections(TSState *st, const char *src, size_t src_len) {
             }
         }
 
-        uint32_t cs = ts_node_start_byte(content_node);
-        uint32_t ce = ts_node_end_byte(content_node);
-        add_injection(st, lang_buf, cs, ce);
+        add_injection(st, lang_buf, content_node);
     }
     ts_query_cursor_delete(cur);
 }
 
 /* ===================================================================
  * Sub-language reparse: feed each sub-parser its accumulated ranges.
+ * Sub trees have been edited along with the host tree (or dropped on a
+ * full reparse), so whatever is left is reused as the old tree.
  * =================================================================== */
-static void reparse_sub_langs(TSState *st, const char *src, size_t src_len) {
+/* Drop the cached render spans of the rows `now` highlights differently
+ * from `before`, which must already be edited to the current text.
+ * Without a tree on both sides any row may have changed. */
+static void ts_invalidate_changes(Buffer *buf, const TSTree *before,
+                                  const TSTree *now) {
+    if (!before || !now) {
+        buf_render_invalidate(buf, 0, buf->num_rows);
+        return;
+    }
+    uint32_t n = 0;
+    TSRange *r = ts_tree_get_changed_ranges(before, now, &n);
+    for (uint32_t i = 0; i < n; i++)
+        buf_render_invalidate(buf, (int)r[i].start_point.row,
+                              (int)r[i].end_point.row + 1);
+    free(r);
+}
+
+static void reparse_sub_langs(TSState *st, Buffer *buf) {
     /* Distinct languages used this round (cap protects stack). */
     enum { MAX_DISTINCT = 16 };
     char langs[MAX_DISTINCT][32];
@@ -711,23 +1009,25 @@ static void reparse_sub_langs(TSState *st, const char *src, size_t src_len) {
         for (int i = 0; i < st->num_injections && rc < MAX_RANGES; i++) {
             if (strcmp(st->injections[i].lang_name, langs[li]) != 0)
                 continue;
-            uint32_t s = st->injections[i].start_byte;
-            uint32_t e = st->injections[i].end_byte;
-            ranges[rc].start_byte = s;
-            ranges[rc].end_byte = e;
-            ranges[rc].start_point = byte_to_point(src, s);
-            ranges[rc].end_point = byte_to_point(src, e);
+            const TSInjectionRange *ir = &st->injections[i];
+            ranges[rc].start_byte = ir->start_byte;
+            ranges[rc].end_byte = ir->end_byte;
+            ranges[rc].start_point = ir->start_point;
+            ranges[rc].end_point = ir->end_point;
             rc++;
         }
         if (rc == 0)
             continue;
         ts_parser_set_included_ranges(sub->parser, ranges, (uint32_t)rc);
-        if (sub->tree) {
-            ts_tree_delete(sub->tree);
-            sub->tree = NULL;
-        }
-        sub->tree =
-            ts_parser_parse_string(sub->parser, NULL, src, (uint32_t)src_len);
+        TSTree *old = sub->tree;
+        sub->tree = ts_parser_parse(sub->parser, old, ts_buffer_input(buf));
+        if (old && sub->tree)
+            ts_invalidate_changes(buf, old, sub->tree);
+        else
+            buf_render_invalidate(buf, (int)ranges[0].start_point.row,
+                                  (int)ranges[rc - 1].end_point.row + 1);
+        if (old)
+            ts_tree_delete(old);
     }
 
     /* Drop trees for languages that no longer have any injection so we
@@ -746,31 +1046,242 @@ static void reparse_sub_langs(TSState *st, const char *src, size_t src_len) {
     }
 }
 
+/* Move everything positioned in the old text along with `e`: the host
+ * tree, sub trees and injection ranges. Nodes inside the edited rows
+ * keep stale kinds until the next parse lands, but everything around
+ * them lines up with the rows again, so frames in between still
+ * highlight correctly outside the edit. Injection points are only
+ * shifted by rows — edits end at column 0, and collect_injections()
+ * recomputes them exactly after each fresh parse. */
+static void ts_apply_edit(TSState *st, const TSInputEdit *e) {
+    if (st->tree)
+        ts_tree_edit(st->tree, e);
+    for (int i = 0; i < st->num_sub_langs; i++)
+        if (st->sub_langs[i].tree)
+            ts_tree_edit(st->sub_langs[i].tree, e);
+    int32_t bytes = (int32_t)(e->new_end_byte - e->old_end_byte);
+    int32_t rows = (int32_t)e->new_end_point.row - (int32_t)e->old_end_point.row;
+    for (int i = 0; i < st->num_injections; i++) {
+        TSInjectionRange *ir = &st->injections[i];
+        if (ir->end_byte <= e->start_byte)
+            continue;
+        if (ir->start_byte >= e->old_end_byte) {
+            ir->start_byte += (uint32_t)bytes;
+            ir->start_point.row += (uint32_t)rows;
+        } else if (ir->start_byte > e->new_end_byte) {
+            ir->start_byte = e->new_end_byte;
+        }
+        if (ir->end_byte >= e->old_end_byte) {
+            ir->end_byte += (uint32_t)bytes;
+            ir->end_point.row += (uint32_t)rows;
+        } else if (ir->end_byte > e->new_end_byte) {
+            ir->end_byte = e->new_end_byte;
+        }
+    }
+}
+
+/* Forget every tree: after a wholesale change nothing lines up. */
+static void ts_drop_trees(TSState *st) {
+    if (st->tree) {
+        ts_tree_delete(st->tree);
+        st->tree = NULL;
+    }
+    for (int i = 0; i < st->num_sub_langs; i++) {
+        if (st->sub_langs[i].tree) {
+            ts_tree_delete(st->sub_langs[i].tree);
+            st->sub_langs[i].tree = NULL;
+        }
+    }
+    st->num_injections = 0;
+    if (st->job)
+        st->job->discard = 1;
+    arrsetlen(st->job_edits, 0);
+}
+
+/* The tree now matches the rows exactly: derive what hangs off it. */
+static void ts_tree_settled(TSState *st, Buffer *buf, int dirty) {
+    st->parsed_dirty = dirty;
+    collect_injections(st, buf);
+    reparse_sub_langs(st, buf);
+}
+
+/* ===================================================================
+ * Background parsing. Jobs run on a detached thread each, against a
+ * snapshot of the text and a copy of the tree (tree-sitter trees are
+ * not thread-safe, copies are cheap), and come back through a pipe the
+ * main loop watches. Only one job per buffer is in flight; edits made
+ * meanwhile are queued in job_edits and trigger another job once the
+ * current one lands.
+ * =================================================================== */
+static int g_job_pipe[2] = {-1, -1};
+
+static void ts_job_free(TSParseJob *job) {
+    if (job->result) ts_tree_delete(job->result);
+    if (job->old)    ts_tree_delete(job->old);
+    if (job->parser) ts_parser_delete(job->parser);
+    free(job->text);
+    if (job->dl_handle)
+        dlclose(job->dl_handle);
+    free(job);
+}
+
+static Buffer *ts_state_buffer(const TSState *st) {
+    for (int i = 0; i < (int)arrlen(g_states); i++)
+        if (g_states[i].value == st)
+            return g_states[i].key;
+    return NULL;
+}
+
+/* Main thread: install a finished parse. */
+static void ts_job_finish(TSParseJob *job) {
+    TSState *st = job->st;
+    Buffer *buf = st ? ts_state_buffer(st) : NULL;
+    int follow_up = 0;
+    if (st) {
+        st->job = NULL;
+        if (buf && job->result && !job->discard) {
+            for (ptrdiff_t i = 0; i < arrlen(st->job_edits); i++)
+                ts_tree_edit(job->result, &st->job_edits[i]);
+            ts_invalidate_changes(buf, st->tree, job->result);
+            if (st->tree)
+                ts_tree_delete(st->tree);
+            st->tree = job->result;
+            job->result = NULL;
+            /* Edits queued meanwhile still need a parse of their own. */
+            if (arrlen(st->job_edits) == 0)
+                ts_tree_settled(st, buf, job->dirty);
+            else
+                follow_up = 1;
+        } else if (buf && job->discard) {
+            /* The text was replaced while this ran and the trees were
+             * dropped; rows refilled since have no spans. */
+            follow_up = 1;
+        }
+        arrsetlen(st->job_edits, 0);
+    }
+    ts_job_free(job);
+    /* Nothing else would start it: the rows those edits touched were
+     * already refilled while this parse ran. */
+    if (follow_up)
+        ts_buffer_reparse(buf);
+}
+
+static void ts_on_job_pipe(int fd, void *ud) {
+    (void)ud;
+    TSParseJob *job;
+    while (read(fd, &job, sizeof(job)) == (ssize_t)sizeof(job))
+        ts_job_finish(job);
+}
+
+static void *ts_job_run(void *arg) {
+    TSParseJob *job = arg;
+    job->result =
+        ts_parser_parse_string(job->parser, job->old, job->text, job->len);
+    /* Pointer-sized writes to a pipe are atomic. */
+    while (write(g_job_pipe[1], &job, sizeof(job)) < 0 && errno == EINTR)
+        ;
+    return NULL;
+}
+
+static int ts_job_pipe_ready(void) {
+    if (g_job_pipe[0] >= 0)
+        return 1;
+    if (pipe(g_job_pipe) != 0)
+        return 0;
+    for (int i = 0; i < 2; i++)
+        fcntl(g_job_pipe[i], F_SETFD, FD_CLOEXEC);
+    fcntl(g_job_pipe[0], F_SETFL, fcntl(g_job_pipe[0], F_GETFL) | O_NONBLOCK);
+    ed_loop_register("treesitter", g_job_pipe[0], ts_on_job_pipe, NULL);
+    return 1;
+}
+
+/* Snapshot the rows and hand the parse to a worker. Returns 0 when
+ * that can't be set up; the caller then parses inline. */
+static int ts_job_start(TSState *st, Buffer *buf) {
+    if (!ts_job_pipe_ready())
+        return 0;
+    TSParseJob *job = calloc(1, sizeof(*job));
+    if (!job)
+        return 0;
+    size_t len = 0;
+    job->text = buf_to_text(buf, &len);
+    job->len = len > 0 ? (uint32_t)len - 1 : 0; /* same text as ts_read_rows */
+    job->parser = ts_parser_new();
+    if (!job->text || !job->parser ||
+        !ts_parser_set_language(job->parser, st->lang)) {
+        ts_job_free(job);
+        return 0;
+    }
+    job->old = st->tree ? ts_tree_copy(st->tree) : NULL;
+    job->dirty = buf->dirty;
+    job->st = st;
+
+    pthread_attr_t attr;
+    pthread_t th;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&th, &attr, ts_job_run, job);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        ts_job_free(job);
+        return 0;
+    }
+    st->job = job;
+    arrsetlen(st->job_edits, 0);
+    return 1;
+}
+
 void ts_buffer_reparse(Buffer *buf) {
     if (!buf) return;
     TSState *st = ts_state_get(buf);
     if (!st || !st->parser || !st->lang)
         return;
-    if (st->parsed_dirty == buf->dirty && st->tree)
+    if (!ts_needs_parse(st, buf))
         return;
-    size_t len = 0;
-    char *src = buf_to_text(buf, &len);
-    if (!src)
+    /* Nothing new since the running parse took its snapshot. */
+    if (st->job && !st->span.touched && !st->span.reset)
         return;
 
     /* Make sure the host parser is unrestricted in case it was reused with
      * included_ranges set elsewhere. */
     ts_parser_set_included_ranges(st->parser, NULL, 0);
 
-    if (st->tree)
-        ts_tree_delete(st->tree);
-    st->tree = ts_parser_parse_string(st->parser, NULL, src, (uint32_t)len);
-    st->parsed_dirty = buf->dirty;
+    /* First bring the existing trees in line with the rows: with a
+     * trustworthy edit span, tell tree-sitter what moved so the parse
+     * below reuses every subtree outside the edit; otherwise start
+     * from nothing. */
+    TSInputEdit edit;
+    if (!st->span.touched && !st->span.reset && st->tree &&
+        st->lines.valid && st->lines.rows == buf->num_rows) {
+        /* Rows unchanged since the trees were last lined up (a parse
+         * landed with edits queued, or only `dirty` moved): parse
+         * again on top of them. */
+    } else if ((st->tree || st->job) && ts_edit_from_span(st, buf, &edit)) {
+        ts_apply_edit(st, &edit);
+        if (st->job)
+            arrput(st->job_edits, edit);
+    } else {
+        line_index_rebuild(&st->lines, buf);
+        ts_drop_trees(st);
+    }
+    buf_edit_span_clear(&st->span);
 
-    collect_injections(st, src, len);
-    reparse_sub_langs(st, src, len);
+    /* A parse is already running; its result gets these edits replayed
+     * and the follow-up parse starts once it lands. */
+    if (st->job)
+        return;
+    if (line_index_text_len(&st->lines) >= TS_ASYNC_MIN_BYTES &&
+        ts_job_start(st, buf))
+        return;
 
-    free(src);
+    TSTree *old = st->tree;
+    st->tree = ts_parser_parse(st->parser, old, ts_buffer_input(buf));
+    ts_invalidate_changes(buf, old, st->tree);
+    if (old)
+        ts_tree_delete(old);
+    if (!st->tree)
+        return; /* the next call parses from scratch */
+    ts_tree_settled(st, buf, buf->dirty);
 }
 
 /* ===================================================================
@@ -843,24 +1354,23 @@ static const char *capture_name_to_sgr(const char *name, uint32_t nlen) {
 }
 
 /* ===================================================================
- * HOOK_RENDER_PRE: push AttrSpans for the whole buffer.
+ * HOOK_RENDER_PRE: push AttrSpans for the rows a window shows.
  * =================================================================== */
 
-/* Push spans for one (tree, query) over a byte range, splitting each
- * query capture by line boundaries. `line_starts[r]` is the chars-
- * space byte offset where row r begins. */
+/* Push spans for one (tree, query) over the byte range [start, end),
+ * splitting each capture by line. Captures are clipped to the range,
+ * so a multi-line token that starts or ends off-screen only costs the
+ * rows inside it. */
 static void push_spans_from_tree(TSTree *tree, TSQuery *query,
-                                 uint32_t range_start, uint32_t range_end,
-                                 uint32_t clip_start, uint32_t clip_end,
-                                 const uint32_t *line_starts,
-                                 const int *line_lens, int num_rows,
-                                 AttrSpans *spans) {
-    if (!tree || !query) return;
+                                 uint32_t start, uint32_t end,
+                                 const TSLineIndex *li, AttrSpans *spans) {
+    if (!tree || !query || start >= end) return;
     TSNode root = ts_tree_root_node(tree);
     TSQueryCursor *cur = ts_query_cursor_new();
+    ts_query_cursor_set_byte_range(cur, start, end);
     ts_query_cursor_exec(cur, query, root);
-    ts_query_cursor_set_byte_range(cur, range_start, range_end);
 
+    int num_rows = li->rows;
     TSQueryMatch m;
     while (ts_query_cursor_next_match(cur, &m)) {
         for (uint32_t i = 0; i < m.capture_count; i++) {
@@ -873,22 +1383,17 @@ static void push_spans_from_tree(TSTree *tree, TSQuery *query,
             if (!sgr) continue;
             uint32_t s = ts_node_start_byte(c.node);
             uint32_t e = ts_node_end_byte(c.node);
-            if (e <= clip_start || s >= clip_end) continue;
-            if (s < clip_start) s = clip_start;
-            if (e > clip_end)   e = clip_end;
-
-            /* Walk the rows this capture intersects and push one span
-             * per row's slice. Linear scan from a binary-searched
-             * starting row keeps multi-line tokens cheap. */
-            int lo = 0, hi = num_rows - 1, row = 0;
-            while (lo <= hi) {
-                int mid = (lo + hi) / 2;
-                if (line_starts[mid] <= s) { row = mid; lo = mid + 1; }
-                else                       { hi = mid - 1; }
-            }
-            while (row < num_rows && line_starts[row] < e) {
-                uint32_t row_start = line_starts[row];
-                uint32_t row_end   = row_start + (uint32_t)line_lens[row];
+            if (e <= start || s >= end) continue;
+            if (s < start) s = start;
+            if (e > end)   e = end;
+
+            /* Find the first row in the index, then walk the (few)
+             * rows the clipped capture still covers. */
+            int row = line_index_row_at(li, s);
+            uint32_t row_start = line_index_start(li, row);
+            for (; row < num_rows && row_start < e;
+                 row_start += li->lens[row++]) {
+                uint32_t row_end = row_start + li->lens[row] - 1;
                 uint32_t cs = s > row_start ? s : row_start;
                 uint32_t ce = e < row_end   ? e : row_end;
                 if (ce > cs) {
@@ -896,7 +1401,6 @@ static void push_spans_from_tree(TSTree *tree, TSQuery *query,
                                   (int)(cs - row_start),
                                   (int)(ce - row_start), sgr, 0);
                 }
-                row++;
             }
         }
     }
@@ -909,47 +1413,34 @@ void ts_render_pre_hook(const struct HookRenderEvent *event) {
     if (!g_ts_enabled) return;
     TSState *st = ts_state_get(buf);
     if (!st) return;
-    /* Reparse if the buffer changed since the last frame. Replaces
-     * the per-frame reparse-all loop that used to live in
-     * src/terminal.c — the renderer fires this hook once per visible
-     * window, so tree-sitter sees the same trigger. */
-    if (st->parser && st->lang && st->parsed_dirty != buf->dirty)
+    /* Reparse if the buffer changed since the last frame. Every row
+     * edit leaves its rows stale, and the renderer fires this hook for
+     * stale rows on the next frame, so no change goes unseen. */
+    if (st->parser && st->lang && ts_needs_parse(st, buf))
         ts_buffer_reparse(buf);
     if (!st->tree || !st->query) return;
-    if (buf->num_rows <= 0) return;
-
-    /* Precompute per-row byte offsets in chars-space. */
-    int n = buf->num_rows;
-    uint32_t *line_starts = malloc((size_t)n * sizeof(uint32_t));
-    int      *line_lens   = malloc((size_t)n * sizeof(int));
-    if (!line_starts || !line_lens) {
-        free(line_starts);
-        free(line_lens);
-        return;
-    }
-    uint32_t off = 0;
-    for (int r = 0; r < n; r++) {
-        line_starts[r] = off;
-        line_lens[r]   = (int)buf->rows[r].chars.len;
-        off += (uint32_t)line_lens[r] + 1; /* +1 for newline */
-    }
-    uint32_t total = off > 0 ? off - 1 : 0;
+    const TSLineIndex *li = &st->lines;
+    if (!li->valid || li->rows != buf->num_rows || li->rows <= 0) return;
 
-    /* Host segments over the whole buffer. */
-    push_spans_from_tree(st->tree, st->query, 0, total, 0, total,
-                         line_starts, line_lens, n, event->spans);
+    /* Only the requested rows: the query cursor skips every subtree
+     * outside their bytes, so a fill costs those rows, not the file. */
+    int r0 = event->row_start < 0 ? 0 : event->row_start;
+    int r1 = event->row_end > li->rows ? li->rows : event->row_end;
+    if (r0 >= r1) return;
+    uint32_t vis_start = line_index_start(li, r0);
+    uint32_t vis_end   = line_index_start(li, r1) - 1;
 
-    /* Sub-language segments for each injection range. */
+    push_spans_from_tree(st->tree, st->query, vis_start, vis_end, li,
+                         event->spans);
+
+    /* Sub-language segments for the injection ranges on screen. */
     for (int j = 0; j < st->num_injections; j++) {
         TSInjectionRange *ir = &st->injections[j];
+        uint32_t s = ir->start_byte > vis_start ? ir->start_byte : vis_start;
+        uint32_t e = ir->end_byte < vis_end ? ir->end_byte : vis_end;
+        if (s >= e) continue;
         TSSubLang *sub = find_sub_lang(st, ir->lang_name);
         if (!sub || !sub->tree || !sub->query) continue;
-        push_spans_from_tree(sub->tree, sub->query,
-                             ir->start_byte, ir->end_byte,
-                             ir->start_byte, ir->end_byte,
-                             line_starts, line_lens, n, event->spans);
+        push_spans_from_tree(sub->tree, sub->query, s, e, li, event->spans);
     }
-
-    free(line_starts);
-    free(line_lens);
 }
@@ -63,8 +63,8 @@ static void viewmd_push(Buffer *buf) {
     write(sock, cursor_hdr, (size_t)hdr_len);
 
     for (int i = 0; i < buf->num_rows; i++) {
-        const char *text = buf->rows[i].chars.data;
-        size_t len = buf->rows[i].chars.len;
+        const char *text = buf_row(buf, i)->chars.data;
+        size_t len = buf_row(buf, i)->chars.len;
         if (text && len > 0)
             write(sock, text, len);
         write(sock, "\n", 1);
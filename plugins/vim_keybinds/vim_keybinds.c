@@ -59,6 +59,8 @@ static int vim_keybinds_init(void) {
     cmapn("o",  "new_line",       "new line below");
     cmapn("U",  "redo",            "redo");
     cmapn("u",  "undo",            "undo");
+    cmapn("g-", "earlier",         "older text state");
+    cmapn("g+", "later",           "newer text state");
     cmapn(".",  "repeat",          "repeat last edit");
     cmapn("q",  "record",          "record macro");
     cmapn("@",  "play",            "play macro");
@@ -128,6 +130,7 @@ static int vim_keybinds_init(void) {
     mapn("gF", kb_search_file_under_cursor, "search file");
     mapn("i", kb_enter_insert_mode, "insert");
     mapn("n", kb_search_next, "next match");
+    mapn("N", kb_search_prev, "previous match");
     mapn("p", kb_paste, "paste after");
     mapn("P", kb_paste_before, "paste before");
     mapn("r", kb_replace_char, "replace char");
@@ -105,7 +105,7 @@ static void vsc_delete_forward(void) {
     Buffer *buf = buf_cur();
     Window *win = window_cur();
     if (!buf || !win || buf->num_rows == 0) return;
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     if (win->cursor.x >= (int)row->chars.len) {
         if (win->cursor.y >= buf->num_rows - 1) return;
         win->cursor.y++;
@@ -130,7 +130,7 @@ static void vsc_delete_word_left(void) {
         kb_insert_backspace();
         return;
     }
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     const char *s = row->chars.data;
     int x = win->cursor.x;
     while (x > 0 && isspace((unsigned char)s[x - 1])) x--;
@@ -160,7 +160,7 @@ static void vsc_delete_word_right(void) {
     Buffer *buf = buf_cur();
     Window *win = window_cur();
     if (!buf || !win || buf->num_rows == 0) return;
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     int len = (int)row->chars.len;
     int x = win->cursor.x;
     if (x >= len) {
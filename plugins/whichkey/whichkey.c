@@ -94,14 +94,16 @@ static size_t wk_format(const HookKeybindFeedEvent *e, char *out, size_t outsz)
      * what *more* the user could type) and sort by tail. ASCII puts
      * space (0x20) before any printable char, so a leader-prefixed
      * binding always floats to the top. */
+    KeybindMatchView *matches = keybind_collect_matches();
+    int match_count = (int)arrlen(matches);
     const KeybindMatchView **sorted = NULL;
     int n = 0;
-    if (e->match_count > 0) {
-        sorted = malloc(sizeof(*sorted) * (size_t)e->match_count);
+    if (match_count > 0) {
+        sorted = malloc(sizeof(*sorted) * (size_t)match_count);
     }
     if (sorted) {
-        for (int i = 0; i < e->match_count; i++) {
-            const KeybindMatchView *m = &e->matches[i];
+        for (int i = 0; i < match_count; i++) {
+            const KeybindMatchView *m = &matches[i];
             if (!m->sequence) continue;
             if ((int)strlen(m->sequence) == prefix_len) continue;
             sorted[n++] = m;
@@ -239,9 +241,9 @@ static size_t wk_format(const HookKeybindFeedEvent *e, char *out, size_t outsz)
 
             /* Skip anything that already appeared in the prefix list. */
             int seen = 0;
-            for (int j = 0; j < e->match_count; j++) {
-                if (e->matches[j].sequence &&
-                    strcmp(e->matches[j].sequence, seq) == 0) {
+            for (int j = 0; j < match_count; j++) {
+                if (matches[j].sequence &&
+                    strcmp(matches[j].sequence, seq) == 0) {
                     seen = 1; break;
                 }
             }
@@ -318,6 +320,7 @@ static size_t wk_format(const HookKeybindFeedEvent *e, char *out, size_t outsz)
         arrfree(ft_seqs);
         arrfree(ft_descs);
     }
+    arrfree(matches);
 
     /* Drop trailing newline so the message bar doesn't reserve a
      * blank row. */
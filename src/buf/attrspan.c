@@ -1,46 +1,202 @@
 #include "buf/attrspan.h"
+#include "buf/buffer.h"
 #include "stb_ds.h"
 #include <stdlib.h>
 #include <string.h>
 
-static void attrspan_free_index(AttrSpans *s) {
-    free(s->row_first);
-    free(s->row_count);
-    s->row_first     = NULL;
-    s->row_count     = NULL;
-    s->row_index_len = 0;
+/* Bumped by attrspan_invalidate_global(); tables compare on sync. */
+static unsigned g_epoch = 1;
+
+static void row_drop(AttrRow *r) {
+    arrfree(r->spans);
+    r->spans = NULL;
+    r->valid = 0;
+}
+
+static void row_stale(AttrRow *r) {
+    /* arrsetlen(spans, 0) keeps the backing storage warm for the refill. */
+    if (r->spans)
+        arrsetlen(r->spans, 0);
+    r->valid = 0;
+}
+
+static AttrRow *slot(const AttrSpans *s, int row) {
+    int i = row - s->base;
+    if (!s->rows || i < 0 || i >= (int)arrlen(s->rows))
+        return NULL;
+    return &s->rows[i];
 }
 
 void attrspan_init(AttrSpans *s) {
     if (!s) return;
-    s->items         = NULL;
-    s->sorted        = 0;
-    s->row_first     = NULL;
-    s->row_count     = NULL;
-    s->row_index_len = 0;
+    s->rows     = NULL;
+    s->base     = 0;
+    s->fill_lo  = 0;
+    s->fill_hi  = 0;
+    s->epoch    = g_epoch;
+    s->filetype = NULL;
 }
 
 void attrspan_free(AttrSpans *s) {
     if (!s) return;
-    arrfree(s->items);
-    s->items  = NULL;
-    s->sorted = 0;
-    attrspan_free_index(s);
+    for (ptrdiff_t i = 0; i < arrlen(s->rows); i++)
+        row_drop(&s->rows[i]);
+    arrfree(s->rows);
+    s->rows = NULL;
+    free(s->filetype);
+    s->filetype = NULL;
+    s->fill_lo = s->fill_hi = 0;
 }
 
 void attrspan_clear(AttrSpans *s) {
     if (!s) return;
-    /* arrsetlen(items, 0) keeps the backing storage warm across frames. */
-    if (s->items)
-        arrsetlen(s->items, 0);
-    s->sorted = 0;
-    attrspan_free_index(s);
+    for (ptrdiff_t i = 0; i < arrlen(s->rows); i++)
+        row_stale(&s->rows[i]);
+}
+
+void attrspan_invalidate_global(void) { g_epoch++; }
+
+void attrspan_sync(AttrSpans *s, const char *filetype,
+                   const BufEditSpan *edits) {
+    if (!s) return;
+    const char *ft = filetype ? filetype : "";
+    if (s->epoch != g_epoch || !s->filetype || strcmp(s->filetype, ft) != 0) {
+        attrspan_clear(s);
+        s->epoch = g_epoch;
+        free(s->filetype);
+        s->filetype = strdup(ft);
+    }
+    if (edits)
+        attrspan_apply_edit(s, edits);
+}
+
+/* Drop slots [at, at + n) of the window. */
+static void rows_remove(AttrSpans *s, int at, int n) {
+    for (int i = at; i < at + n; i++)
+        row_drop(&s->rows[i]);
+    arrdeln(s->rows, at, n);
+}
+
+/* Open n stale slots at window index `at`. */
+static void rows_insert(AttrSpans *s, int at, int n) {
+    size_t tail = arrlenu(s->rows) - (size_t)at;
+    arraddnptr(s->rows, (size_t)n);
+    memmove(&s->rows[at + n], &s->rows[at], tail * sizeof(AttrRow));
+    memset(&s->rows[at], 0, (size_t)n * sizeof(AttrRow));
+}
+
+void attrspan_apply_edit(AttrSpans *s, const BufEditSpan *e) {
+    if (!s || !e || !e->touched)
+        return;
+    if (e->reset) {
+        attrspan_clear(s);
+        return;
+    }
+    int n = (int)arrlen(s->rows);
+    if (n == 0)
+        return;
+    /* e->lo..old_hi is the edited region before the edit; everything
+     * from old_hi on moves by delta. */
+    int lo = e->lo, hi = e->hi, old_hi = e->hi - e->delta;
+    for (int r = lo > s->base ? lo : s->base; r < old_hi && r < s->base + n; r++)
+        row_stale(&s->rows[r - s->base]);
+
+    if (e->delta > 0) {
+        /* New rows enter at old_hi. */
+        int at = old_hi - s->base;
+        if (at <= 0) {
+            s->base += e->delta;
+        } else if (at < n) {
+            if (n + e->delta > ATTRSPAN_CACHE_ROWS)
+                rows_remove(s, at, n - at); /* cheaper to refill later */
+            else
+                rows_insert(s, at, e->delta);
+        }
+    } else if (e->delta < 0) {
+        /* Old rows [hi, old_hi) went away. */
+        int a = hi > s->base ? hi : s->base;
+        int b = old_hi < s->base + n ? old_hi : s->base + n;
+        if (a < b)
+            rows_remove(s, a - s->base, b - a);
+        int below = (old_hi < s->base ? old_hi : s->base) - hi;
+        if (below > 0)
+            s->base -= below;
+    }
+}
+
+void attrspan_cover(AttrSpans *s, int lo, int hi) {
+    if (!s || lo >= hi) return;
+    int n = (int)arrlen(s->rows);
+    if (n == 0) {
+        s->base = lo;
+    } else {
+        /* Keep only what fits in the budget around the request. */
+        int slack = (ATTRSPAN_CACHE_ROWS - (hi - lo)) / 2;
+        if (slack < 0) slack = 0;
+        int keep_lo = lo - slack, keep_hi = hi + slack;
+        int end = s->base + n;
+        if (end > keep_hi) {
+            int at = keep_hi > s->base ? keep_hi - s->base : 0;
+            rows_remove(s, at, n - at);
+            n = at;
+        }
+        if (n > 0 && s->base < keep_lo) {
+            int cut = keep_lo - s->base;
+            if (cut > n) cut = n;
+            rows_remove(s, 0, cut);
+            s->base += cut;
+            n -= cut;
+        }
+        if (n == 0)
+            s->base = lo;
+    }
+    if (lo < s->base) {
+        rows_insert(s, 0, s->base - lo);
+        n += s->base - lo;
+        s->base = lo;
+    }
+    if (hi > s->base + n)
+        rows_insert(s, n, hi - (s->base + n));
+}
+
+int attrspan_next_stale(const AttrSpans *s, int from, int to, int *run_end) {
+    if (!s) return -1;
+    int r = from;
+    while (r < to) {
+        const AttrRow *sl = slot(s, r);
+        if (!sl || !sl->valid)
+            break;
+        r++;
+    }
+    if (r >= to)
+        return -1;
+    int e = r + 1;
+    while (e < to) {
+        const AttrRow *sl = slot(s, e);
+        if (sl && sl->valid)
+            break;
+        e++;
+    }
+    if (run_end) *run_end = e;
+    return r;
+}
+
+void attrspan_fill_begin(AttrSpans *s, int lo, int hi) {
+    if (!s) return;
+    attrspan_cover(s, lo, hi);
+    for (int r = lo; r < hi; r++)
+        row_stale(slot(s, r));
+    s->fill_lo = lo;
+    s->fill_hi = hi;
 }
 
 void attrspan_push(AttrSpans *s, int row, int col_start, int col_end,
                    const char *sgr, int priority) {
-    if (!s || !sgr || col_end <= col_start || row < 0)
+    if (!s || !sgr || col_end <= col_start || row < s->fill_lo ||
+        row >= s->fill_hi)
         return;
+    AttrRow *r = slot(s, row);
+    if (!r) return;
     AttrSpan span = {
         .row       = row,
         .col_start = col_start,
@@ -48,73 +204,52 @@ void attrspan_push(AttrSpans *s, int row, int col_start, int col_end,
         .sgr       = sgr,
         .priority  = priority,
     };
-    arrput(s->items, span);
-    s->sorted = 0;
-}
-
-static int span_cmp(const void *a, const void *b) {
-    const AttrSpan *x = a, *y = b;
-    if (x->row != y->row)               return x->row < y->row ? -1 : 1;
-    if (x->col_start != y->col_start)   return x->col_start < y->col_start ? -1 : 1;
-    if (x->priority != y->priority)     return x->priority > y->priority ? -1 : 1;
-    return 0;
-}
-
-void attrspan_sort(AttrSpans *s) {
-    if (!s || s->sorted) return;
-    size_t n = s->items ? (size_t)arrlen(s->items) : 0;
-    if (n > 1)
-        qsort(s->items, n, sizeof(AttrSpan), span_cmp);
-
-    /* Build the per-row index. Spans are sorted by row asc, so each
-     * row's spans occupy a contiguous range. */
-    attrspan_free_index(s);
-    if (n > 0) {
-        int max_row = 0;
-        for (size_t i = 0; i < n; i++)
-            if (s->items[i].row > max_row) max_row = s->items[i].row;
-        s->row_index_len = max_row + 1;
-        s->row_first = calloc((size_t)s->row_index_len, sizeof(int));
-        s->row_count = calloc((size_t)s->row_index_len, sizeof(int));
-        if (!s->row_first || !s->row_count) {
-            attrspan_free_index(s);
-        } else {
-            for (int r = 0; r < s->row_index_len; r++)
-                s->row_first[r] = -1;
-            for (size_t i = 0; i < n; i++) {
-                int r = s->items[i].row;
-                if (s->row_first[r] < 0) s->row_first[r] = (int)i;
-                s->row_count[r]++;
-            }
+    arrput(r->spans, span);
+}
+
+/* Order by (col_start asc, priority desc) so a left-to-right walk meets
+ * each span in render order and the highest-priority overlap wins by
+ * being seen first. Insertion sort: rows hold a handful of spans, and
+ * it keeps ties in insertion order. */
+static void sort_row(AttrSpan *v, int n) {
+    for (int i = 1; i < n; i++) {
+        AttrSpan x = v[i];
+        int j = i - 1;
+        while (j >= 0 && (v[j].col_start > x.col_start ||
+                          (v[j].col_start == x.col_start &&
+                           v[j].priority < x.priority))) {
+            v[j + 1] = v[j];
+            j--;
         }
+        v[j + 1] = x;
     }
-    s->sorted = 1;
 }
 
-const AttrSpan *attrspan_at(const AttrSpans *s, int row, int col) {
-    if (!s || !s->items) return NULL;
-    /* Fast path: row-indexed lookup after sort. */
-    if (s->sorted && s->row_first && row >= 0 && row < s->row_index_len) {
-        int first = s->row_first[row];
-        if (first < 0) return NULL;
-        int cnt = s->row_count[row];
-        const AttrSpan *best = NULL;
-        for (int i = first; i < first + cnt; i++) {
-            const AttrSpan *sp = &s->items[i];
-            if (sp->col_start > col) break;  /* sorted by col_start asc */
-            if (col >= sp->col_end) continue;
-            if (!best || sp->priority > best->priority)
-                best = sp;
-        }
-        return best;
+void attrspan_fill_end(AttrSpans *s) {
+    if (!s) return;
+    for (int r = s->fill_lo; r < s->fill_hi; r++) {
+        AttrRow *sl = slot(s, r);
+        if (!sl) continue;
+        sort_row(sl->spans, (int)arrlen(sl->spans));
+        sl->valid = 1;
     }
-    /* Pre-sort fallback. */
+    s->fill_lo = s->fill_hi = 0;
+}
+
+int attrspan_row_count(const AttrSpans *s, int row) {
+    const AttrRow *r = s ? slot(s, row) : NULL;
+    return r && r->valid ? (int)arrlen(r->spans) : 0;
+}
+
+const AttrSpan *attrspan_at(const AttrSpans *s, int row, int col) {
+    const AttrRow *r = s ? slot(s, row) : NULL;
+    if (!r || !r->valid) return NULL;
     const AttrSpan *best = NULL;
-    int n = (int)arrlen(s->items);
+    int n = (int)arrlen(r->spans);
     for (int i = 0; i < n; i++) {
-        const AttrSpan *sp = &s->items[i];
-        if (sp->row != row) continue;
-        if (col < sp->col_start || col >= sp->col_end) continue;
+        const AttrSpan *sp = &r->spans[i];
+        if (sp->col_start > col) break; /* sorted by col_start asc */
+        if (col >= sp->col_end) continue;
         if (!best || sp->priority > best->priority)
             best = sp;
     }
@@ -4,11 +4,30 @@
 /*
  * AttrSpan — attributed runs over buffer bytes, applied at render time.
  *
- * Phase-1 scaffolding for the renderer abstraction: each frame the
- * renderer fires HOOK_RENDER_PRE on every visible buffer, and any
- * highlighter plugin appends spans saying "bytes [col_start, col_end)
- * on this row carry this attribute." The renderer walks the row and
- * emits transitions; multiple plugins can stack overlays by priority.
+ * Phase-1 scaffolding for the renderer abstraction: highlighter plugins
+ * listen to HOOK_RENDER_PRE and append spans saying "bytes
+ * [col_start, col_end) on this row carry this attribute." The renderer
+ * walks the row and emits transitions; multiple plugins can stack
+ * overlays by priority.
+ *
+ * Spans are cached per row and survive across frames. The renderer
+ * only fires HOOK_RENDER_PRE for rows that are stale — edited, newly
+ * scrolled into view, or dropped by an invalidation — so a frame that
+ * just moves the cursor does no span work at all. Rows move with
+ * inserts/deletes (attrspan_apply_edit) instead of being recomputed.
+ * The cache covers a sliding window of at most ATTRSPAN_CACHE_ROWS rows
+ * around what windows show.
+ *
+ * Code that writes a row's `chars` directly, bypassing the row
+ * primitives and undo_record_replace(), must call
+ * buf_render_invalidate() for it too; otherwise the row keeps the spans
+ * of its old text.
+ *
+ * Producers whose output depends on more than the row's own text must
+ * say so: buf_render_invalidate() for rows of one buffer (tree-sitter
+ * after a reparse, a plugin whose state changed), or
+ * attrspan_invalidate_global() when the attribute mapping itself
+ * changes (theme switch).
  *
  * The attribute payload is a borrowed ANSI SGR string for now, so the
  * existing theme tokens (`COLOR_KEYWORD` and friends in lib/theme.h)
@@ -19,48 +38,80 @@
 #include <stddef.h>
 
 typedef struct Buffer Buffer;
+struct BufEditSpan;
+
+#define ATTRSPAN_CACHE_ROWS 1024
 
 typedef struct {
     int         row;        /* buffer row (file row index) */
     int         col_start;  /* inclusive, in chars-space byte offset */
     int         col_end;    /* exclusive */
-    const char *sgr;        /* borrowed; lifetime must outlive the frame */
+    const char *sgr;        /* borrowed; must outlive the cached row */
     int         priority;   /* higher wins on overlap; ties: insertion order */
 } AttrSpan;
 
 typedef struct {
-    AttrSpan *items;          /* stb_ds vector; NULL when empty */
-    int       sorted;         /* 1 once attrspan_sort has run for this frame */
-    /* Row index built by attrspan_sort: row_first[r] is the index of
-     * the first span on row r in `items`; row_count[r] is the count.
-     * Lets per-byte lookups skip straight to the row's spans instead
-     * of scanning the whole vector. Indexed by row 0..row_index_len. */
-    int      *row_first;
-    int      *row_count;
-    int       row_index_len;
+    AttrSpan *spans; /* stb_ds vector in render order; NULL when empty */
+    int       valid; /* producers have filled this row */
+} AttrRow;
+
+typedef struct {
+    AttrRow  *rows;     /* stb_ds; rows[i] caches buffer row base + i */
+    int       base;
+    /* Rows attrspan_push accepts: the range being filled right now.
+     * Empty outside attrspan_fill_begin/attrspan_fill_end. */
+    int       fill_lo, fill_hi;
+    unsigned  epoch;    /* attrspan_invalidate_global() generation */
+    char     *filetype; /* filetype the cached rows were produced for */
 } AttrSpans;
 
 /* Lifecycle. Called from buf_new / buf_close. */
 void attrspan_init(AttrSpans *s);
 void attrspan_free(AttrSpans *s);
 
-/* Drop every span in the table. Called by the renderer at the start of
- * each frame, before HOOK_RENDER_PRE fires. */
+/* Mark every cached row stale; storage is kept for the refill. */
 void attrspan_clear(AttrSpans *s);
 
-/* Append a span. Caller is responsible for ensuring `sgr` lives long
- * enough — same contract as VtMark.sgr. */
+/* Make every AttrSpans table stale on its next attrspan_sync(). For
+ * changes to what producers map text to, e.g. a theme switch. */
+void attrspan_invalidate_global(void);
+
+/* Bring the cache up to date before a frame: drop it all when the
+ * global generation or the filetype (which picks the producers)
+ * changed, then apply the pending row edits. */
+void attrspan_sync(AttrSpans *s, const char *filetype,
+                   const struct BufEditSpan *edits);
+
+/* Shift cached rows along with a BufEditSpan and mark its rows stale. */
+void attrspan_apply_edit(AttrSpans *s, const struct BufEditSpan *e);
+
+/* Slide the cache window so it holds rows [lo, hi), keeping whatever
+ * overlaps. Rows entering the window start stale. */
+void attrspan_cover(AttrSpans *s, int lo, int hi);
+
+/* First stale row in [from, to), with *run_end set one past the run of
+ * stale rows starting there. -1 when all are filled. Rows outside the
+ * window count as stale. */
+int attrspan_next_stale(const AttrSpans *s, int from, int to, int *run_end);
+
+/* Refill rows [lo, hi) (must be covered): their old spans are dropped
+ * and attrspan_push accepts spans for them until attrspan_fill_end(),
+ * which sorts them into render order and marks them filled. */
+void attrspan_fill_begin(AttrSpans *s, int lo, int hi);
+void attrspan_fill_end(AttrSpans *s);
+
+/* Append a span to a row being filled; anything else is ignored.
+ * Caller is responsible for ensuring `sgr` lives long enough — same
+ * contract as VtMark.sgr. */
 void attrspan_push(AttrSpans *s, int row, int col_start, int col_end,
                    const char *sgr, int priority);
 
-/* Stable-sort by (row asc, col_start asc, -priority desc) so that a
- * left-to-right walk meets each span in render order and the
- * highest-priority overlap wins by being seen first. */
-void attrspan_sort(AttrSpans *s);
+/* Number of cached spans on `row` (0 when stale or uncached). */
+int attrspan_row_count(const AttrSpans *s, int row);
 
 /* Find the span covering (row, col) with the highest priority among
- * those that match. Returns NULL if no span covers it. O(log n + k)
- * once `s` is sorted; otherwise linear. */
+ * those that match. Returns NULL if no span covers it. O(k) in the
+ * spans on that row. */
 const AttrSpan *attrspan_at(const AttrSpans *s, int row, int col);
 
 #endif /* HED_ATTRSPAN_H */
@@ -13,20 +13,29 @@
 void buf_row_insert_char_in(Buffer *buf, Row *row, int at, int c);
 
 char *buf_to_text(const Buffer *buf, size_t *out_len) {
+    return buf_rows_to_text(buf, 0, buf ? buf->num_rows : 0, out_len);
+}
+
+char *buf_rows_to_text(const Buffer *buf, int lo, int hi, size_t *out_len) {
     if (out_len)
         *out_len = 0;
     if (!buf)
         return NULL;
+    if (lo < 0)
+        lo = 0;
+    if (hi > buf->num_rows)
+        hi = buf->num_rows;
     size_t totlen = 0;
-    for (int j = 0; j < buf->num_rows; j++)
-        totlen += buf->rows[j].chars.len + 1;
+    for (int j = lo; j < hi; j++)
+        totlen += buf_row(buf, j)->chars.len + 1;
     char *out = malloc(totlen + 1);
     if (!out)
         return NULL;
     char *p = out;
-    for (int j = 0; j < buf->num_rows; j++) {
-        memcpy(p, buf->rows[j].chars.data, buf->rows[j].chars.len);
-        p += buf->rows[j].chars.len;
+    for (int j = lo; j < hi; j++) {
+        const Row *row = buf_row(buf, j);
+        memcpy(p, row->chars.data, row->chars.len);
+        p += row->chars.len;
         *p++ = '\n';
     }
     *p = '\0';
@@ -132,7 +141,7 @@ static int row_visual_height_buf(const Buffer *buf, int row_index,
         return 1;
     if (content_cols <= 0)
         return 1;
-    const Row *row = &buf->rows[row_index];
+    const Row *row = buf_row(buf, row_index);
     int rcols = buf_row_cx_to_rx(row, (int)row->chars.len);
     if (rcols <= 0)
         return 1;
@@ -157,7 +166,7 @@ static int cursor_visual_position(const Buffer *buf, const Window *win,
     for (int y = 0; y < cy; y++) {
         visual += row_visual_height_buf(buf, y, content_cols, 1);
     }
-    const Row *row = &buf->rows[cy];
+    const Row *row = buf_row(buf, cy);
     int rx = buf_row_cx_to_rx(row, win->cursor.x);
     if (rx < 0)
         rx = 0;
@@ -212,7 +221,7 @@ static void cursor_from_visual(Buffer *buf, Window *win, int target_visual,
             target_visual = 0;
     }
 
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int rcols = buf_row_cx_to_rx(row, (int)row->chars.len);
     if (rcols < 0)
         rcols = 0;
@@ -335,8 +344,8 @@ void buf_join_lines(void) {
         return;
 
     int y = win->cursor.y;
-    Row *current = &buf->rows[y];
-    Row *next = &buf->rows[y + 1];
+    Row *current = buf_row(buf, y);
+    Row *next = buf_row(buf, y + 1);
     if (!PTR_VALID(current) || !PTR_VALID(next))
         return;
 
@@ -370,9 +379,9 @@ void buf_move_line_up(void) {
     undo_begin(buf, "move line up");
     undo_record_replace(buf, win->cursor.y - 1);
     undo_record_replace(buf, win->cursor.y);
-    Row temp = buf->rows[win->cursor.y];
-    buf->rows[win->cursor.y] = buf->rows[win->cursor.y - 1];
-    buf->rows[win->cursor.y - 1] = temp;
+    Row temp = *buf_row(buf, win->cursor.y);
+    *buf_row(buf, win->cursor.y) = *buf_row(buf, win->cursor.y - 1);
+    *buf_row(buf, win->cursor.y - 1) = temp;
     win->cursor.y--;
     undo_end(buf);
     buf->dirty++;
@@ -385,9 +394,9 @@ void buf_move_line_down(void) {
     undo_begin(buf, "move line down");
     undo_record_replace(buf, win->cursor.y);
     undo_record_replace(buf, win->cursor.y + 1);
-    Row temp = buf->rows[win->cursor.y];
-    buf->rows[win->cursor.y] = buf->rows[win->cursor.y + 1];
-    buf->rows[win->cursor.y + 1] = temp;
+    Row temp = *buf_row(buf, win->cursor.y);
+    *buf_row(buf, win->cursor.y) = *buf_row(buf, win->cursor.y + 1);
+    *buf_row(buf, win->cursor.y + 1) = temp;
     win->cursor.y++;
     undo_end(buf);
     buf->dirty++;
@@ -406,7 +415,7 @@ void buf_indent_line(void) {
         return;
     }
 
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
 
     undo_record_replace(buf, win->cursor.y);
 
@@ -431,7 +440,7 @@ void buf_unindent_line(void) {
         return;
     }
 
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
 
     undo_record_replace(buf, win->cursor.y);
 
@@ -487,7 +496,7 @@ void buf_toggle_comment(void) {
     }
 
     int y = win->cursor.y;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int comment_len = strlen(comment);
 
     undo_record_replace(buf, y);
@@ -548,7 +557,7 @@ int buf_get_line_under_cursor(StrBuf *out) {
     TextSelection sel;
     if (!textobj_line(buf, win->cursor.y, win->cursor.x, &sel))
         return 0;
-    Row *row = &buf->rows[sel.start.line];
+    Row *row = buf_row(buf, sel.start.line);
     strbuf_free(out);
     *out = strbuf_from(row->chars.data + sel.start.col,
                      (size_t)(sel.end.col - sel.start.col));
@@ -568,7 +577,7 @@ int buf_word_view_under_cursor(StrView *out) {
         return 0;
     /* Vim <cword>: if the cursor sits on whitespace, use the next word on
      * the line (textobj_word would yield the blank run itself). */
-    Row *cur_row = &buf->rows[win->cursor.y];
+    Row *cur_row = buf_row(buf, win->cursor.y);
     int cx = win->cursor.x;
     if (cx >= (int)cur_row->chars.len)
         cx = (int)cur_row->chars.len - 1;
@@ -580,7 +589,7 @@ int buf_word_view_under_cursor(StrView *out) {
     TextSelection sel;
     if (!textobj_word(buf, win->cursor.y, cx, &sel))
         return 0;
-    Row *row = &buf->rows[sel.start.line];
+    Row *row = buf_row(buf, sel.start.line);
     *out = strview(row->chars.data + sel.start.col,
                    (size_t)(sel.end.col - sel.start.col));
     return 1;
@@ -683,7 +692,7 @@ int buf_get_path_under_cursor(StrBuf *out, int *out_line, int *out_col) {
     if (!BOUNDS_CHECK(win->cursor.y, buf->num_rows))
         return 0;
 
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     if (row->chars.len == 0)
         return 0;
 
@@ -748,7 +757,7 @@ int buf_get_paragraph_under_cursor(StrBuf *out) {
     strbuf_free(out);
     *out = strbuf_new();
     for (int y = sel.start.line; y <= sel.end.line; y++) {
-        Row *r = &buf->rows[y];
+        Row *r = buf_row(buf, y);
         int start_col = (y == sel.start.line) ? sel.start.col : 0;
         int end_col = (y == sel.end.line) ? sel.end.col : (int)r->chars.len;
         if (start_col < 0)
@@ -810,7 +819,7 @@ static void buf_delete_range(int sy, int sx, int ey, int ex) {
     if (sy == ey) {
         if (sy < 0 || sy >= buf->num_rows)
             return;
-        Row *row = &buf->rows[sy];
+        Row *row = buf_row(buf, sy);
         /* shift left */
         if (ex > (int)row->chars.len)
             ex = (int)row->chars.len;
@@ -827,7 +836,7 @@ static void buf_delete_range(int sy, int sx, int ey, int ex) {
         win->cursor.x = sx;
     } else {
         /* Delete part of first line */
-        Row *first = &buf->rows[sy];
+        Row *first = buf_row(buf, sy);
         if (sx > (int)first->chars.len)
             sx = (int)first->chars.len;
         undo_record_replace(buf, sy);
@@ -838,7 +847,7 @@ static void buf_delete_range(int sy, int sx, int ey, int ex) {
         for (int y = ey - 1; y > sy; y--)
             buf_row_del_in(buf, y);
         /* Delete prefix of last line and merge */
-        Row *last = &buf->rows[sy + 1];
+        Row *last = buf_row(buf, sy + 1);
         int lrx = ex;
         if (lrx < 0)
             lrx = 0;
@@ -870,7 +879,7 @@ void buf_delete_block(Buffer *buf, int sy, int ey, int start_rx,
     /* One undo group for the whole rectangle, so a single `u` restores it. */
     undo_begin(buf, "block delete");
     for (int y = sy; y <= ey; y++) {
-        Row *r = &buf->rows[y];
+        Row *r = buf_row(buf, y);
         int c0 = buf_row_rx_to_cx(r, start_rx);
         int c1 = buf_row_rx_to_cx(r, end_rx_excl);
         if (c0 > (int)r->chars.len) c0 = (int)r->chars.len;
@@ -902,8 +911,8 @@ void buf_delete_selection(TextSelection *sel) {
     if (sel->type == SEL_VISUAL_BLOCK) {
         int sy = sel->start.line, ey = sel->end.line;
         if (sy > ey) { int t = sy; sy = ey; ey = t; }
-        Row *r0 = (sy >= 0 && sy < buf->num_rows) ? &buf->rows[sy] : NULL;
-        Row *r1 = (ey >= 0 && ey < buf->num_rows) ? &buf->rows[ey] : NULL;
+        Row *r0 = (sy >= 0 && sy < buf->num_rows) ? buf_row(buf, sy) : NULL;
+        Row *r1 = (ey >= 0 && ey < buf->num_rows) ? buf_row(buf, ey) : NULL;
         int srx = r0 ? buf_row_cx_to_rx(r0, sel->start.col) : 0;
         int erx = r1 ? buf_row_cx_to_rx(r1, sel->end.col) : sel->end.col;
         buf_delete_block(buf, sy, ey, srx, erx);
@@ -922,7 +931,7 @@ void buf_delete_selection(TextSelection *sel) {
     int full_line_last = 0;
     if (!full_line_cross && sel->start.line == sel->end.line &&
         del_line >= 0 && del_line < buf->num_rows) {
-        int row_len = (int)buf->rows[del_line].chars.len;
+        int row_len = (int)buf_row(buf, del_line)->chars.len;
         full_line_last = (sel->start.col == 0 && sel->end.col == row_len);
     }
     if (full_line_cross || full_line_last) {
@@ -944,7 +953,7 @@ void buf_delete_selection(TextSelection *sel) {
     int cy = win->cursor.y;
     int cx = win->cursor.x;
     if (cy >= 0 && cy < buf->num_rows) {
-        Row *row = &buf->rows[cy];
+        Row *row = buf_row(buf, cy);
         if (cx > 0 && cx < (int)row->chars.len &&
             row->chars.data[cx] == ' ' && row->chars.data[cx - 1] == ' ') {
             undo_record_replace(buf, cy);
@@ -1012,7 +1021,7 @@ void buf_move_cursor_key(int key) {
     Buffer *buf = buf_cur();
     Window *win = window_cur();
     Row *row = (win->cursor.y >= 0 && win->cursor.y < buf->num_rows)
-                   ? &buf->rows[win->cursor.y]
+                   ? buf_row(buf, win->cursor.y)
                    : NULL;
     switch (key) {
     case KEY_ARROW_LEFT:
@@ -1027,7 +1036,7 @@ void buf_move_cursor_key(int key) {
                 win->cursor.x = idx;
             } else if (win->cursor.y > 0) {
                 win->cursor.y--;
-                win->cursor.x = (int)buf->rows[win->cursor.y].chars.len;
+                win->cursor.x = (int)buf_row(buf, win->cursor.y)->chars.len;
             }
         }
         break;
@@ -1133,7 +1142,7 @@ void buf_move_cursor_key(int key) {
         break;
     }
     row = (win->cursor.y >= 0 && win->cursor.y < buf->num_rows)
-              ? &buf->rows[win->cursor.y]
+              ? buf_row(buf, win->cursor.y)
               : NULL;
     int rowlen = row ? (int)row->chars.len : 0;
     if (win->cursor.x > rowlen)
@@ -1160,7 +1169,7 @@ void buf_find_matching_bracket(void) {
         return;
     }
 
-    Row *row = &buf->rows[buf->cursor->y];
+    Row *row = buf_row(buf, buf->cursor->y);
     if (buf->cursor->x >= (int)row->chars.len)
         return;
 
@@ -1195,7 +1204,7 @@ void buf_find_matching_bracket(void) {
 
     /* Search for matching bracket */
     while (y >= 0 && y < buf->num_rows) {
-        row = &buf->rows[y];
+        row = buf_row(buf, y);
 
         while ((direction == 1 && x < (int)row->chars.len) ||
                (direction == -1 && x >= 0)) {
@@ -1219,7 +1228,7 @@ void buf_find_matching_bracket(void) {
         if (direction == 1) {
             x = 0;
         } else if (y >= 0 && y < buf->num_rows) {
-            x = buf->rows[y].chars.len - 1;
+            x = buf_row(buf, y)->chars.len - 1;
         }
     }
 
@@ -1248,7 +1257,7 @@ void buf_select_line(void) {
         return;
     if (!BOUNDS_CHECK(win->cursor.y, buf->num_rows))
         return;
-    win->cursor.x = buf->rows[win->cursor.y].chars.len;
+    win->cursor.x = buf_row(buf, win->cursor.y)->chars.len;
 }
 
 void buf_select_all(void) {
@@ -1260,7 +1269,7 @@ void buf_select_all(void) {
     if (win->cursor.y < 0)
         win->cursor.y = 0;
     if (win->cursor.y < buf->num_rows)
-        win->cursor.x = buf->rows[win->cursor.y].chars.len;
+        win->cursor.x = buf_row(buf, win->cursor.y)->chars.len;
 }
 
 void buf_select_paragraph(void) {
@@ -1299,7 +1308,7 @@ EdError buf_insert_yank_data(Buffer *buf, int at_line, int at_col, const YankDat
     switch (yd->type) {
         case SEL_VISUAL: {
             /* Character-wise paste: inline at cursor */
-            Row *r = &buf->rows[at_line];
+            Row *r = buf_row(buf, at_line);
             int insert_col = at_col;
 
             if (after && insert_col < (int)r->chars.len) {
@@ -1373,7 +1382,7 @@ EdError buf_insert_yank_data(Buffer *buf, int at_line, int at_col, const YankDat
                     buf_row_insert_in(buf, buf->num_rows, "", 0);
                 }
 
-                Row *r = &buf->rows[target_line];
+                Row *r = buf_row(buf, target_line);
 
                 /* Pad line with spaces if needed */
                 if ((int)r->chars.len < insert_col) {
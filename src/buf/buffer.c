@@ -1,11 +1,14 @@
 #include "buf/buf_helpers.h"
 #include "buf/buffer.h"
+#include "buf/vislines.h"
 #include "fs/fs.h"
 #include "input/registers.h"
 #include "editor.h"
 #include "hooks.h"
 #include "terminal.h"
 #include "lib/log.h"
+#include "lib/regsearch.h"
+#include "lib/strsearch.h"
 #include "lib/strutil.h"
 #include "stb_ds.h"
 #include "utils/recent_files.h"
@@ -15,7 +18,7 @@
 #include "lib/safe_string.h"
 #include "utils/fold_methods.h"
 #include <assert.h>
-#include <regex.h>
+#include <limits.h>
 
 
 /* Internal low-level row helpers (not part of public API) */
@@ -47,7 +50,7 @@ int buf_find_by_filename(const char *filename) {
 static void buf_init(Buffer *buf) {
     if (!buf)
         return;
-    buf->rows = NULL;
+    rowtree_init(&buf->rows);
     buf->num_rows = 0;
     buf->all_cursors = NULL;
     buf->cursor = NULL;
@@ -72,6 +75,8 @@ static void buf_init(Buffer *buf) {
     undo_state_init(&buf->undo);
     vtext_init(buf);
     attrspan_init(&buf->render_spans);
+    buf_edit_span_clear(&buf->render_edits);
+    buf->vis_lines = NULL;
 }
 
 /* Create a new buffer and return EdError status */
@@ -117,6 +122,78 @@ EdError buf_new(const char *filename, int *out_idx) {
     return ED_OK;
 }
 
+/* Release the bulk-load arenas. Only safe once nothing borrows from
+ * them any more: rows cleared and undo history dropped. */
+static void buf_text_arenas_free(Buffer *buf) {
+    for (ptrdiff_t i = 0; i < arrlen(buf->text_arenas); i++)
+        free(buf->text_arenas[i]);
+    arrfree(buf->text_arenas);
+    buf->text_arenas = NULL;
+}
+
+/* Map the file, copy its lines back to back into one arena the rows
+ * borrow from, and lay the rows out with rowtree_append_n(): one
+ * allocation for the text instead of one or two per row. Line
+ * splitting matches fs_lines_next(): trailing '\r's are dropped. */
+EdError buf_rows_load_file(Buffer *buf, const char *path) {
+    FsMap m;
+    EdError err = fs_file_map(path, &m);
+    if (err != ED_OK)
+        return err;
+
+    const char *end = m.data + m.len;
+    size_t nlines = 0;
+    for (const char *p = m.data; p < end; nlines++) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+    }
+    if (nlines == 0) {
+        fs_file_unmap(&m);
+        return ED_OK;
+    }
+    if (nlines > INT_MAX) {
+        fs_file_unmap(&m);
+        return ED_ERR_NOMEM; /* rows are int-indexed */
+    }
+
+    /* Each line takes its length plus a NUL in place of the '\n', so
+     * the whole file fits in len + 1 bytes. */
+    char *arena = malloc(m.len + 1);
+    if (!arena || rowtree_append_n(&buf->rows, (int)nlines) != (int)nlines) {
+        free(arena);
+        rowtree_free(&buf->rows);
+        fs_file_unmap(&m);
+        return ED_ERR_NOMEM;
+    }
+    arrput(buf->text_arenas, arena);
+
+    const char *p = m.data;
+    char *dst = arena;
+    for (int i = 0; i < (int)nlines; i++) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t raw = (size_t)((nl ? nl : end) - p);
+        size_t len = raw;
+        memcpy(dst, p, raw);
+        while (len > 0 && dst[len - 1] == '\r')
+            len--;
+        dst[len] = '\0';
+
+        Row *row = buf_row(buf, i);
+        row->chars = (StrBuf){dst, len, 0};
+        if (memchr(dst, '\t', len))
+            buf_row_update(row);
+        else
+            row->render = row->chars; /* nothing to expand: share it */
+
+        dst += raw + 1;
+        p = nl ? nl + 1 : end;
+    }
+    buf->num_rows = buf->rows.count;
+    buf_note_edit(buf, 0, -1, 0);
+    fs_file_unmap(&m);
+    return ED_OK;
+}
+
 /* Opens a file and returns EdError status */
 EdError buf_open_file(const char *filename, Buffer **out) {
     if (!PTR_VALID(out))
@@ -130,19 +207,22 @@ EdError buf_open_file(const char *filename, Buffer **out) {
         return err;
     Buffer *buf = &E.buffers[idx];
 
-    FsLines *r = NULL;
-    if (fs_lines_open(&r, filename) != ED_OK) {
+    err = buf_rows_load_file(buf, filename);
+    if (err == ED_ERR_NOMEM) {
+        /* The file exists but didn't fit: keep the empty buffer from
+         * being written back over it. */
+        buf->readonly = 1;
+        ed_set_status_message("Cannot load %s: %s", filename,
+                              ed_error_string(err));
+        *out = buf;
+        return ED_OK;
+    }
+    if (err != ED_OK) {
         /* New file - this is OK, not an error */
         ed_set_status_message("New file: %s", filename);
         *out = buf;
         return ED_OK;
     }
-
-    const char *line;
-    size_t      linelen;
-    while (fs_lines_next(r, &line, &linelen))
-        buf_row_insert_in(buf, buf->num_rows, line, linelen);
-    fs_lines_close(r);
     buf->dirty = 0;
 
     recent_files_add(&E.recent_files, filename);
@@ -213,7 +293,7 @@ static void win_restore_cursor_from(Buffer *buf, Window *win) {
     int x = buf->cursor->x;
     if (y >= buf->num_rows) y = buf->num_rows > 0 ? buf->num_rows - 1 : 0;
     if (y < 0) y = 0;
-    int len = (y < buf->num_rows) ? (int)buf->rows[y].chars.len : 0;
+    int len = (y < buf->num_rows) ? (int)buf_row(buf, y)->chars.len : 0;
     if (x > len) x = len;
     if (x < 0) x = 0;
     win->cursor.y = y;
@@ -320,10 +400,7 @@ EdError buf_close(int index) {
     hook_fire_buffer(HOOK_BUFFER_CLOSE, &event);
 
     /* Free buffer resources */
-    for (int i = 0; i < buf->num_rows; i++) {
-        row_free(&buf->rows[i]);
-    }
-    free(buf->rows);
+    buf_rows_clear(buf);
     free(buf->filename);
     free(buf->title);
     free(buf->filetype);
@@ -344,6 +421,10 @@ EdError buf_close(int index) {
     buf->cursor_win_id = 0;
     fold_list_free(&buf->folds);
     undo_state_free(&buf->undo);
+    buf_text_arenas_free(buf);
+    vislines_free_all(buf);
+    arrfree(buf->edit_spans);
+    buf->edit_spans = NULL;
     vtext_free(buf);
     attrspan_free(&buf->render_spans);
 
@@ -660,8 +741,136 @@ static void cursors_after_delete_line(Buffer *buf, int iy) {
     cursors_shift_all(buf, shift_delete_line, iy, 0);
 }
 
+/* Text inserted at (iy, ix) spanning `rows` newlines and ending
+ * `last_len` bytes into its last row (or `last_len` bytes long when
+ * rows == 0). Needs more than cursors_shift_all's two ints, so it
+ * walks the same sets itself. */
+static void shift_insert_text(Cursor *c, int iy, int ix, int rows,
+                              int last_len) {
+    if (c->y > iy) {
+        c->y += rows;
+    } else if (c->y == iy && c->x >= ix) {
+        c->y += rows;
+        c->x = rows ? c->x - ix + last_len : c->x + last_len;
+    }
+}
+
+static void cursors_after_insert_text(Buffer *buf, int iy, int ix, int rows,
+                                      int last_len) {
+    for (ptrdiff_t i = 0; i < arrlen(buf->all_cursors); i++) {
+        Cursor *c = buf->all_cursors[i];
+        if (c == buf->cursor) continue;
+        shift_insert_text(c, iy, ix, rows, last_len);
+    }
+    for (ptrdiff_t s = 0; s < arrlen(buf->cursor_sets); s++) {
+        CursorVec v = buf->cursor_sets[s].cursors;
+        for (ptrdiff_t i = 0; i < arrlen(v); i++)
+            shift_insert_text(v[i], iy, ix, rows, last_len);
+    }
+}
+
 /*** Row operations ***/
 
+void buf_edit_span_clear(BufEditSpan *span) {
+    if (span)
+        memset(span, 0, sizeof(*span));
+}
+
+void buf_edit_span_attach(Buffer *buf, BufEditSpan *span) {
+    if (!buf || !span)
+        return;
+    buf_edit_span_clear(span);
+    for (ptrdiff_t i = 0; i < arrlen(buf->edit_spans); i++)
+        if (buf->edit_spans[i] == span)
+            return;
+    arrput(buf->edit_spans, span);
+}
+
+void buf_edit_span_detach(Buffer *buf, BufEditSpan *span) {
+    if (!buf)
+        return;
+    for (ptrdiff_t i = 0; i < arrlen(buf->edit_spans); i++) {
+        if (buf->edit_spans[i] == span) {
+            arrdel(buf->edit_spans, i);
+            return;
+        }
+    }
+}
+
+Buffer *buf_edit_span_owner(const BufEditSpan *span) {
+    if (!span)
+        return NULL;
+    for (ptrdiff_t i = 0; i < arrlen(E.buffers); i++) {
+        Buffer *buf = &E.buffers[i];
+        for (ptrdiff_t j = 0; j < arrlen(buf->edit_spans); j++)
+            if (buf->edit_spans[j] == span)
+                return buf;
+    }
+    return NULL;
+}
+
+static void edit_span_widen(BufEditSpan *s, int row, int old_rows,
+                            int new_rows) {
+    if (s->reset)
+        return;
+    int d = new_rows - old_rows;
+    if (!s->touched) {
+        s->touched = true;
+        s->lo = row;
+        s->hi = row + new_rows;
+        s->delta = d;
+        return;
+    }
+    /* Where the span's end lands after this edit: shifted when the
+     * edit sits wholly before it, else swallowed by the edit. */
+    int hi = row + old_rows <= s->hi ? s->hi + d : row + new_rows;
+    if (hi < row + new_rows)
+        hi = row + new_rows;
+    if (row < s->lo)
+        s->lo = row;
+    s->hi = hi;
+    s->delta += d;
+}
+
+void buf_note_edit(Buffer *buf, int row, int old_rows, int new_rows) {
+    if (!buf)
+        return;
+    for (ptrdiff_t i = 0; i < arrlen(buf->edit_spans); i++) {
+        BufEditSpan *s = buf->edit_spans[i];
+        if (old_rows < 0)
+            s->reset = true;
+        else
+            edit_span_widen(s, row, old_rows, new_rows);
+    }
+    if (old_rows < 0) {
+        buf->render_edits.touched = true;
+        buf->render_edits.reset = true;
+    } else {
+        edit_span_widen(&buf->render_edits, row, old_rows, new_rows);
+    }
+}
+
+void buf_render_invalidate(Buffer *buf, int lo, int hi) {
+    if (!buf)
+        return;
+    if (lo < 0)
+        lo = 0;
+    if (hi > buf->num_rows)
+        hi = buf->num_rows;
+    if (lo < hi)
+        edit_span_widen(&buf->render_edits, lo, hi - lo, hi - lo);
+}
+
+void buf_rows_clear(Buffer *buf) {
+    if (!buf)
+        return;
+    buf_note_edit(buf, 0, -1, 0);
+    for (int i = 0; i < buf->num_rows; i++)
+        row_free(buf_row(buf, i));
+    rowtree_free(&buf->rows);
+    buf->num_rows = 0;
+}
+
 /* Insert a row into a specific buffer (no window/state changes) */
 void buf_row_insert_in(Buffer *buf, int at, const char *s, size_t len) {
     if (!buf)
@@ -669,24 +878,23 @@ void buf_row_insert_in(Buffer *buf, int at, const char *s, size_t len) {
     if (at < 0 || at > buf->num_rows)
         return;
 
-    undo_record_insert(buf, at, s, len);
-
-    Row *new_rows = realloc(buf->rows, sizeof(Row) * (buf->num_rows + 1));
-    if (!new_rows) {
+    Row *row = rowtree_insert(&buf->rows, at);
+    if (!row) {
         ed_set_status_message("Out of memory");
         return;
     }
-    buf->rows = new_rows;
-    memmove(&buf->rows[at + 1], &buf->rows[at],
-            sizeof(Row) * (buf->num_rows - at));
+    buf->num_rows++;
+    buf_note_edit(buf, at, 0, 1);
+    /* Record after the slot exists so a failed insert leaves no
+     * phantom undo entry behind. */
+    undo_record_insert(buf, at, s, len);
 
-    buf->rows[at].chars = strbuf_from(s, len);
-    buf->rows[at].render = strbuf_new();
-    buf->rows[at].fold_start = false;
-    buf->rows[at].fold_end = false;
-    buf_row_update(&buf->rows[at]);
+    row->chars = strbuf_from(s, len);
+    row->render = strbuf_new();
+    row->fold_start = false;
+    row->fold_end = false;
+    buf_row_update(row);
 
-    buf->num_rows++;
     buf->dirty++;
 
     /* Fire hook */
@@ -699,19 +907,81 @@ void buf_row_del_in(Buffer *buf, int at) {
         return;
     if (!BOUNDS_CHECK(at, buf->num_rows))
         return;
-    undo_record_delete(buf, at, buf->rows[at].chars.data,
-                       buf->rows[at].chars.len);
-    row_free(&buf->rows[at]);
-    memmove(&buf->rows[at], &buf->rows[at + 1],
-            sizeof(Row) * (buf->num_rows - at - 1));
+    Row *row = buf_row(buf, at);
+    buf_note_edit(buf, at, 1, 0);
+    undo_record_delete(buf, at, row->chars.data, row->chars.len);
+    row_free(row);
+    rowtree_remove(&buf->rows, at);
     buf->num_rows--;
     buf->dirty++;
 }
 
+static bool row_equals(const Row *row, const char *s, size_t len) {
+    return row->chars.len == len && memcmp(row->chars.data, s, len) == 0;
+}
+
+EdError buf_rows_splice(Buffer *buf, int lo, int hi, const char *text,
+                        size_t len, int *out_rows) {
+    if (!PTR_VALID(buf))
+        return ED_ERR_BUFFER_INVALID;
+    if (lo < 0 || lo > hi || hi > buf->num_rows)
+        return ED_ERR_INVALID_INDEX;
+    if (!text)
+        len = 0;
+
+    /* Slice `text` into lines; empty text means no lines. */
+    StrView *lines = NULL; /* stb_ds */
+    for (size_t start = 0, i = 0; len > 0 && i <= len; i++) {
+        if (i < len && text[i] != '\n')
+            continue;
+        size_t n = i - start;
+        if (n && text[start + n - 1] == '\r')
+            n--;
+        arrput(lines, strview(text + start, n));
+        start = i + 1;
+    }
+    int n = (int)arrlen(lines);
+
+    /* Rows that already hold their new text are left alone. */
+    int pre = 0, suf = 0;
+    while (pre < n && lo + pre < hi &&
+           row_equals(buf_row(buf, lo + pre), lines[pre].data, lines[pre].len))
+        pre++;
+    while (suf < n - pre && hi - suf > lo + pre &&
+           row_equals(buf_row(buf, hi - 1 - suf), lines[n - 1 - suf].data,
+                      lines[n - 1 - suf].len))
+        suf++;
+
+    int at = lo + pre;
+    int old_n = hi - suf - at;
+    int new_n = n - pre - suf;
+    int common = old_n < new_n ? old_n : new_n;
+
+    /* Overlapping rows are rewritten in place; the rest are deleted or
+     * inserted after them. */
+    for (int k = 0; k < common; k++) {
+        undo_record_replace(buf, at + k);
+        Row *row = buf_row(buf, at + k);
+        strbuf_free(&row->chars);
+        row->chars = strbuf_from(lines[pre + k].data, lines[pre + k].len);
+        buf_row_update(row);
+        buf->dirty++;
+    }
+    for (int k = common; k < old_n; k++)
+        buf_row_del_in(buf, at + common);
+    for (int k = common; k < new_n; k++)
+        buf_row_insert_in(buf, at + k, lines[pre + k].data, lines[pre + k].len);
+
+    arrfree(lines);
+    if (out_rows)
+        *out_rows = n;
+    return ED_OK;
+}
+
 void buf_row_insert_char_in(Buffer *buf, Row *row, int at, int c) {
     if (!buf || !row)
         return;
-    undo_record_replace(buf, (int)(row - buf->rows));
+    undo_record_replace(buf, buf_row_index(buf, row));
     strbuf_insert_char(&row->chars, at, c);
     buf_row_update(row);
     buf->dirty++;
@@ -722,7 +992,7 @@ void buf_row_insert_char_in(Buffer *buf, Row *row, int at, int c) {
 void buf_row_append_in(Buffer *buf, Row *row, const StrBuf *str) {
     if (!buf || !row || !str)
         return;
-    undo_record_replace(buf, (int)(row - buf->rows));
+    undo_record_replace(buf, buf_row_index(buf, row));
     strbuf_append(&row->chars, str->data, str->len);
     buf_row_update(row);
     buf->dirty++;
@@ -733,7 +1003,7 @@ void buf_row_del_char_in(Buffer *buf, Row *row, int at) {
         return;
     if (at < 0 || at >= (int)row->chars.len)
         return;
-    undo_record_replace(buf, (int)(row - buf->rows));
+    undo_record_replace(buf, buf_row_index(buf, row));
     strbuf_delete_char(&row->chars, at);
     buf_row_update(row);
     buf->dirty++;
@@ -752,7 +1022,7 @@ void buf_insert_char_in(Buffer *buf, int c) {
     }
     int y0 = win->cursor.y;
     int x0 = win->cursor.x;
-    buf_row_insert_char_in(buf, &buf->rows[y0], x0, c);
+    buf_row_insert_char_in(buf, buf_row(buf, y0), x0, c);
     win->cursor.x = x0 + 1;
     buf_cursor_sync_from_window(buf);
     cursors_after_insert_char(buf, y0, x0);
@@ -771,7 +1041,7 @@ void buf_insert_newline_in(Buffer *buf) {
     if (x0 == 0) {
         buf_row_insert_in(buf, win->cursor.y, "", 0);
     } else {
-        Row *row = &buf->rows[y0];
+        Row *row = buf_row(buf, y0);
         const char *rest = row->chars.data + x0;
         size_t rest_len = row->chars.len - x0;
         /* Capture original row before split: row gets truncated to [0, x0)
@@ -779,7 +1049,7 @@ void buf_insert_newline_in(Buffer *buf) {
         undo_record_replace(buf, y0);
         buf_row_insert_in(buf, y0 + 1, rest, rest_len);
 
-        row = &buf->rows[y0];
+        row = buf_row(buf, y0);
         row->chars.len = x0;
         row->chars.data[row->chars.len] = '\0';
         buf_row_update(row);
@@ -795,6 +1065,66 @@ void buf_insert_newline_in(Buffer *buf) {
     cursors_after_insert_newline(buf, y0, x0);
 }
 
+void buf_insert_text_in(Buffer *buf, const char *text, size_t len) {
+    Window *win = window_cur();
+    if (!buf || !win || !text || len == 0)
+        return;
+    if (buf->readonly) {
+        ed_set_status_message("Buffer is read-only");
+        return;
+    }
+    if (win->cursor.y >= buf->num_rows) {
+        win->cursor.y = buf->num_rows;
+        buf_row_insert_in(buf, buf->num_rows, "", 0);
+    }
+    int y0 = win->cursor.y;
+    Row *row = buf_row(buf, y0);
+    int x0 = win->cursor.x;
+    if (x0 < 0) x0 = 0;
+    if (x0 > (int)row->chars.len) x0 = (int)row->chars.len;
+
+    /* Split the cursor row once: [0, x0) + first line, the middle lines
+     * as rows of their own, then the last line + the old tail. */
+    undo_record_replace(buf, y0);
+    StrBuf tail = strbuf_from(row->chars.data + x0, row->chars.len - (size_t)x0);
+    const char *nl = memchr(text, '\n', len);
+    size_t first = nl ? (size_t)(nl - text) : len;
+    row->chars.len = (size_t)x0;
+    if (row->chars.data)
+        row->chars.data[x0] = '\0';
+    strbuf_append(&row->chars, text, first);
+
+    int y = y0;
+    size_t last_len = first;
+    if (nl) {
+        buf_row_update(row);
+        size_t pos = first + 1;
+        for (;;) {
+            const char *e = memchr(text + pos, '\n', len - pos);
+            if (!e)
+                break;
+            size_t n = (size_t)(e - (text + pos));
+            buf_row_insert_in(buf, ++y, text + pos, n);
+            pos += n + 1;
+        }
+        last_len = len - pos;
+        StrBuf last = strbuf_from(text + pos, last_len);
+        strbuf_append(&last, tail.data, tail.len);
+        buf_row_insert_in(buf, ++y, last.data, last.len);
+        strbuf_free(&last);
+    } else {
+        strbuf_append(&row->chars, tail.data, tail.len);
+        buf_row_update(row);
+    }
+    strbuf_free(&tail);
+    buf->dirty++;
+
+    win->cursor.y = y;
+    win->cursor.x = (y == y0 ? x0 : 0) + (int)last_len;
+    buf_cursor_sync_from_window(buf);
+    cursors_after_insert_text(buf, y0, x0, y - y0, (int)last_len);
+}
+
 void buf_del_char_in(Buffer *buf) {
     Window *win = window_cur();
     if (!buf || !win)
@@ -810,7 +1140,7 @@ void buf_del_char_in(Buffer *buf) {
 
     int y = win->cursor.y;
     int x = win->cursor.x;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     if (x > 0) {
         int deleted_char =
             (x - 1 < (int)row->chars.len) ? row->chars.data[x - 1] : 0;
@@ -824,9 +1154,9 @@ void buf_del_char_in(Buffer *buf) {
         buf_cursor_sync_from_window(buf);
         cursors_after_delete_char(buf, y, x - 1);
     } else {
-        int prev_len = buf->rows[y - 1].chars.len;
+        int prev_len = buf_row(buf, y - 1)->chars.len;
         win->cursor.x = prev_len;
-        buf_row_append_in(buf, &buf->rows[y - 1], &row->chars);
+        buf_row_append_in(buf, buf_row(buf, y - 1), &row->chars);
         buf_row_del_in(buf, y);
         win->cursor.y = y - 1;
         buf_cursor_sync_from_window(buf);
@@ -847,13 +1177,13 @@ void buf_delete_line_in(Buffer *buf) {
 
     /* Update registers: numbered delete and unnamed. A whole-line delete
      * is linewise, so `p` re-opens it as a new line (matches Vim dd/p). */
-    regs_push_delete_typed(buf->rows[win->cursor.y].chars.data,
-                           buf->rows[win->cursor.y].chars.len, REG_LINEWISE);
+    regs_push_delete_typed(buf_row(buf, win->cursor.y)->chars.data,
+                           buf_row(buf, win->cursor.y)->chars.len, REG_LINEWISE);
 
     /* Fire hook before deletion */
     HookLineEvent event = {buf, win->cursor.y,
-                           buf->rows[win->cursor.y].chars.data,
-                           buf->rows[win->cursor.y].chars.len};
+                           buf_row(buf, win->cursor.y)->chars.data,
+                           buf_row(buf, win->cursor.y)->chars.len};
     hook_fire_line(HOOK_LINE_DELETE, &event);
 
     int deleted_y = win->cursor.y;
@@ -879,73 +1209,134 @@ void buf_yank_line_in(Buffer *buf) {
 
 /*** Search ***/
 
-void buf_find_in(Buffer *buf) {
+int buf_search_next(const Buffer *buf, const StrSearch *ss, int y, int x,
+                    int dir, TextPos *out) {
+    if (!buf || buf->num_rows == 0 || ss->len == 0) return 0;
+    int rows = buf->num_rows;
+    if (y < 0) y = 0;
+    if (y >= rows) y = rows - 1;
+
+    /* i == rows comes back to the start row for the part before
+     * (forward) or after (backward) the start column. */
+    for (int i = 0; i <= rows; i++) {
+        int        ry  = dir > 0 ? (y + i) % rows : ((y - i) % rows + rows) % rows;
+        const Row *row = buf_row(buf, ry);
+        size_t     n   = row->chars.len;
+        ptrdiff_t  hit;
+        if (dir > 0) {
+            size_t from = i == 0 ? (size_t)(x < 0 ? 0 : x) : 0;
+            hit = strsearch_find(ss, row->chars.data, n, from);
+        } else {
+            if (i == 0 && x < 0) continue;
+            size_t upto = i == 0 ? (size_t)x : n;
+            hit = strsearch_rfind(ss, row->chars.data, n, upto);
+        }
+        if (hit >= 0) {
+            out->line = ry;
+            out->col  = (int)hit;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int buf_search_all(const Buffer *buf, const StrSearch *ss, TextPos **out) {
+    int count = 0;
+    if (!buf || ss->len == 0) return 0;
+    for (int y = 0; y < buf->num_rows; y++) {
+        const Row *row = buf_row(buf, y);
+        size_t     from = 0;
+        ptrdiff_t  hit;
+        while ((hit = strsearch_find(ss, row->chars.data, row->chars.len,
+                                     from)) >= 0) {
+            TextPos p = { y, (int)hit };
+            arrput(*out, p);
+            count++;
+            from = (size_t)hit + ss->len;
+        }
+    }
+    return count;
+}
+
+int buf_regex_next(const Buffer *buf, RegSearch *rs, int y, int x, int dir,
+                   TextPos *out) {
+    if (!buf || buf->num_rows == 0) return 0;
+    int rows = buf->num_rows;
+    if (y < 0) y = 0;
+    if (y >= rows) y = rows - 1;
+
+    for (int i = 0; i <= rows; i++) {
+        int        ry  = dir > 0 ? (y + i) % rows : ((y - i) % rows + rows) % rows;
+        const Row *row = buf_row(buf, ry);
+        size_t     n   = row->chars.len, so, eo;
+        bool       hit;
+        if (dir > 0) {
+            size_t from = i == 0 ? (size_t)(x < 0 ? 0 : x) : 0;
+            hit = regsearch_find(rs, row->chars.data, n, from, &so, &eo);
+        } else {
+            if (i == 0 && x < 0) continue;
+            size_t upto = i == 0 ? (size_t)x : n;
+            hit = regsearch_rfind(rs, row->chars.data, n, upto, &so, &eo);
+        }
+        if (hit) {
+            out->line = ry;
+            out->col  = (int)so;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void buf_find_dir(Buffer *buf, int dir) {
     if (!buf)
         return;
     if (E.search_query.len == 0)
         return;
+    if (buf->num_rows == 0)
+        return;
 
     Window *win = window_cur();
-    int start_y = win ? win->cursor.y : 0;
-    int current = start_y;
+    int cy = win ? win->cursor.y : 0;
+    int cx = win ? win->cursor.x : 0;
 
     int use_regex = E.search_is_regex;
-    regex_t regex;
-    int regex_ready = 0;
+    TextPos hit;
+    int found = 0;
     if (use_regex) {
-        int rc = regcomp(&regex, E.search_query.data, REG_EXTENDED);
-        if (rc != 0) {
-            char errbuf[128];
-            regerror(rc, &regex, errbuf, sizeof(errbuf));
-            ed_set_status_message("Regex error: %s", errbuf);
+        char       err[128];
+        RegSearch *rs = regsearch_get(E.search_query.data, E.search_icase != 0,
+                                      err, sizeof(err));
+        if (!rs) {
+            ed_set_status_message("Regex error: %s", err);
             return;
         }
-        regex_ready = 1;
+        found = buf_regex_next(buf, rs, cy, dir > 0 ? cx + 1 : cx - 1, dir,
+                               &hit);
+    } else {
+        StrSearch ss;
+        strsearch_init(&ss, E.search_query.data, E.search_query.len,
+                       E.search_icase);
+        found = buf_search_next(buf, &ss, cy, dir > 0 ? cx + 1 : cx - 1,
+                                dir, &hit);
     }
 
-    for (int i = 0; i < buf->num_rows; i++) {
-        current = (start_y + i + 1) % buf->num_rows;
-        Row *row = &buf->rows[current];
-        const char *render = row->render.data;
-        const char *match = NULL;
-        int rx = 0;
-
-        if (regex_ready) {
-            regmatch_t m;
-            if (regexec(&regex, render, 1, &m, 0) == 0 && m.rm_so >= 0) {
-                match = render + m.rm_so;
-                rx = (int)m.rm_so;
-            }
-        } else {
-            const char *lit = strstr(render, E.search_query.data);
-            if (lit) {
-                match = lit;
-                rx = (int)(lit - render);
-            }
-        }
-
-        if (match) {
-            if (win) {
-                win->cursor.y = current;
-                win->cursor.x = buf_row_rx_to_cx(row, rx);
-            }
-            Window *cur = window_cur();
-            if (cur)
-                cur->row_offset = buf->num_rows;
-            if (regex_ready)
-                regfree(&regex);
-            ed_set_status_message("Found%s at line %d",
-                                  use_regex ? " (regex)" : "", current + 1);
-            return;
+    if (found) {
+        if (win) {
+            win->cursor.y = hit.line;
+            win->cursor.x = hit.col;
+            win->row_offset = buf->num_rows;
         }
+        ed_set_status_message("Found%s at line %d",
+                              use_regex ? " (regex)" : "", hit.line + 1);
+        return;
     }
-
-    if (regex_ready)
-        regfree(&regex);
     ed_set_status_message("Not found%s: %s", use_regex ? " (regex)" : "",
                           E.search_query.data);
 }
 
+void buf_find_in(Buffer *buf) { buf_find_dir(buf, 1); }
+void buf_find_prev_in(Buffer *buf) { buf_find_dir(buf, -1); }
+
 /* Reload current buffer's file from disk, discarding unsaved changes */
 void buf_reload(Buffer *buf) {
     if (!buf || !buf->filename) {
@@ -953,12 +1344,7 @@ void buf_reload(Buffer *buf) {
         return;
     }
     /* Clear existing rows */
-    for (int i = 0; i < buf->num_rows; i++) {
-        row_free(&buf->rows[i]);
-    }
-    free(buf->rows);
-    buf->rows = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
     /* reset scroll will be handled by window */
     buf->cursor->x = 0;
     buf->cursor->y = 0;
@@ -967,9 +1353,11 @@ void buf_reload(Buffer *buf) {
     fold_list_free(&buf->folds);
     fold_list_init(&buf->folds);
 
-    /* Drop undo history — rows are about to be replaced wholesale. */
+    /* Drop undo history — rows are about to be replaced wholesale. The
+     * undofile restores it below if the file is still the saved text. */
     undo_state_free(&buf->undo);
     undo_state_init(&buf->undo);
+    buf_text_arenas_free(buf);
 
     /* Drop virtual-text marks — they pin to line indices that the
      * about-to-be-replaced content may not have. */
@@ -979,17 +1367,12 @@ void buf_reload(Buffer *buf) {
     free(buf->filetype);
     buf->filetype = fs_path_detect_filetype(buf->filename);
 
-    FsLines *r = NULL;
-    if (fs_lines_open(&r, buf->filename) != ED_OK) {
+    if (buf_rows_load_file(buf, buf->filename) != ED_OK) {
         ed_set_status_message("reload: cannot open %s", buf->filename);
         buf->dirty = 0;
         return;
     }
-    const char *line;
-    size_t      len;
-    while (fs_lines_next(r, &line, &len))
-        buf_row_insert_in(buf, buf->num_rows, line, len);
-    fs_lines_close(r);
     buf->dirty = 0;
+    undo_file_attach(buf);
     ed_set_status_message("reloaded: %s", buf->filename);
 }
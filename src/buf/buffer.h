@@ -10,6 +10,7 @@
 #include "lib/errors.h"
 #include "buf/attrspan.h"
 #include "buf/row.h"
+#include "buf/rowtree.h"
 #include "buf/virtual_text.h"
 #include "utils/fold.h"
 #include "utils/undo.h"
@@ -26,10 +27,32 @@ typedef struct CursorSet {
     Cursor *active;   /* points into cursors */
 } CursorSet;
 
+/* Rows changed since a consumer last looked. Incremental consumers
+ * (tree-sitter, …) attach one with buf_edit_span_attach() and every
+ * row mutation widens all attached spans. [lo, hi) is in current row
+ * numbering and covers every touched row; `delta` is the net number of
+ * rows inserted inside it, so before the edits the same region was
+ * hi - lo - delta rows long. `reset` means the content was replaced
+ * wholesale (load, reload, clear) and nothing carries over. */
+typedef struct BufEditSpan {
+    bool touched;
+    bool reset;
+    int  lo, hi;
+    int  delta;
+} BufEditSpan;
+
 /* Buffer structure - represents a single file/document */
 typedef struct Buffer {
-    Row *rows;
+    /* Line storage. Reach rows through buf_row(); num_rows mirrors
+     * rows.count and is kept in step by the buf_row_* mutators. */
+    RowTree rows;
     int num_rows;
+    /* Backing storage of bulk-loaded files (stb_ds array of malloc'd
+     * blocks). Only a row's chars and render may borrow into these —
+     * see StrBuf; undo records copy their bytes — so they are released
+     * only once every row is gone (buffer free or reload). */
+    char **text_arenas;
+    BufEditSpan **edit_spans; /* attached consumers (stb_ds array) */
     /* all_cursors holds every cursor (incl. the active one) as heap-
      * allocated entries, so plugins/collab layers can keep stable
      * Cursor* refs. cursor points to one element of all_cursors.data.
@@ -65,14 +88,64 @@ typedef struct Buffer {
 
     VtTable vtext; /* Virtual text annotations (display-only) */
 
-    /* Per-frame attribute spans, populated by HOOK_RENDER_PRE handlers
-     * and consumed by the renderer. Cleared at the start of each frame. */
+    /* Attribute spans cached per row, filled by HOOK_RENDER_PRE
+     * handlers and consumed by the renderer. render_edits collects the
+     * rows changed or invalidated since the last frame; the renderer
+     * folds it into render_spans before refilling stale rows. */
     AttrSpans render_spans;
+    BufEditSpan render_edits;
+
+    /* Screen-row indexes by wrap width (buf/vislines.h); stb_ds array
+     * of owned pointers. */
+    struct VisLines **vis_lines;
 } Buffer;
 
 /* Buffer management */
 Buffer *buf_cur(void);
 
+/* Row `i` of `buf` (NULL when out of range). O(1) for sequential
+ * access, O(log n) otherwise. The pointer is valid until the next row
+ * insert/delete on this buffer. */
+static inline Row *buf_row(const Buffer *buf, int i) {
+    return rowtree_at((RowTree *)&buf->rows, i);
+}
+
+/* Index of a Row obtained from buf_row(), or -1. */
+static inline int buf_row_index(const Buffer *buf, const Row *row) {
+    return rowtree_index_of((RowTree *)&buf->rows, row);
+}
+
+/* Free every row and empty the line store. Records no undo and fires
+ * no hooks — for buffers about to be refilled wholesale (reload,
+ * generated views like quickfix or dired). Leaves dirty untouched. */
+void buf_rows_clear(Buffer *buf);
+
+/* Start (or stop) feeding row edits into `span`, which the caller owns
+ * and must detach before freeing. Attaching clears it. */
+void buf_edit_span_attach(Buffer *buf, BufEditSpan *span);
+void buf_edit_span_detach(Buffer *buf, BufEditSpan *span);
+void buf_edit_span_clear(BufEditSpan *span);
+
+/* The open buffer `span` is attached to, or NULL. */
+Buffer *buf_edit_span_owner(const BufEditSpan *span);
+
+/* Record that the `old_rows` rows at `row` are about to become
+ * `new_rows` rows (1/1 for an in-place change). Called by the row
+ * primitives and undo_record_replace(), so callers that mutate rows
+ * through those never need to. old_rows < 0 marks a wholesale reset. */
+void buf_note_edit(Buffer *buf, int row, int old_rows, int new_rows);
+
+/* Drop the cached render spans of rows [lo, hi) so HOOK_RENDER_PRE
+ * runs for them again on the next frame. For highlighters whose output
+ * changed without the rows themselves changing. */
+void buf_render_invalidate(Buffer *buf, int lo, int hi);
+
+/* Fill an empty buffer with the lines of `path` in one pass. Like
+ * buf_rows_clear() this records no undo and fires no per-line hooks;
+ * fire HOOK_BUFFER_OPEN afterwards if plugins should see the content.
+ * Leaves dirty untouched. */
+EdError buf_rows_load_file(Buffer *buf, const char *path);
+
 /* Buffer creation and management - all return EdError */
 EdError buf_new(const char *filename, int *out_idx);
 
@@ -98,10 +171,16 @@ void buf_prev(void);
 void buf_open_or_switch(const char *filename, bool add_to_jumplist); /* Open file or switch to it if already open */
 void buf_insert_char_in(Buffer *buf, int c);
 void buf_insert_newline_in(Buffer *buf);
+/* Insert `text` at the cursor as one edit: '\n' splits rows, every other
+ * byte is taken literally. The cursor ends up after the text. */
+void buf_insert_text_in(Buffer *buf, const char *text, size_t len);
 void buf_del_char_in(Buffer *buf);
 void buf_delete_line_in(Buffer *buf);
 void buf_yank_line_in(Buffer *buf);
+/* Jump to the next / previous match of E.search_query from the cursor,
+ * wrapping around the buffer. */
 void buf_find_in(Buffer *buf);
+void buf_find_prev_in(Buffer *buf);
 /* Reload this buffer's file content from disk (discard changes) */
 void buf_reload(Buffer *buf);
 
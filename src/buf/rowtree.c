@@ -0,0 +1,446 @@
+#include "buf/rowtree.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct RowTreeInner RowTreeInner;
+
+/* Common header; `leaf` says which of the two layouts follows. */
+struct RowTreeNode {
+    RowTreeInner *parent;
+    int           count; /* rows in this subtree */
+    int           n;     /* rows (leaf) or children (inner) in use */
+    bool          leaf;
+};
+
+struct RowTreeLeaf {
+    RowTreeNode  h;
+    RowTreeLeaf *prev, *next; /* in-order leaf chain */
+    Row          rows[ROWTREE_LEAF_MAX];
+};
+
+struct RowTreeInner {
+    RowTreeNode  h;
+    RowTreeNode *kids[ROWTREE_FANOUT];
+};
+
+/* Deepest split chain a single insert can trigger: one node per level
+ * plus a new root. 16 levels of fanout 32 is far beyond INT_MAX rows. */
+#define ROWTREE_MAX_SPLITS 16
+
+typedef struct {
+    RowTreeInner *inner[ROWTREE_MAX_SPLITS];
+    int           n;
+} InnerPool;
+
+static RowTreeLeaf *leaf_new(void) {
+    RowTreeLeaf *l = calloc(1, sizeof(*l));
+    if (l)
+        l->h.leaf = true;
+    return l;
+}
+
+static int child_slot(const RowTreeInner *p, const RowTreeNode *k) {
+    for (int i = 0; i < p->h.n; i++)
+        if (p->kids[i] == k)
+            return i;
+    return -1;
+}
+
+static void add_count(RowTreeNode *n, int delta) {
+    for (; n; n = (RowTreeNode *)n->parent)
+        n->count += delta;
+}
+
+static int sum_kids(const RowTreeInner *p) {
+    int c = 0;
+    for (int i = 0; i < p->h.n; i++)
+        c += p->kids[i]->count;
+    return c;
+}
+
+static void recount_up(RowTreeNode *n) {
+    for (RowTreeInner *p = n->parent; p; p = p->h.parent)
+        p->h.count = sum_kids(p);
+}
+
+static void node_free(RowTreeNode *n) {
+    if (!n)
+        return;
+    if (!n->leaf) {
+        RowTreeInner *p = (RowTreeInner *)n;
+        for (int i = 0; i < p->h.n; i++)
+            node_free(p->kids[i]);
+    }
+    free(n);
+}
+
+void rowtree_init(RowTree *t) {
+    if (!t)
+        return;
+    memset(t, 0, sizeof(*t));
+}
+
+void rowtree_free(RowTree *t) {
+    if (!t)
+        return;
+    node_free(t->root);
+    rowtree_init(t);
+}
+
+/* Descend to the leaf holding row `i`. With `for_insert`, `i` may be
+ * one past a subtree's end, which lands at the end of that subtree
+ * (appending to the left leaf rather than prepending to the right). */
+static RowTreeLeaf *find_leaf(const RowTree *t, int i, int *start,
+                              bool for_insert) {
+    RowTreeNode *n = t->root;
+    int base = 0;
+    while (n && !n->leaf) {
+        RowTreeInner *p = (RowTreeInner *)n;
+        int k = 0;
+        for (; k < p->h.n - 1; k++) {
+            int c = p->kids[k]->count;
+            if (i < c || (for_insert && i == c))
+                break;
+            i -= c;
+            base += c;
+        }
+        n = p->kids[k];
+    }
+    *start = base;
+    return (RowTreeLeaf *)n;
+}
+
+Row *rowtree_at(RowTree *t, int i) {
+    if (!t || i < 0 || i >= t->count)
+        return NULL;
+    RowTreeLeaf *l = t->hint;
+    if (l) {
+        int off = i - t->hint_start;
+        if (off >= 0 && off < l->h.n)
+            return &l->rows[off];
+        /* Sequential scans step into a neighbouring leaf. */
+        if (off >= l->h.n && l->next && off < l->h.n + l->next->h.n) {
+            t->hint_start += l->h.n;
+            t->hint = l->next;
+            return &t->hint->rows[off - l->h.n];
+        }
+        if (off < 0 && l->prev && off >= -l->prev->h.n) {
+            t->hint_start -= l->prev->h.n;
+            t->hint = l->prev;
+            return &t->hint->rows[off + l->prev->h.n];
+        }
+    }
+    int start;
+    l = find_leaf(t, i, &start, false);
+    t->hint = l;
+    t->hint_start = start;
+    return &l->rows[i - start];
+}
+
+/* Reserve every node a split starting at `leaf` may need, so a failed
+ * allocation leaves the tree untouched instead of half-split. */
+static bool pool_fill(InnerPool *pool, const RowTreeLeaf *leaf) {
+    pool->n = 0;
+    const RowTreeInner *p = leaf->h.parent;
+    int need = 1; /* the leaf's parent gains a child, or a root appears */
+    while (p && p->h.n == ROWTREE_FANOUT) {
+        need++;
+        p = p->h.parent;
+    }
+    for (int i = 0; i < need && i < ROWTREE_MAX_SPLITS; i++) {
+        pool->inner[i] = calloc(1, sizeof(RowTreeInner));
+        if (!pool->inner[i]) {
+            while (i-- > 0)
+                free(pool->inner[i]);
+            return false;
+        }
+        pool->n++;
+    }
+    return true;
+}
+
+static void pool_release(InnerPool *pool) {
+    while (pool->n > 0)
+        free(pool->inner[--pool->n]);
+}
+
+static RowTreeInner *pool_take(InnerPool *pool) {
+    return pool->n > 0 ? pool->inner[--pool->n] : NULL;
+}
+
+static void attach(RowTree *t, RowTreeNode *left, RowTreeNode *right,
+                   InnerPool *pool);
+
+/* Move the upper half of `p`'s children into a fresh sibling and hook
+ * that sibling in next to `p`. */
+static RowTreeInner *split_inner(RowTree *t, RowTreeInner *p,
+                                 InnerPool *pool) {
+    RowTreeInner *q = pool_take(pool);
+    int half = p->h.n / 2;
+    q->h.n = p->h.n - half;
+    memcpy(q->kids, &p->kids[half], (size_t)q->h.n * sizeof(*q->kids));
+    p->h.n = half;
+    for (int i = 0; i < q->h.n; i++)
+        q->kids[i]->parent = q;
+    p->h.count = sum_kids(p);
+    q->h.count = sum_kids(q);
+    attach(t, &p->h, &q->h, pool);
+    return q;
+}
+
+/* Insert `right` as the sibling immediately after `left`. Counts above
+ * the two nodes are fixed up by the caller via recount_up(). */
+static void attach(RowTree *t, RowTreeNode *left, RowTreeNode *right,
+                   InnerPool *pool) {
+    RowTreeInner *p = left->parent;
+    if (!p) {
+        RowTreeInner *root = pool_take(pool);
+        root->kids[0] = left;
+        root->kids[1] = right;
+        root->h.n = 2;
+        root->h.count = left->count + right->count;
+        left->parent = right->parent = root;
+        t->root = &root->h;
+        return;
+    }
+    if (p->h.n == ROWTREE_FANOUT) {
+        RowTreeInner *q = split_inner(t, p, pool);
+        if (child_slot(p, left) < 0)
+            p = q;
+    }
+    int k = child_slot(p, left);
+    memmove(&p->kids[k + 2], &p->kids[k + 1],
+            (size_t)(p->h.n - k - 1) * sizeof(*p->kids));
+    p->kids[k + 1] = right;
+    right->parent = p;
+    p->h.n++;
+}
+
+/* Split `l` after its first `keep` rows. */
+static RowTreeLeaf *split_leaf(RowTree *t, RowTreeLeaf *l, int keep) {
+    InnerPool pool;
+    RowTreeLeaf *r = leaf_new();
+    if (!r)
+        return NULL;
+    if (!pool_fill(&pool, l)) {
+        free(r);
+        return NULL;
+    }
+    r->h.n = l->h.n - keep;
+    memcpy(r->rows, &l->rows[keep], (size_t)r->h.n * sizeof(Row));
+    l->h.n = keep;
+    l->h.count = keep;
+    r->h.count = r->h.n;
+
+    r->prev = l;
+    r->next = l->next;
+    if (l->next)
+        l->next->prev = r;
+    l->next = r;
+
+    attach(t, &l->h, &r->h, &pool);
+    recount_up(&l->h);
+    recount_up(&r->h);
+    pool_release(&pool);
+    t->hint = NULL;
+    return r;
+}
+
+Row *rowtree_insert(RowTree *t, int at) {
+    if (!t || at < 0 || at > t->count)
+        return NULL;
+    if (!t->root) {
+        RowTreeLeaf *l = leaf_new();
+        if (!l)
+            return NULL;
+        t->root = &l->h;
+    }
+    int start;
+    RowTreeLeaf *l = find_leaf(t, at, &start, true);
+    int off = at - start;
+    if (l->h.n == ROWTREE_LEAF_MAX) {
+        /* Appending past the last row (file load, `G o`) starts a fresh
+         * leaf instead of halving a full one, so the tree packs densely. */
+        int keep = (off == l->h.n && !l->next) ? l->h.n : l->h.n / 2;
+        RowTreeLeaf *r = split_leaf(t, l, keep);
+        if (!r)
+            return NULL;
+        if (off > l->h.n || l->h.n == ROWTREE_LEAF_MAX) {
+            off -= l->h.n;
+            start += l->h.n;
+            l = r;
+        }
+    }
+    memmove(&l->rows[off + 1], &l->rows[off],
+            (size_t)(l->h.n - off) * sizeof(Row));
+    memset(&l->rows[off], 0, sizeof(Row));
+    l->h.n++;
+    add_count(&l->h, 1);
+    t->count++;
+    t->hint = l;
+    t->hint_start = start;
+    return &l->rows[off];
+}
+
+int rowtree_append_n(RowTree *t, int n) {
+    if (!t || n <= 0)
+        return 0;
+    if (t->root) {
+        int i = 0;
+        while (i < n && rowtree_insert(t, t->count))
+            i++;
+        return i;
+    }
+
+    int cnt = (n + ROWTREE_LEAF_MAX - 1) / ROWTREE_LEAF_MAX;
+    RowTreeNode **level = malloc((size_t)cnt * sizeof(*level));
+    if (!level)
+        return 0;
+    RowTreeLeaf *prev = NULL;
+    for (int i = 0; i < cnt; i++) {
+        RowTreeLeaf *l = leaf_new();
+        if (!l) {
+            while (i-- > 0)
+                free(level[i]);
+            free(level);
+            return 0;
+        }
+        l->h.n = l->h.count = (i == cnt - 1)
+                                  ? n - i * ROWTREE_LEAF_MAX
+                                  : ROWTREE_LEAF_MAX;
+        l->prev = prev;
+        if (prev)
+            prev->next = l;
+        prev = l;
+        level[i] = &l->h;
+    }
+
+    /* Each pass folds up to FANOUT nodes of `level` under one parent,
+     * writing the parents back over the front of the same array. */
+    while (cnt > 1) {
+        int parents = (cnt + ROWTREE_FANOUT - 1) / ROWTREE_FANOUT;
+        for (int j = 0; j < parents; j++) {
+            RowTreeInner *p = calloc(1, sizeof(*p));
+            if (!p) {
+                for (int k = 0; k < j; k++)
+                    node_free(level[k]);
+                for (int k = j * ROWTREE_FANOUT; k < cnt; k++)
+                    node_free(level[k]);
+                free(level);
+                return 0;
+            }
+            int first = j * ROWTREE_FANOUT;
+            int last = first + ROWTREE_FANOUT < cnt ? first + ROWTREE_FANOUT
+                                                    : cnt;
+            for (int k = first; k < last; k++) {
+                p->kids[k - first] = level[k];
+                level[k]->parent = p;
+            }
+            p->h.n = last - first;
+            p->h.count = sum_kids(p);
+            level[j] = &p->h;
+        }
+        cnt = parents;
+    }
+    t->root = level[0];
+    free(level);
+    t->count = n;
+    t->hint = NULL;
+    return n;
+}
+
+/* Unhook an empty node from its parent, cascading up through parents
+ * it leaves empty, then drop root levels with a single child. */
+static void detach(RowTree *t, RowTreeNode *n) {
+    RowTreeInner *p = n->parent;
+    if (n->leaf) {
+        RowTreeLeaf *l = (RowTreeLeaf *)n;
+        if (l->prev)
+            l->prev->next = l->next;
+        if (l->next)
+            l->next->prev = l->prev;
+    }
+    if (!p) {
+        free(n);
+        t->root = NULL;
+        return;
+    }
+    int k = child_slot(p, n);
+    free(n);
+    memmove(&p->kids[k], &p->kids[k + 1],
+            (size_t)(p->h.n - k - 1) * sizeof(*p->kids));
+    p->h.n--;
+    if (p->h.n == 0) {
+        detach(t, &p->h);
+        return;
+    }
+    while (t->root && !t->root->leaf && t->root->n == 1) {
+        RowTreeInner *old = (RowTreeInner *)t->root;
+        t->root = old->kids[0];
+        t->root->parent = NULL;
+        free(old);
+    }
+}
+
+/* Fold a sparse leaf into a sibling under the same parent so bulk
+ * deletes don't leave a long tail of near-empty leaves behind. */
+static void maybe_merge(RowTree *t, RowTreeLeaf *l) {
+    RowTreeLeaf *a = l, *b = l->next;
+    if (!b || b->h.parent != l->h.parent) {
+        a = l->prev;
+        b = l;
+    }
+    if (!a || a->h.parent != b->h.parent)
+        return;
+    if (a->h.n + b->h.n > ROWTREE_LEAF_MAX / 2)
+        return;
+    memcpy(&a->rows[a->h.n], b->rows, (size_t)b->h.n * sizeof(Row));
+    a->h.n += b->h.n;
+    a->h.count = a->h.n;
+    b->h.n = b->h.count = 0;
+    detach(t, &b->h);
+}
+
+void rowtree_remove(RowTree *t, int at) {
+    if (!t || at < 0 || at >= t->count)
+        return;
+    int start;
+    RowTreeLeaf *l = find_leaf(t, at, &start, false);
+    int off = at - start;
+    memmove(&l->rows[off], &l->rows[off + 1],
+            (size_t)(l->h.n - off - 1) * sizeof(Row));
+    l->h.n--;
+    add_count(&l->h, -1);
+    t->count--;
+    t->hint = NULL;
+    if (l->h.n == 0)
+        detach(t, &l->h);
+    else if (l->h.n < ROWTREE_LEAF_MAX / 4)
+        maybe_merge(t, l);
+    else {
+        t->hint = l;
+        t->hint_start = start;
+    }
+}
+
+int rowtree_index_of(RowTree *t, const Row *row) {
+    if (!t || !row || !t->root)
+        return -1;
+    RowTreeLeaf *l = t->hint;
+    if (l && row >= l->rows && row < l->rows + l->h.n)
+        return t->hint_start + (int)(row - l->rows);
+    RowTreeNode *n = t->root;
+    while (!n->leaf)
+        n = ((RowTreeInner *)n)->kids[0];
+    int base = 0;
+    for (l = (RowTreeLeaf *)n; l; l = l->next) {
+        if (row >= l->rows && row < l->rows + l->h.n) {
+            t->hint = l;
+            t->hint_start = base;
+            return base + (int)(row - l->rows);
+        }
+        base += l->h.n;
+    }
+    return -1;
+}
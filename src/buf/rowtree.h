@@ -0,0 +1,62 @@
+#ifndef HED_ROWTREE_H
+#define HED_ROWTREE_H
+
+/*
+ * RowTree — the line store behind Buffer.
+ *
+ * A counted B+-tree: leaves hold up to ROWTREE_LEAF_MAX Row structs
+ * inline, inner nodes hold up to ROWTREE_FANOUT children and the row
+ * count of each subtree. Finding, inserting or removing row `i` walks
+ * one root-to-leaf path, so line insert/delete is O(log n) instead of
+ * the memmove over the whole row array the flat `Row *rows` needed.
+ *
+ * The tree only owns its nodes, never the Row contents: callers fill
+ * the slot rowtree_insert() hands back and row_free() a row before
+ * rowtree_remove()s it. Row pointers are valid until the next insert
+ * or remove on the same tree (same contract the realloc'd array had).
+ *
+ * Lookups remember the last leaf they landed on, so the common
+ * `for (i = 0; i < num_rows; i++) buf_row(buf, i)` scan costs O(1)
+ * per step instead of a fresh descent.
+ */
+
+#include "buf/row.h"
+
+#define ROWTREE_LEAF_MAX 128
+#define ROWTREE_FANOUT   32
+
+typedef struct RowTreeNode RowTreeNode;
+typedef struct RowTreeLeaf RowTreeLeaf;
+
+typedef struct {
+    RowTreeNode *root;
+    int          count;      /* total rows */
+    RowTreeLeaf *hint;       /* last leaf a lookup landed on */
+    int          hint_start; /* row index of hint->rows[0] */
+} RowTree;
+
+void rowtree_init(RowTree *t);
+
+/* Release every node. Row contents are NOT freed — see header. */
+void rowtree_free(RowTree *t);
+
+/* Row `i`, or NULL when out of range. */
+Row *rowtree_at(RowTree *t, int i);
+
+/* Open a zeroed slot at index `at` (0..count) and return it. NULL on
+ * a bad index or allocation failure. */
+Row *rowtree_insert(RowTree *t, int at);
+
+/* Open `n` zeroed slots at the end; returns how many were added. On
+ * an empty tree the leaves are laid out packed and the inner levels
+ * built bottom-up in one go, which is what file loading uses. Reach
+ * the new rows with rowtree_at(); walking them in order is O(1) each. */
+int rowtree_append_n(RowTree *t, int n);
+
+/* Drop slot `at`. The caller must already have released its Row. */
+void rowtree_remove(RowTree *t, int at);
+
+/* Index of a Row pointer previously obtained from this tree, or -1. */
+int rowtree_index_of(RowTree *t, const Row *row);
+
+#endif /* HED_ROWTREE_H */
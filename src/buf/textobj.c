@@ -217,7 +217,7 @@ static int find_next_word(Buffer *buf, int line, int col, int *out_line,
     if (start_line < 0)
         return 0;
     for (int y = start_line; y < buf->num_rows; y++) {
-        Row *row = &buf->rows[y];
+        Row *row = buf_row(buf, y);
         int start_col = (y == start_line) ? col : 0;
         if (start_col > (int)row->chars.len)
             start_col = (int)row->chars.len;
@@ -241,7 +241,7 @@ static int find_prev_word(Buffer *buf, int line, int col, int *out_line,
     if (start_line < 0)
         return 0;
     for (int y = start_line; y >= 0; y--) {
-        Row *row = &buf->rows[y];
+        Row *row = buf_row(buf, y);
         int start_col = (y == start_line) ? col : (int)row->chars.len;
         if (start_col > (int)row->chars.len)
             start_col = (int)row->chars.len;
@@ -348,7 +348,7 @@ static int find_next_WORD(Buffer *buf, int line, int col, int *out_line,
     if (start_line < 0)
         return 0;
     for (int y = start_line; y < buf->num_rows; y++) {
-        Row *row = &buf->rows[y];
+        Row *row = buf_row(buf, y);
         int start_col = (y == start_line) ? col : 0;
         if (start_col > (int)row->chars.len)
             start_col = (int)row->chars.len;
@@ -372,7 +372,7 @@ static int find_prev_WORD(Buffer *buf, int line, int col, int *out_line,
     if (start_line < 0)
         return 0;
     for (int y = start_line; y >= 0; y--) {
-        Row *row = &buf->rows[y];
+        Row *row = buf_row(buf, y);
         int start_col = (y == start_line) ? col : (int)row->chars.len;
         if (start_col > (int)row->chars.len)
             start_col = (int)row->chars.len;
@@ -397,7 +397,7 @@ static int paragraph_range(Buffer *buf, int line, int *out_sy, int *out_ey) {
 
     int sy = y;
     while (sy > 0) {
-        const Row *prev = &buf->rows[sy - 1];
+        const Row *prev = buf_row(buf, sy - 1);
         if (is_blank_row(prev))
             break;
         sy--;
@@ -405,7 +405,7 @@ static int paragraph_range(Buffer *buf, int line, int *out_sy, int *out_ey) {
 
     int ey = y;
     while (ey + 1 < buf->num_rows) {
-        const Row *next = &buf->rows[ey + 1];
+        const Row *next = buf_row(buf, ey + 1);
         if (is_blank_row(next))
             break;
         ey++;
@@ -474,7 +474,7 @@ static int find_enclosing_pair(Buffer *buf, int line, int col, char open,
     int cur_y = clamp_line(buf, line);
     if (cur_y < 0)
         return 0;
-    const Row *cur_row = &buf->rows[cur_y];
+    const Row *cur_row = buf_row(buf, cur_y);
     if (cur_row->chars.len == 0)
         return 0;
     int cur_x = clamp_col(cur_row, col);
@@ -485,7 +485,7 @@ static int find_enclosing_pair(Buffer *buf, int line, int col, char open,
     int by = -1, bx = -1, found_open = 0;
     if (open == close) {
         for (int y = cur_y; y >= 0 && !found_open; y--) {
-            const Row *row = &buf->rows[y];
+            const Row *row = buf_row(buf, y);
             int startx = (y == cur_y) ? cur_x : (int)row->chars.len - 1;
             if (startx >= (int)row->chars.len)
                 startx = (int)row->chars.len - 1;
@@ -501,7 +501,7 @@ static int find_enclosing_pair(Buffer *buf, int line, int col, char open,
     } else {
         int depth = 0;
         for (int y = cur_y; y >= 0 && !found_open; y--) {
-            const Row *row = &buf->rows[y];
+            const Row *row = buf_row(buf, y);
             int startx = (y == cur_y) ? cur_x : (int)row->chars.len - 1;
             if (startx >= (int)row->chars.len)
                 startx = (int)row->chars.len - 1;
@@ -534,7 +534,7 @@ static int find_enclosing_pair(Buffer *buf, int line, int col, char open,
     int fy = -1, fx = -1, found_close = 0;
     if (open == close) {
         for (int y = by; y < buf->num_rows && !found_close; y++) {
-            const Row *row = &buf->rows[y];
+            const Row *row = buf_row(buf, y);
             int startx = (y == by) ? (bx + 1) : 0;
             for (int x = startx; x < (int)row->chars.len; x++) {
                 if (row->chars.data[x] == close && is_unescaped_quote(row, x)) {
@@ -548,7 +548,7 @@ static int find_enclosing_pair(Buffer *buf, int line, int col, char open,
     } else {
         int depth = 0;
         for (int y = by; y < buf->num_rows && !found_close; y++) {
-            const Row *row = &buf->rows[y];
+            const Row *row = buf_row(buf, y);
             int startx = (y == by) ? (bx + 1) : 0;
             for (int x = startx; x < (int)row->chars.len; x++) {
                 char c = row->chars.data[x];
@@ -586,14 +586,14 @@ static int brackets_select(Buffer *buf, int line, int col, char open,
         TextPos start = {oy, ox};
         TextPos end = {cy, cx + 1};
         TextPos cursor = {clamp_line(buf, line),
-                          clamp_col(&buf->rows[clamp_line(buf, line)], col)};
+                          clamp_col(buf_row(buf, clamp_line(buf, line)), col)};
         return set_selection(sel, start, end, cursor);
     }
 
     TextPos start = {oy, ox + 1};
     TextPos end = {cy, cx};
     TextPos cursor = {clamp_line(buf, line),
-                      clamp_col(&buf->rows[clamp_line(buf, line)], col)};
+                      clamp_col(buf_row(buf, clamp_line(buf, line)), col)};
     return set_selection(sel, start, end, cursor);
 }
 
@@ -603,7 +603,7 @@ int textobj_word(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int sx = 0, ex = 0;
     if (!word_range_at(row, x, &sx, &ex))
@@ -616,7 +616,7 @@ int textobj_word_around(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     const char *s = row->chars.data;
     int len = (int)row->chars.len;
@@ -658,7 +658,7 @@ int textobj_WORD(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int sx = 0, ex = 0;
     if (!WORD_range_at(row, x, &sx, &ex))
@@ -671,7 +671,7 @@ int textobj_WORD_around(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     const char *s = row->chars.data;
     int len = (int)row->chars.len;
@@ -713,7 +713,7 @@ int textobj_line(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int len = (int)row->chars.len;
     TextPos cursor = {y, x};
@@ -726,7 +726,7 @@ int textobj_brackets(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     if (!row || row->chars.len == 0)
         return 0;
     int x = clamp_col(row, col);
@@ -780,7 +780,7 @@ int textobj_to_word_end(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int sx = 0, ex = 0;
     int target_line = y;
@@ -792,7 +792,7 @@ int textobj_to_word_end(Buffer *buf, int line, int col, TextSelection *sel) {
         if (x >= ex - 1) {
             if (!find_next_word(buf, y, ex, &target_line, &sx, &ex))
                 return 0;
-            row = &buf->rows[target_line];
+            row = buf_row(buf, target_line);
             start_col = sx;
         } else {
             if (start_col < sx)
@@ -803,7 +803,7 @@ int textobj_to_word_end(Buffer *buf, int line, int col, TextSelection *sel) {
     } else {
         if (!find_next_word(buf, y, x, &target_line, &sx, &ex))
             return 0;
-        row = &buf->rows[target_line];
+        row = buf_row(buf, target_line);
         start_col = sx;
     }
 
@@ -819,7 +819,7 @@ int textobj_to_word_start(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int orig_x = clamp_col(row, col);
     int sx = 0, ex = 0;
     int target_line = y;
@@ -830,12 +830,12 @@ int textobj_to_word_start(Buffer *buf, int line, int col, TextSelection *sel) {
         if (orig_x == sx) {
             if (!find_prev_word(buf, y, sx, &target_line, &sx, &ex))
                 return 0;
-            row = &buf->rows[target_line];
+            row = buf_row(buf, target_line);
         }
     } else {
         if (!find_prev_word(buf, y, orig_x, &target_line, &sx, &ex))
             return 0;
-        row = &buf->rows[target_line];
+        row = buf_row(buf, target_line);
     }
 
     int row_len = (int)row->chars.len;
@@ -863,7 +863,7 @@ int textobj_to_WORD_end(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int sx = 0, ex = 0;
     int target_line = y;
@@ -875,7 +875,7 @@ int textobj_to_WORD_end(Buffer *buf, int line, int col, TextSelection *sel) {
         if (x >= ex - 1) {
             if (!find_next_WORD(buf, y, ex, &target_line, &sx, &ex))
                 return 0;
-            row = &buf->rows[target_line];
+            row = buf_row(buf, target_line);
             start_col = sx;
         } else {
             if (start_col < sx)
@@ -886,7 +886,7 @@ int textobj_to_WORD_end(Buffer *buf, int line, int col, TextSelection *sel) {
     } else {
         if (!find_next_WORD(buf, y, x, &target_line, &sx, &ex))
             return 0;
-        row = &buf->rows[target_line];
+        row = buf_row(buf, target_line);
         start_col = sx;
     }
 
@@ -902,7 +902,7 @@ int textobj_to_WORD_start(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int orig_x = clamp_col(row, col);
     int sx = 0, ex = 0;
     int target_line = y;
@@ -913,12 +913,12 @@ int textobj_to_WORD_start(Buffer *buf, int line, int col, TextSelection *sel) {
         if (orig_x == sx) {
             if (!find_prev_WORD(buf, y, sx, &target_line, &sx, &ex))
                 return 0;
-            row = &buf->rows[target_line];
+            row = buf_row(buf, target_line);
         }
     } else {
         if (!find_prev_WORD(buf, y, orig_x, &target_line, &sx, &ex))
             return 0;
-        row = &buf->rows[target_line];
+        row = buf_row(buf, target_line);
     }
 
     int row_len = (int)row->chars.len;
@@ -946,7 +946,7 @@ int textobj_to_line_end(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int len = (int)row->chars.len;
     if (x > len)
@@ -960,7 +960,7 @@ int textobj_to_line_start(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int end_col = x;
     if (end_col < (int)row->chars.len)
@@ -975,10 +975,10 @@ int textobj_to_file_end(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int last_y = buf->num_rows - 1;
-    Row *last = &buf->rows[last_y];
+    Row *last = buf_row(buf, last_y);
     int last_len = (int)last->chars.len;
     int cursor_col = (last_len > 0) ? (last_len - 1) : 0;
     TextPos cursor = {last_y, cursor_col};
@@ -992,7 +992,7 @@ int textobj_to_file_start(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int end_col = x;
     if (end_col < (int)row->chars.len)
@@ -1013,7 +1013,7 @@ int textobj_to_paragraph_end(Buffer *buf, int line, int col,
     /* If already at the end of this paragraph, advance to the next one */
     if (y >= ey) {
         int search = ey + 1;
-        while (search < buf->num_rows && is_blank_row(&buf->rows[search]))
+        while (search < buf->num_rows && is_blank_row(buf_row(buf, search)))
             search++;
         if (search >= buf->num_rows)
             return 0; /* no next paragraph */
@@ -1024,13 +1024,13 @@ int textobj_to_paragraph_end(Buffer *buf, int line, int col,
         ey = next_ey;
     }
 
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
-    Row *end_row = &buf->rows[ey];
+    Row *end_row = buf_row(buf, ey);
     int end_line = ey;
     int end_col = (int)end_row->chars.len;
     int cursor_col = (end_col > 0) ? (end_col - 1) : 0;
-    if (ey + 1 < buf->num_rows && is_blank_row(&buf->rows[ey + 1])) {
+    if (ey + 1 < buf->num_rows && is_blank_row(buf_row(buf, ey + 1))) {
         end_line = ey + 1;
         end_col = 0;
         cursor_col = (int)end_row->chars.len;
@@ -1052,9 +1052,9 @@ int textobj_to_paragraph_start(Buffer *buf, int line, int col,
     /* If already at the start of this paragraph, retreat to the previous one */
     if (y <= sy && sy > 0) {
         int search = sy - 1;
-        while (search > 0 && is_blank_row(&buf->rows[search]))
+        while (search > 0 && is_blank_row(buf_row(buf, search)))
             search--;
-        if (search < 0 || is_blank_row(&buf->rows[search]))
+        if (search < 0 || is_blank_row(buf_row(buf, search)))
             return 0; /* no previous paragraph */
         int prev_sy = 0, prev_ey = 0;
         if (!paragraph_range(buf, search, &prev_sy, &prev_ey))
@@ -1063,7 +1063,7 @@ int textobj_to_paragraph_start(Buffer *buf, int line, int col,
         ey = prev_ey;
     }
 
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
     int end_col = x;
     if (end_col < (int)row->chars.len)
@@ -1081,11 +1081,11 @@ int textobj_paragraph(Buffer *buf, int line, int col, TextSelection *sel) {
     if (!paragraph_range(buf, y, &sy, &ey))
         return 0;
     (void)col;
-    Row *end_row = &buf->rows[ey];
+    Row *end_row = buf_row(buf, ey);
     int end_line = ey;
     int end_col = (int)end_row->chars.len;
     int cursor_col = (end_col > 0) ? (end_col - 1) : 0;
-    if (ey + 1 < buf->num_rows && is_blank_row(&buf->rows[ey + 1])) {
+    if (ey + 1 < buf->num_rows && is_blank_row(buf_row(buf, ey + 1))) {
         end_line = ey + 1;
         end_col = 0;
         cursor_col = (int)end_row->chars.len;
@@ -1105,7 +1105,7 @@ int textobj_char_at_cursor(Buffer *buf, int line, int col, TextSelection *sel) {
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
 
     /* Nothing to delete if at or past end of line */
@@ -1135,7 +1135,7 @@ int textobj_line_with_newline(Buffer *buf, int line, int col,
     int y = clamp_line(buf, line);
     if (y < 0)
         return 0;
-    Row *row = &buf->rows[y];
+    Row *row = buf_row(buf, y);
     int x = clamp_col(row, col);
 
     TextPos cursor = {y, x};
@@ -1178,7 +1178,7 @@ int textobj_char_right(Buffer *buf, int line, int col, TextSelection *sel) {
     if (!buf || line < 0 || line >= buf->num_rows)
         return 0;
 
-    Row *row = &buf->rows[line];
+    Row *row = buf_row(buf, line);
     int new_col = utf8_next_cp(row->chars.data, (int)row->chars.len, col);
 
     /* If at end of line, move to start of next line */
@@ -1209,13 +1209,13 @@ int textobj_char_left(Buffer *buf, int line, int col, TextSelection *sel) {
     if (!buf || line < 0 || line >= buf->num_rows)
         return 0;
 
-    Row *row = &buf->rows[line];
+    Row *row = buf_row(buf, line);
     int new_col = utf8_prev_cp(row->chars.data, (int)row->chars.len, col);
 
     /* If at start of line, move to end of previous line */
     if (new_col < 0) {
         if (line > 0) {
-            Row *prev_row = &buf->rows[line - 1];
+            Row *prev_row = buf_row(buf, line - 1);
             sel->cursor.line = line - 1;
             sel->cursor.col = prev_row->chars.len;
         } else {
@@ -1249,7 +1249,7 @@ int textobj_line_down(Buffer *buf, int line, int col, TextSelection *sel) {
     }
 
     /* Keep column position, clamping to line length */
-    Row *new_row = &buf->rows[new_line];
+    Row *new_row = buf_row(buf, new_line);
     int new_col = col;
     if (new_col > (int)new_row->chars.len) {
         new_col = new_row->chars.len;
@@ -1278,7 +1278,7 @@ int textobj_line_up(Buffer *buf, int line, int col, TextSelection *sel) {
     }
 
     /* Keep column position, clamping to line length */
-    Row *new_row = &buf->rows[new_line];
+    Row *new_row = buf_row(buf, new_line);
     int new_col = col;
     if (new_col > (int)new_row->chars.len) {
         new_col = new_row->chars.len;
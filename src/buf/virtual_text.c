@@ -9,8 +9,9 @@
 
 /* Namespace registry�� process-wide, tiny, never removed. */
 typedef struct {
-    char *name;
-    int   auto_clear;   /* 1 = clear marks on edit (default); 0 = persist */
+    char    *name;
+    int      auto_clear;   /* 1 = clear marks on edit (default); 0 = persist */
+    VtFillFn fill;         /* set for lazy namespaces */
 } VtNs;
 
 static VtNs *g_ns = NULL;
@@ -37,16 +38,57 @@ static int vtext_ns_auto_clear(int ns) {
     return g_ns[ns].auto_clear;
 }
 
+int vtext_ns_set_fill(int ns, VtFillFn fill) {
+    if (ns < 0 || ns >= (int)arrlen(g_ns)) return -1;
+    g_ns[ns].fill = fill;
+    return 0;
+}
+
+/* The buffer's record for lazy `ns`, created empty. */
+static VtLazyRange *lazy_range(Buffer *b, int ns) {
+    for (ptrdiff_t i = 0; i < arrlen(b->vtext.lazy); i++)
+        if (b->vtext.lazy[i].ns_id == ns) return &b->vtext.lazy[i];
+    VtLazyRange r = {.ns_id = ns};
+    arrput(b->vtext.lazy, r);
+    return &arrlast(b->vtext.lazy);
+}
+
+/* Forget what was materialized, so the next frame refills. */
+static void lazy_forget(Buffer *b, int ns) {
+    for (ptrdiff_t i = 0; i < arrlen(b->vtext.lazy); i++) {
+        if (ns < 0 || b->vtext.lazy[i].ns_id == ns)
+            b->vtext.lazy[i].lo = b->vtext.lazy[i].hi = 0;
+    }
+}
+
+/* Free and remove mark i. Block-below marks change line heights, so
+ * their removal bumps block_seq for the visual-line indexes. */
+static void mark_drop(Buffer *b, ptrdiff_t i) {
+    VtMark *m = &b->vtext.marks[i];
+    if (m->place == VT_PLACE_BLOCK_BELOW)
+        b->vtext.block_seq++;
+    strbuf_free(&m->text);
+    arrdel(b->vtext.marks, i);
+}
+
 /* Drop every mark whose namespace has auto_clear=1. Marks owned by
  * persistent namespaces (e.g. copilot ghost text) survive. */
 static int vtext_clear_auto(Buffer *b) {
     if (!b) return 0;
     int dropped = 0;
+    /* Lazy auto-clear namespaces stay empty until their owner has
+     * fresh data; refilling from the old data would put it back. */
+    for (ptrdiff_t i = 0; i < arrlen(b->vtext.lazy); i++) {
+        VtLazyRange *r = &b->vtext.lazy[i];
+        if (vtext_ns_auto_clear(r->ns_id)) {
+            r->lo = r->hi = 0;
+            r->held = 1;
+        }
+    }
     for (ptrdiff_t i = arrlen(b->vtext.marks) - 1; i >= 0; i--) {
         VtMark *m = &b->vtext.marks[i];
         if (vtext_ns_auto_clear(m->ns_id)) {
-            strbuf_free(&m->text);
-            arrdel(b->vtext.marks, i);
+            mark_drop(b, i);
             dropped++;
         }
     }
@@ -56,6 +98,8 @@ static int vtext_clear_auto(Buffer *b) {
 void vtext_init(Buffer *b) {
     if (!b) return;
     b->vtext.marks = NULL;
+    b->vtext.block_seq = 0;
+    b->vtext.lazy = NULL;
     vtext_hooks_install_once();
 }
 
@@ -66,6 +110,40 @@ void vtext_free(Buffer *b) {
     }
     arrfree(b->vtext.marks);
     b->vtext.marks = NULL;
+    arrfree(b->vtext.lazy);
+    b->vtext.lazy = NULL;
+}
+
+void vtext_materialize(Buffer *b, int lo, int hi) {
+    if (!b || lo >= hi) return;
+    for (ptrdiff_t n = 0; n < arrlen(g_ns); n++) {
+        if (!g_ns[n].fill) continue;
+        VtLazyRange *r = lazy_range(b, (int)n);
+        if (r->held || (r->lo <= lo && hi <= r->hi)) continue;
+        vtext_clear_ns(b, (int)n);
+        r->lo = lo;
+        r->hi = hi;
+        g_ns[n].fill(b, (int)n, lo, hi);
+    }
+}
+
+void vtext_ns_invalidate(Buffer *b, int ns, int lo, int hi) {
+    if (!b || ns < 0 || ns >= (int)arrlen(g_ns) || !g_ns[ns].fill) return;
+    VtLazyRange *r = lazy_range(b, ns);
+    if (r->held) {
+        r->held = 0;
+        r->lo = r->hi = 0;
+        return;
+    }
+    if (lo < r->lo) lo = r->lo;
+    if (hi > r->hi) hi = r->hi;
+    if (lo >= hi) return;
+    for (ptrdiff_t i = arrlen(b->vtext.marks) - 1; i >= 0; i--) {
+        VtMark *m = &b->vtext.marks[i];
+        if (m->ns_id == ns && m->line >= lo && m->line < hi)
+            mark_drop(b, i);
+    }
+    g_ns[ns].fill(b, ns, lo, hi);
 }
 
 int vtext_buffer_has_marks(const Buffer *b) {
@@ -93,8 +171,7 @@ int vtext_clear_line(Buffer *b, int ns, int line) {
     for (ptrdiff_t i = arrlen(b->vtext.marks) - 1; i >= 0; i--) {
         VtMark *m = &b->vtext.marks[i];
         if (m->ns_id == ns && m->line == line) {
-            strbuf_free(&m->text);
-            arrdel(b->vtext.marks, i);
+            mark_drop(b, i);
             dropped++;
         }
     }
@@ -104,11 +181,11 @@ int vtext_clear_line(Buffer *b, int ns, int line) {
 int vtext_clear_ns(Buffer *b, int ns) {
     if (!b) return -1;
     int dropped = 0;
+    lazy_forget(b, ns);
     for (ptrdiff_t i = arrlen(b->vtext.marks) - 1; i >= 0; i--) {
         VtMark *m = &b->vtext.marks[i];
         if (m->ns_id == ns) {
-            strbuf_free(&m->text);
-            arrdel(b->vtext.marks, i);
+            mark_drop(b, i);
             dropped++;
         }
     }
@@ -119,9 +196,12 @@ int vtext_clear_all(Buffer *b) {
     if (!b) return -1;
     int n = (int)arrlen(b->vtext.marks);
     for (ptrdiff_t i = 0; i < arrlen(b->vtext.marks); i++) {
+        if (b->vtext.marks[i].place == VT_PLACE_BLOCK_BELOW)
+            b->vtext.block_seq++;
         strbuf_free(&b->vtext.marks[i].text);
     }
     arr_reset(b->vtext.marks);
+    lazy_forget(b, -1);
     return n;
 }
 
@@ -137,6 +217,7 @@ int vtext_set_block_below(Buffer *b, int ns, int line,
         .priority = 0,
     };
     arrput(b->vtext.marks, m);
+    b->vtext.block_seq++;
     return 0;
 }
 
@@ -160,6 +241,15 @@ int vtext_block_below_count(const Buffer *b, int line) {
     return total;
 }
 
+void vtext_block_below_counts(const Buffer *b, int *rows, int n) {
+    if (!b || !rows) return;
+    for (ptrdiff_t i = 0; i < arrlen(b->vtext.marks); i++) {
+        const VtMark *m = &b->vtext.marks[i];
+        if (m->place == VT_PLACE_BLOCK_BELOW && m->line >= 0 && m->line < n)
+            rows[m->line] += block_below_rows_in_mark(m);
+    }
+}
+
 int vtext_block_below_at(const Buffer *b, int line, int row_index,
                          const char **out_text, size_t *out_len,
                          const char **out_sgr) {
@@ -26,10 +26,25 @@ typedef struct {
     int          priority;
 } VtMark;
 
+/* What a lazily filled namespace has materialized in one buffer. */
+typedef struct {
+    int  ns_id;
+    int  lo, hi;              /* lines whose marks are in the table */
+    int  held;                /* cleared by an edit; no refill until the
+                                 owner invalidates */
+} VtLazyRange;
+
 typedef struct {
     VtMark *marks;            /* stb_ds vector; NULL when empty */
+    unsigned block_seq;       /* bumped when a BLOCK_BELOW mark comes or
+                                 goes; line heights depend on them */
+    VtLazyRange *lazy;        /* stb_ds; one per lazy namespace in use */
 } VtTable;
 
+/* Fill callback of a lazy namespace: add the marks of lines [lo, hi)
+ * of `b` (EOL marks; the line heights are already laid out). */
+typedef void (*VtFillFn)(Buffer *b, int ns, int lo, int hi);
+
 /* Lifecycle. Called from buf_new / buf_close. The hook subscriptions
  * live on a process-wide registry; vtext_init only zero-inits the
  * per-buffer table and is safe to call repeatedly. */
@@ -51,6 +66,22 @@ int  vtext_ns_create(const char *name);
  * set this to 0. Returns 0 on success, -1 if the ns id is unknown. */
 int  vtext_ns_set_auto_clear(int ns, int auto_clear);
 
+/* Make `ns` lazy. Its owner keeps the annotations for a whole buffer
+ * elsewhere and `fill` turns them into marks only for the lines a
+ * window is showing, so a file with thousands of them still costs a
+ * screenful of marks per frame. Returns 0, or -1 for an unknown ns. */
+int  vtext_ns_set_fill(int ns, VtFillFn fill);
+
+/* Called by the renderer with the lines a window shows: refill every
+ * lazy namespace whose materialized range does not cover [lo, hi). */
+void vtext_materialize(Buffer *b, int lo, int hi);
+
+/* The owner's data for lines [lo, hi) of lazy `ns` changed: drop their
+ * marks and refill those inside the materialized range. Also lifts the
+ * hold an edit put on an auto-clear namespace (an empty range does
+ * only that), so the next frame fills the view afresh. */
+void vtext_ns_invalidate(Buffer *b, int ns, int lo, int hi);
+
 /* Append an EOL mark to `line`. Copies `text`. If `sgr` is NULL the
  * renderer falls back to COLOR_COMMENT. Returns 0 on success. */
 int  vtext_set_eol(Buffer *b, int ns, int line,
@@ -67,6 +98,10 @@ int  vtext_set_block_below(Buffer *b, int ns, int line,
  * by the renderer's height accounting; should be O(marks). */
 int  vtext_block_below_count(const Buffer *b, int line);
 
+/* Add every line's block_below row count into rows[line] for lines
+ * below `n`, in one pass over the marks. */
+void vtext_block_below_counts(const Buffer *b, int *rows, int n);
+
 /* Look up the i-th block_below virtual row for `line` (0-based across
  * all marks on that line, in mark insertion order). Returns the
  * pointer/length into the mark's text on success and the SGR colour
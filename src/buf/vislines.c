@@ -0,0 +1,202 @@
+#include "buf/vislines.h"
+#include "lib/strutil.h"
+#include "stb_ds.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Source of VisLines.used; the smallest stamp is evicted first. */
+static unsigned g_clock;
+
+static int measure(const Buffer *buf, int line, int cols) {
+    if (cols <= 0)
+        return 1;
+    const Row *row = buf_row(buf, line);
+    if (!row)
+        return 1;
+    int w = utf8_display_width(row->render.data, row->render.len);
+    if (w <= 0)
+        return 1;
+    return (w + cols - 1) / cols;
+}
+
+static void tree_add(VisLines *vl, int line, int d) {
+    for (int j = line + 1; j <= vl->n; j += j & -j)
+        vl->tree[j] += d;
+}
+
+/* Fill the tree from wrap_h/vt_h and the fold runs in one linear pass. */
+static void tree_build(VisLines *vl, const FoldIndex *ix) {
+    int n = vl->n;
+    arrsetlen(vl->tree, n + 1);
+    vl->tree[0] = 0;
+    int r = 0;
+    for (int i = 0; i < n; i++) {
+        while (r < ix->run_count && ix->runs[r].hi < i)
+            r++;
+        bool hidden = r < ix->run_count && ix->runs[r].lo <= i;
+        vl->tree[i + 1] = hidden ? 0 : vl->wrap_h[i] + vl->vt_h[i];
+    }
+    for (int i = 1; i <= n; i++) {
+        int j = i + (i & -i);
+        if (j <= n)
+            vl->tree[j] += vl->tree[i];
+    }
+}
+
+static void vt_refill(VisLines *vl, const Buffer *buf) {
+    arrsetlen(vl->vt_h, vl->n);
+    if (vl->n > 0)
+        memset(vl->vt_h, 0, (size_t)vl->n * sizeof(int));
+    vtext_block_below_counts(buf, vl->vt_h, vl->n);
+}
+
+static void rebuild(VisLines *vl, Buffer *buf) {
+    vl->n = buf->num_rows;
+    arrsetlen(vl->wrap_h, vl->n);
+    for (int i = 0; i < vl->n; i++)
+        vl->wrap_h[i] = measure(buf, i, vl->cols);
+    vt_refill(vl, buf);
+    tree_build(vl, &buf->folds.index);
+}
+
+/* Bring the heights in line with the buffer, redoing as little as the
+ * pending edits and counters allow. */
+static void sync(VisLines *vl, Buffer *buf) {
+    BufEditSpan *e = &vl->edits;
+    bool folds_moved = vl->fold_seq != buf->folds.index.seq;
+    bool vt_moved = vl->vt_seq != buf->vtext.block_seq;
+    int n = buf->num_rows;
+
+    if (!vl->built || e->reset ||
+        (e->touched && (e->lo < 0 || e->lo > e->hi || e->hi > n)) ||
+        vl->n + (e->touched ? e->delta : 0) != n) {
+        rebuild(vl, buf);
+    } else if (e->touched && e->delta == 0 && !folds_moved && !vt_moved) {
+        for (int i = e->lo; i < e->hi; i++) {
+            int h = measure(buf, i, vl->cols);
+            if (h != vl->wrap_h[i] &&
+                !fold_is_line_hidden(&buf->folds, i))
+                tree_add(vl, i, h - vl->wrap_h[i]);
+            vl->wrap_h[i] = h;
+        }
+    } else if (e->touched || folds_moved || vt_moved) {
+        if (e->touched) {
+            /* Rows [lo, hi - delta) became [lo, hi); move the tail and
+             * measure only what is new. */
+            int old_n = vl->n;
+            int tail = old_n - (e->hi - e->delta);
+            if (n > old_n)
+                arrsetlen(vl->wrap_h, n);
+            if (tail > 0 && e->delta != 0)
+                memmove(vl->wrap_h + e->hi, vl->wrap_h + e->hi - e->delta,
+                        (size_t)tail * sizeof(int));
+            arrsetlen(vl->wrap_h, n);
+            vl->n = n;
+            for (int i = e->lo; i < e->hi; i++)
+                vl->wrap_h[i] = measure(buf, i, vl->cols);
+        }
+        if (e->touched || vt_moved)
+            vt_refill(vl, buf);
+        tree_build(vl, &buf->folds.index);
+    }
+
+    vl->built = true;
+    vl->fold_seq = buf->folds.index.seq;
+    vl->vt_seq = buf->vtext.block_seq;
+    buf_edit_span_clear(e);
+}
+
+static void vislines_free(Buffer *buf, VisLines *vl) {
+    buf_edit_span_detach(buf, &vl->edits);
+    arrfree(vl->wrap_h);
+    arrfree(vl->vt_h);
+    arrfree(vl->tree);
+    free(vl);
+}
+
+VisLines *vislines_get(Buffer *buf, int cols) {
+    if (!buf)
+        return NULL;
+    if (cols < 0)
+        cols = 0;
+    VisLines *vl = NULL;
+    for (ptrdiff_t i = 0; i < arrlen(buf->vis_lines); i++) {
+        if (buf->vis_lines[i]->cols == cols) {
+            vl = buf->vis_lines[i];
+            break;
+        }
+    }
+    if (!vl) {
+        if (arrlen(buf->vis_lines) >= VISLINES_CACHE) {
+            ptrdiff_t old = 0;
+            for (ptrdiff_t i = 1; i < arrlen(buf->vis_lines); i++)
+                if (buf->vis_lines[i]->used < buf->vis_lines[old]->used)
+                    old = i;
+            vislines_free(buf, buf->vis_lines[old]);
+            arrdel(buf->vis_lines, old);
+        }
+        vl = calloc(1, sizeof(*vl));
+        if (!vl)
+            return NULL;
+        vl->cols = cols;
+        buf_edit_span_attach(buf, &vl->edits);
+        arrput(buf->vis_lines, vl);
+    }
+    vl->used = ++g_clock;
+    sync(vl, buf);
+    return vl;
+}
+
+void vislines_free_all(Buffer *buf) {
+    if (!buf)
+        return;
+    for (ptrdiff_t i = 0; i < arrlen(buf->vis_lines); i++)
+        vislines_free(buf, buf->vis_lines[i]);
+    arrfree(buf->vis_lines);
+    buf->vis_lines = NULL;
+}
+
+int vislines_row_start(const VisLines *vl, int line) {
+    if (!vl || line <= 0)
+        return 0;
+    if (line > vl->n)
+        line = vl->n;
+    int sum = 0;
+    for (int j = line; j > 0; j -= j & -j)
+        sum += vl->tree[j];
+    return sum;
+}
+
+int vislines_total(const VisLines *vl) {
+    return vl ? vislines_row_start(vl, vl->n) : 0;
+}
+
+int vislines_find(const VisLines *vl, int vrow, int *sub) {
+    if (sub)
+        *sub = 0;
+    if (!vl || vl->n == 0)
+        return 0;
+    if (vrow < 0)
+        vrow = 0;
+    /* Fenwick descent: the longest prefix whose height is <= vrow
+     * ends just before the line that holds it. */
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= vl->n)
+        step *= 2;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= vl->n && vl->tree[pos + step] <= vrow) {
+            pos += step;
+            vrow -= vl->tree[pos];
+        }
+    }
+    if (pos < vl->n && sub)
+        *sub = vrow;
+    return pos;
+}
+
+int vislines_real_height(const VisLines *vl, int line) {
+    if (!vl || line < 0 || line >= vl->n)
+        return 1;
+    return vl->wrap_h[line];
+}
@@ -0,0 +1,62 @@
+#ifndef HED_VISLINES_H
+#define HED_VISLINES_H
+
+/*
+ * VisLines — prefix index of how many screen rows each buffer line
+ * takes in a window.
+ *
+ * A line's shown height is 0 when a closed fold hides it, else its
+ * wrap sublines plus its block_below virtual rows. Window row_offset
+ * is an index into the concatenation of those rows, so turning it into
+ * a (line, subline) pair — or a cursor position back into a screen row
+ * — means summing heights over every line above. The index keeps the
+ * heights in a Fenwick tree so both directions are O(log n).
+ *
+ * Indexes are owned by the buffer and keyed by wrap width (0 for no
+ * wrap, where every line is one row), so windows of the same width
+ * share one. Each listens to row edits through a BufEditSpan: in-place
+ * changes remeasure just the touched lines; inserts and deletes shift
+ * the per-line arrays and rebuild the tree in O(n) without remeasuring
+ * the rest. Fold and block_below changes are picked up by comparing
+ * FoldIndex.seq and VtTable.block_seq.
+ */
+
+#include "buf/buffer.h"
+
+#define VISLINES_CACHE 4 /* indexes kept per buffer, least recent out */
+
+typedef struct VisLines {
+    int         cols;     /* wrap width; 0 = no wrap */
+    BufEditSpan edits;    /* attached; rows changed since the last sync */
+    unsigned    fold_seq; /* FoldIndex.seq the heights reflect */
+    unsigned    vt_seq;   /* VtTable.block_seq the heights reflect */
+    int         n;        /* lines covered */
+    int        *wrap_h;   /* per line: real sublines (>= 1) */
+    int        *vt_h;     /* per line: block_below virtual rows */
+    int        *tree;     /* Fenwick tree of shown heights, 1-based */
+    unsigned    used;     /* LRU stamp */
+    bool        built;
+} VisLines;
+
+/* The index for `buf` at wrap width `cols` (<= 0 means no wrap),
+ * created or brought up to date with the buffer. NULL on OOM. */
+VisLines *vislines_get(Buffer *buf, int cols);
+
+/* Drop every index of `buf`. Called from buf_close. */
+void vislines_free_all(Buffer *buf);
+
+/* Screen rows above `line`: the shown heights of lines [0, line). */
+int vislines_row_start(const VisLines *vl, int line);
+
+/* Screen rows of the whole buffer. */
+int vislines_total(const VisLines *vl);
+
+/* The line showing screen row `vrow`, with *sub set to the row within
+ * it (sublines first, then block_below rows). Returns n with *sub = 0
+ * when vrow is past the end. Hidden lines are never returned. */
+int vislines_find(const VisLines *vl, int vrow, int *sub);
+
+/* Real (wrap) sublines of `line`, ignoring folds and virtual rows. */
+int vislines_real_height(const VisLines *vl, int line);
+
+#endif /* HED_VISLINES_H */
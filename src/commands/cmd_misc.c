@@ -14,6 +14,8 @@
 #include "utils/fold_methods.h"
 #include "input/keybinds.h"
 #include "lib/strutil.h"
+#include "hooks.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -222,6 +224,44 @@ void cmd_redo(const char *args) {
         ed_set_status_message("Already at newest change");
 }
 
+/* ":earlier [N]" / ":earlier N{s,m,h,d}", and the same for ":later". */
+static void undo_travel(const char *args, int dir) {
+    Buffer *buf = buf_cur();
+    if (!buf) return;
+    long      n    = 1;
+    long long unit = 0;
+    if (args && *args) {
+        char *end = NULL;
+        n = strtol(args, &end, 10);
+        if (end == args || n < 0) {
+            ed_set_status_message("Invalid argument: %s", args);
+            return;
+        }
+        switch (*end) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 60 * 60; break;
+        case 'd': unit = 24 * 60 * 60; break;
+        }
+        if (unit) end++;
+        /* Only blanks may follow the count and its unit: "1ms" and
+         * "5sfoo" are not counts. */
+        while (*end == ' ' || *end == '\t') end++;
+        if (*end) {
+            ed_set_status_message("Invalid argument: %s", args);
+            return;
+        }
+    }
+    int moved = unit ? undo_goto_time(buf, dir * n * unit)
+                     : undo_goto_step(buf, (int)(dir * n));
+    if (!moved)
+        ed_set_status_message(dir < 0 ? "Already at oldest change"
+                                      : "Already at newest change");
+}
+
+void cmd_earlier(const char *args) { undo_travel(args, -1); }
+void cmd_later(const char *args) { undo_travel(args, +1); }
+
 void cmd_repeat(const char *args) {
     (void)args;
     /* Get the last executed keybind sequence from '.' register */
@@ -343,6 +383,69 @@ void cmd_logclear(const char *args) {
     ed_set_status_message("log cleared");
 }
 
+static int hookstat_cmp(const void *a, const void *b) {
+    const HookStat *x = a, *y = b;
+    return (x->ns < y->ns) - (x->ns > y->ns);
+}
+
+/* :hookprof [on|off|reset] — per-hook timing. With no argument, list
+ * the costliest callbacks in the message bar and all of them in the
+ * log. Callbacks show as addresses; resolve them with addr2line. */
+void cmd_hookprof(const char *args) {
+    while (args && (*args == ' ' || *args == '\t')) args++;
+    if (args && *args) {
+        if (strcmp(args, "on") == 0) {
+            hook_stats_reset();
+            hook_profile(true);
+        } else if (strcmp(args, "off") == 0) {
+            hook_profile(false);
+        } else if (strcmp(args, "reset") == 0) {
+            hook_stats_reset();
+        } else {
+            ed_set_status_message("hookprof: unknown arg '%s' (use on|off|reset)", args);
+            return;
+        }
+        ed_set_status_message("hookprof: %s", hook_profiling() ? "on" : "off");
+        return;
+    }
+
+    int n = 0;
+    const HookStat *stats = hook_stats(&n);
+    HookStat *sorted = n > 0 ? malloc(sizeof(*sorted) * (size_t)n) : NULL;
+    int used = 0;
+    for (int i = 0; i < n && sorted; i++)
+        if (stats[i].calls) sorted[used++] = stats[i];
+    if (used == 0) {
+        ed_set_status_message("hookprof: %s, nothing recorded",
+                              hook_profiling() ? "on" : "off");
+        free(sorted);
+        return;
+    }
+    qsort(sorted, (size_t)used, sizeof(*sorted), hookstat_cmp);
+
+    char buf[1024];
+    int off = 0;
+    for (int i = 0; i < used; i++) {
+        const HookStat *st = &sorted[i];
+        /* ISO C has no %p for function pointers. */
+        uintptr_t addr = (uintptr_t)st->callback;
+        log_msg("hookprof: %-16s 0x%lx %lu calls %.3f ms",
+                hook_type_name(st->type), (unsigned long)addr, st->calls,
+                (double)st->ns / 1e6);
+        if (i >= 8 || off >= (int)sizeof(buf) - 1) continue;
+        int wrote = snprintf(buf + off, sizeof(buf) - (size_t)off,
+                             "%s%-16s 0x%lx %8lu calls %9.3f ms",
+                             i ? "\n" : "", hook_type_name(st->type),
+                             (unsigned long)addr, st->calls,
+                             (double)st->ns / 1e6);
+        if (wrote > 0) off += wrote;
+        if (off > (int)sizeof(buf) - 1) off = (int)sizeof(buf) - 1;
+    }
+    buf[off] = '\0';
+    ed_set_status_message("%s", buf);
+    free(sorted);
+}
+
 void cmd_buf_refresh(const char* args){
 	(void)args;
 	Buffer *buf=buf_cur();
@@ -362,7 +465,7 @@ void cmd_new_line(const char *args) {
         win->cursor.x = 0;
     } else {
         Row *row =
-            (win->cursor.y < buf->num_rows) ? &buf->rows[win->cursor.y] : NULL;
+            (win->cursor.y < buf->num_rows) ? buf_row(buf, win->cursor.y) : NULL;
         win->cursor.x = row ? (int)row->chars.len : 0;
     }
     buf_insert_newline_in(buf);
@@ -449,8 +552,8 @@ void cmd_fold_new(const char *args) {
     }
 
     /* Mark the rows */
-    buf->rows[start_line].fold_start = true;
-    buf->rows[end_line].fold_end = true;
+    buf_row(buf, start_line)->fold_start = true;
+    buf_row(buf, end_line)->fold_end = true;
 
     /* Add fold region */
     fold_add_region(&buf->folds, start_line, end_line);
@@ -496,10 +599,10 @@ void cmd_fold_rm(const char *args) {
     /* Clear fold markers on the rows */
     FoldRegion *region = &buf->folds.regions[idx];
     if (region->start_line >= 0 && region->start_line < buf->num_rows) {
-        buf->rows[region->start_line].fold_start = false;
+        buf_row(buf, region->start_line)->fold_start = false;
     }
     if (region->end_line >= 0 && region->end_line < buf->num_rows) {
-        buf->rows[region->end_line].fold_end = false;
+        buf_row(buf, region->end_line)->fold_end = false;
     }
 
     /* Remove the fold region */
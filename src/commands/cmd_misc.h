@@ -9,12 +9,15 @@ void cmd_registers(const char *args);
 void cmd_put(const char *args);
 void cmd_undo(const char *args);
 void cmd_redo(const char *args);
+void cmd_earlier(const char *args);
+void cmd_later(const char *args);
 void cmd_repeat(const char *args);
 void cmd_macro_record(const char *args);
 void cmd_macro_play(const char *args);
 void cmd_ln(const char *args);
 void cmd_rln(const char *args);
 void cmd_logclear(const char *args);
+void cmd_hookprof(const char *args);
 void cmd_new_line(const char *args);
 void cmd_new_line_above(const char *args);
 void cmd_wrap(const char *args);
@@ -183,11 +183,55 @@ int ed_read_key(void) {
     return key;
 }
 
+/* Bracketed paste is read in chunks this size. */
+#define PASTE_CHUNK (64 * 1024)
+
+static const char PASTE_END[6] = { '\x1b', '[', '2', '0', '1', '~' };
+
+/* Offset of the end marker in s[from, len), or -1. memchr hops from
+ * ESC to ESC, so plain text is skipped at memory speed. A marker cut
+ * off by `len` is not found; the caller rescans the last few bytes
+ * once more data arrives. */
+static ptrdiff_t paste_find_end(const char *s, size_t from, size_t len) {
+    while (from < len) {
+        const char *e = memchr(s + from, PASTE_END[0], len - from);
+        if (!e)
+            return -1;
+        size_t at = (size_t)(e - s);
+        if (len - at < sizeof(PASTE_END))
+            return -1;
+        if (memcmp(e, PASTE_END, sizeof(PASTE_END)) == 0)
+            return (ptrdiff_t)at;
+        from = at + 1;
+    }
+    return -1;
+}
+
+/* Keep text, tabs and line breaks (CRLF and lone CR become '\n'); drop
+ * other control bytes so pasted ANSI sequences can't corrupt the file.
+ * Filters in place and returns the new length. */
+static size_t paste_clean(char *s, size_t len) {
+    size_t o = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\r') {
+            if (i + 1 < len && s[i + 1] == '\n')
+                continue;
+            s[o++] = '\n';
+        } else if (c >= 0x20 || c == '\t' || c == '\n') {
+            s[o++] = (char)c;
+        }
+    }
+    return o;
+}
+
 /* Drain a bracketed paste body (between ESC[200~ and ESC[201~) and
  * insert it verbatim into the current buffer, bypassing keymap
  * dispatch, HOOK_KEYPRESS, and HOOK_CHAR_INSERT. That's what makes
  * pastes survive auto-pair / smart-indent / numeric prefixes
- * unmangled. The whole paste lands as one undo group. */
+ * unmangled. The body is read in bulk and lands as one multi-line
+ * insert in one undo group; bytes read past the end marker go back
+ * to the key parser. */
 static void ed_handle_paste(void) {
     Buffer *buf = buf_cur();
 
@@ -196,68 +240,43 @@ static void ed_handle_paste(void) {
      * leftover content doesn't bleed into subsequent keystrokes. */
     int can_insert = (buf != NULL);
 
-    /* Force INSERT mode for the duration so the paste lands as text
-     * regardless of whether the user was in NORMAL/VISUAL/etc.
-     * Restore afterwards. */
-    EditorMode prev_mode = E.mode;
-    if (can_insert && E.mode != MODE_INSERT) ed_set_mode(MODE_INSERT);
-
-    if (can_insert) undo_begin(buf, "paste");
-
-    /* End-marker matcher: ESC '[' '2' '0' '1' '~'.
-     * If the match fails partway through, the consumed prefix has to
-     * be re-emitted as literal text (paste content is allowed to
-     * contain arbitrary bytes, including stray ESC). */
-    static const char END_MARKER[6] = { '\x1b', '[', '2', '0', '1', '~' };
-    int matched = 0;
-
+    static char chunk[PASTE_CHUNK];
+    StrBuf body = strbuf_new();
+    ptrdiff_t end = -1;
     for (;;) {
-        char c;
-        ssize_t n = read(STDIN_FILENO, &c, 1);
+        ssize_t n = ed_input_read(STDIN_FILENO, chunk, sizeof(chunk));
         if (n == 0) break;            /* EOF — terminal closed */
         if (n < 0) {
             if (errno == EINTR || errno == EAGAIN) continue;
             break;
         }
-
-        if (c == END_MARKER[matched]) {
-            matched++;
-            if (matched == (int)sizeof(END_MARKER)) break;
-            continue;
-        }
-
-        /* Mismatch: flush any matched prefix as literal text, then
-         * re-process the current byte. Done iteratively so a stray
-         * ESC mid-paste doesn't drop characters. */
-        if (matched > 0) {
-            for (int i = 0; i < matched; i++) {
-                char p = END_MARKER[i];
-                if (can_insert) {
-                    if (p == '\n' || p == '\r')
-                        buf_insert_newline_in(buf);
-                    else if ((unsigned char)p >= 0x20 || p == '\t')
-                        buf_insert_char_in(buf, (unsigned char)p);
-                    /* Other control bytes (incl. ESC) are dropped to
-                     * keep pasted ANSI sequences from corrupting the
-                     * file. */
-                }
-            }
-            matched = 0;
-            /* Fall through to handle `c` itself below. */
-            if (c == END_MARKER[0]) { matched = 1; continue; }
-        }
-
-        if (!can_insert) continue;
-        if (c == '\n' || c == '\r') {
-            buf_insert_newline_in(buf);
-        } else if ((unsigned char)c >= 0x20 || c == '\t') {
-            buf_insert_char_in(buf, (unsigned char)c);
-        }
-        /* Drop other control bytes silently. */
+        size_t from = body.len >= sizeof(PASTE_END)
+                          ? body.len - (sizeof(PASTE_END) - 1)
+                          : 0;
+        strbuf_append(&body, chunk, (size_t)n);
+        end = paste_find_end(body.data, from, body.len);
+        if (end >= 0) break;
     }
-
-    if (can_insert) undo_end(buf);
-    if (can_insert && prev_mode != MODE_INSERT) ed_set_mode(prev_mode);
+    size_t len = body.len;
+    if (end >= 0) {
+        size_t after = (size_t)end + sizeof(PASTE_END);
+        ed_input_unread(body.data + after, body.len - after);
+        len = (size_t)end;
+    }
+    len = body.data ? paste_clean(body.data, len) : 0;
+
+    if (can_insert && len > 0) {
+        /* Force INSERT mode for the duration so the paste lands as text
+         * regardless of whether the user was in NORMAL/VISUAL/etc.
+         * Restore afterwards. */
+        EditorMode prev_mode = E.mode;
+        if (E.mode != MODE_INSERT) ed_set_mode(MODE_INSERT);
+        undo_begin(buf, "paste");
+        buf_insert_text_in(buf, body.data, len);
+        undo_end(buf);
+        if (prev_mode != MODE_INSERT) ed_set_mode(prev_mode);
+    }
+    strbuf_free(&body);
 }
 
 
@@ -110,6 +110,7 @@ typedef struct {
 
     StrBuf search_query;
     int search_is_regex; /* 1=regex search, 0=literal */
+    int search_icase;    /* 1=ignore ASCII case */
     Qf qf;
     Window *modal_window; /* Current modal window (NULL if none) */
     struct WLayoutNode *wlayout_root;
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -364,6 +366,92 @@ EdError fs_file_write_atomic(const char *path, const void *data, size_t len) {
     return ED_OK;
 }
 
+/* Slurp `fd` to EOF into the heap (for fds mmap can't handle). */
+static EdError read_fd_all(int fd, FsMap *out) {
+    size_t cap = 64 * 1024, len = 0;
+    char *buf = malloc(cap);
+    if (!buf)
+        return ED_ERR_NOMEM;
+    for (;;) {
+        if (len == cap) {
+            char *nb = realloc(buf, cap * 2);
+            if (!nb) {
+                free(buf);
+                return ED_ERR_NOMEM;
+            }
+            buf = nb;
+            cap *= 2;
+        }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            free(buf);
+            return ED_ERR_FILE_READ;
+        }
+        if (n == 0)
+            break;
+        len += (size_t)n;
+    }
+    if (len == 0) {
+        free(buf);
+        buf = NULL;
+    }
+    out->data   = buf;
+    out->len    = len;
+    out->mapped = false;
+    return ED_OK;
+}
+
+EdError fs_file_map(const char *path, FsMap *out) {
+    if (!out)
+        return ED_ERR_INVALID_ARG;
+    memset(out, 0, sizeof(*out));
+    if (!path || !*path)
+        return ED_ERR_INVALID_ARG;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno_to_ed(errno, ED_ERR_FILE_OPEN);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        EdError err = errno_to_ed(errno, ED_ERR_FILE_READ);
+        close(fd);
+        return err;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        close(fd);
+        return ED_ERR_FILE_READ;
+    }
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            (void)madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            out->data   = p;
+            out->len    = (size_t)st.st_size;
+            out->mapped = true;
+            return ED_OK;
+        }
+    }
+    /* Zero-size regular files may still be /proc-style generators, so
+     * they go through read() like pipes do. */
+    EdError err = read_fd_all(fd, out);
+    close(fd);
+    return err;
+}
+
+void fs_file_unmap(FsMap *m) {
+    if (!m)
+        return;
+    if (m->data) {
+        if (m->mapped)
+            munmap((void *)m->data, m->len);
+        else
+            free((void *)m->data);
+    }
+    memset(m, 0, sizeof(*m));
+}
+
 /* =====================================================================
  * Line scanner
  * ===================================================================== */
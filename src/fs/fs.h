@@ -109,6 +109,19 @@ EdError fs_file_write(const char *path, const void *data, size_t len);
  * On any failure, `path` is left untouched. */
 EdError fs_file_write_atomic(const char *path, const void *data, size_t len);
 
+/* Read-only view of a whole file. Regular files are mmap'd (no copy,
+ * pages fault in as the caller walks them); anything mmap refuses —
+ * pipes, /proc entries — is slurped into the heap instead. `data` is
+ * NOT nul-terminated and is NULL for an empty file. */
+typedef struct {
+    const char *data;
+    size_t      len;
+    bool        mapped; /* private: munmap vs free on release */
+} FsMap;
+
+EdError fs_file_map(const char *path, FsMap *out);
+void    fs_file_unmap(FsMap *m);
+
 /* =====================================================================
  * Line-by-line scanning.
  *
@@ -3,6 +3,7 @@
 #include "stb_ds.h"
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* Hook entry - stores callback with its filters. The callback is held
  * as HookFn (a generic function pointer) so dispatch casts stay
@@ -11,47 +12,215 @@
  * site. HookFn is declared in hooks.h. */
 typedef struct {
     HookFn callback;
-    int mode;       /* EditorMode - filter by mode */
-    char *filetype; /* Filter by filetype, "*" for all */
+    int mode; /* EditorMode - filter by mode, < 0 for all */
+    int ft;   /* interned filetype, HOOK_FT_ANY for "*" */
 } HookEntry;
 
-/* Per-type stb_ds dynamic array of HookEntry. */
+#define HOOK_FT_ANY -1
+
+/* Per-type stb_ds dynamic array of HookEntry, in registration order. */
 static HookEntry *hooks[HOOK_TYPE_COUNT];
 
-/* Helper: check if hook should fire based on filters.
- * entry->mode < 0 is a wildcard that matches every mode (same
- * convention hook_register_mode/key/simple use internally). */
-static int hook_should_fire(const HookEntry *entry, int current_mode,
-                            const char *current_filetype) {
-    if (entry->mode >= 0 && entry->mode != current_mode) {
-        return 0;
-    }
-    if (strcmp(entry->filetype, "*") != 0) {
-        if (!current_filetype ||
-            strcmp(entry->filetype, current_filetype) != 0) {
-            return 0;
+/* Filetypes named by some registration, interned to small ids. */
+static struct { char *key; int value; } *ft_ids = NULL;
+static int ft_count = 0;
+
+/* ------------------------------------------------------------------
+ * Dispatch tables
+ *
+ * Firing used to walk every entry of a type and strcmp its filetype.
+ * Instead each type keeps, per (mode, filetype) pair, the array of
+ * callbacks that apply there, rebuilt from `hooks` the first time the
+ * type fires after a registration change. A fire resolves the pair
+ * once and runs the array.
+ *
+ * Rows are modes, with one extra row for a mode outside the known
+ * range; columns are filetype ids, with one extra column for a
+ * filetype no hook names. Either extra only sees wildcard entries.
+ * ------------------------------------------------------------------ */
+#define HOOK_MODES (MODE_VISUAL_BLOCK + 1)
+
+typedef struct {
+    HookFn fn;
+    int    stat; /* index into hook_stat_tab */
+} HookSlot;
+
+typedef struct {
+    HookSlot **cells; /* (HOOK_MODES + 1) * (nft + 1) stb_ds arrays */
+    int        nft;   /* ft_count when built */
+    bool       stale;
+} HookTable;
+
+static HookTable tables[HOOK_TYPE_COUNT];
+
+/* A callback may register or unregister hooks, or fire another hook,
+ * while a fire is walking a table. Tables replaced during that time
+ * are parked here and freed once the outermost fire returns, so a
+ * fire always finishes over the table it started with. */
+static int         fire_depth = 0;
+static HookSlot ***retired    = NULL;
+
+/* Per (type, callback) timing, collected while profiling is on. */
+static HookStat *hook_stat_tab = NULL;
+static bool      profiling     = false;
+
+static const char *hook_type_names[HOOK_TYPE_COUNT] = {
+    [HOOK_CHAR_INSERT]      = "char_insert",
+    [HOOK_CHAR_DELETE]      = "char_delete",
+    [HOOK_LINE_INSERT]      = "line_insert",
+    [HOOK_LINE_DELETE]      = "line_delete",
+    [HOOK_BUFFER_OPEN]      = "buffer_open",
+    [HOOK_BUFFER_CLOSE]     = "buffer_close",
+    [HOOK_BUFFER_SWITCH]    = "buffer_switch",
+    [HOOK_BUFFER_SAVE]      = "buffer_save",
+    [HOOK_BUFFER_OPEN_PRE]  = "buffer_open_pre",
+    [HOOK_BUFFER_SAVE_PRE]  = "buffer_save_pre",
+    [HOOK_MODE_CHANGE]      = "mode_change",
+    [HOOK_CURSOR_MOVE]      = "cursor_move",
+    [HOOK_KEYPRESS]         = "keypress",
+    [HOOK_MOUSE]            = "mouse",
+    [HOOK_STARTUP_DONE]     = "startup_done",
+    [HOOK_KEYBIND_FEED]     = "keybind_feed",
+    [HOOK_KEYBIND_INVOKE]   = "keybind_invoke",
+    [HOOK_RENDER_PRE]       = "render_pre",
+};
+
+const char *hook_type_name(HookType type) {
+    if (type >= HOOK_TYPE_COUNT || !hook_type_names[type]) return "?";
+    return hook_type_names[type];
+}
+
+static int ft_intern(const char *filetype) {
+    if (strcmp(filetype, "*") == 0) return HOOK_FT_ANY;
+    if (!ft_ids) sh_new_strdup(ft_ids);
+    ptrdiff_t i = shgeti(ft_ids, filetype);
+    if (i >= 0) return ft_ids[i].value;
+    shput(ft_ids, filetype, ft_count);
+    /* Every table's column count just changed. */
+    for (int t = 0; t < HOOK_TYPE_COUNT; t++) tables[t].stale = true;
+    return ft_count++;
+}
+
+static int stat_slot(HookType type, HookFn fn) {
+    for (ptrdiff_t i = 0; i < arrlen(hook_stat_tab); i++)
+        if (hook_stat_tab[i].type == type && hook_stat_tab[i].callback == fn)
+            return (int)i;
+    HookStat st = { .type = type, .callback = fn, .calls = 0, .ns = 0 };
+    arrput(hook_stat_tab, st);
+    return (int)arrlen(hook_stat_tab) - 1;
+}
+
+static void cells_free(HookSlot **cells) {
+    for (ptrdiff_t i = 0; i < arrlen(cells); i++) arrfree(cells[i]);
+    arrfree(cells);
+}
+
+static void table_rebuild(HookType type) {
+    HookTable *t = &tables[type];
+    if (fire_depth > 0) arrput(retired, t->cells);
+    else cells_free(t->cells);
+
+    t->cells = NULL;
+    t->nft   = ft_count;
+    for (int m = 0; m <= HOOK_MODES; m++) {
+        for (int f = 0; f <= t->nft; f++) {
+            HookSlot *cell = NULL;
+            for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
+                const HookEntry *e = &hooks[type][i];
+                if (e->mode >= 0 && e->mode != m) continue;
+                if (e->ft != HOOK_FT_ANY && e->ft != f) continue;
+                HookSlot s = { .fn = e->callback,
+                               .stat = stat_slot(type, e->callback) };
+                arrput(cell, s);
+            }
+            arrput(t->cells, cell);
         }
     }
-    return 1;
+    t->stale = false;
+}
+
+/* Callbacks of `type` that apply in the current mode to `filetype`. */
+static HookSlot *hook_cell(HookType type, const char *filetype) {
+    HookTable *t = &tables[type];
+    if (t->stale || !t->cells) table_rebuild(type);
+    int mode = (int)E.mode;
+    int m = (mode >= 0 && mode < HOOK_MODES) ? mode : HOOK_MODES;
+    int f = t->nft;
+    if (filetype && ft_ids) {
+        ptrdiff_t i = shgeti(ft_ids, filetype);
+        if (i >= 0) f = ft_ids[i].value;
+    }
+    return t->cells[m * (t->nft + 1) + f];
+}
+
+/* Callbacks of an unfiltered type. Those only ever register with
+ * wildcards, so the wildcard-only cell holds every entry. */
+static HookSlot *hook_all(HookType type) {
+    HookTable *t = &tables[type];
+    if (t->stale || !t->cells) table_rebuild(type);
+    return t->cells[HOOK_MODES * (t->nft + 1) + t->nft];
+}
+
+static void fire_enter(void) { fire_depth++; }
+
+static void fire_leave(void) {
+    if (--fire_depth > 0) return;
+    for (ptrdiff_t i = 0; i < arrlen(retired); i++) cells_free(retired[i]);
+    arrfree(retired);
+    retired = NULL;
+}
+
+static long long prof_start(void) {
+    if (!profiling) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void prof_stop(const HookSlot *s, long long t0) {
+    if (!profiling || !t0) return;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long t1 = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    hook_stat_tab[s->stat].calls++;
+    hook_stat_tab[s->stat].ns += (unsigned long long)(t1 - t0);
+}
+
+void hook_profile(bool on) { profiling = on; }
+bool hook_profiling(void) { return profiling; }
+
+const HookStat *hook_stats(int *count) {
+    if (count) *count = (int)arrlen(hook_stat_tab);
+    return hook_stat_tab;
+}
+
+void hook_stats_reset(void) {
+    for (ptrdiff_t i = 0; i < arrlen(hook_stat_tab); i++) {
+        hook_stat_tab[i].calls = 0;
+        hook_stat_tab[i].ns    = 0;
+    }
 }
 
 void hook_init(void) {
     for (int i = 0; i < HOOK_TYPE_COUNT; i++) {
         arrfree(hooks[i]);
         hooks[i] = NULL;
+        if (fire_depth > 0) arrput(retired, tables[i].cells);
+        else cells_free(tables[i].cells);
+        tables[i].cells = NULL;
+        tables[i].stale = true;
     }
 }
 
-/* Shared registration: append a new HookEntry. Returns 0 on OOM/invalid. */
+/* Shared registration: append a new HookEntry. Returns 0 on invalid. */
 static int hook_push(HookType type, int mode, const char *filetype,
                      HookFn callback) {
-    if (type >= HOOK_TYPE_COUNT)
+    if (type >= HOOK_TYPE_COUNT || !filetype)
         return 0;
-    char *ft_copy = strdup(filetype);
-    if (!ft_copy)
-        return 0;
-    HookEntry e = {.callback = callback, .mode = mode, .filetype = ft_copy};
+    HookEntry e = {.callback = callback, .mode = mode,
+                   .ft = ft_intern(filetype)};
     arrput(hooks[type], e);
+    tables[type].stale = true;
     return 1;
 }
 
@@ -109,123 +278,163 @@ int hook_unregister(HookType type, HookFn callback) {
     int removed = 0;
     for (ptrdiff_t i = arrlen(hooks[type]) - 1; i >= 0; i--) {
         if (hooks[type][i].callback == callback) {
-            free(hooks[type][i].filetype);
             arrdel(hooks[type], i);
             removed++;
         }
     }
+    if (removed) tables[type].stale = true;
     return removed;
 }
 
+/* Filetype a buffer event is filtered on. */
+static const char *event_filetype(const Buffer *buf) {
+    return (buf && buf->filetype) ? buf->filetype : "txt";
+}
+
 void hook_fire_char(HookType type, const HookCharEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    const char *filetype =
-        (event->buf && event->buf->filetype) ? event->buf->filetype : "txt";
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        if (hook_should_fire(&hooks[type][i], E.mode, filetype)) {
-            ((HookCharCallback)hooks[type][i].callback)(event);
-        }
+    HookSlot *s = hook_cell(type, event_filetype(event->buf));
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookCharCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_line(HookType type, const HookLineEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    const char *filetype =
-        (event->buf && event->buf->filetype) ? event->buf->filetype : "txt";
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        if (hook_should_fire(&hooks[type][i], E.mode, filetype)) {
-            ((HookLineCallback)hooks[type][i].callback)(event);
-        }
+    HookSlot *s = hook_cell(type, event_filetype(event->buf));
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookLineCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_buffer(HookType type, HookBufferEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    const char *filetype =
-        (event->buf && event->buf->filetype) ? event->buf->filetype : "txt";
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        if (hook_should_fire(&hooks[type][i], E.mode, filetype)) {
-            ((HookBufferCallback)hooks[type][i].callback)(event);
-            if (event->consumed)
-                return;
-        }
+    HookSlot *s = hook_cell(type, event_filetype(event->buf));
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookBufferCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
+        if (event->consumed)
+            break;
     }
+    fire_leave();
 }
 
 void hook_fire_mode(HookType type, const HookModeEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookModeCallback)hooks[type][i].callback)(event);
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookModeCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_key(HookType type, HookKeyEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookKeyCallback)hooks[type][i].callback)(event);
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookKeyCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
         if (event->consumed)
-            return;
+            break;
     }
+    fire_leave();
 }
 
 void hook_fire_mouse(HookType type, const struct MouseEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookMouseCallback)hooks[type][i].callback)(event);
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookMouseCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_simple(HookType type) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookSimpleCallback)hooks[type][i].callback)();
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookSimpleCallback)s[i].fn)();
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_keybind_feed(HookType type, const HookKeybindFeedEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookKeybindFeedCallback)hooks[type][i].callback)(event);
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookKeybindFeedCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_keybind_invoke(HookType type,
                               const HookKeybindInvokeEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        ((HookKeybindInvokeCallback)hooks[type][i].callback)(event);
+    HookSlot *s = hook_all(type);
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookKeybindInvokeCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_render(HookType type, const HookRenderEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    const char *filetype =
-        (event->buf && event->buf->filetype) ? event->buf->filetype : "txt";
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        if (hook_should_fire(&hooks[type][i], E.mode, filetype)) {
-            ((HookRenderCallback)hooks[type][i].callback)(event);
-        }
+    HookSlot *s = hook_cell(type, event_filetype(event->buf));
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookRenderCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
 
 void hook_fire_cursor(HookType type, const HookCursorEvent *event) {
     if (type >= HOOK_TYPE_COUNT)
         return;
-    const char *filetype =
-        (event->buf && event->buf->filetype) ? event->buf->filetype : "txt";
-    for (ptrdiff_t i = 0; i < arrlen(hooks[type]); i++) {
-        if (hook_should_fire(&hooks[type][i], E.mode, filetype)) {
-            ((HookCursorCallback)hooks[type][i].callback)(event);
-        }
+    HookSlot *s = hook_cell(type, event_filetype(event->buf));
+    fire_enter();
+    for (ptrdiff_t i = 0; i < arrlen(s); i++) {
+        long long t0 = prof_start();
+        ((HookCursorCallback)s[i].fn)(event);
+        prof_stop(&s[i], t0);
     }
+    fire_leave();
 }
@@ -54,9 +54,10 @@ typedef enum {
     HOOK_STARTUP_DONE,
 
     /* Fires after every keybind_feed() call. Payload is the feed
-     * snapshot (active sequence, count, exact/partial state, matches
-     * array). Used by which-key style plugins to render an overlay
-     * when the sequence is partial. */
+     * snapshot (active sequence, count, exact/partial state). Used by
+     * which-key style plugins to render an overlay when the sequence
+     * is partial; they fetch the candidates with
+     * keybind_collect_matches(). */
     HOOK_KEYBIND_FEED,
 
     /* Fires from keybind_invoke(), just before the callback runs.
@@ -122,10 +123,6 @@ typedef struct {
     bool exact;
     bool partial;
     bool consumed_count_only;
-    /* Pointer into the feed result's stb_ds matches array. Lives only
-     * for the duration of the hook firing — do not retain. */
-    const struct KeybindMatchView *matches;
-    int  match_count;
 } HookKeybindFeedEvent;
 
 typedef struct {
@@ -135,9 +132,10 @@ typedef struct {
 
 typedef struct HookRenderEvent {
     Buffer    *buf;
-    int        row_start;  /* first visible row (inclusive) */
-    int        row_end;    /* one past last visible row */
-    AttrSpans *spans;      /* handlers append into this */
+    int        row_start;  /* first stale row to fill (inclusive) */
+    int        row_end;    /* one past the last */
+    AttrSpans *spans;      /* handlers append into this; spans for rows
+                            * outside [row_start, row_end) are dropped */
 } HookRenderEvent;
 
 /* Callback function pointer types */
@@ -194,6 +192,24 @@ typedef void (*HookFn)(void);
  * Returns the number of entries removed. */
 int hook_unregister(HookType type, HookFn callback);
 
+/* Optional per-callback timing. While profiling is on, every callback
+ * run by a hook_fire_* call adds its wall time to the stat for its
+ * (type, callback) pair. Off by default; see :hookprof. */
+typedef struct {
+    HookType           type;
+    HookFn             callback;
+    unsigned long      calls;
+    unsigned long long ns;
+} HookStat;
+
+void hook_profile(bool on);
+bool hook_profiling(void);
+/* Every (type, callback) pair registered so far; *count gets the
+ * length. Owned by the hook table. */
+const HookStat *hook_stats(int *count);
+void hook_stats_reset(void);
+const char *hook_type_name(HookType type);
+
 /* Hook firing functions */
 void hook_fire_char(HookType type, const HookCharEvent *event);
 void hook_fire_line(HookType type, const HookLineEvent *event);
@@ -372,14 +372,16 @@ void cmd_prompt_open(void) {
  * The "/" search prompt
  *
  * Far simpler: no completion, no history, just line editing plus a
- * Ctrl-R toggle for regex/literal search mode. Submit fires the search.
+ * Ctrl-R toggle for regex/literal search mode and a Ctrl-T toggle for
+ * ignoring case. Submit fires the search.
  * =========================================================================== */
 
-typedef struct { int use_regex; } SearchState;
+typedef struct { int use_regex; int icase; } SearchState;
 static SearchState g_search_state;
 
 static const char *search_label(Prompt *p) {
     SearchState *s = p->state;
+    if (s->icase) return s->use_regex ? "/(i) " : "/(lit,i) ";
     return s->use_regex ? "/" : "/(lit) ";
 }
 
@@ -389,6 +391,10 @@ static PromptResult search_on_key(Prompt *p, int key) {
         s->use_regex = !s->use_regex;
         return PROMPT_CONTINUE;
     }
+    if (key == CTRL_KEY('t')) {
+        s->icase = !s->icase;
+        return PROMPT_CONTINUE;
+    }
     return prompt_default_on_key(p, key);
 }
 
@@ -399,6 +405,7 @@ static void search_on_submit(Prompt *p, const char *line, int len) {
     strbuf_free(&E.search_query);
     E.search_query    = strbuf_from(line, (size_t)len);
     E.search_is_regex = s->use_regex;
+    E.search_icase    = s->icase;
     buf_find_in(buf);
 }
 
@@ -414,5 +421,6 @@ static const PromptVTable search_vt = {
 void ed_search_prompt(void) {
     if (!buf_cur()) return;
     g_search_state.use_regex = 1;
+    g_search_state.icase     = E.search_icase;
     prompt_open(&search_vt, &g_search_state);
 }
@@ -4,10 +4,53 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static MouseEvent g_last_mouse;
 
+/* Bytes handed back by ed_input_unread(), consumed before the fd. */
+static char  *g_pending;
+static size_t g_pending_len, g_pending_pos;
+
+void ed_input_unread(const char *data, size_t len) {
+    if (!data || len == 0)
+        return;
+    /* In front of anything still pending: these were read first. */
+    size_t rest = g_pending_len - g_pending_pos;
+    char *nb = malloc(len + rest);
+    if (!nb)
+        return;
+    memcpy(nb, data, len);
+    if (rest)
+        memcpy(nb + len, g_pending + g_pending_pos, rest);
+    free(g_pending);
+    g_pending = nb;
+    g_pending_len = len + rest;
+    g_pending_pos = 0;
+}
+
+int ed_input_pending(void) {
+    return g_pending_pos < g_pending_len;
+}
+
+ssize_t ed_input_read(int fd, char *out, size_t cap) {
+    if (g_pending_pos < g_pending_len) {
+        size_t n = g_pending_len - g_pending_pos;
+        if (n > cap)
+            n = cap;
+        memcpy(out, g_pending + g_pending_pos, n);
+        g_pending_pos += n;
+        if (g_pending_pos == g_pending_len) {
+            free(g_pending);
+            g_pending = NULL;
+            g_pending_len = g_pending_pos = 0;
+        }
+        return (ssize_t)n;
+    }
+    return read(fd, out, cap);
+}
+
 const MouseEvent *ed_last_mouse(void) {
     return &g_last_mouse;
 }
@@ -41,7 +84,7 @@ static int mouse_decode(int b, int x, int y, int release) {
 int ed_parse_key_from_fd(int fd) {
     int nread;
     char c;
-    while ((nread = read(fd, &c, 1)) != 1) {
+    while ((nread = ed_input_read(fd, &c, 1)) != 1) {
         if (nread == -1 && errno != EAGAIN)
             die("read");
     }
@@ -51,14 +94,14 @@ int ed_parse_key_from_fd(int fd) {
     if (c == '\x1b') {
         char seq[3];
 
-        if (read(fd, &seq[0], 1) != 1) {
+        if (ed_input_read(fd, &seq[0], 1) != 1) {
             /* Bare ESC. */
             key = '\x1b';
         } else if (seq[0] == 'O') {
             /* SS3 sequence: ESC O <letter> for F1-F4 (xterm) and some
              * Home/End forms. */
             char letter;
-            if (read(fd, &letter, 1) != 1) {
+            if (ed_input_read(fd, &letter, 1) != 1) {
                 key = KEY_META | 'O';
             } else {
                 switch (letter) {
@@ -75,7 +118,7 @@ int ed_parse_key_from_fd(int fd) {
             /* ESC followed by any non-CSI byte = Meta/Alt + that key.
              * Terminals encode M-x as the two bytes ESC, 'x'. */
             key = KEY_META | (unsigned char)seq[0];
-        } else if (read(fd, &seq[1], 1) != 1) {
+        } else if (ed_input_read(fd, &seq[1], 1) != 1) {
             /* CSI prefix but no follow-up — degrade to bare ESC. */
             key = '\x1b';
         } else {
@@ -88,7 +131,7 @@ int ed_parse_key_from_fd(int fd) {
                 char term = '\0';
                 for (;;) {
                     char c2;
-                    if (read(fd, &c2, 1) != 1) { parse_ok = 0; break; }
+                    if (ed_input_read(fd, &c2, 1) != 1) { parse_ok = 0; break; }
                     if (c2 >= '0' && c2 <= '9') {
                         nums[ni] = nums[ni] * 10 + (c2 - '0');
                         continue;
@@ -114,7 +157,7 @@ int ed_parse_key_from_fd(int fd) {
                 int parse_ok = 1;
                 while (dlen < (int)sizeof(digits) - 1) {
                     char c2;
-                    if (read(fd, &c2, 1) != 1) { parse_ok = 0; break; }
+                    if (ed_input_read(fd, &c2, 1) != 1) { parse_ok = 0; break; }
                     if (c2 >= '0' && c2 <= '9') {
                         digits[dlen++] = c2;
                         continue;
@@ -154,8 +197,8 @@ int ed_parse_key_from_fd(int fd) {
                      * For function keys, terminator is '~' and base
                      * comes from `n`. */
                     char mod_b, term;
-                    if (read(fd, &mod_b, 1) != 1 ||
-                        read(fd, &term, 1) != 1) {
+                    if (ed_input_read(fd, &mod_b, 1) != 1 ||
+                        ed_input_read(fd, &term, 1) != 1) {
                         key = '\x1b';
                     } else {
                         int b = 0;
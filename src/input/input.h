@@ -1,6 +1,8 @@
 #ifndef HED_INPUT_H
 #define HED_INPUT_H
 
+#include <sys/types.h>
+
 /*
  * Block on `fd` until one logical keypress is available, then return it as
  * an int with KEY_META/KEY_CTRL/KEY_SHIFT flags OR'd onto the base key
@@ -26,6 +28,15 @@
  */
 int ed_parse_key_from_fd(int fd);
 
+/* Bulk readers of the terminal (bracketed paste) overshoot: whatever
+ * they read past their own data goes back through ed_input_unread()
+ * and comes out of ed_input_read() — which the key parser reads
+ * through — ahead of new input. The event loop drains pending bytes
+ * without waiting on select(), same as queued macro keys. */
+void    ed_input_unread(const char *data, size_t len);
+int     ed_input_pending(void);
+ssize_t ed_input_read(int fd, char *out, size_t cap);
+
 typedef enum {
     MOUSE_PRESS,
     MOUSE_DRAG,    /* motion with a button held (mode 1002) */
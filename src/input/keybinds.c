@@ -31,12 +31,17 @@ typedef struct {
 /* Global keybinding storage (stb_ds dynamic array) */
 static Keybind *keybinds = NULL;
 
-/* Input buffer for multi-key sequences */
+/* Input buffer for multi-key sequences: the typed keys as trie tokens,
+ * plus their spelling for display. */
 static char key_buffer[KEY_BUFFER_SIZE];
 static int key_buffer_len = 0;
+static int key_tokens[KEY_BUFFER_SIZE];
+static int key_tokens_len = 0;
+static int feed_mode = MODE_NORMAL; /* mode of the last keybind_feed() */
 static struct timespec last_key_time;
 static int pending_count = 0; /* numeric prefix */
 static int have_count = 0;
+
 /* Helper: convert key code to string representation */
 static void key_to_string(int key, char *buf, size_t bufsize) {
     if (KEY_IS_META(key) || KEY_IS_CTRL(key) || KEY_IS_SHIFT(key)) {
@@ -133,14 +138,186 @@ static int timeout_exceeded(void) {
     return elapsed_ms > SEQUENCE_TIMEOUT_MS;
 }
 
+/* ========================================================================
+ * Dispatch trie
+ *
+ * Sequences are split into key tokens, spelled the way key_to_string()
+ * spells a key ("d", "<C-x>", "<S-Tab>"), and each distinct token gets
+ * a small integer id. Bindings are compiled into one trie over those
+ * ids per (mode, filetype), so resolving a key costs one step per key
+ * typed so far however many bindings there are. Registration only marks
+ * the tries stale; they are rebuilt on the next feed.
+ * ======================================================================== */
+
+typedef struct {
+    int tok;
+    int node;
+} KbEdge;
+
+typedef struct {
+    KbEdge *kids;  /* stb_ds array, sorted by tok */
+    int     bind;  /* keybinds[] index ending here, -1 if none */
+    int     below; /* bindings strictly below this node */
+} KbNode;
+
+typedef struct {
+    int         mode;
+    const char *filetype; /* NULL = global; borrowed from a Keybind */
+    int         root;
+} KbTrie;
+
+static KbNode *kb_nodes = NULL;
+static KbTrie *kb_tries = NULL;
+static bool kb_tries_stale = true;
+
+/* Token spelling -> id, and id -> spelling (owned by tok_ids). */
+static struct { char *key; int value; } *tok_ids = NULL;
+static char **tok_names = NULL;
+
+/* Key code -> token id, so key_to_string() runs once per distinct key. */
+#define KEY_TOK_SLOTS 256
+static struct {
+    int key;
+    int tok1; /* token id + 1; 0 = empty slot */
+} key_toks[KEY_TOK_SLOTS];
+
+static int tok_intern(const char *s, size_t len) {
+    char name[64];
+    if (len >= sizeof(name)) len = sizeof(name) - 1;
+    memcpy(name, s, len);
+    name[len] = '\0';
+    if (!tok_ids) sh_new_strdup(tok_ids);
+    ptrdiff_t i = shgeti(tok_ids, name);
+    if (i >= 0) return tok_ids[i].value;
+    int id = (int)arrlen(tok_names);
+    shput(tok_ids, name, id);
+    arrput(tok_names, tok_ids[shgeti(tok_ids, name)].key);
+    return id;
+}
+
+static int key_token(int key) {
+    unsigned slot = ((unsigned)key * 2654435761u) >> 24;
+    if (key_toks[slot].tok1 && key_toks[slot].key == key)
+        return key_toks[slot].tok1 - 1;
+    char s[128];
+    key_to_string(key, s, sizeof(s));
+    int tok = tok_intern(s, strlen(s));
+    key_toks[slot].key  = key;
+    key_toks[slot].tok1 = tok + 1;
+    return tok;
+}
+
+/* Length of the token at the start of a registered sequence: a key name
+ * in angle brackets as key_to_string() writes it ("<CR>", "<C-k>",
+ * "<M->>", "<C-S-Right>"), or else one byte, so "<<" is two '<'. */
+static size_t seq_token_len(const char *s) {
+    if (s[0] != '<') return 1;
+    const char *p = s + 1;
+    bool mods = false;
+    while ((p[0] == 'M' || p[0] == 'C' || p[0] == 'S') && p[1] == '-') {
+        p += 2;
+        mods = true;
+    }
+    if (mods && p[0] && p[1] == '>') return (size_t)(p + 2 - s);
+    const char *word = p;
+    while (isalnum((unsigned char)*p)) p++;
+    if (*p == '>' && p - word >= (mods ? 1 : 2)) return (size_t)(p + 1 - s);
+    return 1;
+}
+
+static int trie_node_new(void) {
+    KbNode n = { .kids = NULL, .bind = -1, .below = 0 };
+    arrput(kb_nodes, n);
+    return (int)arrlen(kb_nodes) - 1;
+}
+
+/* Slot of `tok` among the node's children, or -(insertion point + 1). */
+static int edge_find(const KbNode *n, int tok) {
+    int lo = 0, hi = (int)arrlen(n->kids);
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (n->kids[mid].tok < tok) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < (int)arrlen(n->kids) && n->kids[lo].tok == tok) return lo;
+    return -(lo + 1);
+}
+
+static int trie_root(int mode, const char *filetype, bool create) {
+    for (ptrdiff_t i = 0; i < arrlen(kb_tries); i++) {
+        if (kb_tries[i].mode != mode) continue;
+        const char *ft = kb_tries[i].filetype;
+        if (ft == filetype || (ft && filetype && strcmp(ft, filetype) == 0))
+            return kb_tries[i].root;
+    }
+    if (!create) return -1;
+    KbTrie t = { .mode = mode, .filetype = filetype, .root = trie_node_new() };
+    arrput(kb_tries, t);
+    return t.root;
+}
+
+static void trie_insert(int bind) {
+    const Keybind *kb = &keybinds[bind];
+    int node = trie_root(kb->mode, kb->filetype, true);
+    for (const char *s = kb->sequence; *s;) {
+        size_t len = seq_token_len(s);
+        int tok = tok_intern(s, len);
+        s += len;
+        kb_nodes[node].below++;
+        int slot = edge_find(&kb_nodes[node], tok);
+        if (slot >= 0) {
+            node = kb_nodes[node].kids[slot].node;
+            continue;
+        }
+        int child = trie_node_new();
+        KbEdge **kids = &kb_nodes[node].kids;
+        size_t   at   = (size_t)-(slot + 1);
+        (void)arraddnptr(*kids, 1);
+        memmove(&(*kids)[at + 1], &(*kids)[at],
+                (arrlenu(*kids) - 1 - at) * sizeof(KbEdge));
+        (*kids)[at] = (KbEdge){ .tok = tok, .node = child };
+        node = child;
+    }
+    kb_nodes[node].bind = bind;
+}
+
+static void trie_free(void) {
+    for (ptrdiff_t i = 0; i < arrlen(kb_nodes); i++)
+        arrfree(kb_nodes[i].kids);
+    arrfree(kb_nodes);
+    arrfree(kb_tries);
+    kb_nodes = NULL;
+    kb_tries = NULL;
+}
+
+static void trie_rebuild(void) {
+    trie_free();
+    for (ptrdiff_t i = 0; i < arrlen(keybinds); i++)
+        trie_insert((int)i);
+    kb_tries_stale = false;
+}
+
+/* Node reached from `root` by the keys typed so far, or -1. */
+static int trie_walk(int root) {
+    int node = root;
+    for (int i = 0; i < key_tokens_len && node >= 0; i++) {
+        int slot = edge_find(&kb_nodes[node], key_tokens[i]);
+        node = slot >= 0 ? kb_nodes[node].kids[slot].node : -1;
+    }
+    return node;
+}
+
 /* Initialize keybinding system. User content is registered later from
  * config_init() (see src/config.c). Registration uses last-write-wins,
  * so the order in config_init determines precedence. */
 void keybind_init(void) {
     arrfree(keybinds);
     keybinds = NULL;
+    trie_free();
+    kb_tries_stale = true;
     key_buffer_len = 0;
     key_buffer[0] = '\0';
+    key_tokens_len = 0;
     clock_gettime(CLOCK_MONOTONIC, &last_key_time);
 }
 
@@ -148,6 +325,8 @@ void keybind_state_save(KeybindState *out) {
     if (!out) return;
     memcpy(out->key_buffer, key_buffer, sizeof(out->key_buffer));
     out->key_buffer_len = key_buffer_len;
+    memcpy(out->key_tokens, key_tokens, sizeof(out->key_tokens));
+    out->key_tokens_len = key_tokens_len;
     out->pending_count  = pending_count;
     out->have_count     = have_count;
 }
@@ -156,6 +335,8 @@ void keybind_state_load(const KeybindState *in) {
     if (!in) return;
     memcpy(key_buffer, in->key_buffer, sizeof(key_buffer));
     key_buffer_len = in->key_buffer_len;
+    memcpy(key_tokens, in->key_tokens, sizeof(key_tokens));
+    key_tokens_len = in->key_tokens_len;
     pending_count  = in->pending_count;
     have_count     = in->have_count;
 }
@@ -178,6 +359,7 @@ static void remove_duplicate(int mode, const char *sequence,
         free(keybinds[i].cmdline);
         free(keybinds[i].filetype);
         arrdel(keybinds, i);
+        kb_tries_stale = true;
         return; /* invariant: at most one match exists */
     }
 }
@@ -196,6 +378,7 @@ void keybind_register(int mode, const char *sequence,
         .filetype         = NULL,
     };
     arrput(keybinds, kb);
+    kb_tries_stale = true;
 }
 
 void keybind_register_ft(int mode, const char *sequence, const char *filetype,
@@ -211,6 +394,7 @@ void keybind_register_ft(int mode, const char *sequence, const char *filetype,
         .filetype         = filetype ? strdup(filetype) : NULL,
     };
     arrput(keybinds, kb);
+    kb_tries_stale = true;
 }
 
 static void kb_run_command(const char *cmdline) {
@@ -248,6 +432,7 @@ void keybind_register_command(int mode, const char *sequence,
         .filetype         = NULL,
     };
     arrput(keybinds, kb);
+    kb_tries_stale = true;
 }
 
 void keybind_register_command_ft(int mode, const char *sequence,
@@ -264,12 +449,14 @@ void keybind_register_command_ft(int mode, const char *sequence,
         .filetype         = filetype ? strdup(filetype) : NULL,
     };
     arrput(keybinds, kb);
+    kb_tries_stale = true;
 }
 
 /* Clear the key buffer */
 void keybind_clear_buffer(void) {
     key_buffer_len = 0;
     key_buffer[0] = '\0';
+    key_tokens_len = 0;
     pending_count = 0;
     have_count = 0;
 }
@@ -383,62 +570,39 @@ KeybindFeedResult keybind_feed(int key, int mode) {
         return r;
     }
 
-    /* Convert key to string and append to buffer */
-    char key_str[128];
-    key_to_string(key, key_str, sizeof(key_str));
+    /* Append the key's token and its spelling. */
+    int tok = key_token(key);
+    const char *name = tok_names[tok];
+    size_t name_len = strlen(name);
 
-    if (key_buffer_len + strlen(key_str) < KEY_BUFFER_SIZE - 1) {
-        EdError err = safe_strcat(key_buffer, key_str, KEY_BUFFER_SIZE);
-        if (err != ED_OK) {
-            keybind_clear_buffer();
-            safe_strcpy(key_buffer, key_str, KEY_BUFFER_SIZE);
-        }
-        key_buffer_len = strlen(key_buffer);
+    if (key_buffer_len + name_len < KEY_BUFFER_SIZE - 1) {
+        memcpy(key_buffer + key_buffer_len, name, name_len + 1);
+        key_buffer_len += (int)name_len;
     } else {
         keybind_clear_buffer();
-        safe_strcpy(key_buffer, key_str, KEY_BUFFER_SIZE);
+        safe_strcpy(key_buffer, name, KEY_BUFFER_SIZE);
         key_buffer_len = strlen(key_buffer);
     }
+    key_tokens[key_tokens_len++] = tok;
+    feed_mode = mode;
 
-    /* Scan registry. Filetype-specific matches take priority over global
-     * for the same sequence. Collect every (still-reachable) match —
-     * exact or partial — for the caller to display. */
-    int exact_global = -1;
-    int exact_ft     = -1;
+    /* Walk the global trie and the current filetype's. A filetype
+     * binding takes priority over a global one on the same sequence. */
+    if (kb_tries_stale) trie_rebuild();
 
     const char *cur_ft = NULL;
     {
         Buffer *cb = buf_cur();
         if (cb) cur_ft = cb->filetype;
     }
+    int gnode = trie_walk(trie_root(mode, NULL, false));
+    int fnode = cur_ft ? trie_walk(trie_root(mode, cur_ft, false)) : -1;
 
-    for (ptrdiff_t i = 0; i < arrlen(keybinds); i++) {
-        if (keybinds[i].mode != mode) continue;
-
-        bool ft_applicable =
-            keybinds[i].filetype == NULL ||
-            (cur_ft && strcmp(keybinds[i].filetype, cur_ft) == 0);
-        if (!ft_applicable) continue;
-
-        bool is_exact = strcmp(keybinds[i].sequence, key_buffer) == 0;
-        bool is_prefix =
-            !is_exact &&
-            strncmp(keybinds[i].sequence, key_buffer, key_buffer_len) == 0;
-
-        if (is_exact) {
-            if (keybinds[i].filetype) {
-                exact_ft = (int)i;
-            } else if (exact_global < 0) {
-                exact_global = (int)i; /* keep first global */
-            }
-        }
-
-        if (is_exact || is_prefix) {
-            arrput(r.matches, make_view(&keybinds[i]));
-        }
-    }
-
-    int exact_idx = exact_ft >= 0 ? exact_ft : exact_global;
+    int exact_idx = -1;
+    if (fnode >= 0 && kb_nodes[fnode].bind >= 0)
+        exact_idx = kb_nodes[fnode].bind;
+    else if (gnode >= 0 && kb_nodes[gnode].bind >= 0)
+        exact_idx = kb_nodes[gnode].bind;
 
     r.active_sequence = key_buffer;
     r.active_len      = key_buffer_len;
@@ -448,13 +612,12 @@ KeybindFeedResult keybind_feed(int key, int mode) {
     if (r.exact) {
         r.exact_match = make_view(&keybinds[exact_idx]);
     }
-    /* "Partial" = at least one *other* sequence could still be completed.
-     * If only the exact match itself is in the list, there's no point
-     * waiting for more keys. */
-    r.partial = arrlen(r.matches) > (r.exact ? 1 : 0);
+    /* "Partial" = some longer sequence could still be completed. */
+    r.partial = (gnode >= 0 && kb_nodes[gnode].below > 0) ||
+                (fnode >= 0 && kb_nodes[fnode].below > 0);
 
     /* Single unmapped key in NORMAL: caller may want operator_move. */
-    if (!r.exact && !r.partial && mode == MODE_NORMAL && key_buffer_len == 1) {
+    if (!r.exact && !r.partial && mode == MODE_NORMAL && key_tokens_len == 1) {
         r.fallback_textobj = true;
     }
 
@@ -466,18 +629,31 @@ KeybindFeedResult keybind_feed(int key, int mode) {
         .exact               = r.exact,
         .partial             = r.partial,
         .consumed_count_only = r.consumed_count_only,
-        .matches             = r.matches,
-        .match_count         = (int)arrlen(r.matches),
     };
     hook_fire_keybind_feed(HOOK_KEYBIND_FEED, &ev);
 
     return r;
 }
 
-void keybind_feed_result_free(KeybindFeedResult *r) {
-    if (!r) return;
-    arrfree(r->matches);
-    r->matches = NULL;
+static void collect_below(int node, KeybindMatchView **out) {
+    if (kb_nodes[node].bind >= 0)
+        arrput(*out, make_view(&keybinds[kb_nodes[node].bind]));
+    for (ptrdiff_t i = 0; i < arrlen(kb_nodes[node].kids); i++)
+        collect_below(kb_nodes[node].kids[i].node, out);
+}
+
+KeybindMatchView *keybind_collect_matches(void) {
+    KeybindMatchView *out = NULL;
+    if (key_tokens_len == 0) return NULL;
+    if (kb_tries_stale) trie_rebuild();
+
+    Buffer *cb = buf_cur();
+    const char *cur_ft = cb ? cb->filetype : NULL;
+    int fnode = cur_ft ? trie_walk(trie_root(feed_mode, cur_ft, false)) : -1;
+    int gnode = trie_walk(trie_root(feed_mode, NULL, false));
+    if (fnode >= 0) collect_below(fnode, &out);
+    if (gnode >= 0) collect_below(gnode, &out);
+    return out;
 }
 
 void keybind_invoke(const KeybindMatchView *m, int repeat) {
@@ -541,7 +717,6 @@ bool keybind_process(int key, int mode) {
         keybind_clear_buffer();
     }
 
-    keybind_feed_result_free(&r);
     return handled;
 }
 
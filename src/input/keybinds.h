@@ -109,20 +109,13 @@ typedef struct KeybindFeedResult {
     bool partial;
 
     /* The key was swallowed as part of the numeric prefix and the
-     * sequence buffer is still empty. matches is empty in this case
-     * to avoid dumping the entire keymap. */
+     * sequence buffer is still empty. */
     bool consumed_count_only;
 
     /* Single unmapped key in NORMAL mode: keybind_process() falls
      * back to operator_move. Exposed here so callers driving the
      * API directly can decide for themselves. */
     bool fallback_textobj;
-
-    /* stb_ds dynamic array of all matches for the current
-     * active_sequence (empty when active_sequence is empty). Includes
-     * both the exact match and sequences still waiting to complete.
-     * Free with keybind_feed_result_free. */
-    KeybindMatchView *matches;
 } KeybindFeedResult;
 
 /* Feed one key into the dispatcher. Updates the internal sequence
@@ -130,8 +123,11 @@ typedef struct KeybindFeedResult {
  * state. Does NOT run any callback. */
 KeybindFeedResult keybind_feed(int key, int mode);
 
-/* Free the matches array attached to a feed result. */
-void keybind_feed_result_free(KeybindFeedResult *r);
+/* Every binding for the sequence typed so far, in the mode of the last
+ * feed: the exact match and those still waiting to complete. Built on
+ * demand for UIs like whichkey; NULL when the sequence is empty. Free
+ * the stb_ds array with arrfree(). */
+KeybindMatchView *keybind_collect_matches(void);
 
 /* Execute a specific keybinding `repeat` times. Stateless: does not
  * read or modify the sequence buffer or the numeric prefix; the
@@ -155,6 +151,8 @@ void keybind_clear_buffer(void);
 typedef struct KeybindState {
     char key_buffer[16]; /* matches KEY_BUFFER_SIZE in keybinds.c */
     int  key_buffer_len;
+    int  key_tokens[16];
+    int  key_tokens_len;
     int  pending_count;
     int  have_count;
 } KeybindState;
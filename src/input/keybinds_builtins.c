@@ -55,7 +55,7 @@ Selection kb_make_selection(Window *win, Buffer *buf,
         s.anchor_rx = win->sel.anchor_rx;
         s.block_start_rx = win->sel.anchor_rx;
         s.block_end_rx =
-            buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+            buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
         if (s.block_start_rx > s.block_end_rx) {
             int t = s.block_start_rx;
             s.block_start_rx = s.block_end_rx;
@@ -74,7 +74,7 @@ static void visual_begin(int block) {
     win->sel.anchor_y = win->cursor.y;
     win->sel.anchor_x = win->cursor.x;
     win->sel.anchor_rx =
-        buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+        buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     win->sel.block_start_rx = win->sel.anchor_rx;
     win->sel.block_end_rx = win->sel.anchor_rx;
     ed_set_mode(block ? MODE_VISUAL_BLOCK : MODE_VISUAL);
@@ -100,8 +100,8 @@ static int visual_char_range(Buffer *buf, Window *win, int *sy, int *sx,
         top_y = 0;
     if (bot_y >= buf->num_rows)
         bot_y = buf->num_rows - 1;
-    Row *top_row = &buf->rows[top_y];
-    Row *bot_row = &buf->rows[bot_y];
+    Row *top_row = buf_row(buf, top_y);
+    Row *bot_row = buf_row(buf, bot_y);
     if (top_x > (int)top_row->chars.len)
         top_x = (int)top_row->chars.len;
     if (bot_x > (int)bot_row->chars.len)
@@ -128,7 +128,7 @@ static int visual_block_range(Buffer *buf, Window *win, int *sy, int *ey,
         win->sel.anchor_y < win->cursor.y ? win->sel.anchor_y : win->cursor.y;
     int bot_y =
         win->sel.anchor_y > win->cursor.y ? win->sel.anchor_y : win->cursor.y;
-    int cur_rx = buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+    int cur_rx = buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     int start = win->sel.anchor_rx < cur_rx ? win->sel.anchor_rx : cur_rx;
     int end = win->sel.anchor_rx > cur_rx ? win->sel.anchor_rx : cur_rx;
     if (sy)
@@ -170,7 +170,7 @@ int kb_visual_to_textsel(Buffer *buf, Window *win, int block_mode,
         int sy, ey;
         if (!visual_line_range(buf, win, &sy, &ey))
             return 0;
-        int ex = (int)buf->rows[ey].chars.len;
+        int ex = (int)buf_row(buf, ey)->chars.len;
         *out = textsel_make_range(sy, 0, ey, ex, SEL_VISUAL_LINE);
         return 1;
     }
@@ -185,7 +185,7 @@ int kb_visual_to_textsel(Buffer *buf, Window *win, int block_mode,
     if (!visual_block_range(buf, win, &sy, &ey, &start_rx, &end_rx_excl))
         return 0;
     /* For block mode, convert render columns to character columns */
-    Row *first_row = &buf->rows[sy];
+    Row *first_row = buf_row(buf, sy);
     int sx = buf_row_rx_to_cx(first_row, start_rx);
     int ex = buf_row_rx_to_cx(first_row, end_rx_excl);
     *out = textsel_make_range(sy, sx, ey, ex, SEL_VISUAL_BLOCK);
@@ -232,7 +232,7 @@ static int visual_delete(Buffer *buf, Window *win, int block_mode) {
         yank_block(buf, sy, ey, s_rx, e_rx);
         buf_delete_block(buf, sy, ey, s_rx, e_rx);
         win->cursor.y = sy;
-        win->cursor.x = buf_row_rx_to_cx(&buf->rows[sy], s_rx);
+        win->cursor.x = buf_row_rx_to_cx(buf_row(buf, sy), s_rx);
         visual_clear(win);
         ed_set_mode(MODE_NORMAL);
         return 1;
@@ -324,7 +324,7 @@ void kb_append_mode(void) {
     BUFWIN(buf, win)
     ed_set_mode(MODE_INSERT);
     if (win->cursor.y < buf->num_rows) {
-        Row *row = &buf->rows[win->cursor.y];
+        Row *row = buf_row(buf, win->cursor.y);
         if (win->cursor.x < (int)row->chars.len)
             win->cursor.x++;
     }
@@ -365,7 +365,7 @@ void kb_visual_line_toggle(void) {
     win->sel.anchor_y = win->cursor.y;
     win->sel.anchor_x = win->cursor.x;
     win->sel.anchor_rx =
-        buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+        buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     win->sel.block_start_rx = win->sel.anchor_rx;
     win->sel.block_end_rx = win->sel.anchor_rx;
     ed_set_mode(MODE_VISUAL_LINE);
@@ -587,7 +587,7 @@ void kb_operator_select(void) {
     win->sel.type = SEL_VISUAL;
     win->sel.anchor_y = win->cursor.y;
     win->sel.anchor_x = win->cursor.x;
-    win->sel.anchor_rx = buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+    win->sel.anchor_rx = buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     ed_set_mode(MODE_VISUAL);
 
     ed_set_status_message("-- VISUAL --");
@@ -768,6 +768,13 @@ void kb_search_next(void) {
     buf_find_in(buf);
 }
 
+void kb_search_prev(void) {
+    Buffer *buf = buf_cur();
+    if (!buf) return;
+    jump_save_current();
+    buf_find_prev_in(buf);
+}
+
 void kb_find_under_cursor(void) {
     StrView w;
     if (!buf_word_view_under_cursor(&w)) {
@@ -775,6 +782,7 @@ void kb_find_under_cursor(void) {
     }
     strbuf_free(&E.search_query);
     E.search_query = strbuf_from_view(w);
+    E.search_is_regex = 0;
     ed_set_status_message("* %.*s", (int)(w.len > 40 ? 40 : w.len), w.data);
     jump_save_current();
     buf_find_in(buf_cur());
@@ -792,7 +800,7 @@ void kb_find_selection(void) {
         ed_set_status_message("*: multi-line selection not supported");
         return;
     }
-    Row *row = &buf->rows[sy];
+    Row *row = buf_row(buf, sy);
     if (ex > (int)row->chars.len) ex = (int)row->chars.len;
     if (ex <= sx) {
         ed_set_status_message("*: empty selection");
@@ -906,7 +914,7 @@ void kb_open_file_under_cursor(void) {
             if (line > 0)
                 buf_goto_line(line);
             if (col > 0 && win->cursor.y < buf->num_rows) {
-                int max = buf->rows[win->cursor.y].chars.len;
+                int max = buf_row(buf, win->cursor.y)->chars.len;
                 int cx = col - 1;
                 if (cx < 0)
                     cx = 0;
@@ -1018,7 +1026,7 @@ void kb_toggle_case(void) {
     if (win->cursor.y >= buf->num_rows)
         return;
 
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     if (win->cursor.x >= (int)row->chars.len)
         return;
 
@@ -1026,6 +1034,7 @@ void kb_toggle_case(void) {
     char new_char = char_toggle_case(old_char);
 
     if (new_char != old_char) {
+        undo_record_replace(buf, win->cursor.y);
         row->chars.data[win->cursor.x] = new_char;
         buf_row_update(row);
         buf->dirty++;
@@ -1041,7 +1050,7 @@ void kb_replace_char(void) {
 	ASSERT_EDIT(buf, win)
     if (buf->num_rows == 0)
         return;
-    Row *row = &buf->rows[win->cursor.y];
+    Row *row = buf_row(buf, win->cursor.y);
     if (win->cursor.x >= (int)row->chars.len)
         return;
 
@@ -1060,6 +1069,7 @@ void kb_replace_char(void) {
         return;
     }
 
+    undo_record_replace(buf, win->cursor.y);
     row->chars.data[win->cursor.x] = (char)c;
     buf_row_update(row);
     buf->dirty++;
@@ -1109,13 +1119,7 @@ void kb_fold_open_all(void) {
     if (!buf)
         return;
 
-    int count = 0;
-    for (int i = 0; i < buf->folds.count; i++) {
-        if (buf->folds.regions[i].is_collapsed) {
-            buf->folds.regions[i].is_collapsed = false;
-            count++;
-        }
-    }
+    int count = fold_set_all_collapsed(&buf->folds, false);
     ed_set_status_message("Opened %d fold%s", count, count == 1 ? "" : "s");
 }
 
@@ -1124,13 +1128,7 @@ void kb_fold_close_all(void) {
     if (!buf)
         return;
 
-    int count = 0;
-    for (int i = 0; i < buf->folds.count; i++) {
-        if (!buf->folds.regions[i].is_collapsed) {
-            buf->folds.regions[i].is_collapsed = true;
-            count++;
-        }
-    }
+    int count = fold_set_all_collapsed(&buf->folds, true);
     ed_set_status_message("Closed %d fold%s", count, count == 1 ? "" : "s");
 }
 
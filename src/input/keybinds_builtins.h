@@ -31,6 +31,7 @@ void kb_operator_move(int key);    /* Move cursor via text object (fallback) */
 void kb_operator_select(void);     /* Visual select via text object (v + motion) */
 /* Note: cursor movements now handled by text object system */
 void kb_search_next(void);
+void kb_search_prev(void);
 void kb_find_under_cursor(void);
 void kb_find_selection(void);      /* Visual `*`: search the selection */
 void kb_search_file_under_cursor(void);
@@ -0,0 +1,683 @@
+#include "lib/regsearch.h"
+#include "lib/strsearch.h"
+#include "stb_ds.h"
+
+#include <ctype.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RS_NFA_MAX 4096 /* NFA states before a pattern is left to regexec */
+#define RS_DFA_MAX 1024 /* DFA states per automaton, likewise */
+#define RS_DEPTH_MAX 64 /* group nesting the parser follows */
+
+typedef enum { RS_POSIX, RS_LITERAL, RS_DFA } RsMode;
+
+typedef struct { uint8_t bits[32]; } ByteSet;
+
+/* Parse tree. RX_REPEAT has max -1 for "unbounded". */
+typedef enum { RX_EMPTY, RX_SET, RX_CAT, RX_ALT, RX_REPEAT } RxKind;
+
+typedef struct {
+    RxKind kind;
+    int    a, b;     /* children (node indices) */
+    int    min, max; /* RX_REPEAT */
+    int    set;      /* RX_SET: index into sets */
+} RxNode;
+
+/* NFA state: consumes one byte of `set` and goes to `out`; or, with
+ * set == NS_SPLIT, moves to `out` and `out1` (-1 = none) without
+ * consuming; or accepts (NS_MATCH). */
+#define NS_SPLIT (-1)
+#define NS_MATCH (-2)
+typedef struct { int set, out, out1; } NState;
+
+typedef struct {
+    int *ids;       /* stb_ds; consuming and match NFA states, sorted */
+    bool accept;
+    bool dead;      /* no NFA state left: no match can follow */
+    int  next[256]; /* DFA state per byte; -1 = not built yet */
+} DState;
+
+typedef struct {
+    DState *st;                              /* stb_ds */
+    struct { char *key; int value; } *index; /* stb_ds; NFA set -> st[] */
+    int     start;                           /* -1 until built */
+    bool    floating;  /* re-enter the start at every byte (search) */
+} Dfa;
+
+struct RegSearch {
+    char     *pattern;
+    bool      icase;
+    regex_t   re;        /* always compiled: error text and fallback */
+    RsMode    mode;
+    StrSearch lit;       /* RS_LITERAL; the needle is `pattern` */
+
+    /* RS_DFA */
+    NState   *nfa;       /* stb_ds */
+    ByteSet  *sets;      /* stb_ds */
+    int       start, match;
+    bool      anchor_start, anchor_end;
+    Dfa       anchored, floating;
+    bool      first[256]; /* bytes a match can begin with */
+    bool      skip;      /* `first` is usable: no empty match */
+    unsigned *mark;      /* closure scratch, one stamp per NFA state */
+    unsigned  stamp;
+    int      *stack;     /* stb_ds; closure scratch */
+};
+
+/* ---- byte sets ---- */
+
+static void set_add(ByteSet *s, int c) { s->bits[c >> 3] |= (uint8_t)(1u << (c & 7)); }
+static bool set_has(const ByteSet *s, int c) { return s->bits[c >> 3] >> (c & 7) & 1; }
+
+static void set_fold(ByteSet *s) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (set_has(s, c) || set_has(s, c - 32)) {
+            set_add(s, c);
+            set_add(s, c - 32);
+        }
+    }
+}
+
+static void set_invert(ByteSet *s) {
+    for (int i = 0; i < 32; i++) s->bits[i] = (uint8_t)~s->bits[i];
+}
+
+static void set_add_class(ByteSet *s, int (*pred)(int)) {
+    for (int c = 0; c < 256; c++)
+        if (pred(c)) set_add(s, c);
+}
+
+static int is_word(int c) { return isalnum(c) || c == '_'; }
+
+/* ---- parser ----
+ *
+ * Recursive descent over the ERE grammar. Anything it does not handle
+ * clears `ok`, and the pattern is left to regexec(), which also owns
+ * the verdict on whether the pattern is valid at all. */
+
+typedef struct {
+    const char *pat, *p;
+    bool        icase, ok, top_alt;
+    int         depth;
+    bool        anchor_start, anchor_end;
+    RxNode     *nodes; /* stb_ds */
+    ByteSet    *sets;  /* stb_ds */
+} Parser;
+
+static int node_new(Parser *ps, RxKind kind, int a, int b) {
+    RxNode n = { .kind = kind, .a = a, .b = b };
+    arrput(ps->nodes, n);
+    return (int)arrlen(ps->nodes) - 1;
+}
+
+static int node_set(Parser *ps, ByteSet set, bool negate) {
+    if (ps->icase) set_fold(&set);
+    if (negate) set_invert(&set);
+    arrput(ps->sets, set);
+    int n = node_new(ps, RX_SET, -1, -1);
+    ps->nodes[n].set = (int)arrlen(ps->sets) - 1;
+    return n;
+}
+
+static int node_byte(Parser *ps, int c) {
+    ByteSet s = {0};
+    set_add(&s, c);
+    return node_set(ps, s, false);
+}
+
+static int parse_alt(Parser *ps);
+
+static const struct { const char *name; int (*pred)(int); } k_classes[] = {
+    { "alpha", isalpha }, { "digit", isdigit }, { "alnum", isalnum },
+    { "upper", isupper }, { "lower", islower }, { "space", isspace },
+    { "blank", isblank }, { "punct", ispunct }, { "print", isprint },
+    { "graph", isgraph }, { "cntrl", iscntrl }, { "xdigit", isxdigit },
+};
+
+/* After the '['. */
+static int parse_bracket(Parser *ps) {
+    ByteSet s = {0};
+    bool negate = false;
+    if (*ps->p == '^') { negate = true; ps->p++; }
+    bool first = true;
+    while (first || *ps->p != ']') {
+        first = false;
+        unsigned char c = (unsigned char)*ps->p;
+        if (c == '\0') { ps->ok = false; return -1; }
+        if (c == '[' && (ps->p[1] == '=' || ps->p[1] == '.')) {
+            ps->ok = false; /* equivalence classes, collating symbols */
+            return -1;
+        }
+        if (c == '[' && ps->p[1] == ':') {
+            const char *name = ps->p + 2, *end = strstr(name, ":]");
+            if (!end) { ps->ok = false; return -1; }
+            size_t k, len = (size_t)(end - name);
+            for (k = 0; k < sizeof(k_classes) / sizeof(k_classes[0]); k++)
+                if (strlen(k_classes[k].name) == len &&
+                    memcmp(k_classes[k].name, name, len) == 0)
+                    break;
+            if (k == sizeof(k_classes) / sizeof(k_classes[0])) {
+                ps->ok = false;
+                return -1;
+            }
+            set_add_class(&s, k_classes[k].pred);
+            ps->p = end + 2;
+            continue;
+        }
+        ps->p++;
+        if (*ps->p == '-' && ps->p[1] != ']' && ps->p[1] != '\0') {
+            unsigned char hi = (unsigned char)ps->p[1];
+            if (hi == '[' || hi < c) { ps->ok = false; return -1; }
+            for (int x = c; x <= hi; x++) set_add(&s, x);
+            ps->p += 2;
+        } else {
+            set_add(&s, c);
+        }
+    }
+    ps->p++; /* ']' */
+    return node_set(ps, s, negate);
+}
+
+static int parse_atom(Parser *ps) {
+    char c = *ps->p;
+    switch (c) {
+    case '(': {
+        if (++ps->depth > RS_DEPTH_MAX) { ps->ok = false; return -1; }
+        ps->p++;
+        int n = parse_alt(ps);
+        if (!ps->ok) return -1;
+        if (*ps->p != ')') { ps->ok = false; return -1; }
+        ps->p++;
+        ps->depth--;
+        return n;
+    }
+    case '[':
+        ps->p++;
+        return parse_bracket(ps);
+    case '.': {
+        ps->p++;
+        ByteSet s;
+        memset(&s, 0xff, sizeof(s));
+        return node_set(ps, s, false);
+    }
+    case '^':
+        /* Only as the pattern's first byte; anywhere else it is an
+         * assertion the DFA does not model. */
+        if (ps->p != ps->pat) { ps->ok = false; return -1; }
+        ps->p++;
+        ps->anchor_start = true;
+        return node_new(ps, RX_EMPTY, -1, -1);
+    case '$':
+        if (ps->p[1] != '\0' || ps->depth > 0) { ps->ok = false; return -1; }
+        ps->p++;
+        ps->anchor_end = true;
+        return node_new(ps, RX_EMPTY, -1, -1);
+    case '\\': {
+        char e = ps->p[1];
+        ps->p += 2;
+        ByteSet s = {0};
+        switch (e) {
+        case 'w': set_add_class(&s, is_word); return node_set(ps, s, false);
+        case 'W': set_add_class(&s, is_word); return node_set(ps, s, true);
+        case 's': set_add_class(&s, isspace); return node_set(ps, s, false);
+        case 'S': set_add_class(&s, isspace); return node_set(ps, s, true);
+        case '\0': case 'b': case 'B': case '<': case '>': case '`': case '\'':
+            ps->ok = false;
+            return -1;
+        default:
+            if (e >= '1' && e <= '9') { ps->ok = false; return -1; }
+            return node_byte(ps, (unsigned char)e);
+        }
+    }
+    case '*': case '+': case '?': case '{': case ')': case '|': case '\0':
+        ps->ok = false; /* nothing to repeat, or a stray bracket */
+        return -1;
+    default:
+        ps->p++;
+        return node_byte(ps, (unsigned char)c);
+    }
+}
+
+static bool parse_int(Parser *ps, int *out) {
+    if (!isdigit((unsigned char)*ps->p)) return false;
+    int v = 0;
+    while (isdigit((unsigned char)*ps->p)) {
+        v = v * 10 + (*ps->p++ - '0');
+        if (v > 255) return false; /* RE_DUP_MAX */
+    }
+    *out = v;
+    return true;
+}
+
+static int parse_repeat(Parser *ps) {
+    bool anchor = *ps->p == '^' || *ps->p == '$';
+    int  n = parse_atom(ps);
+    while (ps->ok) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*')      { min = 0; max = -1; ps->p++; }
+        else if (c == '+') { min = 1; max = -1; ps->p++; }
+        else if (c == '?') { min = 0; max = 1;  ps->p++; }
+        else if (c == '{') {
+            ps->p++;
+            if (!parse_int(ps, &min)) { ps->ok = false; break; }
+            max = min;
+            if (*ps->p == ',') {
+                ps->p++;
+                max = -1;
+                if (*ps->p != '}' && (!parse_int(ps, &max) || max < min)) {
+                    ps->ok = false;
+                    break;
+                }
+            }
+            if (*ps->p != '}') { ps->ok = false; break; }
+            ps->p++;
+        } else {
+            break;
+        }
+        if (anchor) { ps->ok = false; break; }
+        n = node_new(ps, RX_REPEAT, n, -1);
+        ps->nodes[n].min = min;
+        ps->nodes[n].max = max;
+    }
+    return n;
+}
+
+static int parse_cat(Parser *ps) {
+    int n = -1;
+    while (ps->ok && *ps->p && *ps->p != '|' && *ps->p != ')') {
+        int m = parse_repeat(ps);
+        n = n < 0 ? m : node_new(ps, RX_CAT, n, m);
+    }
+    return n < 0 ? node_new(ps, RX_EMPTY, -1, -1) : n;
+}
+
+static int parse_alt(Parser *ps) {
+    int n = parse_cat(ps);
+    while (ps->ok && *ps->p == '|') {
+        if (ps->depth == 0) ps->top_alt = true;
+        ps->p++;
+        n = node_new(ps, RX_ALT, n, parse_cat(ps));
+    }
+    return n;
+}
+
+/* ---- NFA ----
+ *
+ * Built back to front: each node is compiled with the state it must
+ * continue to, so repeats are just the body compiled once per copy. */
+
+static int nfa_new(RegSearch *rs, int set, int out, int out1) {
+    if (arrlen(rs->nfa) >= RS_NFA_MAX) return -1;
+    NState s = { set, out, out1 };
+    arrput(rs->nfa, s);
+    return (int)arrlen(rs->nfa) - 1;
+}
+
+static int nfa_build(RegSearch *rs, const RxNode *nodes, int n, int next) {
+    if (next < 0) return -1;
+    const RxNode *nd = &nodes[n];
+    switch (nd->kind) {
+    case RX_EMPTY:
+        return next;
+    case RX_SET:
+        return nfa_new(rs, nd->set, next, -1);
+    case RX_CAT:
+        return nfa_build(rs, nodes, nd->a, nfa_build(rs, nodes, nd->b, next));
+    case RX_ALT: {
+        int a = nfa_build(rs, nodes, nd->a, next);
+        int b = nfa_build(rs, nodes, nd->b, next);
+        return (a < 0 || b < 0) ? -1 : nfa_new(rs, NS_SPLIT, a, b);
+    }
+    case RX_REPEAT: {
+        int tail = next;
+        if (nd->max < 0) {
+            /* Loop: split -> body -> back to the split. */
+            int loop = nfa_new(rs, NS_SPLIT, -1, next);
+            if (loop < 0) return -1;
+            int body = nfa_build(rs, nodes, nd->a, loop);
+            if (body < 0) return -1;
+            rs->nfa[loop].out = body;
+            tail = loop;
+        } else {
+            /* Optional copies, each able to skip to `next`. */
+            for (int i = nd->min; i < nd->max && tail >= 0; i++) {
+                int body = nfa_build(rs, nodes, nd->a, tail);
+                tail = body < 0 ? -1 : nfa_new(rs, NS_SPLIT, body, next);
+            }
+        }
+        for (int i = 0; i < nd->min && tail >= 0; i++)
+            tail = nfa_build(rs, nodes, nd->a, tail);
+        return tail;
+    }
+    }
+    return -1;
+}
+
+/* Add the epsilon closure of state `id` to *ids. */
+static void closure(RegSearch *rs, int id, int **ids) {
+    arrput(rs->stack, id);
+    while (arrlen(rs->stack) > 0) {
+        int s = arrpop(rs->stack);
+        if (s < 0 || rs->mark[s] == rs->stamp) continue;
+        rs->mark[s] = rs->stamp;
+        const NState *ns = &rs->nfa[s];
+        if (ns->set == NS_SPLIT) {
+            arrput(rs->stack, ns->out1);
+            arrput(rs->stack, ns->out);
+        } else {
+            arrput(*ids, s);
+        }
+    }
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* ---- lazy DFA ---- */
+
+/* The state for NFA set `ids` (sorted), added if new. Takes `ids`.
+ * -1 once the automaton has outgrown RS_DFA_MAX. */
+static int dfa_state(RegSearch *rs, Dfa *dfa, int *ids) {
+    /* Key: 3 non-zero bytes per id (ids < 2^21). */
+    ptrdiff_t n = arrlen(ids);
+    char  small[256];
+    char *key = (size_t)n * 3 + 1 <= sizeof(small) ? small
+              : malloc((size_t)n * 3 + 1);
+    if (!key) { arrfree(ids); return -1; }
+    for (ptrdiff_t i = 0; i < n; i++) {
+        key[i * 3]     = (char)(0x80 | (ids[i] & 0x7f));
+        key[i * 3 + 1] = (char)(0x80 | ((ids[i] >> 7) & 0x7f));
+        key[i * 3 + 2] = (char)(0x80 | ((ids[i] >> 14) & 0x7f));
+    }
+    key[n * 3] = '\0';
+
+    if (!dfa->index) sh_new_strdup(dfa->index);
+    ptrdiff_t at = shgeti(dfa->index, key);
+    int idx;
+    if (at >= 0) {
+        idx = dfa->index[at].value;
+        arrfree(ids);
+    } else if (arrlen(dfa->st) >= RS_DFA_MAX) {
+        idx = -1;
+        arrfree(ids);
+    } else {
+        DState d = { .ids = ids, .dead = n == 0 };
+        for (ptrdiff_t i = 0; i < n; i++)
+            if (ids[i] == rs->match) d.accept = true;
+        memset(d.next, 0xff, sizeof(d.next));
+        arrput(dfa->st, d);
+        idx = (int)arrlen(dfa->st) - 1;
+        shput(dfa->index, key, idx);
+    }
+    if (key != small) free(key);
+    return idx;
+}
+
+static int dfa_start(RegSearch *rs, Dfa *dfa) {
+    if (dfa->start < 0) {
+        int *ids = NULL;
+        rs->stamp++;
+        closure(rs, rs->start, &ids);
+        if (arrlen(ids) > 1) qsort(ids, (size_t)arrlen(ids), sizeof(int), cmp_int);
+        dfa->start = dfa_state(rs, dfa, ids);
+    }
+    return dfa->start;
+}
+
+static int dfa_step(RegSearch *rs, Dfa *dfa, int d, unsigned char c) {
+    int next = dfa->st[d].next[c];
+    if (next >= 0) return next;
+
+    int *ids = NULL;
+    rs->stamp++;
+    const int *from = dfa->st[d].ids;
+    for (ptrdiff_t i = 0; i < arrlen(from); i++) {
+        const NState *ns = &rs->nfa[from[i]];
+        if (ns->set >= 0 && set_has(&rs->sets[ns->set], c))
+            closure(rs, ns->out, &ids);
+    }
+    if (dfa->floating) closure(rs, rs->start, &ids);
+    if (arrlen(ids) > 1) qsort(ids, (size_t)arrlen(ids), sizeof(int), cmp_int);
+    next = dfa_state(rs, dfa, ids);
+    if (next >= 0) dfa->st[d].next[c] = next;
+    return next;
+}
+
+static void dfa_free(Dfa *dfa) {
+    for (ptrdiff_t i = 0; i < arrlen(dfa->st); i++) arrfree(dfa->st[i].ids);
+    arrfree(dfa->st);
+    shfree(dfa->index);
+}
+
+/* Longest match starting exactly at `at`: its end, -1 for none, -2 if
+ * the DFA overflowed. */
+static ptrdiff_t dfa_match_at(RegSearch *rs, const char *s, size_t n, size_t at) {
+    Dfa          *dfa = &rs->anchored;
+    int           d   = dfa_start(rs, dfa);
+    const DState *st  = dfa->st;
+    ptrdiff_t     end = -1;
+    if (d < 0) return -2;
+    for (size_t pos = at;; pos++) {
+        if (st[d].accept && (!rs->anchor_end || pos == n))
+            end = (ptrdiff_t)pos;
+        if (pos == n || st[d].dead) return end;
+        int next = st[d].next[(unsigned char)s[pos]];
+        if (next < 0) {
+            next = dfa_step(rs, dfa, d, (unsigned char)s[pos]);
+            if (next < 0) return -2;
+            st = dfa->st;
+        }
+        d = next;
+    }
+}
+
+/* 1 found, 0 not, -1 the DFA overflowed. */
+static int dfa_find(RegSearch *rs, const char *s, size_t n, size_t from,
+                    size_t *so, size_t *eo) {
+    size_t first = from, last;
+    if (rs->anchor_start) {
+        if (from > 0) return 0;
+        last = 0;
+    } else {
+        /* One pass with the floating automaton finds where the first
+         * match ends; the leftmost match starts no later than that.
+         * Back in the start state, bytes that cannot begin a match are
+         * skipped without touching the tables. */
+        Dfa          *dfa = &rs->floating;
+        int           d   = dfa_start(rs, dfa);
+        const DState *st  = dfa->st;
+        size_t        pos = from;
+        if (d < 0) return -1;
+        for (;;) {
+            if (d == dfa->start && rs->skip)
+                while (pos < n && !rs->first[(unsigned char)s[pos]]) pos++;
+            if (st[d].accept && (!rs->anchor_end || pos == n)) break;
+            if (pos == n) return 0;
+            int next = st[d].next[(unsigned char)s[pos]];
+            if (next < 0) {
+                next = dfa_step(rs, dfa, d, (unsigned char)s[pos]);
+                if (next < 0) return -1;
+                st = dfa->st;
+            }
+            d = next;
+            pos++;
+        }
+        last = pos;
+    }
+    for (size_t at = first; at <= last; at++) {
+        ptrdiff_t end = dfa_match_at(rs, s, n, at);
+        if (end == -2) return -1;
+        if (end >= 0) {
+            *so = at;
+            *eo = (size_t)end;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ---- compile ---- */
+
+static bool is_plain(const char *p) {
+    return strpbrk(p, ".[]()|*+?{}^$\\") == NULL;
+}
+
+static void rs_build_dfa(RegSearch *rs) {
+    Parser ps = { .pat = rs->pattern, .p = rs->pattern, .icase = rs->icase, .ok = true };
+    int root = parse_alt(&ps);
+    if (ps.ok && *ps.p != '\0') ps.ok = false; /* stray ')' */
+    if (ps.ok && ps.top_alt && (ps.anchor_start || ps.anchor_end)) ps.ok = false;
+    if (ps.ok) {
+        rs->sets  = ps.sets;
+        ps.sets   = NULL;
+        rs->match = nfa_new(rs, NS_MATCH, -1, -1);
+        rs->start = nfa_build(rs, ps.nodes, root, rs->match);
+        if (rs->start >= 0) {
+            rs->mark = calloc((size_t)arrlen(rs->nfa), sizeof(*rs->mark));
+            if (rs->mark) {
+                int *ids = NULL;
+                rs->stamp++;
+                closure(rs, rs->start, &ids);
+                rs->skip = true;
+                for (ptrdiff_t i = 0; i < arrlen(ids); i++) {
+                    const NState *ns = &rs->nfa[ids[i]];
+                    if (ns->set == NS_MATCH) rs->skip = false;
+                    else
+                        for (int c = 0; c < 256; c++)
+                            if (set_has(&rs->sets[ns->set], c)) rs->first[c] = true;
+                }
+                arrfree(ids);
+                rs->anchor_start     = ps.anchor_start;
+                rs->anchor_end       = ps.anchor_end;
+                rs->anchored.start   = rs->floating.start = -1;
+                rs->floating.floating = true;
+                rs->mode = RS_DFA;
+            }
+        }
+    }
+    arrfree(ps.nodes);
+    arrfree(ps.sets);
+}
+
+static void rs_free(RegSearch *rs) {
+    if (!rs) return;
+    regfree(&rs->re);
+    free(rs->pattern);
+    arrfree(rs->nfa);
+    arrfree(rs->sets);
+    dfa_free(&rs->anchored);
+    dfa_free(&rs->floating);
+    free(rs->mark);
+    arrfree(rs->stack);
+    free(rs);
+}
+
+static RegSearch *rs_compile(const char *pattern, bool icase, char *err,
+                             size_t errsz) {
+    RegSearch *rs = calloc(1, sizeof(*rs));
+    if (!rs) return NULL;
+    int rc = regcomp(&rs->re, pattern, REG_EXTENDED | (icase ? REG_ICASE : 0));
+    if (rc != 0) {
+        if (err && errsz) regerror(rc, &rs->re, err, errsz);
+        free(rs);
+        return NULL;
+    }
+    rs->pattern = strdup(pattern);
+    rs->icase   = icase;
+    rs->mode    = RS_POSIX;
+    if (!rs->pattern) { rs_free(rs); return NULL; }
+    if (*pattern && is_plain(pattern)) {
+        strsearch_init(&rs->lit, rs->pattern, strlen(rs->pattern), icase);
+        rs->mode = RS_LITERAL;
+    } else {
+        rs_build_dfa(rs);
+    }
+    return rs;
+}
+
+/* ---- cache ---- */
+
+static struct {
+    RegSearch    *rs;
+    unsigned long used;
+} g_cache[REGSEARCH_CACHE_MAX];
+static unsigned long g_tick;
+
+RegSearch *regsearch_get(const char *pattern, bool icase, char *err,
+                         size_t errsz) {
+    int victim = 0;
+    for (int i = 0; i < REGSEARCH_CACHE_MAX; i++) {
+        RegSearch *rs = g_cache[i].rs;
+        if (rs && rs->icase == icase && strcmp(rs->pattern, pattern) == 0) {
+            g_cache[i].used = ++g_tick;
+            return rs;
+        }
+        if (g_cache[i].used < g_cache[victim].used) victim = i;
+    }
+    RegSearch *rs = rs_compile(pattern, icase, err, errsz);
+    if (!rs) return NULL;
+    rs_free(g_cache[victim].rs);
+    g_cache[victim].rs   = rs;
+    g_cache[victim].used = ++g_tick;
+    return rs;
+}
+
+void regsearch_cache_clear(void) {
+    for (int i = 0; i < REGSEARCH_CACHE_MAX; i++) {
+        rs_free(g_cache[i].rs);
+        g_cache[i].rs   = NULL;
+        g_cache[i].used = 0;
+    }
+}
+
+/* ---- search ---- */
+
+bool regsearch_find(RegSearch *rs, const char *s, size_t n, size_t from,
+                    size_t *so, size_t *eo) {
+    if (from > n) return false;
+    if (rs->mode == RS_LITERAL) {
+        ptrdiff_t at = strsearch_find(&rs->lit, s, n, from);
+        if (at < 0) return false;
+        *so = (size_t)at;
+        *eo = (size_t)at + rs->lit.len;
+        return true;
+    }
+    if (rs->mode == RS_DFA) {
+        int r = dfa_find(rs, s, n, from, so, eo);
+        if (r >= 0) return r == 1;
+        rs->mode = RS_POSIX; /* state blow-up: leave it to regexec */
+    }
+    /* The whole row with a start offset, so ^, \< and \b still see the
+     * byte before `from`. */
+    regmatch_t m = { (regoff_t)from, (regoff_t)n };
+    if (regexec(&rs->re, s, 1, &m, REG_STARTEND) != 0)
+        return false;
+    *so = (size_t)m.rm_so;
+    *eo = (size_t)m.rm_eo;
+    return true;
+}
+
+bool regsearch_rfind(RegSearch *rs, const char *s, size_t n, size_t upto,
+                     size_t *so, size_t *eo) {
+    bool   found = false;
+    size_t pos = 0, a, b;
+    /* Every start position, in order: the leftmost match from one past
+     * the previous start. */
+    while (pos <= upto && regsearch_find(rs, s, n, pos, &a, &b) && a <= upto) {
+        *so = a;
+        *eo = b;
+        found = true;
+        pos = a + 1;
+    }
+    return found;
+}
+
+bool regsearch_is_fast(const RegSearch *rs) {
+    return rs->mode != RS_POSIX;
+}
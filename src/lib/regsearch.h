@@ -0,0 +1,55 @@
+#ifndef REGSEARCH_H
+#define REGSEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Regex search for `/`, `n` and `N`.
+ *
+ * Patterns are POSIX extended regexes, compiled once and kept in a
+ * small cache keyed by pattern and flags, so repeated navigation does
+ * no per-search setup. The common subset — literals, `.`, brackets
+ * and POSIX classes, groups, `|`, `* + ?` and `{m,n}`, GNU `\w \s`,
+ * `^` at the start and `$` at the end — runs on a lazily built DFA.
+ * A row with no match costs one table lookup per byte. When there is
+ * one, that pass only finds where the first match ends; the anchored
+ * DFA is then rerun from each start position until one matches, and
+ * each run may read on to the row's end, so locating the start can be
+ * quadratic in the row length. Anything outside the subset
+ * (back-references, word boundaries, anchors mid-pattern) falls back
+ * to regexec(). Patterns without any operator go straight to the
+ * literal engine.
+ *
+ * Matching is byte-wise in the C locale, like regcomp() here, and
+ * follows POSIX: the leftmost match, and the longest one starting
+ * there.
+ */
+
+typedef struct RegSearch RegSearch;
+
+/* The compiled form of `pattern`, from the cache or compiled now. On
+ * a bad pattern returns NULL with regerror()'s text in `err`. The
+ * result stays valid until REGSEARCH_CACHE_MAX other patterns have
+ * been compiled. */
+#define REGSEARCH_CACHE_MAX 8
+RegSearch *regsearch_get(const char *pattern, bool icase, char *err,
+                         size_t errsz);
+
+/* Leftmost match in row `s` (n bytes, NUL-terminated at n) starting
+ * at or after `from`; `^` still means the row's start. Fills *so and *eo
+ * (end exclusive) and returns true, or returns false. */
+bool regsearch_find(RegSearch *rs, const char *s, size_t n, size_t from,
+                    size_t *so, size_t *eo);
+
+/* Last match starting at or before `upto`, same conventions. */
+bool regsearch_rfind(RegSearch *rs, const char *s, size_t n, size_t upto,
+                     size_t *so, size_t *eo);
+
+/* True if matching runs on the DFA or literal engine, not regexec(). */
+bool regsearch_is_fast(const RegSearch *rs);
+
+/* Drop every cached pattern. */
+void regsearch_cache_clear(void);
+
+#endif /* REGSEARCH_H */
@@ -27,7 +27,8 @@ StrBuf strbuf_from_cstr(const char *cstr) {
 
 void strbuf_free(StrBuf *s) {
     if (s->data) {
-        free(s->data);
+        if (s->cap > 0) /* borrowed storage belongs to someone else */
+            free(s->data);
         s->data = NULL;
     }
     s->len = 0;
@@ -42,6 +43,19 @@ void strbuf_clear(StrBuf *s) {
 }
 
 void strbuf_reserve(StrBuf *s, size_t capacity) {
+    if (s->cap == 0 && s->data) {
+        /* Borrowed: first growth moves the bytes into owned storage. */
+        if (capacity < s->len + 1)
+            capacity = s->len + 1;
+        char *own = malloc(capacity);
+        if (!own)
+            return;
+        memcpy(own, s->data, s->len);
+        own[s->len] = '\0';
+        s->data = own;
+        s->cap = capacity;
+        return;
+    }
     if (capacity > s->cap) {
         char *new_data = realloc(s->data, capacity);
         if (!new_data)
@@ -54,10 +68,19 @@ void strbuf_reserve(StrBuf *s, size_t capacity) {
     }
 }
 
+/* Next capacity for a buffer that needs `need` bytes: double, or 32
+ * for a fresh one, but never less than `need`. */
+static size_t grow_cap(const StrBuf *s, size_t need) {
+    size_t want = s->cap == 0 ? 32 : s->cap * 2;
+    return want < need ? need : want;
+}
+
 void strbuf_append_char(StrBuf *s, int c) {
     if (s->len + 2 > s->cap) {
-        strbuf_reserve(s, s->cap == 0 ? 32 : s->cap * 2);
+        strbuf_reserve(s, grow_cap(s, s->len + 2));
     }
+    if (s->len + 2 > s->cap)
+        return; /* OOM */
     s->data[s->len++] = c;
     s->data[s->len] = '\0';
 }
@@ -72,6 +95,8 @@ void strbuf_append(StrBuf *s, const char *data, size_t len) {
         while (want < s->len + len + 1)
             want *= 2;
         strbuf_reserve(s, want);
+        if (s->len + len + 1 > s->cap)
+            return; /* OOM */
     }
     memcpy(s->data + s->len, data, len);
     s->len += len;
@@ -82,8 +107,10 @@ void strbuf_insert_char(StrBuf *s, size_t pos, int c) {
     if (pos > s->len)
         pos = s->len;
     if (s->len + 2 > s->cap) {
-        strbuf_reserve(s, s->cap == 0 ? 32 : s->cap * 2);
+        strbuf_reserve(s, grow_cap(s, s->len + 2));
     }
+    if (s->len + 2 > s->cap)
+        return; /* OOM */
     memmove(s->data + pos + 1, s->data + pos, s->len - pos + 1);
     s->data[pos] = c;
     s->len++;
@@ -3,11 +3,17 @@
 
 #include <stddef.h>
 
-/* StrBuf: an owned, growable, always-NUL-terminated string buffer. */
+/* StrBuf: an owned, growable, always-NUL-terminated string buffer.
+ *
+ * A StrBuf with data != NULL and cap == 0 is *borrowed*: its bytes
+ * (len + NUL) live in storage someone else owns, e.g. the arena a
+ * buffer's rows were bulk-loaded into. It may be edited in place
+ * within len; the first growth copies it into owned storage, and
+ * strbuf_free() never frees it. */
 typedef struct {
     char *data;
     size_t len;
-    size_t cap; /* allocated bytes, including the trailing NUL */
+    size_t cap; /* allocated bytes, including the trailing NUL; 0 = borrowed */
 } StrBuf;
 
 /* StrView: a borrowed, read-only slice of bytes. Does NOT own its data
@@ -0,0 +1,124 @@
+#include "lib/strsearch.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STRSEARCH_SSE2 1
+#endif
+
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static unsigned char other_case(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return (unsigned char)(c - ('a' - 'A'));
+    if (c >= 'A' && c <= 'Z') return (unsigned char)(c + ('a' - 'A'));
+    return c;
+}
+
+void strsearch_init(StrSearch *ss, const char *needle, size_t len, bool icase) {
+    ss->needle = needle;
+    ss->len    = len;
+    ss->icase  = icase;
+    if (len == 0) {
+        ss->first[0] = ss->first[1] = ss->last[0] = ss->last[1] = 0;
+        return;
+    }
+    unsigned char f = (unsigned char)needle[0];
+    unsigned char l = (unsigned char)needle[len - 1];
+    ss->first[0] = f;
+    ss->last[0]  = l;
+    ss->first[1] = icase ? other_case(f) : f;
+    ss->last[1]  = icase ? other_case(l) : l;
+}
+
+/* Full comparison of a candidate at `p` whose first and last bytes are
+ * already known to match. */
+static bool match_at(const StrSearch *ss, const char *p) {
+    if (ss->len <= 2) return true;
+    if (!ss->icase) return memcmp(p + 1, ss->needle + 1, ss->len - 2) == 0;
+    for (size_t i = 1; i + 1 < ss->len; i++)
+        if (fold((unsigned char)p[i]) != fold((unsigned char)ss->needle[i]))
+            return false;
+    return true;
+}
+
+static bool ends_match(const StrSearch *ss, const char *p) {
+    unsigned char f = (unsigned char)p[0], l = (unsigned char)p[ss->len - 1];
+    return (f == ss->first[0] || f == ss->first[1]) &&
+           (l == ss->last[0]  || l == ss->last[1]);
+}
+
+ptrdiff_t strsearch_find(const StrSearch *ss, const char *hay, size_t n,
+                         size_t from) {
+    size_t len = ss->len;
+    if (len == 0 || from > n || n - from < len) return -1;
+    size_t end = n - len; /* last candidate start */
+    size_t i   = from;
+
+    if (len == 1 && !ss->icase) {
+        const char *p = memchr(hay + i, ss->first[0], n - i);
+        return p ? p - hay : -1;
+    }
+
+#ifdef STRSEARCH_SSE2
+    /* 16 candidates per step: lanes of the block at i against the
+     * first byte, lanes of the block at i + len - 1 against the last.
+     * The tail is one more block ending at `end`, with the lanes
+     * already checked masked off, so short rows never fall back to a
+     * byte loop. */
+    const __m128i f0 = _mm_set1_epi8((char)ss->first[0]);
+    const __m128i f1 = _mm_set1_epi8((char)ss->first[1]);
+    const __m128i l0 = _mm_set1_epi8((char)ss->last[0]);
+    const __m128i l1 = _mm_set1_epi8((char)ss->last[1]);
+    if (end - i >= 15) {
+        for (;;) {
+            size_t   at = i <= end - 15 ? i : end - 15;
+            __m128i  a  = _mm_loadu_si128((const __m128i *)(hay + at));
+            __m128i  b  = _mm_loadu_si128((const __m128i *)(hay + at + len - 1));
+            __m128i  ef = _mm_or_si128(_mm_cmpeq_epi8(a, f0), _mm_cmpeq_epi8(a, f1));
+            __m128i  el = _mm_or_si128(_mm_cmpeq_epi8(b, l0), _mm_cmpeq_epi8(b, l1));
+            unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(ef, el));
+            mask &= ~0u << (i - at);
+            while (mask) {
+                unsigned bit = (unsigned)__builtin_ctz(mask);
+                if (match_at(ss, hay + at + bit)) return (ptrdiff_t)(at + bit);
+                mask &= mask - 1;
+            }
+            if (at + 15 >= end) return -1;
+            i = at + 16;
+        }
+    }
+#else
+    if (!ss->icase) {
+        /* Jump between occurrences of the first byte. */
+        while (i <= end) {
+            const char *p = memchr(hay + i, ss->first[0], end - i + 1);
+            if (!p) return -1;
+            i = (size_t)(p - hay);
+            if (ends_match(ss, p) && match_at(ss, p)) return (ptrdiff_t)i;
+            i++;
+        }
+        return -1;
+    }
+#endif
+    for (; i <= end; i++)
+        if (ends_match(ss, hay + i) && match_at(ss, hay + i))
+            return (ptrdiff_t)i;
+    return -1;
+}
+
+ptrdiff_t strsearch_rfind(const StrSearch *ss, const char *hay, size_t n,
+                          size_t upto) {
+    size_t len = ss->len;
+    if (len == 0 || n < len) return -1;
+    size_t i = n - len;
+    if (upto < i) i = upto;
+    for (;;) {
+        if (ends_match(ss, hay + i) && match_at(ss, hay + i))
+            return (ptrdiff_t)i;
+        if (i == 0) return -1;
+        i--;
+    }
+}
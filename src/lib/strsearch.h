@@ -0,0 +1,42 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Literal substring search.
+ *
+ * A needle is prepared once (strsearch_init) and then run over any
+ * number of haystacks — one per buffer row for `/`, `n`, `*` and the
+ * multicursor match commands. Candidates are found by comparing the
+ * needle's first and last bytes against 16 haystack positions at a
+ * time (SSE2 where the compiler targets it, memchr skipping
+ * otherwise); only positions where both agree are compared in full,
+ * so long rows go by at close to memory bandwidth.
+ *
+ * Case-insensitive mode folds ASCII letters only; other bytes,
+ * including UTF-8 sequences, must match exactly.
+ */
+
+typedef struct StrSearch {
+    const char   *needle; /* borrowed; must outlive the StrSearch */
+    size_t        len;
+    bool          icase;
+    unsigned char first[2]; /* needle[0] in both cases (same if !icase) */
+    unsigned char last[2];  /* needle[len - 1] likewise */
+} StrSearch;
+
+void strsearch_init(StrSearch *ss, const char *needle, size_t len, bool icase);
+
+/* Start of the first match in hay[0, n) that starts at or after
+ * `from`, or -1. An empty needle never matches. */
+ptrdiff_t strsearch_find(const StrSearch *ss, const char *hay, size_t n,
+                         size_t from);
+
+/* Start of the last match in hay[0, n) that starts at or before
+ * `upto`, or -1. */
+ptrdiff_t strsearch_rfind(const StrSearch *ss, const char *hay, size_t n,
+                          size_t upto);
+
+#endif /* STRSEARCH_H */
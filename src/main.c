@@ -5,6 +5,7 @@
 #include "commands/registry.h"
 #include "terminal.h"
 #include "select_loop.h"
+#include "input/input.h"
 #include "input/macros.h"
 #include "buf/buffer.h"
 #include "ui/window.h"
@@ -170,9 +171,9 @@ static void event_loop(void) {
     while (1) {
         ed_render_frame();
 
-        /* Drain queued macro keystrokes without going through select(),
-         * since they have no fd to wake us. */
-        if (macro_queue_has_keys()) {
+        /* Drain queued macro keystrokes and unread input bytes without
+         * going through select(), since they have no fd to wake us. */
+        if (macro_queue_has_keys() || ed_input_pending()) {
             ed_process_keypress();
             continue;
         }
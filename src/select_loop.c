@@ -23,8 +23,9 @@ typedef struct {
     void       *ud;
 } Timer;
 
-static Watch *g_watches = NULL;
-static Timer *g_timers  = NULL;
+static Watch *g_watches  = NULL;
+static Watch *g_wwatches = NULL; /* writable interest */
+static Timer *g_timers   = NULL;
 
 static long long now_ms(void) {
     struct timespec ts;
@@ -35,35 +36,55 @@ static long long now_ms(void) {
 void ed_loop_init(void) {
     arrfree(g_watches);
     g_watches = NULL;
+    arrfree(g_wwatches);
+    g_wwatches = NULL;
     arrfree(g_timers);
     g_timers = NULL;
 }
 
-int ed_loop_register(const char *name, int fd, ed_fd_cb on_readable, void *ud) {
-    if (fd < 0 || !on_readable) return -1;
-    for (ptrdiff_t i = 0; i < arrlen(g_watches); i++) {
-        if (g_watches[i].fd == fd) {
+static int watch_add(Watch **list, const char *name, int fd, ed_fd_cb cb,
+                     void *ud) {
+    if (fd < 0 || !cb) return -1;
+    for (ptrdiff_t i = 0; i < arrlen(*list); i++) {
+        if ((*list)[i].fd == fd) {
             /* Replace in place — last-write-wins, mirrors keybind semantics. */
-            g_watches[i].name = name;
-            g_watches[i].cb   = on_readable;
-            g_watches[i].ud   = ud;
+            (*list)[i].name = name;
+            (*list)[i].cb   = cb;
+            (*list)[i].ud   = ud;
             return 0;
         }
     }
-    Watch w = { name, fd, on_readable, ud };
-    arrput(g_watches, w);
+    Watch w = { name, fd, cb, ud };
+    arrput(*list, w);
     return 0;
 }
 
-void ed_loop_unregister(int fd) {
-    for (ptrdiff_t i = 0; i < arrlen(g_watches); i++) {
-        if (g_watches[i].fd == fd) {
-            arrdel(g_watches, i);
+static void watch_remove(Watch **list, int fd) {
+    for (ptrdiff_t i = 0; i < arrlen(*list); i++) {
+        if ((*list)[i].fd == fd) {
+            arrdel(*list, i);
             return;
         }
     }
 }
 
+int ed_loop_register(const char *name, int fd, ed_fd_cb on_readable, void *ud) {
+    return watch_add(&g_watches, name, fd, on_readable, ud);
+}
+
+void ed_loop_unregister(int fd) {
+    watch_remove(&g_watches, fd);
+}
+
+int ed_loop_register_write(const char *name, int fd, ed_fd_cb on_writable,
+                           void *ud) {
+    return watch_add(&g_wwatches, name, fd, on_writable, ud);
+}
+
+void ed_loop_unregister_write(int fd) {
+    watch_remove(&g_wwatches, fd);
+}
+
 int ed_loop_timer_after(const char *name, int delay_ms,
                         ed_timer_cb cb, void *ud) {
     if (!cb || !name) return -1;
@@ -133,15 +154,45 @@ static void dispatch_expired_timers(void) {
     arrfree(fire);
 }
 
+/* Snapshot before dispatching so a callback that registers/unregisters
+ * during its run cannot invalidate our iteration. A watch removed by
+ * an earlier callback in the same pass is skipped. */
+static void dispatch_ready(Watch **list, fd_set *set) {
+    ptrdiff_t n = arrlen(*list);
+    if (n == 0) return;
+    Watch *snap = malloc((size_t)n * sizeof(Watch));
+    if (!snap) return;
+    memcpy(snap, *list, (size_t)n * sizeof(Watch));
+
+    for (ptrdiff_t i = 0; i < n; i++) {
+        if (!FD_ISSET(snap[i].fd, set)) continue;
+        int live = 0;
+        for (ptrdiff_t j = 0; j < arrlen(*list); j++)
+            if ((*list)[j].fd == snap[i].fd && (*list)[j].cb == snap[i].cb &&
+                (*list)[j].ud == snap[i].ud) {
+                live = 1;
+                break;
+            }
+        if (live) snap[i].cb(snap[i].fd, snap[i].ud);
+    }
+    free(snap);
+}
+
 int ed_loop_select_once(void) {
-    fd_set rfds;
+    fd_set rfds, wfds;
     FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
     int maxfd = -1;
     for (ptrdiff_t i = 0; i < arrlen(g_watches); i++) {
         int fd = g_watches[i].fd;
         FD_SET(fd, &rfds);
         if (fd > maxfd) maxfd = fd;
     }
+    for (ptrdiff_t i = 0; i < arrlen(g_wwatches); i++) {
+        int fd = g_wwatches[i].fd;
+        FD_SET(fd, &wfds);
+        if (fd > maxfd) maxfd = fd;
+    }
 
     struct timeval  tv;
     struct timeval *tvp = NULL;
@@ -149,28 +200,14 @@ int ed_loop_select_once(void) {
 
     if (maxfd < 0 && !tvp) return 0; /* nothing to wait on */
 
-    int rc = select(maxfd + 1, &rfds, NULL, NULL, tvp);
+    int rc = select(maxfd + 1, &rfds, &wfds, NULL, tvp);
     if (rc == -1) {
         if (errno == EINTR) return 0;
         return -1;
     }
 
-    /* Snapshot before dispatching so a callback that registers/unregisters
-     * during its run cannot invalidate our iteration. */
-    ptrdiff_t n = arrlen(g_watches);
-    Watch *snap = NULL;
-    if (n > 0) {
-        snap = malloc((size_t)n * sizeof(Watch));
-        if (!snap) return 0;
-        memcpy(snap, g_watches, (size_t)n * sizeof(Watch));
-    }
-
-    for (ptrdiff_t i = 0; i < n; i++) {
-        if (FD_ISSET(snap[i].fd, &rfds)) {
-            snap[i].cb(snap[i].fd, snap[i].ud);
-        }
-    }
-    free(snap);
+    dispatch_ready(&g_wwatches, &wfds);
+    dispatch_ready(&g_watches, &rfds);
 
     dispatch_expired_timers();
     return 0;
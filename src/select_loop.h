@@ -24,6 +24,13 @@ void ed_loop_init(void);
 int  ed_loop_register(const char *name, int fd, ed_fd_cb on_readable, void *ud);
 void ed_loop_unregister(int fd);
 
+/* Same for writability: `on_writable` runs whenever `fd` can take more
+ * bytes. For draining non-blocking write queues — register while data
+ * is queued and unregister once it is written, or the loop spins. */
+int  ed_loop_register_write(const char *name, int fd, ed_fd_cb on_writable,
+                            void *ud);
+void ed_loop_unregister_write(int fd);
+
 /* Schedule a one-shot timer to fire roughly `delay_ms` from now. The
  * loop dispatches it from inside ed_loop_select_once() after select()
  * returns (either because an fd fired or the timeout elapsed).
@@ -7,6 +7,7 @@
 #include "buf/buffer.h"
 #include "buf/buf_helpers.h"
 #include "buf/virtual_text.h"
+#include "buf/vislines.h"
 #include "editor.h"
 #include "input/prompt.h"
 #include "utils/fold.h"
@@ -15,6 +16,7 @@
 #include "lib/strutil.h"
 #include "lib/log.h"
 #include "ui/wlayout.h"
+#include "ui/screen.h"
 #include <assert.h>
 
 #include <stdarg.h>
@@ -81,6 +83,9 @@ void enable_raw_mode(void) {
 
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
         die("tcsetattr");
+    /* Whatever ran while we were cooked (a shell-out, a reload) owned
+     * the screen; repaint it whole. */
+    screen_invalidate();
 
     /* Bracketed paste: terminal will wrap pasted text in ESC[200~ ...
      * ESC[201~ so the input parser can route the body around hooks
@@ -231,7 +236,7 @@ void window_scroll(Window *win) {
 
     E.render_x = 0;
     if (win->cursor.y < buf->num_rows) {
-        E.render_x = buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+        E.render_x = buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     }
 
     if (!win->wrap) {
@@ -253,36 +258,18 @@ void window_scroll(Window *win) {
     /* Wrap enabled: treat row_offset as visual (wrapped) row index */
     win->col_offset = 0; /* no horizontal scroll when wrapped */
 
-    /* Compute cursor's visual row index. Virtual block_below rows for
-     * earlier rows count toward the offset; the cursor itself sits on
-     * a real subline so we don't add the cursor row's own virtuals. */
-    int cursor_visual = 0;
-    for (int y = 0; y < buf->num_rows; y++) {
-        Row *row = &buf->rows[y];
-        int h = row_visual_height(row, content_cols, 1);
-        if (y < win->cursor.y) {
-            cursor_visual += h + vtext_block_below_count(buf, y);
-        } else if (y == win->cursor.y) {
-            int rx = buf_row_cx_to_rx(row, win->cursor.x);
-            if (rx < 0)
-                rx = 0;
-            int sub = rx / content_cols;
-            if (sub >= h)
-                sub = h - 1;
-            cursor_visual += sub;
-            break;
-        } else {
-            break;
-        }
-    }
-
-    /* Total visual height — every row contributes its real sublines
-     * plus its block_below count. */
-    int total_visual = 0;
-    for (int y = 0; y < buf->num_rows; y++) {
-        total_visual += row_visual_height(&buf->rows[y], content_cols, 1)
-                      + vtext_block_below_count(buf, y);
+    /* Cursor's visual row: everything shown above its line, plus its
+     * subline. The cursor sits on a real subline, so its own line's
+     * block_below rows don't count. */
+    VisLines *vl = vislines_get(buf, content_cols);
+    int cursor_visual = vislines_row_start(vl, win->cursor.y);
+    if (win->cursor.y < buf->num_rows) {
+        int rx = E.render_x < 0 ? 0 : E.render_x;
+        int sub = rx / content_cols;
+        int h = vislines_real_height(vl, win->cursor.y);
+        cursor_visual += sub < h ? sub : h - 1;
     }
+    int total_visual = vislines_total(vl);
 
     int max_off = total_visual - win->height;
     if (max_off < 0)
@@ -357,39 +344,19 @@ int window_screen_to_buffer(const Window *win, int srow, int scol,
     if (content_cols < 1)
         content_cols = 1;
 
-    /* Same walk as ed_draw_rows_win: row_offset is a visual row index;
-     * each visible line contributes its wrap sublines plus its
-     * block-below virtual rows. */
-    int target = win->row_offset + vy;
-    int y = 0;
+    /* row_offset is a visual row index over every shown line's wrap
+     * sublines and block-below virtual rows, as in ed_draw_rows_win. */
+    VisLines *vl = vislines_get(buf, win->wrap ? content_cols : 0);
     int sub = 0;
-    int found = 0;
-    while (y < buf->num_rows) {
-        if (fold_is_line_hidden(&buf->folds, y)) {
-            y++;
-            continue;
-        }
-        int h_real = row_visual_height(&buf->rows[y], content_cols,
-                                       win->wrap);
-        int h_total = h_real + vtext_block_below_count(buf, y);
-        if (target < h_total) {
-            sub = target;
-            /* Virtual block-below row: snap to the anchor line's last
-             * real subline. */
-            if (sub >= h_real)
-                sub = h_real - 1;
-            found = 1;
-            break;
-        }
-        target -= h_total;
-        y++;
-    }
-    if (!found) {
+    int y = vislines_find(vl, win->row_offset + vy, &sub);
+    if (y >= buf->num_rows) {
         /* Below EOF: clamp to the last visible line. */
-        y = buf->num_rows - 1;
-        while (y > 0 && fold_is_line_hidden(&buf->folds, y))
-            y--;
-        sub = row_visual_height(&buf->rows[y], content_cols, win->wrap) - 1;
+        y = fold_next_visible_line(&buf->folds, buf->num_rows - 1, -1);
+        sub = vislines_real_height(vl, y) - 1;
+    } else if (sub >= vislines_real_height(vl, y)) {
+        /* Virtual block-below row: snap to the anchor line's last
+         * real subline. */
+        sub = vislines_real_height(vl, y) - 1;
     }
 
     int cell = scol - win->left - margin; /* 0-based content column */
@@ -401,7 +368,7 @@ int window_screen_to_buffer(const Window *win, int srow, int scol,
                        : win->col_offset + cell;
 
     *out_y = y;
-    *out_x = buf_row_rx_to_cx(&buf->rows[y], rx);
+    *out_x = buf_row_rx_to_cx(buf_row(buf, y), rx);
     return 1;
 }
 
@@ -423,7 +390,7 @@ static void render_slice_ss(const StrBuf *r, int start_col, int want_cols,
 static void render_emit_slice_with_spans(Abuf *ab, const Buffer *buf, int row,
                                           int col_offset, int max_cols) {
     if (!buf || row < 0 || row >= buf->num_rows) return;
-    const Row *r = &buf->rows[row];
+    const Row *r = buf_row(buf, row);
     const char *cdata = r->chars.data;
     int clen = (int)r->chars.len;
 
@@ -502,7 +469,7 @@ static int visual_row_span(const Buffer *buf, const Window *win, int cur_rx,
                                                    : win->cursor.y;
         if (row < sy || row > ey)
             return 0;
-        int rcols = render_cols_ss(&buf->rows[row].render);
+        int rcols = render_cols_ss(&buf_row(buf, row)->render);
         if (start_rx)
             *start_rx = 0;
         if (end_rx)
@@ -520,7 +487,7 @@ static int visual_row_span(const Buffer *buf, const Window *win, int cur_rx,
         int anchor_rx = win->sel.block_start_rx;
         int start = anchor_rx < cur_rx ? anchor_rx : cur_rx;
         int end = anchor_rx > cur_rx ? anchor_rx : cur_rx;
-        int rcols = render_cols_ss(&buf->rows[row].render);
+        int rcols = render_cols_ss(&buf_row(buf, row)->render);
         if (start < 0)
             start = 0;
         if (end < start)
@@ -552,7 +519,7 @@ static int visual_row_span(const Buffer *buf, const Window *win, int cur_rx,
     if (row < top_y || row > bot_y)
         return 0;
 
-    Row *r = &buf->rows[row];
+    Row *r = buf_row(buf, row);
     int start_cx = 0;
     int end_cx_excl = (int)r->chars.len;
 
@@ -581,6 +548,38 @@ static int visual_row_span(const Buffer *buf, const Window *win, int cur_rx,
     return 1;
 }
 
+/* Bring buf->render_spans up to date for rows [row_start, row_end):
+ * fold in the edits since the last frame, then fire HOOK_RENDER_PRE
+ * once per run of stale rows. Rows already filled cost nothing, so a
+ * frame that only moves the cursor skips the handlers entirely. A
+ * handler may invalidate more rows while it runs (tree-sitter after a
+ * reparse); those are picked up by another pass. */
+static void render_spans_refresh(Buffer *buf, int row_start, int row_end) {
+    AttrSpans *spans = &buf->render_spans;
+    for (int pass = 0; pass < 3; pass++) {
+        attrspan_sync(spans, buf->filetype, &buf->render_edits);
+        buf_edit_span_clear(&buf->render_edits);
+        if (row_start >= row_end)
+            return;
+        attrspan_cover(spans, row_start, row_end);
+        int lo, hi, from = row_start;
+        while ((lo = attrspan_next_stale(spans, from, row_end, &hi)) >= 0) {
+            attrspan_fill_begin(spans, lo, hi);
+            HookRenderEvent rev = {
+                .buf       = buf,
+                .row_start = lo,
+                .row_end   = hi,
+                .spans     = spans,
+            };
+            hook_fire_render(HOOK_RENDER_PRE, &rev);
+            attrspan_fill_end(spans);
+            from = hi;
+        }
+        if (!buf->render_edits.touched)
+            return;
+    }
+}
+
 static void ed_draw_rows_win(Abuf *ab, const Window *win) {
     Buffer *buf = NULL;
     assert(win!=NULL);
@@ -588,27 +587,6 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
         win->buffer_index < (int)arrlen(E.buffers))
         buf = &E.buffers[win->buffer_index];
 
-    /* Phase-1 renderer abstraction: clear last frame's spans and let
-     * handlers repopulate them for the rows this window is about to
-     * paint. row_end is a conservative upper bound — wrap/folds can
-     * make the actual visible range smaller; spans outside the
-     * visible area are harmless, just unused. */
-    if (buf) {
-        attrspan_clear(&buf->render_spans);
-        int row_start = win->row_offset;
-        if (row_start < 0) row_start = 0;
-        int row_end = row_start + win->height;
-        if (row_end > buf->num_rows) row_end = buf->num_rows;
-        HookRenderEvent rev = {
-            .buf       = buf,
-            .row_start = row_start,
-            .row_end   = row_end,
-            .spans     = &buf->render_spans,
-        };
-        hook_fire_render(HOOK_RENDER_PRE, &rev);
-        attrspan_sort(&buf->render_spans);
-    }
-
     int gutter = window_gutter_width(win, win->height);
     int margin = gutter ? (gutter + 1) : 0; /* number + space */
     int content_cols = win->width - margin;
@@ -616,35 +594,32 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
         content_cols = 0;
     int cursor_rx = 0;
     if (buf && win->cursor.y >= 0 && win->cursor.y < buf->num_rows) {
-        cursor_rx = buf_row_cx_to_rx(&buf->rows[win->cursor.y], win->cursor.x);
+        cursor_rx = buf_row_cx_to_rx(buf_row(buf, win->cursor.y), win->cursor.x);
     }
 
+    /* First line and subline on screen: row_offset counts every shown
+     * line's wrap sublines plus its block_below rows. */
     int row = 0;
     int sub = 0;
     if (buf) {
-        int target = win->row_offset;
-        int y = 0;
-        while (y < buf->num_rows) {
-            /* Skip hidden lines */
-            if (fold_is_line_hidden(&buf->folds, y)) {
-                y++;
-                continue;
-            }
-            int h_real = row_visual_height(&buf->rows[y], content_cols,
-                                           win->wrap);
-            int h_total = h_real + vtext_block_below_count(buf, y);
-            if (target < h_total) {
-                row = y;
-                sub = target;
-                break;
-            }
-            target -= h_total;
-            y++;
-        }
-        if (y >= buf->num_rows) {
-            row = buf->num_rows;
-            sub = 0;
-        }
+        VisLines *vl = vislines_get(buf, win->wrap ? content_cols : 0);
+        row = vislines_find(vl, win->row_offset, &sub);
+    }
+
+    /* Refill the spans of stale rows this window is about to paint.
+     * row_end is a conservative upper bound — wrap can make the actual
+     * visible range smaller; spans outside the visible area are
+     * harmless, just unused. Rows hidden in closed folds don't use up
+     * screen lines, so they extend the range. */
+    if (buf) {
+        int row_end = row;
+        for (int shown = 0; row_end < buf->num_rows && shown < win->height;
+             shown++)
+            row_end = fold_next_visible_line(&buf->folds, row_end, 1) + 1;
+        if (row_end > buf->num_rows)
+            row_end = buf->num_rows;
+        render_spans_refresh(buf, row, row_end);
+        vtext_materialize(buf, row, row_end);
     }
 
     for (int vy = 0; vy < win->height; vy++) {
@@ -660,7 +635,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
          * cursor mapping — just paint the virtual text. */
         if (buf && filerow < buf->num_rows) {
             int h_real_now = win->wrap
-                ? row_visual_height(&buf->rows[filerow], content_cols, 1)
+                ? row_visual_height(buf_row(buf, filerow), content_cols, 1)
                 : 1;
             if (sub >= h_real_now) {
                 int virt_idx = sub - h_real_now;
@@ -689,10 +664,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
                 sub++;
                 if (sub >= h_total_now) {
                     sub = 0;
-                    row++;
-                    while (row < buf->num_rows
-                           && fold_is_line_hidden(&buf->folds, row))
-                        row++;
+                    row = fold_next_visible_line(&buf->folds, row + 1, 1);
                 }
                 continue;
             }
@@ -714,7 +686,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
 
                 /* Fold marker after line number */
                 char fold_mark = ' ';
-                if (buf->rows[filerow].fold_start) {
+                if (buf_row(buf, filerow)->fold_start) {
                     /* Check if fold is collapsed */
                     int fold_idx = fold_find_at_line(&buf->folds, filerow);
                     if (fold_idx >= 0 &&
@@ -723,7 +695,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
                     } else if (fold_idx >= 0) {
                         fold_mark = '-'; /* Expanded fold start */
                     }
-                } else if (buf->rows[filerow].fold_end) {
+                } else if (buf_row(buf, filerow)->fold_end) {
                     /* End of fold */
                     int fold_idx = fold_find_at_line(&buf->folds, filerow);
                     if (fold_idx >= 0 &&
@@ -742,7 +714,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
         } else {
             /* Check if this line has a collapsed fold */
             bool is_folded = false;
-            if (buf->rows[filerow].fold_start) {
+            if (buf_row(buf, filerow)->fold_start) {
                 int fold_idx = fold_find_at_line(&buf->folds, filerow);
                 if (fold_idx >= 0 &&
                     buf->folds.regions[fold_idx].is_collapsed) {
@@ -762,7 +734,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
                 ab_append_str(ab, fold_prefix);
 
                 /* Show first line content (trimmed to fit) */
-                Row *first_row = &buf->rows[filerow];
+                Row *first_row = buf_row(buf, filerow);
                 int line_rcols = render_cols_ss(&first_row->render);
                 int prefix_len = strlen(fold_prefix);
                 int available_cols = content_cols - prefix_len;
@@ -782,7 +754,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
                 }
             } else {
                 /* Normal line rendering */
-                int line_rcols = render_cols_ss(&buf->rows[filerow].render);
+                int line_rcols = render_cols_ss(&buf_row(buf, filerow)->render);
                 int start_rx;
                 int len;
 
@@ -812,18 +784,17 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
 #define APPEND_SLICE(start_rx_, slice_cols_)                                   \
     do {                                                                       \
         int __sb = 0, __blen = 0;                                              \
-        render_slice_ss(&buf->rows[filerow].render, (start_rx_),               \
+        render_slice_ss(&buf_row(buf, filerow)->render, (start_rx_),               \
                         (slice_cols_), &__sb, &__blen);                        \
         if (__blen > 0) {                                                      \
             /* Highlighters push AttrSpans via HOOK_RENDER_PRE; the            \
              * renderer walks them and emits SGR transitions. Buffers          \
              * without any spans pass through as plain text. */                \
-            if (buf->render_spans.items &&                                     \
-                arrlen(buf->render_spans.items) > 0) {                         \
+            if (attrspan_row_count(&buf->render_spans, filerow) > 0) {         \
                 render_emit_slice_with_spans(ab, buf, filerow,                 \
                                              (start_rx_), (slice_cols_));      \
             } else {                                                           \
-                ab_append(ab, &buf->rows[filerow].render.data[__sb], __blen);  \
+                ab_append(ab, &buf_row(buf, filerow)->render.data[__sb], __blen);  \
             }                                                                  \
         }                                                                      \
     } while (0)
@@ -867,7 +838,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
                  * of the row, after the buffer slice and any selection
                  * inversion, so reverse-video does not bleed in. */
                 if (vtext_buffer_has_marks(buf) && start_rx <= line_rcols) {
-                    int h = row_visual_height(&buf->rows[filerow],
+                    int h = row_visual_height(buf_row(buf, filerow),
                                               content_cols, win->wrap);
                     int is_last = win->wrap ? (sub == h - 1) : 1;
                     if (is_last) {
@@ -886,7 +857,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
          * through real sublines first (only > 1 when wrap is on) and
          * then through virtual block_below rows. */
         if (buf && row < buf->num_rows) {
-            Row *r       = &buf->rows[row];
+            Row *r       = buf_row(buf, row);
             int  h_real  = win->wrap
                 ? row_visual_height(r, content_cols, 1)
                 : 1;
@@ -894,11 +865,7 @@ static void ed_draw_rows_win(Abuf *ab, const Window *win) {
             sub++;
             if (sub >= h_total) {
                 sub = 0;
-                row++;
-                while (row < buf->num_rows &&
-                       fold_is_line_hidden(&buf->folds, row)) {
-                    row++;
-                }
+                row = fold_next_visible_line(&buf->folds, row + 1, 1);
             }
         }
     }
@@ -931,7 +898,7 @@ static void draw_extra_cursors_win(Abuf *ab, const Window *win) {
         if (c->y < 0 || c->y >= buf->num_rows) continue;
         if (c->y < win->row_offset || c->y >= win->row_offset + win->height)
             continue;
-        Row *row = &buf->rows[c->y];
+        Row *row = buf_row(buf, c->y);
         int rx = buf_row_cx_to_rx(row, c->x);
         if (rx < win->col_offset || rx >= win->col_offset + content_cols)
             continue;
@@ -1017,15 +984,10 @@ void ed_render_frame(void) {
     Window *win = window_cur();
     window_scroll(win);
 
+    /* The frame is painted in full into `ab`; screen_present() turns it
+     * into the minimal update against what the terminal already shows. */
     Abuf ab;
     ab_init(&ab);
-    /* DEC mode 2026 (Synchronized Output): begin atomic frame. Modern
-     * terminals buffer until ESU and commit in one shot, eliminating
-     * mid-frame flicker. Older terminals (and tmux pre-3.4) ignore the
-     * sequence — harmless. */
-    ab_append(&ab, "\x1b[?2026h", 8);
-    ansi_hide_cursor(&ab);
-    ansi_home(&ab);
 
     /* Draw all windows. Highlighters listen to HOOK_RENDER_PRE fired
      * from ed_draw_rows_win and refresh their state on demand —
@@ -1088,25 +1050,12 @@ void ed_render_frame(void) {
             if (content_cols <= 0)
                 content_cols = 1;
 
-            int visual_row = 0;
-            for (int y = 0; y < buf->num_rows; y++) {
-                Row *row = &buf->rows[y];
-                int h = row_visual_height(row, content_cols, 1);
-                if (y < win->cursor.y) {
-                    visual_row += h;
-                } else if (y == win->cursor.y) {
-                    int rx = buf_row_cx_to_rx(row, win->cursor.x);
-                    if (rx < 0)
-                        rx = 0;
-                    int sub = rx / content_cols;
-                    if (sub >= h)
-                        sub = h - 1;
-                    visual_row += sub;
-                    break;
-                } else {
-                    break;
-                }
-            }
+            VisLines *vl = vislines_get(buf, content_cols);
+            int sub = (E.render_x < 0 ? 0 : E.render_x) / content_cols;
+            int h = vislines_real_height(vl, win->cursor.y);
+            if (sub >= h)
+                sub = h - 1;
+            int visual_row = vislines_row_start(vl, win->cursor.y) + sub;
             cur_row = (visual_row - win->row_offset) + win->top;
 
             /* Horizontal: position within current wrapped segment */
@@ -1117,12 +1066,11 @@ void ed_render_frame(void) {
             cur_col = vis_col + win->left + margin;
         }
     }
-    ansi_move(&ab, cur_row, cur_col);
-    ansi_show_cursor(&ab);
-    /* End Synchronized Update — terminal commits the whole frame now. */
-    ab_append(&ab, "\x1b[?2026l", 8);
-
-    write(STDOUT_FILENO, ab.data, (size_t)ab.len);
+    Abuf out;
+    ab_init(&out);
+    screen_present(&ab, lo.term_rows, lo.term_cols, cur_row, cur_col, &out);
+    write(STDOUT_FILENO, out.data, (size_t)out.len);
+    ab_free(&out);
     ab_free(&ab);
 }
 
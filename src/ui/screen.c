@@ -0,0 +1,813 @@
+#include "ui/screen.h"
+#include "lib/strutil.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CELL_BYTES 16
+/* Rows a scroll must save before it beats just redrawing them. */
+#define SCROLL_MIN_GAIN 3
+/* Scroll distances scored per frame, most voted first. */
+#define SCROLL_CANDIDATES 4
+/* Clean cells worth rewriting to avoid a cursor move between runs. */
+#define GAP_REWRITE_MAX 3
+/* Wider terminals fall back to sending frames as painted. */
+#define MAX_COLS 4096
+
+enum {
+    AT_BOLD      = 1u << 0,
+    AT_DIM       = 1u << 1,
+    AT_ITALIC    = 1u << 2,
+    AT_UNDERLINE = 1u << 3,
+    AT_BLINK     = 1u << 4,
+    AT_REVERSE   = 1u << 5,
+    AT_HIDDEN    = 1u << 6,
+    AT_STRIKE    = 1u << 7,
+};
+
+/* Colours: 0 is the terminal default, COL_IDX | n palette entry n,
+ * COL_RGB | 0xRRGGBB a direct colour. */
+#define COL_IDX 0x01000000u
+#define COL_RGB 0x02000000u
+
+typedef struct {
+    uint32_t fg, bg;
+    uint32_t flags;
+} CellAttr;
+
+typedef struct {
+    char     ch[CELL_BYTES]; /* glyph bytes (+ combining marks) */
+    uint8_t  len;
+    uint8_t  width;          /* 1 or 2; 0 = right half of a wide glyph */
+    CellAttr attr;
+} Cell;
+
+static Cell *g_front;      /* what the terminal shows */
+static Cell *g_back;       /* the frame being presented */
+static int   g_rows, g_cols;
+static int   g_front_valid;
+
+/* Terminal-side state while writing an update. */
+static int      t_y, t_x;  /* cursor, -1 when unknown */
+static CellAttr t_attr;
+static int      t_attr_known;
+
+static const Cell BLANK = {.ch = " ", .len = 1, .width = 1};
+
+static int attr_eq(const CellAttr *a, const CellAttr *b) {
+    return a->fg == b->fg && a->bg == b->bg && a->flags == b->flags;
+}
+
+static int cell_eq(const Cell *a, const Cell *b) {
+    return a->len == b->len && a->width == b->width &&
+           attr_eq(&a->attr, &b->attr) && memcmp(a->ch, b->ch, a->len) == 0;
+}
+
+static int row_eq(const Cell *a, const Cell *b, int cols) {
+    for (int x = 0; x < cols; x++)
+        if (!cell_eq(&a[x], &b[x]))
+            return 0;
+    return 1;
+}
+
+static uint32_t row_hash(const Cell *r, int cols) {
+    uint32_t h = 2166136261u;
+#define MIX(v) (h = (h ^ (uint32_t)(v)) * 16777619u)
+    for (int x = 0; x < cols; x++) {
+        for (int i = 0; i < r[x].len; i++)
+            MIX((unsigned char)r[x].ch[i]);
+        MIX(r[x].width);
+        MIX(r[x].attr.fg);
+        MIX(r[x].attr.bg);
+        MIX(r[x].attr.flags);
+    }
+#undef MIX
+    return h;
+}
+
+static void grid_blank(Cell *g, int n) {
+    for (int i = 0; i < n; i++)
+        g[i] = BLANK;
+}
+
+void screen_invalidate(void) { g_front_valid = 0; }
+
+void screen_free(void) {
+    free(g_front);
+    free(g_back);
+    g_front = g_back = NULL;
+    g_rows = g_cols = 0;
+    g_front_valid = 0;
+}
+
+static int grids_resize(int rows, int cols) {
+    if (rows == g_rows && cols == g_cols && g_front && g_back)
+        return 1;
+    screen_free();
+    size_t n = (size_t)rows * (size_t)cols;
+    g_front = malloc(n * sizeof(Cell));
+    g_back  = malloc(n * sizeof(Cell));
+    if (!g_front || !g_back) {
+        screen_free();
+        return 0;
+    }
+    g_rows = rows;
+    g_cols = cols;
+    return 1;
+}
+
+/* ---------------------------------------------------------------------
+ * Replay: apply the renderer's ANSI stream to the back grid.
+ * ------------------------------------------------------------------ */
+
+typedef struct {
+    int      y, x;
+    int      wrap; /* wrote the last column; the next glyph wraps */
+    CellAttr attr;
+    Abuf    *side; /* mode/cursor-style escapes to pass through */
+} Replay;
+
+/* One SGR parameter; `sub` when it came after a ':'. */
+typedef struct {
+    int v;
+    int sub;
+} SgrParam;
+
+static uint32_t sgr_ext_color(const SgrParam *p, int n, int *i) {
+    /* p[*i] is 38/48/58; consume its arguments. */
+    int k = *i + 1;
+    if (k >= n)
+        return 0;
+    int colon = p[k].sub;
+    if (p[k].v == 5 && k + 1 < n) {
+        *i = k + 1;
+        return COL_IDX | (uint32_t)(p[k + 1].v & 0xff);
+    }
+    if (p[k].v == 2) {
+        int first = k + 1;
+        /* 38:2:<colorspace>:r:g:b carries an extra id. */
+        int subs = 0;
+        while (first + subs < n && p[first + subs].sub) subs++;
+        if (colon && subs >= 4)
+            first++;
+        if (first + 2 < n) {
+            *i = first + 2;
+            return COL_RGB | ((uint32_t)(p[first].v & 0xff) << 16) |
+                   ((uint32_t)(p[first + 1].v & 0xff) << 8) |
+                   (uint32_t)(p[first + 2].v & 0xff);
+        }
+    }
+    *i = n;
+    return 0;
+}
+
+static void sgr_apply(CellAttr *a, const char *s, int len) {
+    SgrParam p[48];
+    int n = 0, v = 0, sub = 0;
+    for (int i = 0; i <= len && n < (int)(sizeof(p) / sizeof(p[0])); i++) {
+        if (i == len || s[i] == ';' || s[i] == ':') {
+            p[n].v = v;
+            p[n].sub = sub;
+            n++;
+            v = 0;
+            sub = i < len && s[i] == ':';
+        } else if (s[i] >= '0' && s[i] <= '9') {
+            v = v * 10 + (s[i] - '0');
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        int c = p[i].v;
+        if (c == 0) {
+            memset(a, 0, sizeof(*a));
+        } else if (c == 1) {
+            a->flags |= AT_BOLD;
+        } else if (c == 2) {
+            a->flags |= AT_DIM;
+        } else if (c == 3) {
+            a->flags |= AT_ITALIC;
+        } else if (c == 4) {
+            /* 4:0 turns underline off; other styles collapse to plain. */
+            if (i + 1 < n && p[i + 1].sub) {
+                if (p[++i].v == 0) a->flags &= ~AT_UNDERLINE;
+                else               a->flags |= AT_UNDERLINE;
+            } else {
+                a->flags |= AT_UNDERLINE;
+            }
+        } else if (c == 5 || c == 6) {
+            a->flags |= AT_BLINK;
+        } else if (c == 7) {
+            a->flags |= AT_REVERSE;
+        } else if (c == 8) {
+            a->flags |= AT_HIDDEN;
+        } else if (c == 9) {
+            a->flags |= AT_STRIKE;
+        } else if (c == 21) {
+            a->flags |= AT_UNDERLINE;
+        } else if (c == 22) {
+            a->flags &= ~(AT_BOLD | AT_DIM);
+        } else if (c == 23) {
+            a->flags &= ~AT_ITALIC;
+        } else if (c == 24) {
+            a->flags &= ~AT_UNDERLINE;
+        } else if (c == 25) {
+            a->flags &= ~AT_BLINK;
+        } else if (c == 27) {
+            a->flags &= ~AT_REVERSE;
+        } else if (c == 28) {
+            a->flags &= ~AT_HIDDEN;
+        } else if (c == 29) {
+            a->flags &= ~AT_STRIKE;
+        } else if (c >= 30 && c <= 37) {
+            a->fg = COL_IDX | (uint32_t)(c - 30);
+        } else if (c == 38) {
+            a->fg = sgr_ext_color(p, n, &i);
+        } else if (c == 39) {
+            a->fg = 0;
+        } else if (c >= 40 && c <= 47) {
+            a->bg = COL_IDX | (uint32_t)(c - 40);
+        } else if (c == 48) {
+            a->bg = sgr_ext_color(p, n, &i);
+        } else if (c == 49) {
+            a->bg = 0;
+        } else if (c == 58) {
+            (void)sgr_ext_color(p, n, &i); /* underline colour: dropped */
+        } else if (c >= 90 && c <= 97) {
+            a->fg = COL_IDX | (uint32_t)(c - 90 + 8);
+        } else if (c >= 100 && c <= 107) {
+            a->bg = COL_IDX | (uint32_t)(c - 100 + 8);
+        }
+    }
+}
+
+/* Erased cells keep only the background, like a terminal with bce. */
+static Cell erased(const CellAttr *a) {
+    Cell c = BLANK;
+    c.attr.bg = a->bg;
+    return c;
+}
+
+/* Before overwriting cell x: a wide glyph cut in half loses both halves. */
+static void split_wide(Cell *row, int x, int cols) {
+    if (row[x].width == 0 && x > 0) {
+        CellAttr a = row[x - 1].attr;
+        row[x - 1] = BLANK;
+        row[x - 1].attr = a;
+    }
+    if (row[x].width == 2 && x + 1 < cols) {
+        CellAttr a = row[x + 1].attr;
+        row[x + 1] = BLANK;
+        row[x + 1].attr = a;
+    }
+}
+
+static void erase_cells(Replay *r, int y, int x0, int x1) {
+    if (y < 0 || y >= g_rows || x0 >= x1)
+        return;
+    Cell *row = &g_back[(size_t)y * (size_t)g_cols];
+    split_wide(row, x0, g_cols);
+    split_wide(row, x1 - 1, g_cols);
+    Cell e = erased(&r->attr);
+    for (int x = x0; x < x1; x++)
+        row[x] = e;
+}
+
+static int csi_arg(const char *p, int len, int idx, int dflt) {
+    int cur = 0, v = 0, have = 0;
+    for (int i = 0; i <= len; i++) {
+        if (i == len || p[i] == ';') {
+            if (cur == idx)
+                return have && v > 0 ? v : dflt;
+            cur++;
+            v = 0;
+            have = 0;
+        } else if (p[i] >= '0' && p[i] <= '9') {
+            v = v * 10 + (p[i] - '0');
+            have = 1;
+        }
+    }
+    return dflt;
+}
+
+static int clampi(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* Returns 0 for a sequence the grid can't model. */
+static int replay_csi(Replay *r, const char *seq, int seqlen, const char *p,
+                      int plen, int inter, char fin) {
+    int priv = plen > 0 && (p[0] == '?' || p[0] == '>' || p[0] == '<' ||
+                            p[0] == '=');
+    if (inter) {
+        if (fin == 'q') { /* DECSCUSR cursor style */
+            ab_append(r->side, seq, seqlen);
+            return 1;
+        }
+        return 0;
+    }
+    if (priv) {
+        if (p[0] != '?' || (fin != 'h' && fin != 'l'))
+            return 0;
+        int mode = csi_arg(p + 1, plen - 1, 0, 0);
+        if (mode == 25 || mode == 2026)
+            return 1; /* cursor visibility / sync: screen_present owns them */
+        if (mode == 47 || mode == 1047 || mode == 1049)
+            return 0; /* alternate screen switches the whole grid */
+        ab_append(r->side, seq, seqlen);
+        return 1;
+    }
+    switch (fin) {
+    case 'm':
+        sgr_apply(&r->attr, p, plen);
+        return 1;
+    case 'H':
+    case 'f':
+        r->y = clampi(csi_arg(p, plen, 0, 1) - 1, 0, g_rows - 1);
+        r->x = clampi(csi_arg(p, plen, 1, 1) - 1, 0, g_cols - 1);
+        r->wrap = 0;
+        return 1;
+    case 'A':
+        r->y = clampi(r->y - csi_arg(p, plen, 0, 1), 0, g_rows - 1);
+        r->wrap = 0;
+        return 1;
+    case 'B':
+        r->y = clampi(r->y + csi_arg(p, plen, 0, 1), 0, g_rows - 1);
+        r->wrap = 0;
+        return 1;
+    case 'C':
+        r->x = clampi(r->x + csi_arg(p, plen, 0, 1), 0, g_cols - 1);
+        r->wrap = 0;
+        return 1;
+    case 'D':
+        r->x = clampi(r->x - csi_arg(p, plen, 0, 1), 0, g_cols - 1);
+        r->wrap = 0;
+        return 1;
+    case 'G':
+        r->x = clampi(csi_arg(p, plen, 0, 1) - 1, 0, g_cols - 1);
+        r->wrap = 0;
+        return 1;
+    case 'd':
+        r->y = clampi(csi_arg(p, plen, 0, 1) - 1, 0, g_rows - 1);
+        r->wrap = 0;
+        return 1;
+    case 'K': {
+        int mode = csi_arg(p, plen, 0, 0);
+        if (mode == 0)      erase_cells(r, r->y, r->x, g_cols);
+        else if (mode == 1) erase_cells(r, r->y, 0, r->x + 1);
+        else if (mode == 2) erase_cells(r, r->y, 0, g_cols);
+        return 1;
+    }
+    case 'J': {
+        int mode = csi_arg(p, plen, 0, 0);
+        if (mode == 0) {
+            erase_cells(r, r->y, r->x, g_cols);
+            for (int y = r->y + 1; y < g_rows; y++)
+                erase_cells(r, y, 0, g_cols);
+        } else if (mode == 1) {
+            for (int y = 0; y < r->y; y++)
+                erase_cells(r, y, 0, g_cols);
+            erase_cells(r, r->y, 0, r->x + 1);
+        } else if (mode == 2 || mode == 3) {
+            for (int y = 0; y < g_rows; y++)
+                erase_cells(r, y, 0, g_cols);
+        }
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+static int replay_glyph(Replay *r, const char *s, int adv, int w) {
+    Cell *row = &g_back[(size_t)r->y * (size_t)g_cols];
+    if (w == 0) {
+        /* Combining mark: joins the glyph left of the cursor. */
+        int x = r->wrap ? r->x : r->x - 1;
+        if (x < 0)
+            return 1;
+        if (row[x].width == 0 && x > 0)
+            x--;
+        if (row[x].len + adv <= CELL_BYTES) {
+            memcpy(row[x].ch + row[x].len, s, (size_t)adv);
+            row[x].len = (uint8_t)(row[x].len + adv);
+        }
+        return 1;
+    }
+    if (r->wrap) {
+        if (r->y + 1 >= g_rows)
+            return 0; /* would scroll the terminal */
+        r->y++;
+        r->x = 0;
+        r->wrap = 0;
+        row = &g_back[(size_t)r->y * (size_t)g_cols];
+    }
+    if (w == 2 && r->x + 1 >= g_cols)
+        return 0; /* wide glyph wrapping early: leave it to the terminal */
+    if (adv > CELL_BYTES)
+        return 0;
+    split_wide(row, r->x, g_cols);
+    Cell *c = &row[r->x];
+    memset(c, 0, sizeof(*c));
+    memcpy(c->ch, s, (size_t)adv);
+    c->len = (uint8_t)adv;
+    c->width = (uint8_t)w;
+    c->attr = r->attr;
+    if (w == 2) {
+        split_wide(row, r->x + 1, g_cols);
+        Cell *h = &row[r->x + 1];
+        memset(h, 0, sizeof(*h));
+        h->attr = r->attr;
+    }
+    r->x += w;
+    if (r->x >= g_cols) {
+        r->x = g_cols - 1;
+        r->wrap = 1;
+    }
+    return 1;
+}
+
+static int replay(const char *s, int n, Abuf *side) {
+    grid_blank(g_back, g_rows * g_cols);
+    Replay r = {.side = side};
+    int i = 0;
+    while (i < n) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == 0x1b) {
+            if (i + 1 >= n || s[i + 1] != '[')
+                return 0;
+            int j = i + 2;
+            while (j < n && s[j] >= 0x30 && s[j] <= 0x3f) j++;
+            int pend = j;
+            while (j < n && s[j] >= 0x20 && s[j] <= 0x2f) j++;
+            if (j >= n || s[j] < 0x40 || s[j] > 0x7e)
+                return 0;
+            if (!replay_csi(&r, s + i, j + 1 - i, s + i + 2, pend - (i + 2),
+                            j > pend, s[j]))
+                return 0;
+            i = j + 1;
+            continue;
+        }
+        if (c == '\r') {
+            r.x = 0;
+            r.wrap = 0;
+            i++;
+            continue;
+        }
+        if (c == '\n') {
+            if (r.y + 1 >= g_rows)
+                return 0;
+            r.y++;
+            r.wrap = 0;
+            i++;
+            continue;
+        }
+        if (c == '\b') {
+            if (r.x > 0 && !r.wrap)
+                r.x--;
+            r.wrap = 0;
+            i++;
+            continue;
+        }
+        if (c == '\t') {
+            r.x = clampi((r.x / 8 + 1) * 8, 0, g_cols - 1);
+            i++;
+            continue;
+        }
+        if (c < 0x20 || c == 0x7f) {
+            i++;
+            continue;
+        }
+        int adv = 1;
+        int w = utf8_char_width(s + i, (size_t)(n - i), &adv);
+        if (adv < 1)
+            adv = 1;
+        if (!replay_glyph(&r, s + i, adv, w))
+            return 0;
+        i += adv;
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------
+ * Output: write the difference between back and front.
+ * ------------------------------------------------------------------ */
+
+static void out_color(char *b, int *n, size_t cap, uint32_t col, int base) {
+    /* base 30 for fg, 40 for bg */
+    if (!col)
+        return;
+    uint32_t v = col & 0xffffffu;
+    if (col & COL_RGB)
+        *n += snprintf(b + *n, cap - (size_t)*n, ";%d;2;%u;%u;%u", base + 8,
+                       (v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff);
+    else if (v < 8)
+        *n += snprintf(b + *n, cap - (size_t)*n, ";%u", (unsigned)base + v);
+    else if (v < 16)
+        *n += snprintf(b + *n, cap - (size_t)*n, ";%u",
+                       (unsigned)base + 60 + v - 8);
+    else
+        *n += snprintf(b + *n, cap - (size_t)*n, ";%d;5;%u", base + 8, v);
+}
+
+static void out_attr(Abuf *o, const CellAttr *a) {
+    if (t_attr_known && attr_eq(&t_attr, a))
+        return;
+    static const struct { uint32_t bit; const char *code; } FLAGS[] = {
+        {AT_BOLD, ";1"},    {AT_DIM, ";2"},     {AT_ITALIC, ";3"},
+        {AT_UNDERLINE, ";4"}, {AT_BLINK, ";5"}, {AT_REVERSE, ";7"},
+        {AT_HIDDEN, ";8"},  {AT_STRIKE, ";9"},
+    };
+    char b[96];
+    int n = snprintf(b, sizeof(b), "\x1b[0");
+    for (size_t i = 0; i < sizeof(FLAGS) / sizeof(FLAGS[0]); i++)
+        if (a->flags & FLAGS[i].bit)
+            n += snprintf(b + n, sizeof(b) - (size_t)n, "%s", FLAGS[i].code);
+    out_color(b, &n, sizeof(b), a->fg, 30);
+    out_color(b, &n, sizeof(b), a->bg, 40);
+    n += snprintf(b + n, sizeof(b) - (size_t)n, "m");
+    ab_append(o, b, n);
+    t_attr = *a;
+    t_attr_known = 1;
+}
+
+static void out_move(Abuf *o, int y, int x) {
+    if (t_y == y && t_x == x)
+        return;
+    char b[32];
+    int n = snprintf(b, sizeof(b), "\x1b[%d;%dH", y + 1, x + 1);
+    ab_append(o, b, n);
+    t_y = y;
+    t_x = x;
+}
+
+static void out_cell(Abuf *o, const Cell *c) {
+    out_attr(o, &c->attr);
+    ab_append(o, c->ch, c->len);
+    t_x += c->width;
+    if (t_x >= g_cols)
+        t_y = t_x = -1; /* pending wrap: don't trust the position */
+}
+
+/* A cell erase-to-EOL can produce: a space whose attributes don't
+ * show on blanks. */
+static int el_blank(const Cell *c) {
+    return c->len == 1 && c->ch[0] == ' ' && c->width == 1 &&
+           !(c->attr.flags & (AT_UNDERLINE | AT_REVERSE | AT_STRIKE));
+}
+
+static void update_row(Abuf *o, int y) {
+    Cell *back  = &g_back[(size_t)y * (size_t)g_cols];
+    Cell *front = &g_front[(size_t)y * (size_t)g_cols];
+    unsigned char dirty[MAX_COLS];
+    int cols = g_cols;
+    int any = 0;
+    for (int x = 0; x < cols; x++) {
+        dirty[x] = !cell_eq(&back[x], &front[x]);
+        any |= dirty[x];
+    }
+    if (!any)
+        return;
+    /* Wide glyphs are written whole: touching either half rewrites
+     * the lead cell, in both the old and the new row. */
+    for (int x = cols - 1; x > 0; x--)
+        if (dirty[x] && (back[x].width == 0 || front[x].width == 0))
+            dirty[x - 1] = 1;
+
+    /* Trailing run erase-to-EOL can clear in one go. */
+    int tail = cols;
+    while (tail > 0 && el_blank(&back[tail - 1]) &&
+           back[tail - 1].attr.bg == back[cols - 1].attr.bg)
+        tail--;
+    if (cols - tail < 4)
+        tail = cols; /* not worth an escape */
+
+    int x = 0;
+    while (x < cols) {
+        if (!dirty[x]) {
+            x++;
+            continue;
+        }
+        if (x >= tail) {
+            out_move(o, y, x);
+            CellAttr a = {.bg = back[cols - 1].attr.bg};
+            out_attr(o, &a);
+            ab_append(o, "\x1b[K", 3);
+            break;
+        }
+        out_move(o, y, x);
+        while (x < tail) {
+            if (back[x].width == 0) { /* half of a glyph just written */
+                x++;
+                continue;
+            }
+            if (!dirty[x]) {
+                /* Bridge a short clean gap rather than moving. */
+                int g = x;
+                while (g < tail && g - x <= GAP_REWRITE_MAX && !dirty[g])
+                    g++;
+                if (g >= tail || dirty[g] == 0 || t_y != y)
+                    break;
+            }
+            out_cell(o, &back[x]);
+            x += back[x].width;
+        }
+    }
+}
+
+/* A row hash's occurrences in the back and front grids. */
+typedef struct {
+    uint32_t hash;
+    int      nb, nf; /* 0 in both: empty slot */
+    int      fy;     /* front row holding it, when nf == 1 */
+} RowSlot;
+
+static RowSlot *slot_find(RowSlot *tab, size_t mask, uint32_t h) {
+    size_t i = h & mask;
+    while ((tab[i].nb || tab[i].nf) && tab[i].hash != h)
+        i = (i + 1) & mask;
+    tab[i].hash = h;
+    return &tab[i];
+}
+
+typedef struct {
+    int net, top, bot, k;
+} ScrollPick;
+
+/* Score the runs of rows that shifting by s (back[y] == front[y + s])
+ * would reuse, keeping the best in *p. */
+static void scroll_eval(const uint32_t *hb, const uint32_t *hf,
+                        const unsigned char *same, int s, ScrollPick *p) {
+    int rows = g_rows, cols = g_cols;
+    int dir = s > 0 ? 1 : -1, k = s > 0 ? s : -s;
+    /* dir 1: content moved up, back[y] == front[y + k]. */
+    int y = dir > 0 ? 0 : k;
+    int end = dir > 0 ? rows - k : rows;
+    while (y < end) {
+        if (hb[y] != hf[y + s] ||
+            !row_eq(&g_back[(size_t)y * cols],
+                    &g_front[(size_t)(y + s) * cols], cols)) {
+            y++;
+            continue;
+        }
+        int a = y, gain = 0;
+        while (y < end && hb[y] == hf[y + s] &&
+               row_eq(&g_back[(size_t)y * cols],
+                      &g_front[(size_t)(y + s) * cols], cols)) {
+            gain += !same[y];
+            y++;
+        }
+        int b = y - 1;
+        /* Rows the scroll exposes must be redrawn. */
+        int e0 = dir > 0 ? b + 1 : a - k;
+        int e1 = dir > 0 ? b + k : a - 1;
+        int loss = 0;
+        for (int e = e0; e <= e1; e++)
+            loss += same[e];
+        if (gain - loss > p->net) {
+            p->net = gain - loss;
+            p->top = dir > 0 ? a : a - k;
+            p->bot = dir > 0 ? b + k : b;
+            p->k = s;
+        }
+    }
+}
+
+/* Shift rows with a scroll region when that saves redrawing at least
+ * SCROLL_MIN_GAIN of them. Only whole-width rows qualify, so a split
+ * window scrolling beside another never matches.
+ *
+ * Candidate shifts come from changed rows whose contents occur exactly
+ * once in both grids: each such row votes for the distance it moved,
+ * and only the SCROLL_CANDIDATES most voted are scored. That keeps a
+ * frame O(rows) instead of trying every distance. */
+static void try_scroll(Abuf *o) {
+    int rows = g_rows, cols = g_cols;
+    size_t cap = 1;
+    while (cap < (size_t)rows * 2)
+        cap <<= 1;
+    uint32_t *hb = malloc((size_t)rows * sizeof(uint32_t));
+    uint32_t *hf = malloc((size_t)rows * sizeof(uint32_t));
+    unsigned char *same = malloc((size_t)rows);
+    RowSlot *tab = calloc(cap, sizeof(RowSlot));
+    int *votes = calloc((size_t)rows * 2, sizeof(int));
+    if (!hb || !hf || !same || !tab || !votes) {
+        free(hb);
+        free(hf);
+        free(same);
+        free(tab);
+        free(votes);
+        return;
+    }
+    for (int y = 0; y < rows; y++) {
+        hb[y] = row_hash(&g_back[(size_t)y * cols], cols);
+        hf[y] = row_hash(&g_front[(size_t)y * cols], cols);
+        same[y] = hb[y] == hf[y] &&
+                  row_eq(&g_back[(size_t)y * cols], &g_front[(size_t)y * cols],
+                         cols);
+        slot_find(tab, cap - 1, hb[y])->nb++;
+        RowSlot *f = slot_find(tab, cap - 1, hf[y]);
+        f->nf++;
+        f->fy = y;
+    }
+    for (int y = 0; y < rows; y++) {
+        if (same[y])
+            continue;
+        const RowSlot *t = slot_find(tab, cap - 1, hb[y]);
+        if (t->nb == 1 && t->nf == 1 && t->fy != y)
+            votes[t->fy - y + rows]++;
+    }
+
+    ScrollPick best = {.net = SCROLL_MIN_GAIN - 1};
+    for (int c = 0; c < SCROLL_CANDIDATES; c++) {
+        int top = 0;
+        for (int i = 1; i < rows * 2; i++)
+            if (votes[i] > votes[top])
+                top = i;
+        if (votes[top] == 0)
+            break;
+        votes[top] = 0;
+        scroll_eval(hb, hf, same, top - rows, &best);
+    }
+    free(hb);
+    free(hf);
+    free(same);
+    free(tab);
+    free(votes);
+    if (!best.k)
+        return;
+    int best_k = best.k, best_top = best.top, best_bot = best.bot;
+
+    int k = best_k > 0 ? best_k : -best_k;
+    char b[64];
+    CellAttr plain = {0};
+    out_attr(o, &plain); /* scrolled-in lines take the current bg */
+    int n = snprintf(b, sizeof(b), "\x1b[%d;%dr\x1b[%d%c\x1b[r", best_top + 1,
+                     best_bot + 1, k, best_k > 0 ? 'S' : 'T');
+    ab_append(o, b, n);
+    t_y = t_x = -1; /* DECSTBM homes the cursor */
+
+    Cell *f = g_front;
+    size_t rl = (size_t)cols;
+    if (best_k > 0) {
+        memmove(&f[best_top * rl], &f[(best_top + k) * rl],
+                (size_t)(best_bot - best_top + 1 - k) * rl * sizeof(Cell));
+        grid_blank(&f[(best_bot - k + 1) * rl], (int)(k * rl));
+    } else {
+        memmove(&f[(best_top + k) * rl], &f[best_top * rl],
+                (size_t)(best_bot - best_top + 1 - k) * rl * sizeof(Cell));
+        grid_blank(&f[best_top * rl], (int)(k * rl));
+    }
+}
+
+static void out_cursor(Abuf *o, int cur_row, int cur_col) {
+    char b[32];
+    int n = snprintf(b, sizeof(b), "\x1b[%d;%dH", cur_row, cur_col);
+    ab_append(o, b, n);
+    ab_append(o, "\x1b[?25h", 6);
+}
+
+void screen_present(const Abuf *frame, int rows, int cols, int cur_row,
+                    int cur_col, Abuf *out) {
+    /* DEC mode 2026 (Synchronized Output): begin atomic frame. Modern
+     * terminals buffer until ESU and commit in one shot, eliminating
+     * mid-frame flicker. Older terminals (and tmux pre-3.4) ignore the
+     * sequence — harmless. */
+    ab_append(out, "\x1b[?2026h", 8);
+    ab_append(out, "\x1b[?25l", 6);
+
+    Abuf side;
+    ab_init(&side);
+    int ok = rows > 0 && cols > 0 && cols <= MAX_COLS;
+    if (ok && (rows != g_rows || cols != g_cols))
+        g_front_valid = 0;
+    ok = ok && grids_resize(rows, cols) &&
+         replay(frame->data, frame->len, &side);
+    if (!ok) {
+        /* Can't model this frame: send it as painted. */
+        ab_append(out, "\x1b[H", 3);
+        ab_append(out, frame->data, frame->len);
+        g_front_valid = 0;
+    } else {
+        ab_append(out, side.data, side.len);
+        t_y = t_x = -1;
+        t_attr_known = 0;
+        if (!g_front_valid) {
+            ab_append(out, "\x1b[m\x1b[2J", 7);
+            memset(&t_attr, 0, sizeof(t_attr));
+            t_attr_known = 1;
+            grid_blank(g_front, rows * cols);
+            g_front_valid = 1;
+        } else {
+            try_scroll(out);
+        }
+        for (int y = 0; y < rows; y++)
+            update_row(out, y);
+        memcpy(g_front, g_back, (size_t)rows * (size_t)cols * sizeof(Cell));
+        ab_append(out, "\x1b[m", 3);
+    }
+    ab_free(&side);
+
+    out_cursor(out, cur_row, cur_col);
+    /* End Synchronized Update — terminal commits the whole frame now. */
+    ab_append(out, "\x1b[?2026l", 8);
+}
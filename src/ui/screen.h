@@ -0,0 +1,37 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+/*
+ * Screen — what the terminal shows, as a grid of cells.
+ *
+ * The renderer still paints each frame as an ANSI stream into an Abuf.
+ * screen_present() replays that stream onto a back grid (cursor moves,
+ * SGR, erase-to-EOL, text), diffs it against the front grid — the
+ * cells the terminal holds from the last frame — and writes only the
+ * difference: cursor moves, attribute changes and the cells that
+ * changed. When whole rows moved up or down (the view scrolled by a few
+ * lines) it shifts them with a scroll region first, so only the rows
+ * that scrolled in are drawn.
+ *
+ * Anything that writes to the terminal behind the renderer's back
+ * (shell-outs, clearing on exit) must call screen_invalidate() so the
+ * next frame repaints from scratch. A frame containing escapes the
+ * replay does not understand is passed through verbatim and also
+ * forces a full repaint next time.
+ */
+
+#include "ui/abuf.h"
+
+/* Forget what the terminal shows; the next frame is a full repaint. */
+void screen_invalidate(void);
+
+/* Bring a rows x cols terminal up to date with `frame` and leave the
+ * cursor at (cur_row, cur_col), 1-based. The update is appended to
+ * `out` inside a synchronized-output block. */
+void screen_present(const Abuf *frame, int rows, int cols, int cur_row,
+                    int cur_col, Abuf *out);
+
+/* Release the grids (tests, leak checkers). */
+void screen_free(void);
+
+#endif /* SCREEN_H */
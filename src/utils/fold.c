@@ -5,12 +5,139 @@
 
 #define FOLD_INITIAL_CAPACITY 16
 
+/*** Hidden-line index ***/
+
+static bool span_reserve(FoldSpan **v, int *capacity, int need) {
+    if (need <= *capacity)
+        return true;
+    int new_capacity = *capacity ? *capacity : FOLD_INITIAL_CAPACITY;
+    while (new_capacity < need)
+        new_capacity *= 2;
+    FoldSpan *nv = realloc(*v, (size_t)new_capacity * sizeof(FoldSpan));
+    if (!nv)
+        return false;
+    *v = nv;
+    *capacity = new_capacity;
+    return true;
+}
+
+/* Merge the sorted closed spans into disjoint runs. O(closed). */
+static void index_merge(FoldIndex *ix) {
+    ix->seq++;
+    ix->run_count = 0;
+    if (!span_reserve(&ix->runs, &ix->run_capacity, ix->closed_count))
+        return;
+    int hidden = 0;
+    for (int i = 0; i < ix->closed_count; i++) {
+        const FoldSpan *c = &ix->closed[i];
+        FoldSpan *last = ix->run_count ? &ix->runs[ix->run_count - 1] : NULL;
+        if (last && c->lo <= last->hi + 1) {
+            if (c->hi > last->hi) {
+                hidden += c->hi - last->hi;
+                last->hi = c->hi;
+            }
+            continue;
+        }
+        ix->runs[ix->run_count++] = (FoldSpan){c->lo, c->hi, hidden};
+        hidden += c->hi - c->lo + 1;
+    }
+}
+
+/* First closed span with lo > `lo`. */
+static int closed_upper(const FoldIndex *ix, int lo) {
+    int a = 0, b = ix->closed_count;
+    while (a < b) {
+        int m = a + (b - a) / 2;
+        if (ix->closed[m].lo <= lo)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/* A collapsed region hides the lines after its start line. */
+static bool region_span(const FoldRegion *r, FoldSpan *out) {
+    *out = (FoldSpan){r->start_line + 1, r->end_line, 0};
+    return out->lo <= out->hi;
+}
+
+static void index_add(FoldIndex *ix, const FoldRegion *r) {
+    FoldSpan sp;
+    if (!region_span(r, &sp))
+        return;
+    if (!span_reserve(&ix->closed, &ix->closed_capacity, ix->closed_count + 1))
+        return;
+    int at = closed_upper(ix, sp.lo);
+    memmove(&ix->closed[at + 1], &ix->closed[at],
+            (size_t)(ix->closed_count - at) * sizeof(FoldSpan));
+    ix->closed[at] = sp;
+    ix->closed_count++;
+    index_merge(ix);
+}
+
+static void index_remove(FoldIndex *ix, const FoldRegion *r) {
+    FoldSpan sp;
+    if (!region_span(r, &sp))
+        return;
+    /* Spans with the same lo sit just below closed_upper(lo). */
+    for (int i = closed_upper(ix, sp.lo) - 1;
+         i >= 0 && ix->closed[i].lo == sp.lo; i--) {
+        if (ix->closed[i].hi != sp.hi)
+            continue;
+        memmove(&ix->closed[i], &ix->closed[i + 1],
+                (size_t)(ix->closed_count - i - 1) * sizeof(FoldSpan));
+        ix->closed_count--;
+        index_merge(ix);
+        return;
+    }
+}
+
+static int span_cmp(const void *a, const void *b) {
+    const FoldSpan *x = a, *y = b;
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/* Rebuild from scratch after many regions changed at once. */
+static void index_rebuild(FoldList *list) {
+    FoldIndex *ix = &list->index;
+    ix->closed_count = 0;
+    if (!span_reserve(&ix->closed, &ix->closed_capacity, list->count)) {
+        ix->run_count = 0;
+        return;
+    }
+    for (int i = 0; i < list->count; i++) {
+        FoldSpan sp;
+        if (list->regions[i].is_collapsed &&
+            region_span(&list->regions[i], &sp))
+            ix->closed[ix->closed_count++] = sp;
+    }
+    qsort(ix->closed, (size_t)ix->closed_count, sizeof(FoldSpan), span_cmp);
+    index_merge(ix);
+}
+
+/* Last run starting at or before `line`, or -1. */
+static int run_at(const FoldIndex *ix, int line) {
+    int a = 0, b = ix->run_count;
+    while (a < b) {
+        int m = a + (b - a) / 2;
+        if (ix->runs[m].lo <= line)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a - 1;
+}
+
+/*** Fold list ***/
+
 void fold_list_init(FoldList *list) {
     if (!list)
         return;
     list->regions = NULL;
     list->count = 0;
     list->capacity = 0;
+    memset(&list->index, 0, sizeof(list->index));
 }
 
 void fold_list_free(FoldList *list) {
@@ -22,6 +149,9 @@ void fold_list_free(FoldList *list) {
     }
     list->count = 0;
     list->capacity = 0;
+    free(list->index.closed);
+    free(list->index.runs);
+    memset(&list->index, 0, sizeof(list->index));
 }
 
 static void fold_list_ensure_capacity(FoldList *list) {
@@ -57,6 +187,8 @@ void fold_add_region(FoldList *list, int start_line, int end_line) {
 void fold_remove_region(FoldList *list, int idx) {
     if (!list || idx < 0 || idx >= list->count)
         return;
+    if (list->regions[idx].is_collapsed)
+        index_remove(&list->index, &list->regions[idx]);
 
     /* Shift remaining elements down */
     for (int i = idx; i < list->count - 1; i++) {
@@ -87,12 +219,40 @@ int fold_find_at_line(const FoldList *list, int line) {
     return best_idx;
 }
 
+void fold_set_collapsed(FoldList *list, int idx, bool collapsed) {
+    if (!list || idx < 0 || idx >= list->count)
+        return;
+    FoldRegion *r = &list->regions[idx];
+    if (r->is_collapsed == collapsed)
+        return;
+    r->is_collapsed = collapsed;
+    if (collapsed)
+        index_add(&list->index, r);
+    else
+        index_remove(&list->index, r);
+}
+
+int fold_set_all_collapsed(FoldList *list, bool collapsed) {
+    if (!list)
+        return 0;
+    int changed = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (list->regions[i].is_collapsed != collapsed) {
+            list->regions[i].is_collapsed = collapsed;
+            changed++;
+        }
+    }
+    if (changed)
+        index_rebuild(list);
+    return changed;
+}
+
 bool fold_toggle_at_line(FoldList *list, int line) {
     int idx = fold_find_at_line(list, line);
     if (idx == -1)
         return false;
 
-    list->regions[idx].is_collapsed = !list->regions[idx].is_collapsed;
+    fold_set_collapsed(list, idx, !list->regions[idx].is_collapsed);
     return true;
 }
 
@@ -101,7 +261,7 @@ bool fold_collapse_at_line(FoldList *list, int line) {
     if (idx == -1)
         return false;
 
-    list->regions[idx].is_collapsed = true;
+    fold_set_collapsed(list, idx, true);
     return true;
 }
 
@@ -110,7 +270,7 @@ bool fold_expand_at_line(FoldList *list, int line) {
     if (idx == -1)
         return false;
 
-    list->regions[idx].is_collapsed = false;
+    fold_set_collapsed(list, idx, false);
     return true;
 }
 
@@ -143,6 +303,7 @@ void fold_apply_level(FoldList *list, int level) {
      * level (e.g. 100) opens every fold. */
     for (int i = 0; i < list->count; i++)
         list->regions[i].is_collapsed = fold_region_level(list, i) > level;
+    index_rebuild(list);
 }
 
 bool fold_is_line_hidden(const FoldList *list, int line) {
@@ -150,35 +311,47 @@ bool fold_is_line_hidden(const FoldList *list, int line) {
         return false;
 
     /* A line is hidden if it's inside a collapsed fold and not on the start
-     * line */
-    for (int i = 0; i < list->count; i++) {
-        FoldRegion *r = &list->regions[i];
-        if (r->is_collapsed && line > r->start_line && line <= r->end_line) {
-            return true;
-        }
-    }
+     * line; the runs already exclude start lines. */
+    int i = run_at(&list->index, line);
+    return i >= 0 && line <= list->index.runs[i].hi;
+}
+
+int fold_next_visible_line(const FoldList *list, int line, int dir) {
+    if (!list || line < 0)
+        return line;
+    int i = run_at(&list->index, line);
+    if (i < 0 || line > list->index.runs[i].hi)
+        return line;
+    /* Runs are disjoint and never adjacent, so the line just outside
+     * one is visible. */
+    return dir < 0 ? list->index.runs[i].lo - 1 : list->index.runs[i].hi + 1;
+}
 
-    return false;
+int fold_hidden_before(const FoldList *list, int line) {
+    if (!list || line <= 0)
+        return 0;
+    int i = run_at(&list->index, line - 1);
+    if (i < 0)
+        return 0;
+    const FoldSpan *r = &list->index.runs[i];
+    int last = line - 1 < r->hi ? line - 1 : r->hi;
+    return r->before + last - r->lo + 1;
 }
 
 int fold_get_visible_line_count(const FoldList *list, int total_lines) {
     if (!list || total_lines <= 0)
         return total_lines;
 
-    int visible = 0;
-    for (int line = 0; line < total_lines; line++) {
-        if (!fold_is_line_hidden(list, line)) {
-            visible++;
-        }
-    }
-
-    return visible;
+    return total_lines - fold_hidden_before(list, total_lines);
 }
 
 void fold_clear_all(FoldList *list) {
     if (!list)
         return;
     list->count = 0;
+    list->index.closed_count = 0;
+    list->index.run_count = 0;
+    list->index.seq++;
 }
 
 void fold_reset_buffer(struct Buffer *buf) {
@@ -186,7 +359,7 @@ void fold_reset_buffer(struct Buffer *buf) {
         return;
     fold_clear_all(&buf->folds);
     for (int i = 0; i < buf->num_rows; i++) {
-        buf->rows[i].fold_start = false;
-        buf->rows[i].fold_end   = false;
+        buf_row(buf, i)->fold_start = false;
+        buf_row(buf, i)->fold_end   = false;
     }
 }
@@ -19,11 +19,35 @@ typedef struct FoldRegion {
     bool is_collapsed;  /* Whether this fold is currently collapsed */
 } FoldRegion;
 
-/* Fold list - dynamic array of fold regions for a buffer */
+/* A span of lines [lo, hi], inclusive. In FoldIndex.runs, `before` is
+ * the number of hidden lines in all earlier runs. */
+typedef struct FoldSpan {
+    int lo, hi;
+    int before;
+} FoldSpan;
+
+/* Hidden-line index, kept in step with the regions' collapsed flags.
+ * `closed` holds the hidden span (start_line + 1 .. end_line) of every
+ * collapsed region, sorted by lo; spans may overlap or nest. `runs` is
+ * their union as disjoint sorted runs with running hidden counts, so
+ * "is line hidden" and "how many hidden lines before" are a binary
+ * search instead of a walk over every region. */
+typedef struct FoldIndex {
+    FoldSpan *closed;
+    int closed_count, closed_capacity;
+    FoldSpan *runs;
+    int run_count, run_capacity;
+    unsigned seq; /* bumped whenever the hidden lines change */
+} FoldIndex;
+
+/* Fold list - dynamic array of fold regions for a buffer.
+ * Read regions[] freely, but change is_collapsed only through the
+ * functions below so the index stays current. */
 typedef struct FoldList {
     FoldRegion *regions; /* Array of fold regions */
     int count;           /* Number of active folds */
     int capacity;        /* Allocated capacity */
+    FoldIndex index;     /* Hidden lines of the collapsed regions */
 } FoldList;
 
 /* Initialize a new fold list */
@@ -50,9 +74,23 @@ bool fold_collapse_at_line(FoldList *list, int line);
 /* Expand fold at the given line */
 bool fold_expand_at_line(FoldList *list, int line);
 
-/* Check if a line is hidden due to folding */
+/* Collapse or expand region `idx` */
+void fold_set_collapsed(FoldList *list, int idx, bool collapsed);
+
+/* Collapse or expand every region; returns how many changed state */
+int fold_set_all_collapsed(FoldList *list, bool collapsed);
+
+/* Check if a line is hidden due to folding. O(log folds). */
 bool fold_is_line_hidden(const FoldList *list, int line);
 
+/* `line` if it is visible, else the nearest visible line after it
+ * (dir > 0; may be past the end of the buffer) or before it (dir < 0).
+ * O(log folds). */
+int fold_next_visible_line(const FoldList *list, int line, int dir);
+
+/* Number of hidden lines in [0, line). O(log folds). */
+int fold_hidden_before(const FoldList *list, int line);
+
 /* Get the visible line count (accounting for collapsed folds) */
 int fold_get_visible_line_count(const FoldList *list, int total_lines);
 
@@ -95,13 +95,14 @@ static void qf_update_window_view(Qf *qf) {
      * lines are constructed with a two-character prefix ("* " or "  "). */
     if (buf->num_rows > 0) {
         for (int i = 0; i < buf->num_rows; i++) {
-            Row *row = &buf->rows[i];
+            Row *row = buf_row(buf, i);
             if (!row->chars.data || row->chars.len == 0)
                 continue;
             char desired = (i == sel) ? '*' : ' ';
             if (row->chars.data[0] != desired) {
                 row->chars.data[0] = desired;
                 buf_row_update(row);
+                buf_render_invalidate(buf, i, i + 1);
             }
         }
     }
@@ -137,18 +138,14 @@ static void qf_buf_row_insert(Buffer *buf, int at, const char *s, size_t len) {
     if (at < 0 || at > buf->num_rows)
         return;
 
-    Row *new_rows = realloc(buf->rows, sizeof(Row) * (buf->num_rows + 1));
-    if (!new_rows) {
+    Row *row = rowtree_insert(&buf->rows, at);
+    if (!row) {
         ed_set_status_message("Quickfix: out of memory");
         return;
     }
-    buf->rows = new_rows;
-    memmove(&buf->rows[at + 1], &buf->rows[at],
-            sizeof(Row) * (buf->num_rows - at));
-
-    buf->rows[at].chars = strbuf_from(s, len);
-    buf->rows[at].render = strbuf_new();
-    buf_row_update(&buf->rows[at]);
+    row->chars = strbuf_from(s, len);
+    row->render = strbuf_new();
+    buf_row_update(row);
 
     buf->num_rows++;
     buf->dirty++;
@@ -166,12 +163,7 @@ static void qf_sync_buffer(Qf *qf) {
         return;
 
     /* Clear existing rows */
-    for (int i = 0; i < buf->num_rows; i++) {
-        row_free(&buf->rows[i]);
-    }
-    free(buf->rows);
-    buf->rows = NULL;
-    buf->num_rows = 0;
+    buf_rows_clear(buf);
 
     /* Rebuild from items */
     int sel = (qf->sel >= 0 && qf->sel < (int)arrlen(qf->items)) ? qf->sel : -1;
@@ -555,7 +547,7 @@ static void qf_jump_to_internal(const QfItem *it, int focus_target) {
             buf_goto_line(it->line);
         }
         if (it->col > 0 && win->cursor.y < b->num_rows) {
-            int max = b->rows[win->cursor.y].chars.len;
+            int max = buf_row(b, win->cursor.y)->chars.len;
             int cx = it->col - 1;
             if (cx < 0)
                 cx = 0;
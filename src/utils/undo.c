@@ -1,11 +1,16 @@
 #include "utils/undo.h"
 #include "buf/buffer.h"
 #include "editor.h"
+#include "fs/fs.h"
 #include "hooks.h"
 #include "lib/log.h"
+#include "lib/path_limits.h"
 #include "buf/row.h"
+#include "utils/undofile.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* Forward declarations of buffer primitives we drive during apply.
  * (The full prototypes live in buffer.c / row.c respectively.) */
@@ -14,62 +19,215 @@ void buf_row_del_in(Buffer *buf, int at);
 void buf_row_update(Row *row);
 
 /* ===================================================================
- * Group/record memory management
+ * Arena
+ *
+ * Chunks are bump-allocated in order. Groups are allocated in the
+ * same order as they sit in the ring, so the live data is always one
+ * run: dropping the oldest group releases whole chunks from the front,
+ * and a group that cannot be kept rewinds the back to its mark.
  * =================================================================== */
 
-static void rec_clear(UndoRec *r) {
-    if (!r)
-        return;
-    strbuf_free(&r->data);
+#define UNDO_CHUNK_BYTES ((size_t)64 << 10)
+#define UNDO_ALIGN       sizeof(void *)
+
+struct UndoChunk {
+    UndoChunk *next;
+    size_t     used, cap;
+    char       data[];
+};
+
+static void *arena_alloc(UndoArena *a, size_t n) {
+    n = (n + UNDO_ALIGN - 1) & ~(UNDO_ALIGN - 1);
+    UndoChunk *c = a->tail;
+    if (!c || c->cap - c->used < n) {
+        size_t cap = n > UNDO_CHUNK_BYTES ? n : UNDO_CHUNK_BYTES;
+        c = malloc(sizeof(UndoChunk) + cap);
+        if (!c)
+            return NULL;
+        c->next = NULL;
+        c->used = 0;
+        c->cap  = cap;
+        if (a->tail)
+            a->tail->next = c;
+        else
+            a->head = c;
+        a->tail = c;
+        a->bytes += cap;
+    }
+    void *p = c->data + c->used;
+    c->used += n;
+    return p;
 }
 
-static void group_free(UndoGroup *g) {
-    if (!g)
+/* Free everything allocated after `m`. */
+static void arena_rewind(UndoArena *a, UndoMark m) {
+    UndoChunk *c = m.chunk ? m.chunk->next : a->head;
+    if (m.chunk) {
+        m.chunk->next = NULL;
+        m.chunk->used = m.used;
+        a->tail = m.chunk;
+    } else {
+        a->head = a->tail = NULL;
+    }
+    while (c) {
+        UndoChunk *next = c->next;
+        a->bytes -= c->cap;
+        free(c);
+        c = next;
+    }
+}
+
+/* Free the chunks wholly before `m`. */
+static void arena_release_before(UndoArena *a, UndoMark m) {
+    if (!m.chunk)
         return;
-    for (int i = 0; i < g->len; i++)
-        rec_clear(&g->recs[i]);
-    free(g->recs);
-    free(g);
+    while (a->head && a->head != m.chunk) {
+        UndoChunk *next = a->head->next;
+        a->bytes -= a->head->cap;
+        free(a->head);
+        a->head = next;
+    }
 }
 
-static UndoRec *group_add_rec(UndoGroup *g) {
-    if (g->len == g->cap) {
-        int nc = g->cap ? g->cap * 2 : 8;
-        UndoRec *nr = realloc(g->recs, (size_t)nc * sizeof(UndoRec));
-        if (!nr)
-            return NULL;
-        g->recs = nr;
-        g->cap = nc;
+static char *arena_copy(UndoArena *a, const char *s, size_t n) {
+    if (n == 0)
+        return NULL;
+    char *p = arena_alloc(a, n);
+    if (p)
+        memcpy(p, s, n);
+    return p;
+}
+
+/* ===================================================================
+ * Group ring
+ * =================================================================== */
+
+static UndoGroup *ring_at(UndoState *u, int i) {
+    return undo_group_at(u, i);
+}
+
+/* Release the records of a group restored from the undofile. Groups in
+ * the arena are released with it. */
+static void group_free_own(UndoGroup *g) {
+    free(g->own);
+    g->own = NULL;
+}
+
+/* Is group `seq` the current one or one of its ancestors? Parents are
+ * always older than their children. */
+static bool on_cur_path(UndoState *u, int seq) {
+    int s = u->cur;
+    while (s > seq) {
+        UndoGroup *g = undo_group_seq(u, s);
+        if (!g)
+            return false;
+        s = g->parent;
     }
-    UndoRec *r = &g->recs[g->len++];
-    memset(r, 0, sizeof(*r));
-    return r;
+    return s == seq;
 }
 
-static void stack_push(UndoGroup ***stack, int *len, int *cap, UndoGroup *g) {
-    if (*len == *cap) {
-        int nc = *cap ? *cap * 2 : 16;
-        UndoGroup **ns =
-            realloc(*stack, (size_t)nc * sizeof(UndoGroup *));
-        if (!ns) {
-            group_free(g);
-            return;
+/* Is `c` a child of `seq` (or of the root, for UNDO_ROOT)? */
+static bool is_child(UndoState *u, const UndoGroup *c, int seq) {
+    if (c->dead)
+        return false;
+    if (undo_group_seq(u, seq))
+        return c->parent == seq;
+    return !undo_group_seq(u, c->parent);
+}
+
+/* Mark dead every live group whose parent is dead. */
+static void kill_orphans(UndoState *u, int from) {
+    for (int i = from; i < u->len; i++) {
+        UndoGroup *c = ring_at(u, i);
+        UndoGroup *p = undo_group_seq(u, c->parent);
+        if (!c->dead && p && p->dead) {
+            c->dead = 1;
+            group_free_own(c);
         }
-        *stack = ns;
-        *cap = nc;
     }
-    (*stack)[(*len)++] = g;
 }
 
-static UndoGroup *stack_pop(UndoGroup ***stack, int *len) {
-    if (*len == 0)
-        return NULL;
-    return (*stack)[--(*len)];
+static void drop_oldest(UndoState *u) {
+    UndoGroup *g    = ring_at(u, 0);
+    int        seq  = u->seq0;
+    bool       live = !g->dead;
+    bool       main = live && on_cur_path(u, seq);
+    int        next = g->next;
+    group_free_own(g);
+    u->head = (u->head + 1) % UNDO_MAX_DEPTH;
+    u->len--;
+    u->seq0++;
+    if (live) {
+        /* On the current path, g's state becomes the root and the root's
+         * other children are cut off; elsewhere, g's children are. */
+        for (int i = 0; i < u->len; i++) {
+            UndoGroup *c = ring_at(u, i);
+            if (!c->dead && !undo_group_seq(u, c->parent) &&
+                (c->parent == seq) != main) {
+                c->dead = 1;
+                group_free_own(c);
+            }
+        }
+        kill_orphans(u, 0);
+        if (main) {
+            u->root_next = next;
+            if (u->cur == seq)
+                u->cur = UNDO_ROOT;
+        }
+    }
+    if (u->len > 0)
+        arena_release_before(&u->arena, ring_at(u, 0)->mark);
+    else if (u->has_open && u->open.len > 0)
+        arena_release_before(&u->arena, u->open.mark);
+    else
+        arena_rewind(&u->arena, (UndoMark){ NULL, 0 });
+}
+
+/* Drop the oldest groups while over budget, keeping the newest one
+ * (the open group if it has records, else the newest closed group). */
+static void enforce_budget(UndoState *u) {
+    int keep = (u->has_open && u->open.len > 0) ? 0 : 1;
+    while (u->arena.bytes + u->pending_bytes > UNDO_BUDGET_BYTES &&
+           u->len > keep)
+        drop_oldest(u);
+}
+
+void undo_group_lost(UndoState *u, int seq) {
+    UndoGroup *g = undo_group_seq(u, seq);
+    if (!g || g->dead)
+        return;
+    if (on_cur_path(u, seq)) {
+        /* Undo stops here, so this state is the oldest one left. */
+        while (u->len > 0 && u->seq0 <= seq)
+            drop_oldest(u);
+        return;
+    }
+    g->dead = 1;
+    group_free_own(g);
+    kill_orphans(u, seq - u->seq0 + 1);
+}
+
+/* Make redo from `parent` follow `child`. */
+static void set_next(UndoState *u, int parent, int child) {
+    UndoGroup *p = undo_group_seq(u, parent);
+    if (p)
+        p->next = child;
+    else
+        u->root_next = child;
 }
 
-static void stack_clear(UndoGroup ***stack, int *len) {
-    while (*len > 0)
-        group_free((*stack)[--(*len)]);
+/* The child of `seq` redo goes to: the one it last came from or made,
+ * else the newest. UNDO_ROOT if there is none. */
+static int redo_child(UndoState *u, int seq) {
+    UndoGroup *p    = undo_group_seq(u, seq);
+    int        next = p ? p->next : u->root_next;
+    UndoGroup *c    = undo_group_seq(u, next);
+    if (c && is_child(u, c, seq))
+        return next;
+    for (int i = u->len - 1; i >= 0; i--)
+        if (is_child(u, ring_at(u, i), seq))
+            return u->seq0 + i;
+    return UNDO_ROOT;
 }
 
 /* ===================================================================
@@ -80,51 +238,150 @@ void undo_state_init(UndoState *u) {
     if (!u)
         return;
     memset(u, 0, sizeof(*u));
+    u->cur       = UNDO_ROOT;
+    u->root_next = UNDO_ROOT;
+    u->file.fd   = -1;
 }
 
 void undo_state_free(UndoState *u) {
     if (!u)
         return;
-    if (u->open) {
-        group_free(u->open);
-        u->open = NULL;
-    }
-    stack_clear(&u->undo, &u->undo_len);
-    free(u->undo);
-    u->undo = NULL;
-    u->undo_cap = 0;
-    stack_clear(&u->redo, &u->redo_len);
-    free(u->redo);
-    u->redo = NULL;
-    u->redo_cap = 0;
+    undofile_detach(u);
+    for (int i = 0; u->ring && i < u->len; i++)
+        group_free_own(ring_at(u, i));
+    for (int i = 0; i < u->pending_len; i++)
+        strbuf_free(&u->pending[i].snap);
+    free(u->pending);
+    arena_rewind(&u->arena, (UndoMark){ NULL, 0 });
+    free(u->ring);
+    memset(u, 0, sizeof(*u));
+    u->cur       = UNDO_ROOT;
+    u->root_next = UNDO_ROOT;
+    u->file.fd   = -1;
 }
 
 /* ===================================================================
- * Group lifecycle
+ * Pending replaces
+ *
+ * undo_record_replace runs before the row changes and the row may keep
+ * changing until the group closes, so it only snapshots the row. The
+ * snapshot is reduced to a diff when the row is deleted or the group
+ * closes, against the row's contents then — or, if the same row was
+ * recorded again later, against that later snapshot.
  * =================================================================== */
 
-static void enforce_depth(UndoState *u) {
-    while (u->undo_len > UNDO_MAX_DEPTH) {
-        group_free(u->undo[0]);
-        memmove(&u->undo[0], &u->undo[1],
-                (size_t)(u->undo_len - 1) * sizeof(UndoGroup *));
-        u->undo_len--;
+static void pending_snap_free(UndoState *u, UndoPending *p) {
+    u->pending_bytes -= p->snap.cap;
+    strbuf_free(&p->snap);
+}
+
+/* Diff `p`'s snapshot against `c` into its record. */
+static void pending_diff(UndoArena *ar, UndoPending *p, const char *c,
+                         size_t clen) {
+    UndoRec    *r    = p->rec;
+    const char *a    = p->snap.data ? p->snap.data : "";
+    size_t      alen = p->snap.len;
+    if (!c)
+        c = "";
+
+    size_t pre = 0, max = alen < clen ? alen : clen;
+    while (pre < max && a[pre] == c[pre])
+        pre++;
+    size_t suf = 0;
+    while (suf < max - pre && a[alen - 1 - suf] == c[clen - 1 - suf])
+        suf++;
+
+    r->at      = (int)pre;
+    r->old_len = (int)(alen - pre - suf);
+    r->new_len = (int)(clen - pre - suf);
+    r->bytes   = arena_alloc(ar, (size_t)r->old_len + (size_t)r->new_len);
+    if (r->bytes) {
+        memcpy(r->bytes, a + pre, (size_t)r->old_len);
+        memcpy(r->bytes + r->old_len, c + pre, (size_t)r->new_len);
+    } else {
+        r->old_len = r->new_len = 0;
+    }
+}
+
+static void pending_diff_row(struct Buffer *buf, UndoPending *p) {
+    if (p->row >= 0 && p->row < buf->num_rows) {
+        Row *row = buf_row(buf, p->row);
+        pending_diff(&buf->undo.arena, p, row->chars.data, row->chars.len);
+    } else {
+        pending_diff(&buf->undo.arena, p, p->snap.data, p->snap.len);
+    }
+}
+
+static int pending_cmp(const void *a, const void *b) {
+    const UndoPending *x = a, *y = b;
+    if (x->row != y->row)
+        return x->row < y->row ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static void pending_finalize_all(struct Buffer *buf) {
+    UndoState *u = &buf->undo;
+    int        n = u->pending_len;
+    if (n > 1)
+        qsort(u->pending, (size_t)n, sizeof(UndoPending), pending_cmp);
+    for (int i = 0; i < n; i++) {
+        UndoPending *p = &u->pending[i];
+        if (i + 1 < n && p[1].row == p->row)
+            pending_diff(&u->arena, p, p[1].snap.data, p[1].snap.len);
+        else
+            pending_diff_row(buf, p);
     }
+    for (int i = 0; i < n; i++)
+        pending_snap_free(u, &u->pending[i]);
+    u->pending_len = 0;
 }
 
+/* Row `d` is about to be deleted: finalize its pending replaces and
+ * move the ones below up. */
+static void pending_row_deleted(struct Buffer *buf, int d) {
+    UndoState   *u    = &buf->undo;
+    UndoPending *prev = NULL;
+    for (int i = 0; i < u->pending_len; i++) {
+        UndoPending *p = &u->pending[i];
+        if (p->row != d)
+            continue;
+        if (prev)
+            pending_diff(&u->arena, prev, p->snap.data, p->snap.len);
+        prev = p;
+    }
+    if (!prev)
+        goto shift;
+    pending_diff_row(buf, prev);
+    int w = 0;
+    for (int i = 0; i < u->pending_len; i++) {
+        if (u->pending[i].row == d)
+            pending_snap_free(u, &u->pending[i]);
+        else
+            u->pending[w++] = u->pending[i];
+    }
+    u->pending_len = w;
+shift:
+    for (int i = 0; i < u->pending_len; i++)
+        if (u->pending[i].row > d)
+            u->pending[i].row--;
+}
+
+/* ===================================================================
+ * Group lifecycle
+ * =================================================================== */
+
 void undo_begin(struct Buffer *buf, const char *desc) {
     if (!buf)
         return;
     UndoState *u = &buf->undo;
     if (u->applying)
         return;
-    if (u->open)
+    if (u->has_open)
         undo_end(buf);
-    u->open = calloc(1, sizeof(UndoGroup));
-    if (!u->open)
-        return;
+    memset(&u->open, 0, sizeof(u->open));
+    u->has_open = 1;
     if (desc)
-        strncpy(u->open->desc, desc, sizeof(u->open->desc) - 1);
+        strncpy(u->open.desc, desc, sizeof(u->open.desc) - 1);
 }
 
 void undo_end(struct Buffer *buf) {
@@ -133,22 +390,39 @@ void undo_end(struct Buffer *buf) {
     UndoState *u = &buf->undo;
     if (u->applying)
         return;
-    if (!u->open)
+    if (!u->has_open)
         return;
-    if (u->open->len == 0) {
-        group_free(u->open);
-        u->open = NULL;
+    pending_finalize_all(buf);
+    u->has_open = 0;
+    if (u->open.len == 0)
         return;
+    if (!u->ring) {
+        u->ring = calloc(UNDO_MAX_DEPTH, sizeof(UndoGroup));
+        if (!u->ring) {
+            arena_rewind(&u->arena, u->open.mark);
+            return;
+        }
     }
-    stack_push(&u->undo, &u->undo_len, &u->undo_cap, u->open);
-    u->open = NULL;
-    enforce_depth(u);
-    /* New edit invalidates redo history. */
-    stack_clear(&u->redo, &u->redo_len);
+    while (u->len >= UNDO_MAX_DEPTH)
+        drop_oldest(u);
+    /* The new group branches off the current state; the states it
+     * leaves behind stay reachable. */
+    UndoGroup *g = ring_at(u, u->len);
+    int        seq = u->seq0 + u->len;
+    *g = u->open;
+    g->parent = u->cur;
+    g->next   = UNDO_ROOT;
+    g->time   = (long long)time(NULL);
+    g->dead   = 0;
+    u->len++;
+    set_next(u, g->parent, seq);
+    u->cur = seq;
+    enforce_budget(u);
+    undofile_append(buf, ring_at(u, u->len - 1));
 }
 
 int undo_has_open(const struct Buffer *buf) {
-    return buf && buf->undo.open != NULL;
+    return buf && buf->undo.has_open;
 }
 
 int undo_is_applying(const struct Buffer *buf) {
@@ -163,38 +437,76 @@ static UndoGroup *ensure_open(struct Buffer *buf) {
     UndoState *u = &buf->undo;
     if (u->applying)
         return NULL;
-    if (!u->open) {
-        u->open = calloc(1, sizeof(UndoGroup));
-        if (!u->open)
-            return NULL;
-        strncpy(u->open->desc, "auto", sizeof(u->open->desc) - 1);
+    if (!u->has_open) {
+        memset(&u->open, 0, sizeof(u->open));
+        u->has_open = 1;
+        strncpy(u->open.desc, "auto", sizeof(u->open.desc) - 1);
     }
-    return u->open;
+    return &u->open;
+}
+
+static UndoRec *group_add_rec(UndoState *u, UndoKind kind, int row_idx) {
+    UndoGroup *g = &u->open;
+    UndoRec *r = arena_alloc(&u->arena, sizeof(UndoRec));
+    if (!r)
+        return NULL;
+    /* The group starts where its first record does, so a full chunk
+     * left by the previous group is not pinned by this one. */
+    if (g->len == 0)
+        g->mark = (UndoMark){ u->arena.tail,
+                              (size_t)((char *)r - u->arena.tail->data) };
+    memset(r, 0, sizeof(*r));
+    r->kind    = kind;
+    r->row_idx = row_idx;
+    r->prev    = g->last;
+    if (g->last)
+        g->last->next = r;
+    else
+        g->first = r;
+    g->last = r;
+    g->len++;
+    enforce_budget(u);
+    return r;
 }
 
 void undo_record_replace(struct Buffer *buf, int row_idx) {
     if (!buf)
         return;
+    /* Every in-place row change passes through here first, so this is
+     * also where edit spans hear about it. */
+    if (row_idx >= 0 && row_idx < buf->num_rows)
+        buf_note_edit(buf, row_idx, 1, 1);
     UndoGroup *g = ensure_open(buf);
     if (!g)
         return;
     if (row_idx < 0 || row_idx >= buf->num_rows)
         return;
-    /* Coalesce: if the previous record is a REPLACE on the same row,
-     * we already captured the original pre-mutation chars; nothing to do. */
-    if (g->len > 0) {
-        UndoRec *last = &g->recs[g->len - 1];
-        if (last->kind == UR_REPLACE && last->row_idx == row_idx)
+    UndoState *u = &buf->undo;
+    /* Coalesce: if the previous record is a pending REPLACE on the same
+     * row, its snapshot already holds the pre-mutation chars. */
+    if (u->pending_len > 0 && u->pending[u->pending_len - 1].rec == g->last &&
+        u->pending[u->pending_len - 1].row == row_idx)
+        return;
+
+    if (u->pending_len == u->pending_cap) {
+        int nc = u->pending_cap ? u->pending_cap * 2 : 8;
+        UndoPending *np = realloc(u->pending, (size_t)nc * sizeof(UndoPending));
+        if (!np)
             return;
+        u->pending = np;
+        u->pending_cap = nc;
     }
-    UndoRec *r = group_add_rec(g);
+    UndoRec *r = group_add_rec(u, UR_REPLACE, row_idx);
     if (!r)
         return;
-    r->kind = UR_REPLACE;
-    r->row_idx = row_idx;
-    Row *row = &buf->rows[row_idx];
-    r->data = strbuf_new();
-    strbuf_append(&r->data, row->chars.data, row->chars.len);
+    Row *row = buf_row(buf, row_idx);
+    UndoPending *p = &u->pending[u->pending_len++];
+    p->rec  = r;
+    p->row  = row_idx;
+    p->seq  = g->len;
+    p->snap = strbuf_from(row->chars.data, row->chars.len);
+    u->pending_bytes += p->snap.cap;
+    enforce_budget(u);
 }
 
 void undo_record_insert(struct Buffer *buf, int row_idx, const char *data,
@@ -204,14 +516,16 @@ void undo_record_insert(struct Buffer *buf, int row_idx, const char *data,
     UndoGroup *g = ensure_open(buf);
     if (!g)
         return;
-    UndoRec *r = group_add_rec(g);
+    UndoState *u = &buf->undo;
+    /* The new row's slot already exists: rows from row_idx moved down. */
+    for (int i = 0; i < u->pending_len; i++)
+        if (u->pending[i].row >= row_idx)
+            u->pending[i].row++;
+    UndoRec *r = group_add_rec(u, UR_INSERT, row_idx);
     if (!r)
         return;
-    r->kind = UR_INSERT;
-    r->row_idx = row_idx;
-    r->data = strbuf_new();
-    if (data && len)
-        strbuf_append(&r->data, data, len);
+    r->bytes   = arena_copy(&u->arena, data, len);
+    r->old_len = r->bytes ? (int)len : 0;
 }
 
 void undo_record_delete(struct Buffer *buf, int row_idx, const char *data,
@@ -221,14 +535,13 @@ void undo_record_delete(struct Buffer *buf, int row_idx, const char *data,
     UndoGroup *g = ensure_open(buf);
     if (!g)
         return;
-    UndoRec *r = group_add_rec(g);
+    UndoState *u = &buf->undo;
+    pending_row_deleted(buf, row_idx);
+    UndoRec *r = group_add_rec(u, UR_DELETE, row_idx);
     if (!r)
         return;
-    r->kind = UR_DELETE;
-    r->row_idx = row_idx;
-    r->data = strbuf_new();
-    if (data && len)
-        strbuf_append(&r->data, data, len);
+    r->bytes   = arena_copy(&u->arena, data, len);
+    r->old_len = r->bytes ? (int)len : 0;
 }
 
 /* ===================================================================
@@ -236,14 +549,32 @@ void undo_record_delete(struct Buffer *buf, int row_idx, const char *data,
  * =================================================================== */
 
 /* Apply a single record. dir = +1 means redo (forward), -1 means undo. */
-static void apply_rec(struct Buffer *buf, UndoRec *r, int dir) {
+static void apply_rec(struct Buffer *buf, const UndoRec *r, int dir) {
     if (r->kind == UR_REPLACE) {
         if (r->row_idx < 0 || r->row_idx >= buf->num_rows)
             return;
-        Row *row = &buf->rows[r->row_idx];
-        StrBuf tmp = row->chars;
-        row->chars = r->data;
-        r->data = tmp;
+        if (r->old_len == 0 && r->new_len == 0)
+            return;
+        Row *row = buf_row(buf, r->row_idx);
+        /* Undo swaps the inserted span back for the removed one; redo
+         * the other way round. */
+        size_t      cut  = (size_t)(dir < 0 ? r->new_len : r->old_len);
+        const char *put  = dir < 0 ? r->bytes : r->bytes + r->old_len;
+        size_t      plen = (size_t)(dir < 0 ? r->old_len : r->new_len);
+        size_t      at   = (size_t)r->at;
+        if (at + cut > row->chars.len) {
+            log_msg("undo: row %d out of sync, skipping", r->row_idx);
+            return;
+        }
+        buf_note_edit(buf, r->row_idx, 1, 1);
+        StrBuf next = strbuf_new();
+        strbuf_reserve(&next, row->chars.len - cut + plen + 1);
+        strbuf_append(&next, row->chars.data, at);
+        strbuf_append(&next, put, plen);
+        strbuf_append(&next, row->chars.data + at + cut,
+                      row->chars.len - at - cut);
+        strbuf_free(&row->chars);
+        row->chars = next;
         buf_row_update(row);
         buf->dirty++;
         return;
@@ -251,32 +582,356 @@ static void apply_rec(struct Buffer *buf, UndoRec *r, int dir) {
     int doing_insert = (r->kind == UR_INSERT && dir > 0) ||
                        (r->kind == UR_DELETE && dir < 0);
     if (doing_insert) {
-        buf_row_insert_in(buf, r->row_idx, r->data.data, r->data.len);
+        buf_row_insert_in(buf, r->row_idx, r->bytes ? r->bytes : "",
+                          (size_t)r->old_len);
     } else {
         if (r->row_idx >= 0 && r->row_idx < buf->num_rows)
             buf_row_del_in(buf, r->row_idx);
     }
 }
 
+/* Apply a whole group: its records in reverse to undo it (dir = -1),
+ * in order to redo it (dir = +1). */
+static void apply_group(struct Buffer *buf, const UndoGroup *g, int dir) {
+    if (dir < 0) {
+        for (const UndoRec *r = g->last; r; r = r->prev)
+            apply_rec(buf, r, -1);
+    } else {
+        for (const UndoRec *r = g->first; r; r = r->next)
+            apply_rec(buf, r, +1);
+    }
+}
+
 int undo_apply(struct Buffer *buf) {
     if (!buf)
         return 0;
     UndoState *u = &buf->undo;
-    if (u->open)
+    if (u->has_open)
         undo_end(buf);
-    if (u->undo_len == 0)
-        return 0;
-    UndoGroup *g = stack_pop(&u->undo, &u->undo_len);
+    int        seq = u->cur;
+    UndoGroup *g   = undo_group_seq(u, seq);
     if (!g)
         return 0;
+    if (!undofile_fault(buf, g)) {
+        /* Nothing older can be undone without this group either. */
+        log_msg("undo: cannot read group from undofile, dropping history");
+        while (u->len > 0 && u->seq0 <= seq)
+            drop_oldest(u);
+        return 0;
+    }
+    u->applying = 1;
+    apply_group(buf, g, -1);
+    u->applying = 0;
+    u->cur = undo_group_seq(u, g->parent) ? g->parent : UNDO_ROOT;
+    set_next(u, u->cur, seq);
+    return 1;
+}
+
+/* ===================================================================
+ * Jumps
+ *
+ * A jump across several groups is played over a window of working
+ * rows instead of the buffer. Rows enter the window as views of the
+ * buffer rows they start as, the first time a record reaches them;
+ * records then insert, delete and rewrite window rows. Once the whole
+ * path is played, the window is compared with the buffer rows it
+ * covers and only the difference is written back, so a row edited
+ * by many groups, or inserted and deleted again, costs one change.
+ * =================================================================== */
+
+typedef struct {
+    const char *s;
+    size_t      len;
+    int         src; /* buffer row it still is, or -1 */
+    char       *own; /* rewritten contents */
+} UndoWinRow;
+
+/* The window stands for buffer rows [lo, hi). lo < 0 until a record
+ * reaches it. Working row w is buffer row w before the window and
+ * buffer row w - n + hi after it. */
+typedef struct {
+    struct Buffer *buf;
+    UndoWinRow    *rows;
+    int            n, cap;
+    int            lo, hi;
+    bool           oom;
+} UndoWin;
+
+static bool win_reserve(UndoWin *w, int extra) {
+    if (w->n + extra <= w->cap)
+        return true;
+    int nc = w->cap ? w->cap : 64;
+    while (nc < w->n + extra)
+        nc *= 2;
+    UndoWinRow *nr = realloc(w->rows, (size_t)nc * sizeof(UndoWinRow));
+    if (!nr) {
+        w->oom = true;
+        return false;
+    }
+    w->rows = nr;
+    w->cap  = nc;
+    return true;
+}
+
+static UndoWinRow win_view(struct Buffer *buf, int i) {
+    Row *row = buf_row(buf, i);
+    return (UndoWinRow){ row->chars.data ? row->chars.data : "",
+                         row->chars.len, i, NULL };
+}
+
+/* Bring working row `r` into the window; with `slot`, only the gap
+ * before it, for an insert there. */
+static bool win_cover(UndoWin *w, int r, bool slot) {
+    if (w->lo < 0)
+        w->lo = w->hi = r;
+    if (r < w->lo) {
+        int k = w->lo - r;
+        if (!win_reserve(w, k))
+            return false;
+        memmove(w->rows + k, w->rows, (size_t)w->n * sizeof(UndoWinRow));
+        for (int i = 0; i < k; i++)
+            w->rows[i] = win_view(w->buf, r + i);
+        w->n += k;
+        w->lo = r;
+    }
+    int k = r - (w->lo + w->n) + (slot ? 0 : 1);
+    if (k > 0) {
+        if (!win_reserve(w, k))
+            return false;
+        for (int i = 0; i < k; i++)
+            w->rows[w->n + i] = win_view(w->buf, w->hi + i);
+        w->n += k;
+        w->hi += k;
+    }
+    return true;
+}
+
+/* apply_rec() on the window. */
+static void win_apply(UndoWin *w, const UndoRec *r, int dir) {
+    int total = w->buf->num_rows + (w->lo < 0 ? 0 : w->n - (w->hi - w->lo));
+    if (r->kind == UR_REPLACE) {
+        if (r->row_idx < 0 || r->row_idx >= total)
+            return;
+        if (r->old_len == 0 && r->new_len == 0)
+            return;
+        if (!win_cover(w, r->row_idx, false))
+            return;
+        UndoWinRow *row  = &w->rows[r->row_idx - w->lo];
+        size_t      cut  = (size_t)(dir < 0 ? r->new_len : r->old_len);
+        const char *put  = dir < 0 ? r->bytes : r->bytes + r->old_len;
+        size_t      plen = (size_t)(dir < 0 ? r->old_len : r->new_len);
+        size_t      at   = (size_t)r->at;
+        if (at + cut > row->len) {
+            log_msg("undo: row %d out of sync, skipping", r->row_idx);
+            return;
+        }
+        size_t len  = row->len - cut + plen;
+        char  *next = malloc(len + 1);
+        if (!next) {
+            w->oom = true;
+            return;
+        }
+        memcpy(next, row->s, at);
+        memcpy(next + at, put, plen);
+        memcpy(next + at + plen, row->s + at + cut, row->len - at - cut);
+        free(row->own);
+        *row = (UndoWinRow){ next, len, -1, next };
+        return;
+    }
+    int doing_insert = (r->kind == UR_INSERT && dir > 0) ||
+                       (r->kind == UR_DELETE && dir < 0);
+    if (doing_insert) {
+        if (r->row_idx < 0 || r->row_idx > total ||
+            !win_cover(w, r->row_idx, true) || !win_reserve(w, 1))
+            return;
+        int i = r->row_idx - w->lo;
+        memmove(w->rows + i + 1, w->rows + i,
+                (size_t)(w->n - i) * sizeof(UndoWinRow));
+        w->rows[i] = (UndoWinRow){ r->bytes ? r->bytes : "",
+                                   (size_t)r->old_len, -1, NULL };
+        w->n++;
+    } else {
+        if (r->row_idx < 0 || r->row_idx >= total ||
+            !win_cover(w, r->row_idx, false))
+            return;
+        int i = r->row_idx - w->lo;
+        free(w->rows[i].own);
+        memmove(w->rows + i, w->rows + i + 1,
+                (size_t)(w->n - i - 1) * sizeof(UndoWinRow));
+        w->n--;
+    }
+}
+
+/* Turn buffer rows [at, at + old_n) into `rows`. */
+static void splice_rows(struct Buffer *buf, int at, int old_n,
+                        const UndoWinRow *rows, int new_n) {
+    int common = old_n < new_n ? old_n : new_n;
+    for (int k = 0; k < common; k++) {
+        Row *row = buf_row(buf, at + k);
+        if (row->chars.len == rows[k].len &&
+            (rows[k].len == 0 ||
+             memcmp(row->chars.data, rows[k].s, rows[k].len) == 0))
+            continue;
+        buf_note_edit(buf, at + k, 1, 1);
+        strbuf_free(&row->chars);
+        row->chars = strbuf_from(rows[k].s, rows[k].len);
+        buf_row_update(row);
+        buf->dirty++;
+    }
+    for (int k = common; k < old_n; k++)
+        buf_row_del_in(buf, at + common);
+    for (int k = common; k < new_n; k++)
+        buf_row_insert_in(buf, at + k, rows[k].s, rows[k].len);
+}
+
+/* Write the window back. Rows still viewing their buffer row stay put
+ * and split it into gaps; each gap is rewritten on its own, from the
+ * last one up, so the buffer rows before it keep their indices. */
+static void win_commit(UndoWin *w) {
+    if (w->lo < 0)
+        return;
+    int i    = w->n;
+    int next = w->hi;
+    for (;;) {
+        int j = i;
+        while (j > 0 && w->rows[j - 1].src < 0)
+            j--;
+        int prev = j > 0 ? w->rows[j - 1].src : w->lo - 1;
+        if (next - prev - 1 > 0 || i > j)
+            splice_rows(w->buf, prev + 1, next - prev - 1, w->rows + j, i - j);
+        if (j == 0)
+            break;
+        i    = j - 1;
+        next = prev;
+    }
+}
+
+static void win_free(UndoWin *w) {
+    for (int i = 0; i < w->n; i++)
+        free(w->rows[i].own);
+    free(w->rows);
+}
+
+/* Move the buffer to the state of group `target` (or UNDO_ROOT): undo
+ * up to the nearest group the two paths share, then redo down. */
+static int goto_seq(struct Buffer *buf, int target) {
+    UndoState *u = &buf->undo;
+    if (target == u->cur)
+        return 0;
+    int  *path = malloc((size_t)(2 * u->len + 1) * sizeof(int));
+    char *mark = calloc((size_t)u->len + 1, 1);
+    if (!path || !mark) {
+        free(path);
+        free(mark);
+        return 0;
+    }
+    UndoGroup *g;
+    for (int s = target; (g = undo_group_seq(u, s)); s = g->parent)
+        mark[s - u->seq0] = 1;
+    /* path[0, nu): groups to undo, newest first; then the groups to
+     * redo, newest first too. */
+    int nu = 0, s = u->cur;
+    for (; (g = undo_group_seq(u, s)) && !mark[s - u->seq0]; s = g->parent)
+        path[nu++] = s;
+    int lca = undo_group_seq(u, s) ? s : UNDO_ROOT;
+    int n   = nu;
+    for (s = target; s != lca && (g = undo_group_seq(u, s)); s = g->parent)
+        path[n++] = s;
+    free(mark);
+
+    for (int i = 0; i < n; i++) {
+        if (!undofile_fault(buf, undo_group_seq(u, path[i]))) {
+            log_msg("undo: cannot read group from undofile");
+            free(path);
+            return 0;
+        }
+    }
+
     u->applying = 1;
-    for (int i = g->len - 1; i >= 0; i--)
-        apply_rec(buf, &g->recs[i], -1);
+    bool done = false;
+    if (n > 1) {
+        UndoWin w = { .buf = buf, .lo = -1, .hi = -1 };
+        for (int i = 0; i < nu; i++) {
+            g = undo_group_seq(u, path[i]);
+            for (const UndoRec *r = g->last; r; r = r->prev)
+                win_apply(&w, r, -1);
+        }
+        for (int i = n - 1; i >= nu; i--) {
+            g = undo_group_seq(u, path[i]);
+            for (const UndoRec *r = g->first; r; r = r->next)
+                win_apply(&w, r, +1);
+        }
+        if (!w.oom) {
+            win_commit(&w);
+            done = true;
+        }
+        win_free(&w);
+    }
+    if (!done) {
+        for (int i = 0; i < nu; i++)
+            apply_group(buf, undo_group_seq(u, path[i]), -1);
+        for (int i = n - 1; i >= nu; i--)
+            apply_group(buf, undo_group_seq(u, path[i]), +1);
+    }
     u->applying = 0;
-    stack_push(&u->redo, &u->redo_len, &u->redo_cap, g);
+
+    /* Redo retraces the path: back up the branch that was left, then
+     * down the one that was taken. */
+    for (int i = 0; i < nu; i++)
+        set_next(u, undo_group_seq(u, path[i])->parent, path[i]);
+    for (int i = nu; i < n; i++)
+        set_next(u, undo_group_seq(u, path[i])->parent, path[i]);
+    u->cur = target;
+    free(path);
     return 1;
 }
 
+int undo_goto_step(struct Buffer *buf, int n) {
+    if (!buf || n == 0)
+        return 0;
+    UndoState *u = &buf->undo;
+    if (u->has_open)
+        undo_end(buf);
+    int step   = n < 0 ? -1 : 1;
+    int left   = n < 0 ? -n : n;
+    int target = u->cur;
+    int s      = u->cur == UNDO_ROOT ? u->seq0 - 1 : u->cur;
+    for (s += step; left > 0 && s >= u->seq0 && s < u->seq0 + u->len;
+         s += step) {
+        if (!undo_group_seq(u, s)->dead) {
+            target = s;
+            left--;
+        }
+    }
+    if (step < 0 && left > 0)
+        target = UNDO_ROOT;
+    return goto_seq(buf, target);
+}
+
+int undo_goto_time(struct Buffer *buf, long long secs) {
+    if (!buf)
+        return 0;
+    UndoState *u = &buf->undo;
+    if (u->has_open)
+        undo_end(buf);
+    int first = -1;
+    for (int i = 0; i < u->len && first < 0; i++)
+        if (!ring_at(u, i)->dead)
+            first = i;
+    if (first < 0)
+        return 0;
+    /* The root is taken to be just older than the first group. */
+    UndoGroup *c    = undo_group_seq(u, u->cur);
+    long long  when = (c ? c->time : ring_at(u, first)->time - 1) + secs;
+    int        target = UNDO_ROOT;
+    for (int i = first; i < u->len; i++) {
+        UndoGroup *g = ring_at(u, i);
+        if (!g->dead && g->time <= when)
+            target = u->seq0 + i;
+    }
+    return goto_seq(buf, target);
+}
+
 /* ===================================================================
  * Mode change hook: open insert group on entry, close on exit.
  * =================================================================== */
@@ -303,30 +958,87 @@ static void on_mode_change(const HookModeEvent *event) {
     }
 }
 
+/* ===================================================================
+ * Undofile
+ * =================================================================== */
+
+/* "<cache>/undo/<absolute path, '/' encoded as '%'>". A '%' or '='
+ * in the path is written as "=%" or "==", so no two paths share a
+ * name: "/a%b" and "/a/b" give "%a=%b" and "%a%b". */
+static bool undofile_path(const Buffer *buf, char *out, size_t out_sz) {
+    char dir[PATH_MAX];
+    if (!buf->filename || !fs_path_cache_for_cwd("undo", dir, sizeof(dir)) ||
+        fs_mkdir_p(dir) != ED_OK)
+        return false;
+    char *uri = fs_path_to_file_uri(buf->filename, NULL);
+    if (!uri)
+        return false;
+    char        enc[PATH_MAX];
+    size_t      n   = 0;
+    bool        ok  = true;
+    const char *abs = fs_uri_to_path(uri);
+    for (; *abs && (ok = n + 2 < sizeof(enc)); abs++) {
+        if (*abs == '%' || *abs == '=')
+            enc[n++] = '=';
+        enc[n++] = *abs == '/' ? '%' : *abs;
+    }
+    enc[n] = '\0';
+    ok = ok && fs_path_join(out, out_sz, dir, enc);
+    free(uri);
+    return ok;
+}
+
+void undo_file_attach(struct Buffer *buf) {
+    char path[PATH_MAX];
+    if (!buf || !undofile_path(buf, path, sizeof(path)))
+        return;
+    undofile_attach(buf, path);
+}
+
+static void on_buffer_open(HookBufferEvent *event) {
+    if (event && event->buf)
+        undo_file_attach(event->buf);
+}
+
+static void on_buffer_save(HookBufferEvent *event) {
+    if (!event || !event->buf)
+        return;
+    Buffer *buf = event->buf;
+    /* A new file, or one saved under another name. */
+    char path[PATH_MAX];
+    if (!buf->undo.file.path ||
+        (undofile_path(buf, path, sizeof(path)) &&
+         strcmp(path, buf->undo.file.path) != 0))
+        undo_file_attach(buf);
+    undofile_checkpoint(buf);
+}
+
 void undo_register_hooks(void) {
     hook_register_mode(HOOK_MODE_CHANGE, on_mode_change);
+    hook_register_buffer(HOOK_BUFFER_OPEN, -1, "*", on_buffer_open);
+    hook_register_buffer(HOOK_BUFFER_SAVE, -1, "*", on_buffer_save);
 }
 
 int redo_apply(struct Buffer *buf) {
     if (!buf)
         return 0;
     UndoState *u = &buf->undo;
-    /* If the user made a fresh edit since the last undo, the open group
-     * already cleared the redo stack via undo_end; nothing to do. */
-    if (u->open)
+    if (u->has_open)
         undo_end(buf);
-    if (u->redo_len == 0)
-        return 0;
-    UndoGroup *g = stack_pop(&u->redo, &u->redo_len);
+    int        seq = redo_child(u, u->cur);
+    UndoGroup *g   = undo_group_seq(u, seq);
     if (!g)
         return 0;
+    if (!undofile_fault(buf, g)) {
+        log_msg("undo: cannot read group from undofile, dropping branch");
+        g->dead = 1;
+        kill_orphans(u, seq - u->seq0 + 1);
+        return 0;
+    }
     u->applying = 1;
-    for (int i = 0; i < g->len; i++)
-        apply_rec(buf, &g->recs[i], +1);
+    apply_group(buf, g, +1);
     u->applying = 0;
-    /* Push back to undo stack directly (without going through undo_end,
-     * which would clear the rest of the redo stack). */
-    stack_push(&u->undo, &u->undo_len, &u->undo_cap, g);
-    enforce_depth(u);
+    set_next(u, u->cur, seq);
+    u->cur = seq;
     return 1;
 }
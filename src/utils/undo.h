@@ -18,6 +18,18 @@
  * - Undo applies a group's records in reverse; redo applies in original
  *   order.
  *
+ * Tree
+ * ----
+ * Groups form a tree of text states. Each group applies on top of its
+ * parent's state (the root is the oldest state kept). An edit made after
+ * undo starts a new branch instead of discarding the undone groups.
+ * Redo follows the child that was last created or undone from. Groups
+ * are numbered in creation order, so :earlier / :later move through the
+ * states in the order they were made, by count or by wall-clock time,
+ * whatever branch they are on. A jump of more than one group plays the
+ * path over a copy of the rows it touches and writes only the net
+ * difference back into the buffer.
+ *
  * Lifecycle
  * ---------
  *   undo_begin(buf, "desc")     -- explicit group open
@@ -28,6 +40,29 @@
  * group is opened. The keypress dispatcher closes any open group at the
  * top of normal/visual-mode dispatch so each command becomes one undo.
  *
+ * Memory
+ * ------
+ * Records live in a per-buffer arena of chunks, allocated in the same
+ * order as the groups, so dropping the oldest group frees from the
+ * front. A UR_REPLACE keeps only
+ * the changed span of the row (offset plus removed and inserted
+ * bytes): the row is snapshotted when recorded and reduced to a diff
+ * when the group closes or the row is deleted. Groups sit in a ring of
+ * UNDO_MAX_DEPTH slots; beyond that, or once the arena and the
+ * pending snapshots outgrow UNDO_BUDGET_BYTES, the oldest groups are
+ * dropped. The newest group
+ * is always kept, however large. Dropping a group that leads to the
+ * current state makes its state the new root, and the branches beside
+ * it become unreachable; dropping one on another branch makes its
+ * subtree unreachable. Unreachable groups are marked dead and freed when
+ * they reach the front of the ring.
+ *
+ * Persistence
+ * -----------
+ * Buffers backed by a file also log their closed groups to an undofile
+ * (utils/undofile.h), so the history survives reloads and restarts.
+ * Groups restored from it stay on disk until undo or redo reaches them.
+ *
  * Cursor
  * ------
  * v1 does not restore cursor position on undo/redo. The cursor stays
@@ -37,34 +72,104 @@
 struct Buffer;
 
 typedef enum {
-    UR_REPLACE = 1, /* swap row.chars with rec.data */
+    UR_REPLACE = 1, /* splice the row: old bytes <-> new bytes at `at`   */
     UR_INSERT  = 2, /* on do: insert row at idx with data; on undo: delete  */
     UR_DELETE  = 3  /* on do: delete row at idx; on undo: insert with data  */
 } UndoKind;
 
-typedef struct {
-    UndoKind kind;
-    int      row_idx;
-    StrBuf data;
+/* Arena-allocated. For UR_REPLACE, bytes holds the old_len bytes the
+ * edit removed at `at` followed by the new_len bytes it inserted; for
+ * UR_INSERT / UR_DELETE it holds the whole row (old_len bytes). */
+typedef struct UndoRec {
+    struct UndoRec *prev, *next;
+    UndoKind        kind;
+    int             row_idx;
+    int             at;
+    int             old_len;
+    int             new_len;
+    char           *bytes;
 } UndoRec;
 
+typedef struct UndoChunk UndoChunk;
+
+/* A position in the arena: everything allocated after it can be
+ * rewound, everything in chunks before it released. */
+typedef struct {
+    UndoChunk *chunk;
+    size_t     used;
+} UndoMark;
+
+typedef struct {
+    UndoChunk *head, *tail;
+    size_t     bytes; /* capacity of all chunks */
+} UndoArena;
+
+#define UNDO_ROOT (-1)
+
+/* A group restored from the undofile has no records (first == NULL)
+ * until it is read back into `own`; it has no arena mark either.
+ * Groups are named by their sequence number; parent and next hold
+ * UNDO_ROOT or a sequence number older than the ring when none. */
 typedef struct UndoGroup {
-    UndoRec *recs;
-    int      len;
-    int      cap;
-    char     desc[24];
+    UndoRec  *first, *last;
+    int       len;
+    UndoMark  mark;   /* arena position before the group's first record */
+    int       parent; /* the group whose state this one applies to */
+    int       next;   /* the child redo follows */
+    long long time;   /* when the group closed, seconds since the epoch */
+    int       dead;   /* unreachable from the root */
+    char      desc[24];
+    long long disk_off, disk_len; /* its undofile record; 0 if none */
+    char     *own;                /* records read back from the undofile */
 } UndoGroup;
 
+/* A UR_REPLACE of the open group, not yet reduced to a diff. */
 typedef struct {
-    UndoGroup **undo;
-    int         undo_len, undo_cap;
-    UndoGroup **redo;
-    int         redo_len, redo_cap;
-    UndoGroup  *open;
-    int         applying; /* set while undo_apply / redo_apply is running */
+    UndoRec *rec;
+    int      row;  /* current index of the row (shifts with inserts) */
+    int      seq;  /* recording order */
+    StrBuf   snap; /* row contents when recorded */
+} UndoPending;
+
+/* The buffer's undofile. path is NULL when the buffer has none; fd is
+ * -1 until the file exists. */
+typedef struct {
+    char     *path;
+    int       fd;
+    long long len;
+} UndoFile;
+
+typedef struct {
+    UndoArena    arena;
+    /* Ring of groups in creation (and arena) order: `len` groups from
+     * `head`, numbered from `seq0`. `cur` is the group whose state the
+     * buffer holds; `root_next` is the child of the root redo follows. */
+    UndoGroup   *ring;
+    int          head, len, seq0;
+    int          cur, root_next;
+    UndoGroup    open;
+    int          has_open;
+    UndoPending *pending;
+    int          pending_len, pending_cap;
+    size_t       pending_bytes; /* held by pending snapshots */
+    int          applying; /* set while undo or redo is being applied */
+    UndoFile     file;
 } UndoState;
 
-#define UNDO_MAX_DEPTH 500
+#define UNDO_MAX_DEPTH    500
+#define UNDO_BUDGET_BYTES ((size_t)32 << 20)
+
+/* Group `i` of the ring, counting from the oldest. */
+static inline UndoGroup *undo_group_at(UndoState *u, int i) {
+    return &u->ring[(u->head + i) % UNDO_MAX_DEPTH];
+}
+
+/* The group numbered `seq`, or NULL if it is the root or was dropped. */
+static inline UndoGroup *undo_group_seq(UndoState *u, int seq) {
+    if (seq < u->seq0 || seq >= u->seq0 + u->len)
+        return NULL;
+    return undo_group_at(u, seq - u->seq0);
+}
 
 void undo_state_init(UndoState *u);
 void undo_state_free(UndoState *u);
@@ -87,8 +192,28 @@ void undo_record_delete(struct Buffer *buf, int row_idx,
 int undo_apply(struct Buffer *buf);
 int redo_apply(struct Buffer *buf);
 
-/* Register undo's mode-change hook (opens insert group on entry, closes
- * on exit). Call from config_init. */
+/* Move `n` states later (n < 0: earlier) in the order they were made,
+ * across branches. Returns 1 if the text changed state, 0 if already
+ * at the oldest / newest state. */
+int undo_goto_step(struct Buffer *buf, int n);
+
+/* Move to the last state made at most `secs` seconds after (secs < 0:
+ * before) the current one. Same return as undo_goto_step. */
+int undo_goto_time(struct Buffer *buf, long long secs);
+
+/* Group `seq` cannot be read back from the undofile. If it leads to
+ * the current state, it and every older group are dropped and its
+ * state becomes the root; otherwise it and its subtree are marked
+ * dead. */
+void undo_group_lost(UndoState *u, int seq);
+
+/* Connect `buf` to its undofile, restoring the history saved with the
+ * text it now holds. Called on open and reload. */
+void undo_file_attach(struct Buffer *buf);
+
+/* Register undo's hooks: the mode-change hook (opens insert group on
+ * entry, closes on exit) and the open/save hooks that keep the undofile.
+ * Call from config_init. */
 void undo_register_hooks(void);
 
 #endif /* UNDO_H */
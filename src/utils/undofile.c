@@ -0,0 +1,493 @@
+#include "utils/undofile.h"
+#include "buf/buffer.h"
+#include "lib/log.h"
+#include "lib/path_limits.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define UF_MAGIC     "HEDUNDO2"
+#define UF_MAGIC_LEN 8
+#define UF_HEAD      16 /* type, len, hash */
+#define UF_TAIL      4  /* total */
+#define UF_REC_HEAD  20 /* kind, row, at, old_len, new_len */
+#define UF_GROUP_HEAD (4 + 24) /* record count, desc */
+#define UF_CKPT_HEAD (8 + 8 + 4 + 4 + 4) /* text hash, length, n, cur, root_next */
+#define UF_CKPT_GROUP (8 + 8 + 4 + 4 + 8)  /* off, len, parent, next, time */
+#define UF_SLACK     ((long long)1 << 20)
+
+enum { UF_GROUP = 1, UF_CHECKPOINT = 2 };
+
+/* FNV-1a over 8-byte words, with a shift so high bits reach the low
+ * ones. Only ever compared with itself. */
+#define UF_HASH_SEED 0xcbf29ce484222325ULL
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t n) {
+    const unsigned char *p = data;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    for (; n > 0; p++, n--)
+        h = (h ^ *p) * 0x100000001b3ULL;
+    return h;
+}
+
+/* Hash of the buffer's text as it is saved: rows joined by '\n'. */
+static uint64_t content_hash(const Buffer *buf, uint64_t *len) {
+    uint64_t h = UF_HASH_SEED, n = 0;
+    for (int i = 0; i < buf->num_rows; i++) {
+        const Row *row = buf_row(buf, i);
+        h = hash_bytes(h, row->chars.data, row->chars.len);
+        h = hash_bytes(h, "\n", 1);
+        n += row->chars.len + 1;
+    }
+    *len = n;
+    return h;
+}
+
+static bool read_at(int fd, void *out, size_t n, long long off) {
+    char *p = out;
+    while (n > 0) {
+        ssize_t r = pread(fd, p, n, (off_t)off);
+        if (r <= 0)
+            return false;
+        p += r;
+        n -= (size_t)r;
+        off += r;
+    }
+    return true;
+}
+
+static bool write_at(int fd, const void *data, size_t n, long long off) {
+    const char *p = data;
+    while (n > 0) {
+        ssize_t w = pwrite(fd, p, n, (off_t)off);
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (size_t)w;
+        off += w;
+    }
+    return true;
+}
+
+static void put_u32(char **p, uint32_t v) { memcpy(*p, &v, 4); *p += 4; }
+static void put_u64(char **p, uint64_t v) { memcpy(*p, &v, 8); *p += 8; }
+static uint32_t get_u32(const char **p) { uint32_t v; memcpy(&v, *p, 4); *p += 4; return v; }
+static uint64_t get_u64(const char **p) { uint64_t v; memcpy(&v, *p, 8); *p += 8; return v; }
+
+/* A record buffer with room for the header before `len` payload bytes
+ * and the trailer after them. */
+static char *record_new(size_t len) {
+    return malloc(UF_HEAD + len + UF_TAIL);
+}
+
+/* Fill in the header and trailer of `rec` and append it. Returns its
+ * offset, or 0 if it could not be written. */
+static long long record_put(UndoFile *f, uint32_t type, char *rec, size_t len) {
+    if (f->fd < 0) {
+        f->fd = open(f->path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (f->fd < 0)
+            return 0;
+        f->len = 0;
+    }
+    if (f->len == 0) {
+        if (!write_at(f->fd, UF_MAGIC, UF_MAGIC_LEN, 0))
+            return 0;
+        f->len = UF_MAGIC_LEN;
+    }
+    size_t total = UF_HEAD + len + UF_TAIL;
+    if (total > UINT32_MAX)
+        return 0;
+    char *p = rec;
+    put_u32(&p, type);
+    put_u32(&p, (uint32_t)len);
+    put_u64(&p, hash_bytes(UF_HASH_SEED, rec + UF_HEAD, len));
+    p = rec + UF_HEAD + len;
+    put_u32(&p, (uint32_t)total);
+    long long off = f->len;
+    if (!write_at(f->fd, rec, total, off)) {
+        if (ftruncate(f->fd, (off_t)off) != 0)
+            log_msg("undofile: cannot trim %s", f->path);
+        return 0;
+    }
+    f->len += (long long)total;
+    return off;
+}
+
+/* Read the header of the record at `off` and check it lies in the
+ * first `end` bytes. */
+static bool record_head(const UndoFile *f, long long off, long long end,
+                        uint32_t *type, uint32_t *len, uint64_t *hash) {
+    char head[UF_HEAD];
+    if (off < UF_MAGIC_LEN || off + UF_HEAD + UF_TAIL > end ||
+        !read_at(f->fd, head, sizeof(head), off))
+        return false;
+    const char *p = head;
+    *type = get_u32(&p);
+    *len  = get_u32(&p);
+    *hash = get_u64(&p);
+    return off + UF_HEAD + (long long)*len + UF_TAIL <= end;
+}
+
+void undofile_detach(UndoState *u) {
+    if (u->file.fd >= 0 && u->file.path)
+        close(u->file.fd);
+    free(u->file.path);
+    u->file.path = NULL;
+    u->file.fd   = -1;
+    u->file.len  = 0;
+}
+
+/* ===================================================================
+ * Groups
+ * =================================================================== */
+
+static size_t rec_bytes(const UndoRec *r) {
+    return (size_t)r->old_len + (r->kind == UR_REPLACE ? (size_t)r->new_len : 0);
+}
+
+void undofile_append(struct Buffer *buf, UndoGroup *g) {
+    UndoFile *f = &buf->undo.file;
+    if (!f->path || g->disk_off || !g->first)
+        return;
+    size_t len = UF_GROUP_HEAD;
+    for (const UndoRec *r = g->first; r; r = r->next)
+        len += UF_REC_HEAD + rec_bytes(r);
+    char *rec = record_new(len);
+    if (!rec)
+        return;
+    char *p = rec + UF_HEAD;
+    put_u32(&p, (uint32_t)g->len);
+    memcpy(p, g->desc, sizeof(g->desc));
+    p += sizeof(g->desc);
+    for (const UndoRec *r = g->first; r; r = r->next) {
+        put_u32(&p, (uint32_t)r->kind);
+        put_u32(&p, (uint32_t)r->row_idx);
+        put_u32(&p, (uint32_t)r->at);
+        put_u32(&p, (uint32_t)r->old_len);
+        put_u32(&p, (uint32_t)r->new_len);
+        size_t n = rec_bytes(r);
+        if (n) {
+            memcpy(p, r->bytes, n);
+            p += n;
+        }
+    }
+    long long off = record_put(f, UF_GROUP, rec, len);
+    free(rec);
+    if (!off) {
+        log_msg("undofile: cannot write %s, not logging this buffer", f->path);
+        undofile_detach(&buf->undo);
+        return;
+    }
+    g->disk_off = off;
+    g->disk_len = UF_HEAD + (long long)len + UF_TAIL;
+}
+
+bool undofile_fault(struct Buffer *buf, UndoGroup *g) {
+    UndoFile *f = &buf->undo.file;
+    if (g->first)
+        return true;
+    if (!f->path || f->fd < 0 || !g->disk_off)
+        return false;
+    uint32_t type, len;
+    uint64_t hash;
+    if (!record_head(f, g->disk_off, f->len, &type, &len, &hash) ||
+        type != UF_GROUP || len < UF_GROUP_HEAD ||
+        UF_HEAD + (long long)len + UF_TAIL != g->disk_len)
+        return false;
+    uint32_t nrec;
+    if (!read_at(f->fd, &nrec, 4, g->disk_off + UF_HEAD) ||
+        nrec == 0 || nrec > (len - UF_GROUP_HEAD) / UF_REC_HEAD)
+        return false;
+
+    size_t  recs_sz = (size_t)nrec * sizeof(UndoRec);
+    char   *own     = malloc(recs_sz + len);
+    if (!own)
+        return false;
+    char *payload = own + recs_sz;
+    if (!read_at(f->fd, payload, len, g->disk_off + UF_HEAD) ||
+        hash_bytes(UF_HASH_SEED, payload, len) != hash) {
+        free(own);
+        return false;
+    }
+
+    UndoRec    *recs = (UndoRec *)(void *)own;
+    const char *p    = payload + 4;
+    const char *end  = payload + len;
+    memcpy(g->desc, p, sizeof(g->desc));
+    g->desc[sizeof(g->desc) - 1] = '\0';
+    p += sizeof(g->desc);
+    for (uint32_t i = 0; i < nrec; i++) {
+        UndoRec *r = &recs[i];
+        if (end - p < UF_REC_HEAD)
+            goto bad;
+        memset(r, 0, sizeof(*r));
+        r->kind    = (UndoKind)get_u32(&p);
+        r->row_idx = (int)get_u32(&p);
+        r->at      = (int)get_u32(&p);
+        r->old_len = (int)get_u32(&p);
+        r->new_len = (int)get_u32(&p);
+        if ((r->kind != UR_REPLACE && r->kind != UR_INSERT &&
+             r->kind != UR_DELETE) ||
+            r->at < 0 || r->old_len < 0 || r->new_len < 0)
+            goto bad;
+        size_t n = rec_bytes(r);
+        if ((size_t)(end - p) < n)
+            goto bad;
+        r->bytes = n ? (char *)p : NULL;
+        p += n;
+        r->prev = i ? &recs[i - 1] : NULL;
+        r->next = i + 1 < nrec ? &recs[i + 1] : NULL;
+    }
+    g->own   = own;
+    g->first = &recs[0];
+    g->last  = &recs[nrec - 1];
+    g->len   = (int)nrec;
+    return true;
+bad:
+    free(own);
+    return false;
+}
+
+/* ===================================================================
+ * Checkpoints
+ * =================================================================== */
+
+/* Rebuild the ring from the checkpoint at `off` if it was taken for
+ * the buffer's current text. */
+static bool restore(struct Buffer *buf, long long off, uint32_t len,
+                    uint64_t hash) {
+    UndoState *u = &buf->undo;
+    if (len < UF_CKPT_HEAD)
+        return false;
+    char *payload = malloc(len);
+    if (!payload)
+        return false;
+    bool ok = false;
+    if (!read_at(u->file.fd, payload, len, off + UF_HEAD) ||
+        hash_bytes(UF_HASH_SEED, payload, len) != hash)
+        goto out;
+
+    const char *p         = payload;
+    uint64_t    text_h    = get_u64(&p);
+    uint64_t    text_len  = get_u64(&p);
+    uint32_t    n         = get_u32(&p);
+    int32_t     cur       = (int32_t)get_u32(&p);
+    int32_t     root_next = (int32_t)get_u32(&p);
+    if (n > UNDO_MAX_DEPTH || len != UF_CKPT_HEAD + (uint64_t)n * UF_CKPT_GROUP ||
+        cur < UNDO_ROOT || cur >= (int32_t)n || root_next < UNDO_ROOT ||
+        root_next >= (int32_t)n)
+        goto out;
+    uint64_t cur_len;
+    if (content_hash(buf, &cur_len) != text_h || cur_len != text_len)
+        goto out;
+
+    if (!u->ring) {
+        u->ring = calloc(UNDO_MAX_DEPTH, sizeof(UndoGroup));
+        if (!u->ring)
+            goto out;
+    }
+    /* Groups are renumbered from 0; parents come before children. */
+    u->head = 0;
+    for (int32_t i = 0; i < (int32_t)n; i++) {
+        UndoGroup *g = &u->ring[i];
+        memset(g, 0, sizeof(*g));
+        g->disk_off = (long long)get_u64(&p);
+        g->disk_len = (long long)get_u64(&p);
+        g->parent   = (int32_t)get_u32(&p);
+        g->next     = (int32_t)get_u32(&p);
+        g->time     = (long long)get_u64(&p);
+        if (g->disk_off < UF_MAGIC_LEN || g->disk_len <= 0 ||
+            g->disk_off + g->disk_len > off || g->parent < UNDO_ROOT ||
+            g->parent >= i || g->next < UNDO_ROOT || g->next >= (int32_t)n)
+            goto out;
+    }
+    u->len       = (int)n;
+    u->seq0      = 0;
+    u->cur       = cur;
+    u->root_next = root_next;
+    ok = true;
+out:
+    free(payload);
+    return ok;
+}
+
+bool undofile_attach(struct Buffer *buf, const char *path) {
+    UndoState *u = &buf->undo;
+    UndoFile  *f = &u->file;
+    /* Groups kept so far point into the old file: read them in, to be
+     * logged again in the new one. One that cannot be read is given up,
+     * so no checkpoint lists a group that is not in the log. */
+    for (int i = 0; u->ring && i < u->len; i++) {
+        UndoGroup *g = undo_group_at(u, i);
+        undofile_fault(buf, g);
+        g->disk_off = g->disk_len = 0;
+    }
+    for (int seq = u->seq0; seq < u->seq0 + u->len; seq++) {
+        UndoGroup *g = undo_group_seq(u, seq);
+        if (g && !g->dead && !g->first)
+            undo_group_lost(u, seq);
+    }
+    undofile_detach(u);
+    f->path = strdup(path);
+    if (!f->path)
+        return false;
+    f->fd = open(path, O_RDWR);
+    if (f->fd < 0)
+        return false;
+
+    struct stat st;
+    char        magic[UF_MAGIC_LEN];
+    bool        restored = false;
+    long long   keep     = 0;
+    if (fstat(f->fd, &st) != 0)
+        goto done;
+    f->len = (long long)st.st_size;
+    /* Only an empty history can be replaced by the logged one. */
+    if (u->len || u->has_open)
+        goto done;
+    if (f->len < UF_MAGIC_LEN || !read_at(f->fd, magic, UF_MAGIC_LEN, 0) ||
+        memcmp(magic, UF_MAGIC, UF_MAGIC_LEN) != 0)
+        goto done;
+
+    /* Walk back over the groups logged since the last save. */
+    long long end = f->len;
+    while (end > UF_MAGIC_LEN) {
+        uint32_t total, type, len;
+        uint64_t hash;
+        if (!read_at(f->fd, &total, 4, end - UF_TAIL) ||
+            total < UF_HEAD + UF_TAIL || total > end - UF_MAGIC_LEN ||
+            !record_head(f, end - total, end, &type, &len, &hash) ||
+            UF_HEAD + len + UF_TAIL != total)
+            break;
+        if (type == UF_CHECKPOINT) {
+            restored = restore(buf, end - total, len, hash);
+            keep     = end;
+            break;
+        }
+        if (type != UF_GROUP)
+            break;
+        end -= total;
+    }
+
+done:
+    if (!restored)
+        keep = 0;
+    if (keep != f->len && ftruncate(f->fd, (off_t)keep) != 0) {
+        log_msg("undofile: cannot trim %s", f->path);
+        undofile_detach(u);
+        return false;
+    }
+    f->len = keep;
+    return restored;
+}
+
+/* Rewrite the log with only the live groups in the ring. */
+static void compact(struct Buffer *buf) {
+    UndoState *u = &buf->undo;
+    UndoFile  *f = &u->file;
+    int        n = u->len;
+    char       tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", f->path) >= (int)sizeof(tmp))
+        return;
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return;
+    long long *offs = malloc(((size_t)n + 1) * sizeof(long long));
+    long long  pos  = UF_MAGIC_LEN;
+    bool       ok   = offs && write_at(fd, UF_MAGIC, UF_MAGIC_LEN, 0);
+    for (int i = 0; ok && i < n; i++) {
+        UndoGroup *g = undo_group_at(u, i);
+        offs[i]      = 0;
+        if (g->dead || !g->disk_off)
+            continue;
+        char *rec = malloc((size_t)g->disk_len);
+        ok = rec && read_at(f->fd, rec, (size_t)g->disk_len, g->disk_off) &&
+             write_at(fd, rec, (size_t)g->disk_len, pos);
+        free(rec);
+        offs[i] = pos;
+        pos += g->disk_len;
+    }
+    if (ok && rename(tmp, f->path) == 0) {
+        for (int i = 0; i < n; i++)
+            undo_group_at(u, i)->disk_off = offs[i];
+        close(f->fd);
+        f->fd  = fd;
+        f->len = pos;
+    } else {
+        close(fd);
+        unlink(tmp);
+    }
+    free(offs);
+}
+
+/* Checkpoint number of group `seq`, given each ring slot's in `idx`. */
+static int ckpt_index(UndoState *u, const int *idx, int seq) {
+    return undo_group_seq(u, seq) ? idx[seq - u->seq0] : UNDO_ROOT;
+}
+
+void undofile_checkpoint(struct Buffer *buf) {
+    UndoState *u = &buf->undo;
+    UndoFile  *f = &u->file;
+    if (!f->path)
+        return;
+    /* Live groups are numbered from 0 in the checkpoint. */
+    int      *idx  = malloc(((size_t)u->len + 1) * sizeof(int));
+    int       n    = 0;
+    long long live = 0;
+    if (!idx)
+        return;
+    for (int i = 0; i < u->len; i++) {
+        UndoGroup *g = undo_group_at(u, i);
+        idx[i]       = g->dead ? UNDO_ROOT : n++;
+        if (g->dead)
+            continue;
+        if (!g->disk_off)
+            undofile_append(buf, g);
+        if (!f->path) {
+            free(idx);
+            return;
+        }
+        live += g->disk_len;
+    }
+    if (f->len > 2 * live + UF_SLACK)
+        compact(buf);
+
+    size_t len = UF_CKPT_HEAD + (size_t)n * UF_CKPT_GROUP;
+    char  *rec = record_new(len);
+    if (!rec) {
+        free(idx);
+        return;
+    }
+    char    *p = rec + UF_HEAD;
+    uint64_t text_len;
+    put_u64(&p, content_hash(buf, &text_len));
+    put_u64(&p, text_len);
+    put_u32(&p, (uint32_t)n);
+    put_u32(&p, (uint32_t)ckpt_index(u, idx, u->cur));
+    put_u32(&p, (uint32_t)ckpt_index(u, idx, u->root_next));
+    for (int i = 0; i < u->len; i++) {
+        UndoGroup *g = undo_group_at(u, i);
+        if (g->dead)
+            continue;
+        put_u64(&p, (uint64_t)g->disk_off);
+        put_u64(&p, (uint64_t)g->disk_len);
+        put_u32(&p, (uint32_t)ckpt_index(u, idx, g->parent));
+        put_u32(&p, (uint32_t)ckpt_index(u, idx, g->next));
+        put_u64(&p, (uint64_t)g->time);
+    }
+    if (!record_put(f, UF_CHECKPOINT, rec, len)) {
+        log_msg("undofile: cannot write %s, not logging this buffer", f->path);
+        undofile_detach(u);
+    }
+    free(rec);
+    free(idx);
+}
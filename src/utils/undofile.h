@@ -0,0 +1,61 @@
+#ifndef UNDOFILE_H
+#define UNDOFILE_H
+
+#include "utils/undo.h"
+#include <stdbool.h>
+
+/*
+ * On-disk undo history: one append-only log per file, kept under
+ * "~/.cache/hed/<encoded-cwd>/undo/".
+ *
+ * Format
+ * ------
+ * An 8-byte magic, then records:
+ *
+ *   u32 type | u32 len | u64 hash(payload) | payload[len] | u32 total
+ *
+ * `total` is the whole record's size, so the log can be walked back
+ * from its end. Integers are in host byte order; the cache is local.
+ *
+ * - GROUP: one closed undo group, appended by undo_end().
+ * - CHECKPOINT: written on save. It holds the hash and length of the
+ *   saved text, the current group and the root's redo child, then for
+ *   every live group in the tree, oldest first: the offset and size of
+ *   its record, its parent and redo child (as indexes into this list),
+ *   and the time it closed.
+ *
+ * Loading
+ * -------
+ * On open the log is walked back from its end over the groups logged
+ * since the last save, to the last checkpoint. Only that checkpoint is
+ * read. If it matches the text just loaded, the ring is rebuilt with
+ * every group left on disk, and the unsaved groups after it are cut
+ * off. Otherwise the log starts over. Undo and redo read a group in
+ * the first time they reach it.
+ *
+ * Dropped groups stay in the log until a checkpoint finds it more than
+ * twice the size of the live groups; then it is rewritten with only
+ * those.
+ */
+
+struct Buffer;
+
+/* Use `path` as the buffer's undofile and restore the history it
+ * holds for the buffer's current text. Returns true if a history was
+ * restored. The file is only created once there is something to log. */
+bool undofile_attach(struct Buffer *buf, const char *path);
+
+/* Close the undofile; the file itself is kept. */
+void undofile_detach(UndoState *u);
+
+/* Log a closed group. */
+void undofile_append(struct Buffer *buf, UndoGroup *g);
+
+/* Log a checkpoint for the buffer's current text, which was just
+ * saved. Groups not logged yet are logged first. */
+void undofile_checkpoint(struct Buffer *buf);
+
+/* Read group `g` back from the undofile. */
+bool undofile_fault(struct Buffer *buf, UndoGroup *g);
+
+#endif /* UNDOFILE_H */
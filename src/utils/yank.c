@@ -107,7 +107,7 @@ YankData yank_data_new(Buffer *buf, const TextSelection *sel) {
             /* Character-wise or line-wise: store text with newlines */
             for (int y = sy; y <= ey; y++) {
                 if (y >= buf->num_rows) break;
-                Row *r = &buf->rows[y];
+                Row *r = buf_row(buf, y);
                 int start_col = (y == sy) ? sx : 0;
                 int end_col = (y == ey) ? ex : (int)r->chars.len;
 
@@ -126,7 +126,7 @@ YankData yank_data_new(Buffer *buf, const TextSelection *sel) {
             /* Block-wise: store each row segment separately */
             for (int y = sy; y <= ey; y++) {
                 if (y >= buf->num_rows) break;
-                Row *r = &buf->rows[y];
+                Row *r = buf_row(buf, y);
 
                 /* For block mode, sx and ex are the column boundaries */
                 int start_col = sx;
@@ -194,7 +194,7 @@ EdError yank_block(Buffer *buf, int sy, int ey, int start_rx, int end_rx_excl) {
 
     StrBuf out = strbuf_new();
     for (int y = sy; y <= ey; y++) {
-        Row *r = &buf->rows[y];
+        Row *r = buf_row(buf, y);
         int c0 = buf_row_rx_to_cx(r, start_rx);
         int c1 = buf_row_rx_to_cx(r, end_rx_excl);
         if (c0 > (int)r->chars.len) c0 = (int)r->chars.len;
@@ -278,7 +278,7 @@ EdError paste_from_register(Buffer *buf, char reg_name, bool after) {
             win->cursor.x = 0;
         } else {
             int rowlen = (at_line < buf->num_rows)
-                             ? (int)buf->rows[at_line].chars.len : 0;
+                             ? (int)buf_row(buf, at_line)->chars.len : 0;
             int col = at_col;
             if (after && col < rowlen) col++;
             if (col < 0) col = 0;
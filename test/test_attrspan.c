@@ -0,0 +1,147 @@
+/* AttrSpans cache tests: fill rows with one span tagged by the row's
+ * identity, push edits through attrspan_apply_edit, and check every
+ * cached row either still carries its own tag at its new index or is
+ * stale. */
+#include "../src/buf/attrspan.h"
+#include "../src/buf/buffer.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) { }
+void tearDown(void) { }
+
+static const char SGR[] = "\x1b[1m";
+
+/* Fill rows [lo, hi) with one span whose col_end is tag[row]. */
+static void fill(AttrSpans *s, int lo, int hi, const int *tag) {
+    attrspan_fill_begin(s, lo, hi);
+    for (int r = lo; r < hi; r++)
+        attrspan_push(s, r, 0, tag[r], SGR, 0);
+    attrspan_fill_end(s);
+}
+
+static int cached_tag(const AttrSpans *s, int row) {
+    if (attrspan_row_count(s, row) == 0)
+        return -1;
+    return attrspan_at(s, row, 0)->col_end;
+}
+
+static BufEditSpan span(int lo, int hi, int delta) {
+    BufEditSpan e = {.touched = true, .lo = lo, .hi = hi, .delta = delta};
+    return e;
+}
+
+void test_fill_and_lookup(void) {
+    AttrSpans s;
+    attrspan_init(&s);
+    attrspan_cover(&s, 10, 20);
+    int run_end = 0;
+    ASSERT_EQ_INT(10, attrspan_next_stale(&s, 10, 20, &run_end));
+    ASSERT_EQ_INT(20, run_end);
+
+    attrspan_fill_begin(&s, 10, 20);
+    attrspan_push(&s, 12, 0, 10, SGR, 0);
+    attrspan_push(&s, 12, 2, 4, "\x1b[2m", 5);
+    attrspan_push(&s, 25, 0, 10, SGR, 0); /* outside the fill: dropped */
+    attrspan_fill_end(&s);
+    ASSERT_EQ_INT(-1, attrspan_next_stale(&s, 10, 20, &run_end));
+    ASSERT_EQ_INT(2, attrspan_row_count(&s, 12));
+    ASSERT_EQ_INT(0, attrspan_row_count(&s, 25));
+    /* Higher priority wins inside the overlap, the wide span outside. */
+    ASSERT_EQ_INT(5, attrspan_at(&s, 12, 3)->priority);
+    ASSERT_EQ_INT(0, attrspan_at(&s, 12, 5)->priority);
+    TEST_ASSERT_TRUE_MESSAGE(attrspan_at(&s, 12, 10) == NULL, "past span end");
+
+    /* Only newly covered rows come back stale. */
+    attrspan_cover(&s, 15, 25);
+    ASSERT_EQ_INT(20, attrspan_next_stale(&s, 15, 25, &run_end));
+    ASSERT_EQ_INT(25, run_end);
+    attrspan_free(&s);
+}
+
+void test_edits_shift_rows(void) {
+    enum { N = 200, W0 = 40, W1 = 140 };
+    AttrSpans s;
+    attrspan_init(&s);
+    /* ref[r]: tag expected on row r, or 0 for "must be stale". */
+    static int ref[N * 2], next[N * 2];
+    int n = N, tag = 0;
+    for (int r = 0; r < n; r++)
+        ref[r] = ++tag;
+    attrspan_cover(&s, W0, W1);
+    fill(&s, W0, W1, ref);
+
+    srand(99);
+    for (int op = 0; op < 2000; op++) {
+        /* A random edit: rows [lo, lo + old_rows) become new_rows rows. */
+        int lo = rand() % n;
+        int old_rows = rand() % 4;
+        if (lo + old_rows > n) old_rows = n - lo;
+        int new_rows = rand() % 4;
+        if (n - old_rows + new_rows > N * 2 - 1) new_rows = 0;
+        BufEditSpan e = span(lo, lo + new_rows, new_rows - old_rows);
+        attrspan_apply_edit(&s, &e);
+
+        int m = 0;
+        for (int r = 0; r < lo; r++) next[m++] = ref[r];
+        for (int k = 0; k < new_rows; k++) next[m++] = 0;
+        for (int r = lo + old_rows; r < n; r++) next[m++] = ref[r];
+        n = m;
+        memcpy(ref, next, (size_t)n * sizeof(int));
+
+        for (int r = 0; r < n; r++) {
+            int got = cached_tag(&s, r);
+            if (got >= 0)
+                ASSERT_EQ_INT(ref[r], got);
+        }
+        /* Refill a viewport now and then, like the renderer would. */
+        if (op % 50 == 0 && n > W1) {
+            for (int r = 0; r < n; r++)
+                if (ref[r] == 0) ref[r] = ++tag;
+            attrspan_cover(&s, W0, W1);
+            int rlo, rhi, from = W0;
+            while ((rlo = attrspan_next_stale(&s, from, W1, &rhi)) >= 0) {
+                fill(&s, rlo, rhi, ref);
+                from = rhi;
+            }
+        }
+    }
+    attrspan_free(&s);
+}
+
+void test_sync_drops_on_key_change(void) {
+    AttrSpans s;
+    attrspan_init(&s);
+    int tag[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    attrspan_sync(&s, "c", NULL);
+    attrspan_cover(&s, 0, 8);
+    fill(&s, 0, 8, tag);
+    attrspan_sync(&s, "c", NULL);
+    ASSERT_EQ_INT(-1, attrspan_next_stale(&s, 0, 8, NULL));
+
+    attrspan_sync(&s, "markdown", NULL);
+    ASSERT_EQ_INT(0, attrspan_next_stale(&s, 0, 8, NULL));
+    fill(&s, 0, 8, tag);
+
+    attrspan_invalidate_global();
+    attrspan_sync(&s, "markdown", NULL);
+    ASSERT_EQ_INT(0, attrspan_next_stale(&s, 0, 8, NULL));
+    fill(&s, 0, 8, tag);
+
+    BufEditSpan reset = {.touched = true, .reset = true};
+    attrspan_sync(&s, "markdown", &reset);
+    ASSERT_EQ_INT(0, attrspan_next_stale(&s, 0, 8, NULL));
+    attrspan_free(&s);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_and_lookup);
+    RUN_TEST(test_edits_shift_rows);
+    RUN_TEST(test_sync_drops_on_key_change);
+    return UNITY_END();
+}
@@ -0,0 +1,75 @@
+/* Fold index tests: toggle random nested folds and check every index
+ * query against a brute-force walk over the regions. */
+#include "../src/utils/fold.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void setUp(void) { }
+void tearDown(void) { }
+
+static int ref_hidden(const FoldList *l, int line) {
+    for (int i = 0; i < l->count; i++) {
+        const FoldRegion *r = &l->regions[i];
+        if (r->is_collapsed && line > r->start_line && line <= r->end_line)
+            return 1;
+    }
+    return 0;
+}
+
+static void check_all(const FoldList *l, int lines) {
+    int hidden = 0;
+    for (int y = 0; y < lines; y++) {
+        int h = ref_hidden(l, y);
+        ASSERT_EQ_INT(h, fold_is_line_hidden(l, y));
+        ASSERT_EQ_INT(hidden, fold_hidden_before(l, y));
+        int next = y;
+        while (ref_hidden(l, next)) next++;
+        ASSERT_EQ_INT(next, fold_next_visible_line(l, y, 1));
+        int prev = y;
+        while (ref_hidden(l, prev)) prev--;
+        ASSERT_EQ_INT(prev, fold_next_visible_line(l, y, -1));
+        hidden += h;
+    }
+    ASSERT_EQ_INT(lines - hidden, fold_get_visible_line_count(l, lines));
+}
+
+void test_nested_toggles_match_walk(void) {
+    enum { LINES = 300 };
+    FoldList l;
+    fold_list_init(&l);
+    srand(7);
+    for (int i = 0; i < 60; i++) {
+        int a = rand() % LINES, len = rand() % 40;
+        fold_add_region(&l, a, a + len < LINES ? a + len : LINES - 1);
+    }
+    check_all(&l, LINES);
+    for (int op = 0; op < 300; op++) {
+        int k = rand() % 10;
+        if (k < 7)
+            fold_set_collapsed(&l, rand() % l.count, rand() % 2);
+        else if (k == 7)
+            fold_toggle_at_line(&l, rand() % LINES);
+        else if (k == 8)
+            fold_apply_level(&l, rand() % 4);
+        else if (l.count > 20)
+            fold_remove_region(&l, rand() % l.count);
+        check_all(&l, LINES);
+    }
+    fold_set_all_collapsed(&l, false);
+    ASSERT_EQ_INT(0, fold_hidden_before(&l, LINES));
+    ASSERT_EQ_INT(l.count, fold_set_all_collapsed(&l, true));
+    ASSERT_EQ_INT(0, fold_set_all_collapsed(&l, true));
+    check_all(&l, LINES);
+    fold_clear_all(&l);
+    ASSERT_EQ_INT(0, fold_hidden_before(&l, LINES));
+    fold_list_free(&l);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nested_toggles_match_walk);
+    return UNITY_END();
+}
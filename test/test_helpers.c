@@ -167,17 +167,7 @@ Buffer *create_test_buffer(const char *text) {
     if (!buf)
         return NULL;
 
-    int num_lines = 1;
-    for (const char *p = text; *p; p++) {
-        if (*p == '\n')
-            num_lines++;
-    }
-
-    buf->rows = calloc(num_lines, sizeof(Row));
-    if (!buf->rows) {
-        free(buf);
-        return NULL;
-    }
+    rowtree_init(&buf->rows);
     buf->num_rows = 0;
 
     const char *line_start = text;
@@ -185,7 +175,11 @@ Buffer *create_test_buffer(const char *text) {
     while (1) {
         if (*p == '\n' || *p == '\0') {
             size_t line_len = p - line_start;
-            Row *row = &buf->rows[buf->num_rows];
+            Row *row = rowtree_insert(&buf->rows, buf->num_rows);
+            if (!row) {
+                free_test_buffer(buf);
+                return NULL;
+            }
             row->chars.data = malloc(line_len + 1);
             if (!row->chars.data) {
                 free_test_buffer(buf);
@@ -210,10 +204,10 @@ Buffer *create_test_buffer(const char *text) {
 void free_test_buffer(Buffer *buf) {
     if (!buf)
         return;
-    for (int i = 0; i < buf->num_rows; i++) {
-        free(buf->rows[i].chars.data);
+    for (int i = 0; i < buf->rows.count; i++) {
+        free(buf_row(buf, i)->chars.data);
     }
-    free(buf->rows);
+    rowtree_free(&buf->rows);
     free(buf);
 }
 /* Convenience wrappers for bracket tests */
@@ -2,10 +2,22 @@
 #define TEST_HELPERS_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 #include "../src/buf/buffer.h"
 #include "../src/buf/textobj.h"
 
+/* Unity assertion on two ints that names the expression and both
+ * values on failure. */
+#define ASSERT_EQ_INT(expected, actual)                                        \
+    do {                                                                       \
+        int _e = (int)(expected), _a = (int)(actual);                          \
+        char _msg[160];                                                        \
+        snprintf(_msg, sizeof(_msg), "%s: expected %d, got %d", #actual, _e,   \
+                 _a);                                                          \
+        TEST_ASSERT_TRUE_MESSAGE(_e == _a, _msg);                              \
+    } while (0)
+
 typedef struct {
     char *text;
     TextPos initial;
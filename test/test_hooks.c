@@ -0,0 +1,171 @@
+/* Hook dispatch tests: mode and filetype filters resolved through the
+ * per-type tables, the "txt" filetype of buffers without one, hooks
+ * registered and unregistered from a callback while a fire is running,
+ * and a buffer hook consuming the event. */
+#include "../src/hooks.h"
+#include "../src/editor.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* hooks.c reads the current mode from here. */
+Ed E;
+
+/* Each callback appends its letter, so a fire leaves the order it ran
+ * callbacks in. */
+static char   g_log[64];
+static Buffer g_buf;
+
+static void note(char c) {
+    size_t n = strlen(g_log);
+    if (n + 1 < sizeof(g_log)) {
+        g_log[n]     = c;
+        g_log[n + 1] = '\0';
+    }
+}
+
+static void ch_a(const HookCharEvent *e) { (void)e; note('a'); }
+static void ch_b(const HookCharEvent *e) { (void)e; note('b'); }
+static void ch_c(const HookCharEvent *e) { (void)e; note('c'); }
+static void ch_d(const HookCharEvent *e) { (void)e; note('d'); }
+
+static const char *fire_char(int mode, const char *filetype) {
+    E.mode         = mode;
+    g_buf.filetype = (char *)filetype;
+    g_log[0]       = '\0';
+    HookCharEvent ev = { .buf = &g_buf, .row = 0, .col = 0, .c = 'x' };
+    hook_fire_char(HOOK_CHAR_INSERT, &ev);
+    return g_log;
+}
+
+static const char *fire_buffer(HookType type, const char *filetype) {
+    g_buf.filetype = (char *)filetype;
+    g_log[0]       = '\0';
+    HookBufferEvent ev = { .buf = &g_buf, .filename = NULL, .consumed = 0 };
+    hook_fire_buffer(type, &ev);
+    return g_log;
+}
+
+void setUp(void) {
+    memset(&g_buf, 0, sizeof(g_buf));
+    g_log[0] = '\0';
+    E.mode   = MODE_NORMAL;
+    hook_init();
+}
+
+void tearDown(void) { hook_init(); }
+
+void test_mode_and_filetype_filter(void) {
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", ch_a);
+    hook_register_char(HOOK_CHAR_INSERT, MODE_INSERT, "*", ch_b);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "c", ch_c);
+    hook_register_char(HOOK_CHAR_INSERT, MODE_NORMAL, "py", ch_d);
+
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("abc", fire_char(MODE_INSERT, "c"),
+                                     "insert, c");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ac", fire_char(MODE_NORMAL, "c"),
+                                     "normal, c");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ad", fire_char(MODE_NORMAL, "py"),
+                                     "normal, py");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ab", fire_char(MODE_INSERT, "py"),
+                                     "insert, py");
+    /* A filetype no hook names, and a mode outside the table, only see
+     * the wildcards. */
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ab", fire_char(MODE_INSERT, "rust"),
+                                     "unknown filetype");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ac",
+                                     fire_char(MODE_VISUAL_BLOCK + 7, "c"),
+                                     "unknown mode");
+
+    /* A filetype first named after the tables were built. */
+    hook_register_char(HOOK_CHAR_INSERT, -1, "rust", ch_d);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("abd", fire_char(MODE_INSERT, "rust"),
+                                     "new filetype column");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("abc", fire_char(MODE_INSERT, "c"),
+                                     "old columns kept");
+
+    ASSERT_EQ_INT(2, hook_unregister(HOOK_CHAR_INSERT, (HookFn)ch_d));
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("a", fire_char(MODE_NORMAL, "py"),
+                                     "unregistered everywhere");
+}
+
+static void buf_t(HookBufferEvent *e) { (void)e; note('t'); }
+static void buf_s(HookBufferEvent *e) { (void)e; note('s'); }
+
+void test_txt_default(void) {
+    hook_register_buffer(HOOK_BUFFER_OPEN, -1, "txt", buf_t);
+    hook_register_buffer(HOOK_BUFFER_OPEN, -1, "*", buf_s);
+
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ts", fire_buffer(HOOK_BUFFER_OPEN, NULL),
+                                     "no filetype is txt");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ts", fire_buffer(HOOK_BUFFER_OPEN, "txt"),
+                                     "txt");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("s", fire_buffer(HOOK_BUFFER_OPEN, "c"),
+                                     "c");
+
+    /* No buffer at all also counts as txt. */
+    g_log[0] = '\0';
+    HookBufferEvent ev = { .buf = NULL, .filename = NULL, .consumed = 0 };
+    hook_fire_buffer(HOOK_BUFFER_OPEN, &ev);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ts", g_log, "no buffer");
+}
+
+/* ch_x swaps ch_b out for ch_d, names a new filetype (which makes every
+ * table stale) and fires another hook, all in the middle of a fire. */
+static void key_k(HookKeyEvent *e) { (void)e; note('k'); }
+
+static void ch_x(const HookCharEvent *e) {
+    (void)e;
+    note('x');
+    hook_unregister(HOOK_CHAR_INSERT, (HookFn)ch_b);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", ch_d);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "go", ch_c);
+    HookKeyEvent kev = { .key = 'k', .consumed = 0 };
+    hook_fire_key(HOOK_KEYPRESS, &kev);
+}
+
+void test_change_during_fire(void) {
+    hook_register_key(HOOK_KEYPRESS, key_k);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", ch_a);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", ch_x);
+    hook_register_char(HOOK_CHAR_INSERT, -1, "*", ch_b);
+
+    /* The fire finishes over the table it started with. */
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("axkb", fire_char(MODE_NORMAL, "c"),
+                                     "first fire");
+    hook_unregister(HOOK_CHAR_INSERT, (HookFn)ch_x);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("ad", fire_char(MODE_NORMAL, "c"),
+                                     "changes seen next time");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("adc", fire_char(MODE_NORMAL, "go"),
+                                     "filetype named mid-fire");
+}
+
+static void buf_eat(HookBufferEvent *e) {
+    note('e');
+    e->consumed = 1;
+}
+
+void test_consumed_stops_dispatch(void) {
+    hook_register_buffer(HOOK_BUFFER_OPEN_PRE, -1, "*", buf_s);
+    hook_register_buffer(HOOK_BUFFER_OPEN_PRE, -1, "md", buf_eat);
+    hook_register_buffer(HOOK_BUFFER_OPEN_PRE, -1, "*", buf_t);
+
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("se",
+                                     fire_buffer(HOOK_BUFFER_OPEN_PRE, "md"),
+                                     "stops after the consumer");
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("st",
+                                     fire_buffer(HOOK_BUFFER_OPEN_PRE, "c"),
+                                     "consumer filtered out");
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_mode_and_filetype_filter);
+    RUN_TEST(test_txt_default);
+    RUN_TEST(test_change_during_fire);
+    RUN_TEST(test_consumed_stops_dispatch);
+    return UNITY_END();
+}
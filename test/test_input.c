@@ -2,6 +2,7 @@
  * pipe and assert on the decoded key, with focus on SGR mouse events. */
 #include "../src/input/input.h"
 #include "../src/editor.h"
+#include "test_helpers.h"
 #include "unity/unity.h"
 
 #include <stdio.h>
@@ -19,15 +20,6 @@ void die(const char *s) {
 }
 
 /* The vendored Unity is minimal (only *_MESSAGE asserts). */
-#define ASSERT_EQ_INT(expected, actual)                                        \
-    do {                                                                       \
-        int _e = (int)(expected), _a = (int)(actual);                          \
-        char _msg[160];                                                        \
-        snprintf(_msg, sizeof(_msg), "%s: expected %d, got %d", #actual, _e,   \
-                 _a);                                                          \
-        TEST_ASSERT_TRUE_MESSAGE(_e == _a, _msg);                              \
-    } while (0)
-
 static int parse_bytes(const char *bytes, size_t len) {
     int fds[2];
     ASSERT_EQ_INT(0, pipe(fds));
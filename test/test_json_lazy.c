@@ -0,0 +1,89 @@
+/* Lazy JSON view tests: member lookup past nested values, string
+ * decoding, budgeted array walks, and bounded scans of bad input. */
+#include "../plugins/lsp/json_lazy.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) { }
+void tearDown(void) { }
+
+#define ASSERT_TRUE(c)  TEST_ASSERT_TRUE_MESSAGE((c), #c)
+#define ASSERT_FALSE(c) TEST_ASSERT_TRUE_MESSAGE(!(c), "!" #c)
+#define ASSERT_STR(expected, actual)                                           \
+    TEST_ASSERT_EQUAL_STRING_MESSAGE((expected), (actual), #actual)
+
+static JsonVal root(const char *s) { return jv_root(s, strlen(s)); }
+
+void test_lookup_skips_nested_values(void) {
+    JsonVal v = root("{\"result\":{\"items\":[{\"id\":9},\"}]\\\"\"],"
+                     "\"x\":[]},\"jsonrpc\":\"2.0\",\"id\":42}");
+    ASSERT_EQ_INT(JV_OBJECT, v.type);
+    ASSERT_EQ_INT(42, jv_get_int(v, "id", -1));
+    ASSERT_TRUE(jv_streq(jv_get(v, "jsonrpc"), "2.0"));
+    ASSERT_EQ_INT(JV_ARRAY, jv_path(v, "result.x").type);
+    ASSERT_FALSE(jv_ok(jv_get(v, "method")));
+    ASSERT_FALSE(jv_ok(jv_path(v, "result.items.id")));
+    ASSERT_EQ_INT(-1, jv_get_int(v, "jsonrpc", -1));
+}
+
+void test_string_decoding(void) {
+    JsonVal v = root("{\"s\":\"a\\\"b\\\\c\\n\\u00e9\\ud83d\\ude00\\/\"}");
+    char *s = jv_get_strdup(v, "s");
+    ASSERT_STR("a\"b\\c\n\xc3\xa9\xf0\x9f\x98\x80/", s);
+    ASSERT_TRUE(jv_streq(jv_get(v, "s"), s));
+    free(s);
+
+    char small[4];
+    ASSERT_TRUE(jv_strcpy(jv_get(v, "s"), small, sizeof(small)));
+    ASSERT_STR("a\"b", small);
+    ASSERT_FALSE(jv_strcpy(jv_get(v, "missing"), small, sizeof(small)));
+    ASSERT_STR("", small);
+}
+
+void test_array_walk_with_budget(void) {
+    JsonVal  v = root("[ 1, {\"a\":[2,3]}, \"x,y\", null, true, -2.5e1 ]");
+    JsonIter it;
+    JsonVal  e;
+    ASSERT_EQ_INT(6, jv_count(v, 0));
+    ASSERT_EQ_INT(3, jv_count(v, 3));
+    ASSERT_TRUE(jv_iter(v, &it));
+    JvType want[] = { JV_NUMBER, JV_OBJECT, JV_STRING, JV_NULL, JV_BOOL, JV_NUMBER };
+    int n = 0;
+    while (jv_iter_next(&it, &e)) {
+        ASSERT_EQ_INT(want[n], e.type);
+        n++;
+    }
+    ASSERT_EQ_INT(6, n);
+    ASSERT_EQ_INT(-25, jv_int(e, 0));
+    ASSERT_EQ_INT(0, jv_count(root("[]"), 0));
+}
+
+void test_malformed_input_stays_in_bounds(void) {
+    const char *full = "{\"id\":1,\"result\":[{\"label\":\"abc\"}]}";
+    size_t len = strlen(full);
+    for (size_t cut = 0; cut < len; cut++) {
+        /* Exact-size copy, no terminator: a scan past `cut` would be
+         * caught by the sanitizers. */
+        char *p = malloc(cut ? cut : 1);
+        memcpy(p, full, cut);
+        JsonVal v = jv_root(p, cut);
+        ASSERT_FALSE(jv_ok(v));
+        free(p);
+    }
+    JsonVal v = root("{\"id\":1,\"result\":[1 2]}");
+    ASSERT_EQ_INT(1, jv_get_int(v, "id", -1));
+    ASSERT_EQ_INT(1, jv_count(jv_get(v, "result"), 0));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lookup_skips_nested_values);
+    RUN_TEST(test_string_decoding);
+    RUN_TEST(test_array_walk_with_budget);
+    RUN_TEST(test_malformed_input_stays_in_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+/* Keybinding trie tests: how registered sequences split into key tokens
+ * ("<C-x>", "<M->>", "<<"), filetype bindings over global ones, exact
+ * versus partial matches, and the bindings collected below a prefix. */
+#include "../src/input/keybinds.h"
+#include "../src/hooks.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The pieces of the editor keybinds.c calls. buf_cur() returns a stub
+ * buffer whose filetype each test sets. */
+static Buffer g_buf;
+static int    g_moves;
+
+Buffer *buf_cur(void) { return &g_buf; }
+void hook_fire_keybind_feed(HookType type, const HookKeybindFeedEvent *event) {
+    (void)type;
+    (void)event;
+}
+void hook_fire_keybind_invoke(HookType type,
+                              const HookKeybindInvokeEvent *event) {
+    (void)type;
+    (void)event;
+}
+void regs_set_dot(const char *data, size_t len) {
+    (void)data;
+    (void)len;
+}
+void log_msg(const char *fmt, ...) { (void)fmt; }
+int command_invoke(const char *name, const char *args) {
+    (void)name;
+    (void)args;
+    return 0;
+}
+void kb_operator_move(int key) {
+    (void)key;
+    g_moves++;
+}
+
+static void cb_a(void) {}
+static void cb_b(void) {}
+static void cb_c(void) {}
+static void cb_d(void) {}
+
+void setUp(void) {
+    memset(&g_buf, 0, sizeof(g_buf));
+    g_moves = 0;
+    keybind_init();
+}
+
+void tearDown(void) { keybind_clear_buffer(); }
+
+/* Feed `n` keys from a fresh sequence; the result of the last one. */
+static KeybindFeedResult feed_keys(const int *keys, int n) {
+    KeybindFeedResult r = {0};
+    keybind_clear_buffer();
+    for (int i = 0; i < n; i++)
+        r = keybind_feed(keys[i], MODE_NORMAL);
+    return r;
+}
+
+#define FEED(...)                                                         \
+    feed_keys((const int[]){__VA_ARGS__},                                 \
+              (int)(sizeof((const int[]){__VA_ARGS__}) / sizeof(int)))
+
+void test_sequences_tokenise(void) {
+    keybind_register(MODE_NORMAL, "<C-x>s", cb_a, "ctrl-x s");
+    keybind_register(MODE_NORMAL, "<M->>", cb_b, "meta >");
+    keybind_register(MODE_NORMAL, "<<", cb_c, "dedent");
+    keybind_register(MODE_NORMAL, "<lt", cb_d, "not a key name");
+
+    /* <C-x> is one key: Ctrl-X then s completes it. */
+    KeybindFeedResult r = FEED(0x18);
+    TEST_ASSERT_TRUE_MESSAGE(r.partial && !r.exact, "<C-x> is a prefix");
+    r = FEED(0x18, 's');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_a,
+                             "<C-x>s");
+    ASSERT_EQ_INT(0, FEED('<', 'C').exact);
+
+    /* <M->> is Meta+'>', not '<', 'M', '-', '>'. */
+    r = FEED(KEY_META | '>');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_b,
+                             "<M->>");
+    ASSERT_EQ_INT(0, r.partial);
+
+    /* "<<" is two '<' keys, and "<lt" three plain bytes. */
+    r = FEED('<');
+    TEST_ASSERT_TRUE_MESSAGE(r.partial && !r.exact, "< waits");
+    r = FEED('<', '<');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_c, "<<");
+    r = FEED('<', 'l', 't');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_d, "<lt");
+}
+
+void test_filetype_over_global(void) {
+    keybind_register(MODE_NORMAL, "gd", cb_a, "global");
+    keybind_register_ft(MODE_NORMAL, "gd", "c", cb_b, "c only");
+    keybind_register_ft(MODE_NORMAL, "gx", "c", cb_c, "c only");
+
+    g_buf.filetype = "c";
+    KeybindFeedResult r = FEED('g', 'd');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_b,
+                             "filetype binding wins");
+    ASSERT_EQ_INT(1, r.exact_match.filetype_specific);
+    ASSERT_EQ_INT(1, FEED('g', 'x').exact);
+
+    g_buf.filetype = "txt";
+    r = FEED('g', 'd');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_a,
+                             "global elsewhere");
+    ASSERT_EQ_INT(0, FEED('g', 'x').exact);
+
+    /* Re-registering replaces the binding, in its own scope only. */
+    keybind_register(MODE_NORMAL, "gd", cb_d, "global again");
+    r = FEED('g', 'd');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact_match.callback == cb_d, "replaced");
+    g_buf.filetype = "c";
+    r = FEED('g', 'd');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact_match.callback == cb_b, "ft kept");
+}
+
+void test_partial_and_exact(void) {
+    keybind_register(MODE_NORMAL, "g", cb_a, "g");
+    keybind_register(MODE_NORMAL, "gg", cb_b, "top");
+    keybind_register(MODE_INSERT, "jk", cb_c, "escape");
+
+    KeybindFeedResult r = FEED('g');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.partial, "g: exact and prefix");
+    r = FEED('g', 'g');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && !r.partial, "gg: exact only");
+    r = FEED('g', 'q');
+    TEST_ASSERT_TRUE_MESSAGE(!r.exact && !r.partial && !r.fallback_textobj,
+                             "gq: nothing");
+
+    /* Bindings belong to their mode. */
+    r = FEED('j');
+    TEST_ASSERT_TRUE_MESSAGE(!r.partial && r.fallback_textobj,
+                             "jk is insert-only");
+    keybind_clear_buffer();
+    keybind_feed('j', MODE_INSERT);
+    r = keybind_feed('k', MODE_INSERT);
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.exact_match.callback == cb_c, "jk");
+
+    /* Counts go in front of the sequence. */
+    r = FEED('3', 'g', 'g');
+    TEST_ASSERT_TRUE_MESSAGE(r.exact && r.has_count, "3gg");
+    ASSERT_EQ_INT(3, r.count);
+
+    /* Unmapped single keys fall back to a motion. */
+    keybind_clear_buffer();
+    ASSERT_EQ_INT(1, keybind_process('w', MODE_NORMAL));
+    ASSERT_EQ_INT(1, g_moves);
+}
+
+static bool has_seq(const KeybindMatchView *m, const char *seq) {
+    for (ptrdiff_t i = 0; i < arrlen(m); i++)
+        if (strcmp(m[i].sequence, seq) == 0) return true;
+    return false;
+}
+
+void test_collect_matches(void) {
+    keybind_register(MODE_NORMAL, "g", cb_a, "g");
+    keybind_register(MODE_NORMAL, "gg", cb_b, "top");
+    keybind_register(MODE_NORMAL, "gd", cb_c, "definition");
+    keybind_register(MODE_NORMAL, "x", cb_c, "delete");
+    keybind_register_ft(MODE_NORMAL, "gt", "c", cb_d, "c only");
+
+    keybind_clear_buffer();
+    TEST_ASSERT_TRUE_MESSAGE(keybind_collect_matches() == NULL,
+                             "empty sequence");
+
+    g_buf.filetype = "c";
+    FEED('g');
+    KeybindMatchView *m = keybind_collect_matches();
+    ASSERT_EQ_INT(4, (int)arrlen(m));
+    /* Filetype bindings come first. */
+    TEST_ASSERT_TRUE_MESSAGE(strcmp(m[0].sequence, "gt") == 0, "ft first");
+    TEST_ASSERT_TRUE_MESSAGE(has_seq(m, "g") && has_seq(m, "gg") &&
+                                 has_seq(m, "gd") && !has_seq(m, "x"),
+                             "everything under g");
+    arrfree(m);
+
+    g_buf.filetype = NULL;
+    FEED('g', 'd');
+    m = keybind_collect_matches();
+    ASSERT_EQ_INT(1, (int)arrlen(m));
+    TEST_ASSERT_TRUE_MESSAGE(m[0].callback == cb_c, "just gd");
+    arrfree(m);
+
+    FEED('q');
+    TEST_ASSERT_TRUE_MESSAGE(keybind_collect_matches() == NULL, "no match");
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sequences_tokenise);
+    RUN_TEST(test_filetype_over_global);
+    RUN_TEST(test_partial_and_exact);
+    RUN_TEST(test_collect_matches);
+    return UNITY_END();
+}
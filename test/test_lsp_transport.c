@@ -0,0 +1,201 @@
+/* LSP framing tests: messages fed through a pipe a byte at a time and
+ * in random splits (headers resumed across reads, frames split inside
+ * the terminator, several frames in one read, bodies larger than the
+ * initial buffer), and a write queue drained into a pipe that fills
+ * up. */
+#include "../plugins/lsp/lsp_transport.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int g_fd[2];
+
+void setUp(void) {
+    TEST_ASSERT_TRUE_MESSAGE(pipe(g_fd) == 0, "pipe");
+    fcntl(g_fd[0], F_SETFL, fcntl(g_fd[0], F_GETFL) | O_NONBLOCK);
+}
+
+void tearDown(void) {
+    close(g_fd[0]);
+    close(g_fd[1]);
+}
+
+/* Body i: a recognisable JSON object, `extra` bytes of padding long. */
+static char *make_body(int i, size_t extra, size_t *len) {
+    char *b = malloc(extra + 64);
+    int n = snprintf(b, 64, "{\"id\":%d,\"pad\":\"", i);
+    memset(b + n, 'a' + i % 26, extra);
+    n += (int)extra;
+    n += snprintf(b + n, 8, "\"}");
+    *len = (size_t)n;
+    return b;
+}
+
+/* The wire bytes of `count` messages, some with extra headers. */
+static char *make_stream(char **bodies, size_t *lens, int count,
+                         size_t *out_len) {
+    size_t cap = 256, len = 0;
+    for (int i = 0; i < count; i++)
+        cap += lens[i] + 128;
+    char *s = malloc(cap);
+    for (int i = 0; i < count; i++) {
+        if (i % 3 == 1)
+            len += (size_t)sprintf(s + len, "content-length: %zu\r\n"
+                                   "Content-Type: application/"
+                                   "vscode-jsonrpc; charset=utf-8\r\n\r\n",
+                                   lens[i]);
+        else if (i % 3 == 2)
+            len += (size_t)sprintf(s + len, "X-Junk: 1\r\n\r\n"
+                                   "Content-Length: %zu\r\n\r\n", lens[i]);
+        else
+            len += (size_t)sprintf(s + len, "Content-Length: %zu\r\n\r\n",
+                                   lens[i]);
+        memcpy(s + len, bodies[i], lens[i]);
+        len += lens[i];
+    }
+    *out_len = len;
+    return s;
+}
+
+/* Write `stream` into the pipe in chunks of at most `max_chunk` bytes
+ * (1 for byte by byte, else random sizes), filling the transport and
+ * draining complete messages after each. */
+static void feed(char *stream, size_t len, size_t max_chunk, char **bodies,
+                 size_t *lens, int count) {
+    LspTransport t;
+    lsp_transport_init(&t);
+    int got = 0;
+    size_t at = 0;
+    while (at < len) {
+        size_t n = max_chunk == 1 ? 1 : 1 + (size_t)rand() % max_chunk;
+        if (n > len - at)
+            n = len - at;
+        /* Stay below the pipe's capacity so the write never blocks. */
+        if (n > 32 * 1024)
+            n = 32 * 1024;
+        TEST_ASSERT_TRUE_MESSAGE(write(g_fd[1], stream + at, n) == (ssize_t)n,
+                                 "pipe write");
+        at += n;
+        while (lsp_transport_fill(&t, g_fd[0]) > 0)
+            ;
+        const char *body;
+        size_t blen;
+        while (lsp_transport_next(&t, &body, &blen)) {
+            TEST_ASSERT_TRUE_MESSAGE(got < count, "no extra messages");
+            ASSERT_EQ_INT((int)lens[got], (int)blen);
+            TEST_ASSERT_TRUE_MESSAGE(memcmp(body, bodies[got], blen) == 0,
+                                     "body intact");
+            got++;
+        }
+    }
+    ASSERT_EQ_INT(count, got);
+    lsp_transport_free(&t);
+}
+
+void test_byte_by_byte_and_split(void) {
+    enum { COUNT = 40 };
+    char  *bodies[COUNT];
+    size_t lens[COUNT];
+    srand(5);
+    for (int i = 0; i < COUNT; i++) {
+        /* A few bodies outgrow the initial buffer. */
+        size_t extra = i % 10 == 9 ? 150 * 1024 : (size_t)rand() % 300;
+        bodies[i] = make_body(i, extra, &lens[i]);
+    }
+    size_t len;
+    char *stream = make_stream(bodies, lens, 3, &len);
+    feed(stream, len, 1, bodies, lens, 3);
+    free(stream);
+
+    stream = make_stream(bodies, lens, COUNT, &len);
+    feed(stream, len, 7, bodies, lens, COUNT);
+    feed(stream, len, 4096, bodies, lens, COUNT);
+    feed(stream, len, 1 << 20, bodies, lens, COUNT);
+
+    free(stream);
+    for (int i = 0; i < COUNT; i++)
+        free(bodies[i]);
+}
+
+void test_unusable_header_skipped(void) {
+    static const char s[] = "Content-Length: x\r\n\r\n"
+                            "Content-Length: 99999999999999\r\n\r\n"
+                            "Content-Length: 2\r\n\r\n{}";
+    char  *bodies[] = {"{}"};
+    size_t lens[] = {2};
+    feed((char *)s, sizeof(s) - 1, 1, bodies, lens, 1);
+}
+
+void test_write_queue_drains(void) {
+    enum { COUNT = 6 };
+    fcntl(g_fd[1], F_SETFL, fcntl(g_fd[1], F_GETFL) | O_NONBLOCK);
+    char  *bodies[COUNT];
+    size_t lens[COUNT], total = 0;
+    LspTransport out, in;
+    lsp_transport_init(&out);
+    lsp_transport_init(&in);
+    for (int i = 0; i < COUNT; i++) {
+        bodies[i] = make_body(i, 40 * 1024, &lens[i]);
+        total += lens[i];
+    }
+    /* The pipe takes less than half the messages; queue the rest
+     * behind the bytes it left unwritten. */
+    for (int i = 0; i < COUNT / 2; i++)
+        lsp_transport_queue(&out, bodies[i], lens[i]);
+    ASSERT_EQ_INT(1, lsp_transport_flush(&out, g_fd[1]));
+    for (int i = COUNT / 2; i < COUNT; i++)
+        lsp_transport_queue(&out, bodies[i], lens[i]);
+    TEST_ASSERT_TRUE_MESSAGE(lsp_transport_pending(&out) < total,
+                             "part of the queue written");
+
+    /* Flush reports what is left, and each drain of the read side
+     * lets it go further. */
+    int got = 0, rounds = 0, rc;
+    while ((rc = lsp_transport_flush(&out, g_fd[1])) != 0) {
+        ASSERT_EQ_INT(1, rc);
+        TEST_ASSERT_TRUE_MESSAGE(lsp_transport_pending(&out) > 0,
+                                 "bytes left when flush says so");
+        while (lsp_transport_fill(&in, g_fd[0]) > 0)
+            ;
+        const char *body;
+        size_t blen;
+        while (lsp_transport_next(&in, &body, &blen)) {
+            ASSERT_EQ_INT((int)lens[got], (int)blen);
+            TEST_ASSERT_TRUE_MESSAGE(memcmp(body, bodies[got], blen) == 0,
+                                     "body intact");
+            got++;
+        }
+        rounds++;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(rounds > 0, "pipe filled at least once");
+    ASSERT_EQ_INT(0, (int)lsp_transport_pending(&out));
+    while (lsp_transport_fill(&in, g_fd[0]) > 0)
+        ;
+    const char *body;
+    size_t blen;
+    while (lsp_transport_next(&in, &body, &blen))
+        got++;
+    ASSERT_EQ_INT(COUNT, got);
+
+    lsp_transport_queue(&out, "{\"a\":1}", 7);
+    lsp_transport_discard(&out);
+    ASSERT_EQ_INT(0, (int)lsp_transport_pending(&out));
+
+    lsp_transport_free(&out);
+    lsp_transport_free(&in);
+    for (int i = 0; i < COUNT; i++)
+        free(bodies[i]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_byte_by_byte_and_split);
+    RUN_TEST(test_unusable_header_skipped);
+    RUN_TEST(test_write_queue_drains);
+    return UNITY_END();
+}
@@ -0,0 +1,134 @@
+/* Regex search tests: the DFA against regexec() over random patterns
+ * from the subset it handles, plus the cache, the fallbacks and the
+ * row conventions (`^` at the row start only, backward search). */
+#include "../src/lib/regsearch.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) { }
+void tearDown(void) { regsearch_cache_clear(); }
+
+static RegSearch *get(const char *pat, bool icase) {
+    char err[128];
+    return regsearch_get(pat, icase, err, sizeof(err));
+}
+
+/* Start of the match from `from`, -1 for none; *end gets its end. */
+static int find(RegSearch *rs, const char *s, size_t from, int *end) {
+    size_t so, eo;
+    if (!regsearch_find(rs, s, strlen(s), from, &so, &eo)) return -1;
+    if (end) *end = (int)eo;
+    return (int)so;
+}
+
+static char g_pat[256];
+static int  g_len;
+
+static void emit(const char *s) {
+    while (*s) g_pat[g_len++] = *s++;
+}
+
+static void gen(int depth) {
+    switch (depth > 3 ? rand() % 3 : rand() % 10) {
+    case 0: case 1: { char c[2] = { "abcA"[rand() % 4], 0 }; emit(c); break; }
+    case 2: emit(rand() % 2 ? "." : "[ab]"); break;
+    case 3: gen(depth + 1); gen(depth + 1); break;
+    case 4: emit("("); gen(depth + 1); emit("|"); gen(depth + 1); emit(")"); break;
+    case 5: emit("("); gen(depth + 1); emit(")*"); break;
+    case 6: gen(depth + 1); emit("+"); break;
+    case 7: emit("("); gen(depth + 1); emit(")?"); break;
+    case 8: emit("("); gen(depth + 1); emit(rand() % 2 ? "){1,2}" : "){2}"); break;
+    case 9: emit(rand() % 2 ? "[^a]" : "[[:upper:]b]"); break;
+    }
+}
+
+static void test_dfa_matches_regexec(void) {
+    srand(11);
+    for (int round = 0; round < 3000; round++) {
+        g_len = 0;
+        if (rand() % 8 == 0) emit("^");
+        gen(0);
+        if (rand() % 8 == 0) emit("$");
+        g_pat[g_len] = '\0';
+        bool icase = rand() % 3 == 0;
+
+        RegSearch *rs = get(g_pat, icase);
+        TEST_ASSERT_NOT_NULL_MESSAGE(rs, g_pat);
+        TEST_ASSERT_TRUE_MESSAGE(regsearch_is_fast(rs), g_pat);
+        regex_t re;
+        regcomp(&re, g_pat, REG_EXTENDED | (icase ? REG_ICASE : 0));
+        for (int t = 0; t < 8; t++) {
+            char s[32];
+            int  n = rand() % 20;
+            for (int i = 0; i < n; i++) s[i] = "abcAB"[rand() % 5];
+            s[n] = '\0';
+            size_t     from = (size_t)(rand() % (n + 1));
+            regmatch_t m;
+            int want = regexec(&re, s + from, 1, &m, from ? REG_NOTBOL : 0) == 0
+                     ? (int)from + (int)m.rm_so : -1;
+            int end = -1, got = find(rs, s, from, &end);
+            char msg[400];
+            snprintf(msg, sizeof(msg), "/%s/%s on \"%s\" from %zu: want %d, got %d",
+                     g_pat, icase ? "i" : "", s, from, want, got);
+            TEST_ASSERT_TRUE_MESSAGE(want == got, msg);
+            if (want >= 0)
+                TEST_ASSERT_TRUE_MESSAGE((int)from + (int)m.rm_eo == end, msg);
+        }
+        regfree(&re);
+    }
+}
+
+static void test_cache_and_fallback(void) {
+    RegSearch *a = get("fo+", false);
+    TEST_ASSERT_TRUE_MESSAGE(a == get("fo+", false), "cache hit");
+    TEST_ASSERT_TRUE_MESSAGE(a != get("fo+", true), "icase keyed separately");
+    TEST_ASSERT_TRUE_MESSAGE(regsearch_is_fast(get("plain text", false)), "literal");
+
+    /* Back-references and word boundaries go to regexec. */
+    RegSearch *br = get("(a)\\1", false);
+    TEST_ASSERT_TRUE_MESSAGE(!regsearch_is_fast(br), "backref falls back");
+    ASSERT_EQ_INT(2, find(br, "abaa", 0, NULL));
+    RegSearch *wb = get("\\bfoo", false);
+    TEST_ASSERT_TRUE_MESSAGE(!regsearch_is_fast(wb), "\\b falls back");
+    ASSERT_EQ_INT(5, find(wb, "xfoo foo", 0, NULL));
+    /* From mid-row the byte before `from` still counts. */
+    ASSERT_EQ_INT(5, find(wb, "xfoo foo", 1, NULL));
+    ASSERT_EQ_INT(5, find(get("\\<foo", false), "xfoo foo", 1, NULL));
+    ASSERT_EQ_INT(-1, find(get("^(x)\\1*", false), "xxfoo", 1, NULL));
+    ASSERT_EQ_INT(3, find(br, "abaaa", 3, NULL));
+
+    char err[128] = "";
+    TEST_ASSERT_TRUE_MESSAGE(regsearch_get("a(", false, err, sizeof(err)) == NULL, "bad pattern rejected");
+    TEST_ASSERT_TRUE_MESSAGE(err[0] != '\0', "error text");
+}
+
+static void test_row_conventions(void) {
+    RegSearch *rs = get("^ab", false);
+    ASSERT_EQ_INT(0, find(rs, "abab", 0, NULL));
+    ASSERT_EQ_INT(-1, find(rs, "abab", 1, NULL));
+
+    rs = get("[0-9]+", false);
+    size_t so, eo;
+    const char *s = "a12b345c6";
+    TEST_ASSERT_TRUE_MESSAGE(regsearch_rfind(rs, s, strlen(s), 5, &so, &eo), "rfind from 5");
+    ASSERT_EQ_INT(5, so); /* "45": starts inside the "345" run */
+    TEST_ASSERT_TRUE_MESSAGE(regsearch_rfind(rs, s, strlen(s), 3, &so, &eo), "rfind from 3");
+    ASSERT_EQ_INT(2, so);
+    TEST_ASSERT_TRUE_MESSAGE(!regsearch_rfind(rs, s, strlen(s), 0, &so, &eo), "nothing at 0");
+
+    rs = get("\\w+\\s*=", false);
+    ASSERT_EQ_INT(4, find(rs, "let x_1  = 2", 0, NULL));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_dfa_matches_regexec);
+    RUN_TEST(test_cache_and_fallback);
+    RUN_TEST(test_row_conventions);
+    return UNITY_END();
+}
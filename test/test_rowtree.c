@@ -0,0 +1,143 @@
+/* RowTree tests: drive random inserts/removes against a plain int
+ * array and check every row still lands at the same index. Each Row's
+ * chars.len carries a unique tag so identity survives the moves. */
+#include "../src/buf/rowtree.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) { }
+void tearDown(void) { }
+
+static void check_matches(RowTree *t, const int *ref, int n) {
+    ASSERT_EQ_INT(n, t->count);
+    for (int i = 0; i < n; i++) {
+        Row *r = rowtree_at(t, i);
+        TEST_ASSERT_TRUE_MESSAGE(r != NULL, "row missing");
+        ASSERT_EQ_INT(ref[i], (int)r->chars.len);
+    }
+    /* Backwards too, so the prev-leaf hint path gets exercised. */
+    for (int i = n - 1; i >= 0; i--)
+        ASSERT_EQ_INT(ref[i], (int)rowtree_at(t, i)->chars.len);
+    TEST_ASSERT_TRUE_MESSAGE(rowtree_at(t, n) == NULL, "past-end lookup");
+}
+
+void test_append_and_lookup(void) {
+    RowTree t;
+    rowtree_init(&t);
+    enum { N = 10000 };
+    static int ref[N];
+    for (int i = 0; i < N; i++) {
+        Row *r = rowtree_insert(&t, i);
+        r->chars.len = (size_t)i;
+        ref[i] = i;
+    }
+    check_matches(&t, ref, N);
+    rowtree_free(&t);
+    ASSERT_EQ_INT(0, t.count);
+}
+
+void test_append_n_bulk(void) {
+    /* Bulk-built tree must behave like one grown row by row, including
+     * the ragged last leaf/inner node and later edits on top. */
+    RowTree t;
+    rowtree_init(&t);
+    enum { N = 128 * 32 * 3 + 77 };
+    static int ref[N + 2];
+    ASSERT_EQ_INT(N, rowtree_append_n(&t, N));
+    for (int i = 0; i < N; i++) {
+        rowtree_at(&t, i)->chars.len = (size_t)i;
+        ref[i] = i;
+    }
+    check_matches(&t, ref, N);
+
+    rowtree_insert(&t, 500)->chars.len = 9999;
+    memmove(&ref[501], &ref[500], (size_t)(N - 500) * sizeof(int));
+    ref[500] = 9999;
+    ASSERT_EQ_INT(1, rowtree_append_n(&t, 1));
+    rowtree_at(&t, N + 1)->chars.len = 4242;
+    ref[N + 1] = 4242;
+    check_matches(&t, ref, N + 2);
+
+    for (int i = 0; i < N + 2; i++)
+        rowtree_remove(&t, 0);
+    TEST_ASSERT_TRUE_MESSAGE(t.root == NULL, "tree not empty");
+    rowtree_free(&t);
+}
+
+void test_random_insert_remove(void) {
+    RowTree t;
+    rowtree_init(&t);
+    enum { OPS = 60000, CAP = 20000 };
+    static int ref[CAP];
+    int n = 0, tag = 0;
+    srand(1234);
+    for (int op = 0; op < OPS; op++) {
+        int grow = n < 64 || (n < CAP && rand() % 100 < 55);
+        if (grow) {
+            int at = rand() % (n + 1);
+            Row *r = rowtree_insert(&t, at);
+            TEST_ASSERT_TRUE_MESSAGE(r != NULL, "insert failed");
+            r->chars.len = (size_t)++tag;
+            memmove(&ref[at + 1], &ref[at], (size_t)(n - at) * sizeof(int));
+            ref[at] = tag;
+            n++;
+        } else {
+            int at = rand() % n;
+            rowtree_remove(&t, at);
+            memmove(&ref[at], &ref[at + 1], (size_t)(n - at - 1) * sizeof(int));
+            n--;
+        }
+        if (op % 5000 == 0)
+            check_matches(&t, ref, n);
+    }
+    check_matches(&t, ref, n);
+    rowtree_free(&t);
+}
+
+void test_drain_front(void) {
+    /* Deleting a block at the top (dG from line 1) empties leaves one
+     * after another and must collapse the tree back to nothing. */
+    RowTree t;
+    rowtree_init(&t);
+    for (int i = 0; i < 5000; i++)
+        rowtree_insert(&t, i)->chars.len = (size_t)i;
+    for (int i = 0; i < 4999; i++) {
+        rowtree_remove(&t, 0);
+        ASSERT_EQ_INT(i + 1, (int)rowtree_at(&t, 0)->chars.len);
+    }
+    rowtree_remove(&t, 0);
+    ASSERT_EQ_INT(0, t.count);
+    TEST_ASSERT_TRUE_MESSAGE(t.root == NULL, "tree not empty");
+    rowtree_insert(&t, 0)->chars.len = 7;
+    ASSERT_EQ_INT(7, (int)rowtree_at(&t, 0)->chars.len);
+    rowtree_free(&t);
+}
+
+void test_index_of(void) {
+    RowTree t;
+    rowtree_init(&t);
+    for (int i = 0; i < 3000; i++)
+        rowtree_insert(&t, i);
+    for (int i = 0; i < 3000; i += 7) {
+        Row *r = rowtree_at(&t, i);
+        (void)rowtree_at(&t, 2999 - i); /* move the hint elsewhere */
+        ASSERT_EQ_INT(i, rowtree_index_of(&t, r));
+    }
+    Row stray;
+    ASSERT_EQ_INT(-1, rowtree_index_of(&t, &stray));
+    rowtree_free(&t);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_append_and_lookup);
+    RUN_TEST(test_append_n_bulk);
+    RUN_TEST(test_random_insert_remove);
+    RUN_TEST(test_drain_front);
+    RUN_TEST(test_index_of);
+    return UNITY_END();
+}
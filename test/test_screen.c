@@ -0,0 +1,109 @@
+/* Screen diff tests: present whole frames and check the update written
+ * to the terminal only carries what changed. */
+#include "../src/ui/screen.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void setUp(void) { screen_invalidate(); }
+void tearDown(void) { screen_free(); }
+
+#define ROWS 20
+#define COLS 40
+
+static int contains(const Abuf *ab, const char *needle) {
+    size_t n = strlen(needle);
+    for (int i = 0; i + (int)n <= ab->len; i++)
+        if (memcmp(ab->data + i, needle, n) == 0)
+            return 1;
+    return 0;
+}
+
+/* Paint rows "line <first + y>" the way the renderer does. */
+static void paint(Abuf *frame, int first, const char *row3) {
+    char line[64];
+    for (int y = 0; y < ROWS; y++) {
+        int n = snprintf(line, sizeof(line), "\x1b[%d;1H\x1b[32mline %d\x1b[m\x1b[K",
+                         y + 1, first + y);
+        ab_append(frame, line, n);
+        if (y == 3 && row3)
+            ab_append_str(frame, row3);
+    }
+}
+
+static void present(int first, const char *row3, Abuf *out) {
+    Abuf frame;
+    ab_init(&frame);
+    paint(&frame, first, row3);
+    ab_init(out);
+    screen_present(&frame, ROWS, COLS, 1, 1, out);
+    ab_free(&frame);
+}
+
+void test_unchanged_frame_writes_nothing(void) {
+    Abuf out;
+    present(0, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[2J"), "first frame repaints");
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "line 19"), "first frame drawn");
+    ab_free(&out);
+
+    present(0, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(!contains(&out, "line"), "no cells rewritten");
+    TEST_ASSERT_TRUE_MESSAGE(out.len < 48, "only the frame envelope");
+    ab_free(&out);
+}
+
+void test_one_cell_change(void) {
+    Abuf out;
+    present(0, " a", &out);
+    ab_free(&out);
+    present(0, " b", &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[4;8H\x1b[0mb"),
+                             "moves to the cell");
+    TEST_ASSERT_TRUE_MESSAGE(!contains(&out, "line"), "rest of the row kept");
+    ab_free(&out);
+
+    /* Shorter row: the tail is erased rather than painted. */
+    present(0, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[4;8H\x1b[0m\x1b[K"),
+                             "tail erased");
+    TEST_ASSERT_TRUE_MESSAGE(!contains(&out, "line"), "rest of the row kept");
+    ab_free(&out);
+}
+
+void test_scroll_uses_region(void) {
+    Abuf out;
+    present(0, NULL, &out);
+    ab_free(&out);
+    present(2, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[1;20r\x1b[2S\x1b[r"),
+                             "scrolled up by two");
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "line 21"), "new rows drawn");
+    TEST_ASSERT_TRUE_MESSAGE(!contains(&out, "line 10"), "kept rows not drawn");
+    ab_free(&out);
+
+    present(0, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[2T"), "scrolled down by two");
+    TEST_ASSERT_TRUE_MESSAGE(!contains(&out, "line 10"), "kept rows not drawn");
+    ab_free(&out);
+}
+
+void test_unknown_escape_passes_through(void) {
+    Abuf out;
+    present(0, "\x1b]0;title\x07", &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b]0;title\x07"), "sent verbatim");
+    ab_free(&out);
+    present(0, NULL, &out);
+    TEST_ASSERT_TRUE_MESSAGE(contains(&out, "\x1b[2J"), "then a full repaint");
+    ab_free(&out);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_frame_writes_nothing);
+    RUN_TEST(test_one_cell_change);
+    RUN_TEST(test_scroll_uses_region);
+    RUN_TEST(test_unknown_escape_passes_through);
+    return UNITY_END();
+}
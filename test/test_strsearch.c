@@ -0,0 +1,97 @@
+/* Literal search tests: strsearch_find / strsearch_rfind against a
+ * naive scan over random haystacks (small alphabet, so candidates are
+ * dense and the vector path's lane masks and tail loop both get work),
+ * plus the case-folding and boundary cases. */
+#include "../src/lib/strsearch.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void setUp(void) { }
+void tearDown(void) { }
+
+static int lower(int c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+
+static int naive_at(const char *h, const char *q, size_t len, int icase) {
+    for (size_t k = 0; k < len; k++) {
+        int a = (unsigned char)h[k], b = (unsigned char)q[k];
+        if (icase ? lower(a) != lower(b) : a != b) return 0;
+    }
+    return 1;
+}
+
+static int naive_find(const char *h, size_t n, const char *q, size_t len,
+                      size_t from, int icase) {
+    for (size_t i = from; len <= n && i + len <= n; i++)
+        if (naive_at(h + i, q, len, icase)) return (int)i;
+    return -1;
+}
+
+static int naive_rfind(const char *h, size_t n, const char *q, size_t len,
+                       size_t upto, int icase) {
+    int best = -1;
+    for (size_t i = 0; len <= n && i + len <= n && i <= upto; i++)
+        if (naive_at(h + i, q, len, icase)) best = (int)i;
+    return best;
+}
+
+static void test_matches_naive_scan(void) {
+    srand(7);
+    char hay[200], q[8];
+    for (int round = 0; round < 3000; round++) {
+        size_t n   = (size_t)(rand() % 200);
+        size_t len = 1 + (size_t)(rand() % 6);
+        int    icase = round & 1;
+        for (size_t i = 0; i < n; i++)   hay[i] = "abAB"[rand() % 4];
+        for (size_t i = 0; i < len; i++) q[i]   = "abAB"[rand() % 4];
+        StrSearch ss;
+        strsearch_init(&ss, q, len, icase);
+        size_t from = n ? (size_t)(rand() % (int)(n + 1)) : 0;
+        ASSERT_EQ_INT(naive_find(hay, n, q, len, from, icase),
+                      strsearch_find(&ss, hay, n, from));
+        ASSERT_EQ_INT(naive_rfind(hay, n, q, len, from, icase),
+                      strsearch_rfind(&ss, hay, n, from));
+    }
+}
+
+static void test_case_folding(void) {
+    const char *h = "Hello, WORLD; hello world";
+    StrSearch ss;
+    strsearch_init(&ss, "world", 5, true);
+    ASSERT_EQ_INT(7, strsearch_find(&ss, h, strlen(h), 0));
+    ASSERT_EQ_INT(20, strsearch_find(&ss, h, strlen(h), 8));
+    ASSERT_EQ_INT(20, strsearch_rfind(&ss, h, strlen(h), 100));
+    strsearch_init(&ss, "world", 5, false);
+    ASSERT_EQ_INT(20, strsearch_find(&ss, h, strlen(h), 0));
+    /* Only ASCII letters fold. */
+    strsearch_init(&ss, "[x]", 3, true);
+    ASSERT_EQ_INT(-1, strsearch_find(&ss, "{X}", 3, 0));
+}
+
+static void test_bounds(void) {
+    StrSearch ss;
+    strsearch_init(&ss, "", 0, false);
+    ASSERT_EQ_INT(-1, strsearch_find(&ss, "abc", 3, 0));
+    strsearch_init(&ss, "abc", 3, false);
+    ASSERT_EQ_INT(-1, strsearch_find(&ss, "ab", 2, 0));
+    ASSERT_EQ_INT(-1, strsearch_find(&ss, "abc", 3, 4));
+    ASSERT_EQ_INT(0, strsearch_find(&ss, "abc", 3, 0));
+    /* A match ending exactly at the end of a long haystack. */
+    char big[4099];
+    memset(big, 'a', sizeof(big));
+    memcpy(big + sizeof(big) - 3, "abc", 3);
+    big[sizeof(big) - 4] = 'x';
+    ASSERT_EQ_INT(4096, strsearch_find(&ss, big, sizeof(big), 0));
+    ASSERT_EQ_INT(-1, strsearch_rfind(&ss, big, sizeof(big), 4095));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_naive_scan);
+    RUN_TEST(test_case_folding);
+    RUN_TEST(test_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,469 @@
+/* Undo tests: random edit groups on a stub buffer (in-place splices,
+ * repeated edits of one row, row swaps, inserts and deletes mixed in
+ * one group), then random undo/redo walks checked against a snapshot
+ * of every group. Random walks over the undo tree by undo, redo,
+ * count and time. Also the depth limit, the byte budget, and a
+ * history saved to an undofile and restored lazily, including groups
+ * that can no longer be read. */
+#include "../src/buf/buffer.h"
+#include "../src/fs/fs.h"
+#include "../src/hooks.h"
+#include "../src/utils/undofile.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The pieces of buffer.c, row.c, hooks.c, fs.c and log.c undo.c calls. */
+static Buffer g_buf;
+Buffer *buf_cur(void) { return &g_buf; }
+void buf_note_edit(Buffer *buf, int row, int old_rows, int new_rows) {
+    (void)buf; (void)row; (void)old_rows; (void)new_rows;
+}
+void buf_row_update(Row *row) { (void)row; }
+void hook_register_mode(HookType type, HookModeCallback callback) {
+    (void)type; (void)callback;
+}
+void hook_register_buffer(HookType type, int mode, const char *filetype,
+                          HookBufferCallback callback) {
+    (void)type; (void)mode; (void)filetype; (void)callback;
+}
+void log_msg(const char *fmt, ...) { (void)fmt; }
+bool fs_path_cache_for_cwd(const char *name, char *out, size_t out_sz) {
+    (void)name; (void)out; (void)out_sz;
+    return false;
+}
+EdError fs_mkdir_p(const char *path) { (void)path; return ED_OK; }
+char *fs_path_to_file_uri(const char *path, const char *base_dir) {
+    (void)path; (void)base_dir;
+    return NULL;
+}
+const char *fs_uri_to_path(const char *uri) { return uri; }
+int fs_path_join(char *out, size_t out_sz, const char *dir, const char *path) {
+    (void)out; (void)out_sz; (void)dir; (void)path;
+    return 0;
+}
+
+void buf_row_insert_in(Buffer *buf, int at, const char *s, size_t len) {
+    Row *row = rowtree_insert(&buf->rows, at);
+    buf->num_rows++;
+    undo_record_insert(buf, at, s, len);
+    row->chars  = strbuf_from(s, len);
+    row->render = strbuf_new();
+}
+
+void buf_row_del_in(Buffer *buf, int at) {
+    Row *row = buf_row(buf, at);
+    undo_record_delete(buf, at, row->chars.data, row->chars.len);
+    strbuf_free(&row->chars);
+    strbuf_free(&row->render);
+    rowtree_remove(&buf->rows, at);
+    buf->num_rows--;
+}
+
+static void reset_buf(void) {
+    while (g_buf.num_rows > 0) {
+        Row *row = buf_row(&g_buf, 0);
+        strbuf_free(&row->chars);
+        strbuf_free(&row->render);
+        rowtree_remove(&g_buf.rows, 0);
+        g_buf.num_rows--;
+    }
+    undo_state_free(&g_buf.undo);
+    undo_state_init(&g_buf.undo);
+}
+
+void setUp(void) {
+    rowtree_init(&g_buf.rows);
+    undo_state_init(&g_buf.undo);
+}
+
+void tearDown(void) {
+    reset_buf();
+    rowtree_free(&g_buf.rows);
+}
+
+/* Whole buffer as one string, rows joined with '\n'. */
+static char *dump(void) {
+    StrBuf s = strbuf_new();
+    for (int i = 0; i < g_buf.num_rows; i++) {
+        Row *row = buf_row(&g_buf, i);
+        strbuf_append(&s, row->chars.data, row->chars.len);
+        strbuf_append_char(&s, '\n');
+    }
+    char *out = strbuf_to_cstr(&s);
+    strbuf_free(&s);
+    return out;
+}
+
+static void rand_text(char *out, int n) {
+    for (int i = 0; i < n; i++) out[i] = "abc "[rand() % 4];
+}
+
+/* Splice random text into row r the way the row primitives do:
+ * record first, then mutate. */
+static void splice(int r) {
+    undo_record_replace(&g_buf, r);
+    Row   *row = buf_row(&g_buf, r);
+    size_t at  = row->chars.len ? (size_t)rand() % (row->chars.len + 1) : 0;
+    size_t cut = (size_t)rand() % (row->chars.len - at + 1);
+    char   ins[8];
+    int    n = rand() % 6;
+    rand_text(ins, n);
+    StrBuf next = strbuf_new();
+    strbuf_append(&next, row->chars.data, at);
+    strbuf_append(&next, ins, (size_t)n);
+    strbuf_append(&next, row->chars.data + at + cut, row->chars.len - at - cut);
+    strbuf_free(&row->chars);
+    row->chars = next;
+}
+
+static void random_edit(void) {
+    int n = g_buf.num_rows;
+    switch (rand() % 6) {
+    case 0: case 1:
+        if (n) splice(rand() % n);
+        break;
+    case 2: {
+        char t[12];
+        int  len = rand() % 12;
+        rand_text(t, len);
+        buf_row_insert_in(&g_buf, rand() % (n + 1), t, (size_t)len);
+        break;
+    }
+    case 3:
+        if (n > 1) buf_row_del_in(&g_buf, rand() % n);
+        break;
+    case 4:
+        if (n > 1) { /* move a line: both rows recorded, then swapped */
+            int    r = rand() % (n - 1);
+            undo_record_replace(&g_buf, r);
+            undo_record_replace(&g_buf, r + 1);
+            StrBuf tmp = buf_row(&g_buf, r)->chars;
+            buf_row(&g_buf, r)->chars = buf_row(&g_buf, r + 1)->chars;
+            buf_row(&g_buf, r + 1)->chars = tmp;
+        }
+        break;
+    case 5: /* split a row after editing it, like typing then Enter */
+        if (n) {
+            int r = rand() % n;
+            splice(r);
+            Row   *row = buf_row(&g_buf, r);
+            size_t at  = row->chars.len / 2;
+            undo_record_replace(&g_buf, r);
+            char tail[64];
+            size_t tl = row->chars.len - at < sizeof(tail) ? row->chars.len - at : sizeof(tail);
+            if (tl) memcpy(tail, row->chars.data + at, tl);
+            buf_row_insert_in(&g_buf, r + 1, tail, tl);
+            row = buf_row(&g_buf, r);
+            row->chars.len = at;
+            splice(r + 1);
+        }
+        break;
+    }
+}
+
+static void test_random_undo_redo(void) {
+    srand(23);
+    for (int round = 0; round < 40; round++) {
+        reset_buf();
+        for (int i = 0; i < 6; i++) buf_row_insert_in(&g_buf, i, "one two", 7);
+        undo_end(&g_buf);
+
+        char *snap[64];
+        int   top = 0, len = 0; /* snap[top] is the current state */
+        snap[0] = dump();
+        for (int step = 0; step < 120; step++) {
+            int op = rand() % 4;
+            if (op == 0 && top > 0) {
+                TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo");
+                top--;
+            } else if (op == 1 && top < len) {
+                TEST_ASSERT_TRUE_MESSAGE(redo_apply(&g_buf), "redo");
+                top++;
+            } else if (top < 63) {
+                undo_begin(&g_buf, "edit");
+                for (int e = 1 + rand() % 5; e > 0; e--) random_edit();
+                undo_end(&g_buf);
+                for (int k = top + 1; k <= len; k++) free(snap[k]);
+                snap[++top] = dump();
+                len = top;
+            }
+            char *now = dump();
+            char  msg[64];
+            snprintf(msg, sizeof(msg), "round %d step %d", round, step);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[top], now, msg);
+            free(now);
+        }
+        while (top > 0) {
+            TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo to start");
+            top--;
+        }
+        char *now = dump();
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[0], now, "back at the start");
+        free(now);
+        for (int k = 0; k <= len; k++) free(snap[k]);
+    }
+}
+
+/* Edits after undo branch off; every state stays reachable. After each
+ * step the text must be the one recorded when the current group was
+ * made. Group times are faked so :earlier / :later by time can be
+ * checked against a scan. */
+static void test_tree(void) {
+    srand(25);
+    for (int round = 0; round < 20; round++) {
+        reset_buf();
+        for (int i = 0; i < 5; i++) buf_row_insert_in(&g_buf, i, "one two", 7);
+        undo_end(&g_buf);
+        char      *snap[200];
+        long long  clock = 1000;
+        int        made  = 0;
+        snap[0]          = dump();
+        g_buf.undo.ring[0].time = clock;
+        ASSERT_EQ_INT(0, g_buf.undo.cur);
+        for (int step = 0; step < 150; step++) {
+            UndoState *u   = &g_buf.undo;
+            int        cur = u->cur;
+            int        op  = rand() % 6;
+            if (op == 0 || made == 0) {
+                if (made == 199) continue;
+                undo_begin(&g_buf, "edit");
+                buf_row_insert_in(&g_buf, rand() % (g_buf.num_rows + 1), "new", 3);
+                for (int e = rand() % 4; e > 0; e--) random_edit();
+                undo_end(&g_buf);
+                clock += rand() % 30;
+                undo_group_seq(u, u->cur)->time = clock;
+                snap[++made] = dump();
+                ASSERT_EQ_INT(made, u->cur);
+            } else if (op == 1) {
+                undo_apply(&g_buf);
+            } else if (op == 2) {
+                redo_apply(&g_buf);
+            } else if (op == 3) {
+                int n    = rand() % 21 - 10;
+                /* Groups are numbered from 0, the root just before. */
+                int want = cur + n;
+                if (want < UNDO_ROOT) want = UNDO_ROOT;
+                if (want > made) want = made;
+                undo_goto_step(&g_buf, n);
+                ASSERT_EQ_INT(want, u->cur);
+            } else {
+                long long secs = rand() % 200 - 100;
+                long long now  = cur == UNDO_ROOT ? u->ring[0].time - 1
+                                                  : undo_group_seq(u, cur)->time;
+                int want = UNDO_ROOT;
+                for (int k = 0; k <= made; k++)
+                    if (undo_group_seq(u, k)->time <= now + secs)
+                        want = k;
+                undo_goto_time(&g_buf, secs);
+                ASSERT_EQ_INT(want, u->cur);
+            }
+            char *now = dump();
+            char  msg[64];
+            snprintf(msg, sizeof(msg), "round %d step %d", round, step);
+            if (u->cur == UNDO_ROOT)
+                TEST_ASSERT_TRUE_MESSAGE(!now || !*now, msg);
+            else
+                TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[u->cur], now, msg);
+            free(now);
+        }
+        for (int k = 0; k <= made; k++) free(snap[k]);
+    }
+}
+
+static void test_depth_limit(void) {
+    buf_row_insert_in(&g_buf, 0, "", 0);
+    undo_end(&g_buf);
+    for (int i = 0; i < UNDO_MAX_DEPTH + 50; i++) {
+        undo_begin(&g_buf, "x");
+        undo_record_replace(&g_buf, 0);
+        strbuf_append_char(&buf_row(&g_buf, 0)->chars, 'x');
+        undo_end(&g_buf);
+    }
+    int n = 0;
+    while (undo_apply(&g_buf)) n++;
+    ASSERT_EQ_INT(UNDO_MAX_DEPTH, n);
+}
+
+static void test_budget(void) {
+    size_t big = UNDO_BUDGET_BYTES / 4;
+    char  *text = malloc(big);
+    memset(text, 'z', big);
+    for (int i = 0; i < 10; i++) {
+        undo_begin(&g_buf, "paste");
+        buf_row_insert_in(&g_buf, 0, text, big);
+        undo_end(&g_buf);
+        TEST_ASSERT_TRUE_MESSAGE(g_buf.undo.arena.bytes <= UNDO_BUDGET_BYTES + big,
+                                 "arena within budget");
+    }
+    int n = 0;
+    while (undo_apply(&g_buf)) n++;
+    TEST_ASSERT_TRUE_MESSAGE(n >= 3 && n < 10, "oldest pastes dropped");
+    ASSERT_EQ_INT(10 - n, g_buf.num_rows);
+    reset_buf();
+
+    /* The newest group stays undoable even when it alone is over. */
+    undo_begin(&g_buf, "huge");
+    for (int i = 0; i < 5; i++) buf_row_insert_in(&g_buf, 0, text, big);
+    undo_end(&g_buf);
+    TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "huge group undone");
+    ASSERT_EQ_INT(0, g_buf.num_rows);
+    reset_buf();
+
+    /* Row snapshots an open group holds count too. */
+    for (int i = 0; i < 3; i++) {
+        undo_begin(&g_buf, "paste");
+        buf_row_insert_in(&g_buf, 0, text, big);
+        undo_end(&g_buf);
+    }
+    ASSERT_EQ_INT(3, g_buf.undo.len);
+    undo_begin(&g_buf, "edit");
+    undo_record_replace(&g_buf, 0);
+    undo_record_replace(&g_buf, 1);
+    TEST_ASSERT_TRUE_MESSAGE(g_buf.undo.len < 3, "pastes dropped for snapshots");
+    TEST_ASSERT_TRUE_MESSAGE(g_buf.undo.arena.bytes + g_buf.undo.pending_bytes <=
+                                 UNDO_BUDGET_BYTES + big,
+                             "snapshots within budget");
+    undo_end(&g_buf);
+    ASSERT_EQ_INT(0, (int)g_buf.undo.pending_bytes);
+    free(text);
+}
+
+/* Log groups, checkpoint, then drop the history as a reload does and
+ * attach again: every state is reachable by undo and back by redo. */
+static void test_undofile(void) {
+    char path[] = "/tmp/hed_undo_XXXXXX";
+    int  fd     = mkstemp(path);
+    TEST_ASSERT_TRUE_MESSAGE(fd >= 0, "temp file");
+    close(fd);
+    unlink(path);
+
+    srand(24);
+    undofile_attach(&g_buf, path);
+    for (int i = 0; i < 4; i++) buf_row_insert_in(&g_buf, i, "one two", 7);
+    undo_end(&g_buf);
+    char *snap[21];
+    snap[0] = dump();
+    for (int k = 1; k <= 20; k++) {
+        undo_begin(&g_buf, "edit");
+        for (int e = 1 + rand() % 5; e > 0; e--) random_edit();
+        undo_end(&g_buf);
+        snap[k] = dump();
+    }
+    /* Undo a few so the checkpoint carries redo groups too. */
+    for (int k = 0; k < 5; k++) TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo");
+    undofile_checkpoint(&g_buf);
+    /* Unsaved groups after the checkpoint are cut off on restore. */
+    undo_begin(&g_buf, "unsaved");
+    buf_row_insert_in(&g_buf, 0, "x", 1);
+    undo_end(&g_buf);
+    TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo unsaved");
+
+    undo_state_free(&g_buf.undo);
+    undo_state_init(&g_buf.undo);
+    TEST_ASSERT_TRUE_MESSAGE(undofile_attach(&g_buf, path), "restored");
+    ASSERT_EQ_INT(21, g_buf.undo.len);
+    ASSERT_EQ_INT(15, g_buf.undo.cur);
+    TEST_ASSERT_TRUE_MESSAGE(!undo_group_at(&g_buf.undo, 0)->first, "left on disk");
+    for (int k = 15; k > 0; k--) {
+        TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo restored");
+        char *now = dump();
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[k - 1], now, "after undo");
+        free(now);
+    }
+    for (int k = 1; k <= 20; k++) {
+        TEST_ASSERT_TRUE_MESSAGE(redo_apply(&g_buf), "redo restored");
+        char *now = dump();
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[k], now, "after redo");
+        free(now);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(!redo_apply(&g_buf), "redo exhausted");
+
+    /* Text that is not the checkpointed one starts the log over. */
+    undo_state_free(&g_buf.undo);
+    undo_state_init(&g_buf.undo);
+    TEST_ASSERT_TRUE_MESSAGE(!undofile_attach(&g_buf, path), "other text");
+    ASSERT_EQ_INT(0, g_buf.undo.len);
+
+    for (int k = 0; k <= 20; k++) free(snap[k]);
+    unlink(path);
+}
+
+/* Groups that cannot be read back when the buffer moves to another
+ * undofile are given up, and the next checkpoint still restores. */
+static void test_undofile_lost_group(void) {
+    char path[] = "/tmp/hed_undo_XXXXXX", moved[] = "/tmp/hed_undo_XXXXXX";
+    int  fd     = mkstemp(path);
+    int  fd2    = mkstemp(moved);
+    TEST_ASSERT_TRUE_MESSAGE(fd >= 0 && fd2 >= 0, "temp files");
+    close(fd2);
+    unlink(moved);
+
+    srand(7);
+    undofile_attach(&g_buf, path);
+    for (int i = 0; i < 4; i++) buf_row_insert_in(&g_buf, i, "one two", 7);
+    undo_end(&g_buf);
+    char *snap[11];
+    snap[0] = dump();
+    for (int k = 1; k <= 10; k++) {
+        undo_begin(&g_buf, "edit");
+        splice(0); /* never an empty group */
+        for (int e = rand() % 3; e > 0; e--) random_edit();
+        undo_end(&g_buf);
+        snap[k] = dump();
+    }
+    for (int k = 0; k < 3; k++) TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo");
+    undofile_checkpoint(&g_buf);
+    undo_state_free(&g_buf.undo);
+    undo_state_init(&g_buf.undo);
+    TEST_ASSERT_TRUE_MESSAGE(undofile_attach(&g_buf, path), "restored");
+    ASSERT_EQ_INT(7, g_buf.undo.cur);
+
+    /* Spoil group 3, on the way back from the current state, and group
+     * 9, on the redo branch. */
+    for (int i = 3; i <= 9; i += 6) {
+        long long off = undo_group_at(&g_buf.undo, i)->disk_off;
+        TEST_ASSERT_TRUE_MESSAGE(pwrite(fd, "XXXX", 4, off + 30) == 4, "spoil");
+    }
+    close(fd);
+    TEST_ASSERT_TRUE_MESSAGE(!undofile_attach(&g_buf, moved), "moved");
+    undofile_checkpoint(&g_buf);
+
+    undo_state_free(&g_buf.undo);
+    undo_state_init(&g_buf.undo);
+    TEST_ASSERT_TRUE_MESSAGE(undofile_attach(&g_buf, moved), "checkpoint kept");
+    /* Undo now stops at group 3's state, and redo before group 9. */
+    for (int k = 7; k > 3; k--) {
+        TEST_ASSERT_TRUE_MESSAGE(undo_apply(&g_buf), "undo to group 3");
+        char *now = dump();
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[k - 1], now, "after undo");
+        free(now);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(!undo_apply(&g_buf), "group 3 gone");
+    for (int k = 4; k <= 8; k++) {
+        TEST_ASSERT_TRUE_MESSAGE(redo_apply(&g_buf), "redo");
+        char *now = dump();
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(snap[k], now, "after redo");
+        free(now);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(!redo_apply(&g_buf), "group 9 gone");
+
+    for (int k = 0; k <= 10; k++) free(snap[k]);
+    unlink(path);
+    unlink(moved);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_random_undo_redo);
+    RUN_TEST(test_tree);
+    RUN_TEST(test_depth_limit);
+    RUN_TEST(test_budget);
+    RUN_TEST(test_undofile);
+    RUN_TEST(test_undofile_lost_group);
+    return UNITY_END();
+}
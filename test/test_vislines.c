@@ -0,0 +1,196 @@
+/* Screen-row index tests: random in-place edits, inserts, deletes,
+ * fold toggles and block_below changes on a stub buffer, with every
+ * query checked against a linear recount of the line heights. Also
+ * the per-buffer cache of indexes by wrap width. */
+#include "../src/buf/vislines.h"
+#include "test_helpers.h"
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The pieces of buffer.c and virtual_text.c vislines.c calls. Block
+ * rows below each line come from g_vt instead of vtext marks; like
+ * marks, they stay on their line number when rows move. */
+static Buffer g_buf;
+static int    g_vt[512];
+
+void buf_edit_span_clear(BufEditSpan *span) { memset(span, 0, sizeof(*span)); }
+
+void buf_edit_span_attach(Buffer *buf, BufEditSpan *span) {
+    buf_edit_span_clear(span);
+    arrput(buf->edit_spans, span);
+}
+
+void buf_edit_span_detach(Buffer *buf, BufEditSpan *span) {
+    for (ptrdiff_t i = 0; i < arrlen(buf->edit_spans); i++) {
+        if (buf->edit_spans[i] == span) {
+            arrdel(buf->edit_spans, i);
+            return;
+        }
+    }
+}
+
+/* Same widening as buffer.c. */
+void buf_note_edit(Buffer *buf, int row, int old_rows, int new_rows) {
+    for (ptrdiff_t i = 0; i < arrlen(buf->edit_spans); i++) {
+        BufEditSpan *s = buf->edit_spans[i];
+        int d = new_rows - old_rows;
+        if (!s->touched) {
+            *s = (BufEditSpan){true, false, row, row + new_rows, d};
+            continue;
+        }
+        int hi = row + old_rows <= s->hi ? s->hi + d : row + new_rows;
+        if (hi < row + new_rows)
+            hi = row + new_rows;
+        if (row < s->lo)
+            s->lo = row;
+        s->hi = hi;
+        s->delta += d;
+    }
+}
+
+void vtext_block_below_counts(const Buffer *b, int *rows, int n) {
+    (void)b;
+    for (int i = 0; i < n; i++)
+        rows[i] += g_vt[i];
+}
+
+static void set_row(int at, int width) {
+    Row *row = buf_row(&g_buf, at);
+    strbuf_free(&row->chars);
+    row->chars = strbuf_new();
+    for (int i = 0; i < width; i++)
+        strbuf_append_char(&row->chars, 'x');
+    strbuf_free(&row->render);
+    row->render = strbuf_from(row->chars.data, row->chars.len);
+}
+
+static void insert_row(int at, int width) {
+    rowtree_insert(&g_buf.rows, at);
+    g_buf.num_rows++;
+    set_row(at, width);
+    buf_note_edit(&g_buf, at, 0, 1);
+}
+
+static void delete_row(int at) {
+    Row *row = buf_row(&g_buf, at);
+    strbuf_free(&row->chars);
+    strbuf_free(&row->render);
+    rowtree_remove(&g_buf.rows, at);
+    g_buf.num_rows--;
+    buf_note_edit(&g_buf, at, 1, 0);
+}
+
+void setUp(void) {
+    memset(&g_buf, 0, sizeof(g_buf));
+    memset(g_vt, 0, sizeof(g_vt));
+    rowtree_init(&g_buf.rows);
+    fold_list_init(&g_buf.folds);
+}
+
+void tearDown(void) {
+    vislines_free_all(&g_buf);
+    while (g_buf.num_rows > 0)
+        delete_row(0);
+    arrfree(g_buf.edit_spans);
+    fold_list_free(&g_buf.folds);
+    rowtree_free(&g_buf.rows);
+}
+
+static int ref_height(int line, int cols) {
+    if (fold_is_line_hidden(&g_buf.folds, line))
+        return 0;
+    int w = (int)buf_row(&g_buf, line)->chars.len;
+    int h = cols <= 0 || w == 0 ? 1 : (w + cols - 1) / cols;
+    return h + g_vt[line];
+}
+
+static void check_all(int cols) {
+    VisLines *vl = vislines_get(&g_buf, cols);
+    TEST_ASSERT_NOT_NULL_MESSAGE(vl, "index built");
+    ASSERT_EQ_INT(g_buf.num_rows, vl->n);
+    int vrow = 0;
+    for (int y = 0; y < g_buf.num_rows; y++) {
+        int h = ref_height(y, cols);
+        ASSERT_EQ_INT(vrow, vislines_row_start(vl, y));
+        for (int s = 0; s < h; s++) {
+            int sub = -1;
+            ASSERT_EQ_INT(y, vislines_find(vl, vrow + s, &sub));
+            ASSERT_EQ_INT(s, sub);
+        }
+        vrow += h;
+    }
+    ASSERT_EQ_INT(vrow, vislines_row_start(vl, g_buf.num_rows));
+    ASSERT_EQ_INT(vrow, vislines_total(vl));
+    ASSERT_EQ_INT(g_buf.num_rows, vislines_find(vl, vrow, NULL));
+}
+
+void test_random_edits_match_recount(void) {
+    enum { LINES = 200 };
+    srand(11);
+    for (int i = 0; i < LINES; i++)
+        insert_row(i, rand() % 50);
+    check_all(0);
+    check_all(16);
+    for (int op = 0; op < 2000; op++) {
+        int k = rand() % 12;
+        int n = g_buf.num_rows;
+        if (k < 5 && n > 0) {
+            int at = rand() % n;
+            set_row(at, rand() % 50);
+            buf_note_edit(&g_buf, at, 1, 1);
+        } else if (k < 7 && n < LINES * 2) {
+            insert_row(rand() % (n + 1), rand() % 50);
+        } else if (k < 9 && n > 1) {
+            delete_row(rand() % n);
+        } else if (k == 9) {
+            int a = rand() % n, len = rand() % 20;
+            fold_add_region(&g_buf.folds, a, a + len < n ? a + len : n - 1);
+            fold_set_collapsed(&g_buf.folds, g_buf.folds.count - 1, true);
+        } else if (k == 10 && g_buf.folds.count > 0) {
+            fold_set_collapsed(&g_buf.folds, rand() % g_buf.folds.count,
+                               rand() % 2);
+        } else {
+            g_vt[rand() % n] = rand() % 3;
+            g_buf.vtext.block_seq++;
+        }
+        /* Alternate widths so both indexes see runs of several edits
+         * between syncs. */
+        if (op % 3 == 0)
+            check_all(0);
+        if (op % 5 == 0)
+            check_all(16);
+    }
+    check_all(0);
+    check_all(16);
+    ASSERT_EQ_INT(2, (int)arrlen(g_buf.vis_lines));
+}
+
+void test_cache_evicts_least_recent(void) {
+    for (int i = 0; i < 10; i++)
+        insert_row(i, i * 7);
+    for (int c = 1; c <= VISLINES_CACHE; c++)
+        vislines_get(&g_buf, c * 10);
+    vislines_get(&g_buf, 10); /* 20 is now the least recent */
+    vislines_get(&g_buf, 99);
+    ASSERT_EQ_INT(VISLINES_CACHE, (int)arrlen(g_buf.vis_lines));
+    for (ptrdiff_t i = 0; i < arrlen(g_buf.vis_lines); i++)
+        TEST_ASSERT_TRUE_MESSAGE(g_buf.vis_lines[i]->cols != 20,
+                                 "least recent width evicted");
+    /* Widths <= 0 share the no-wrap index. */
+    VisLines *a = vislines_get(&g_buf, 0);
+    ASSERT_EQ_INT(1, a == vislines_get(&g_buf, -5));
+    /* An evicted width comes back correct. */
+    set_row(3, 45);
+    buf_note_edit(&g_buf, 3, 1, 1);
+    check_all(20);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_random_edits_match_recount);
+    RUN_TEST(test_cache_evicts_least_recent);
+    return UNITY_END();
+}